@@ -0,0 +1,93 @@
+/**
+ * @file bench_contexts.c
+ * @brief Benchmark for creating and destroying many TinyCLI contexts
+ *
+ * Usage: tinycli-bench-contexts [total] [batch]
+ *
+ * Creates `total` contexts (default 100000) on a shared runtime, keeping up
+ * to `batch` of them (default 1000) alive at once, and reports the cost per
+ * context and the framework memory used by a live batch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "tinycli.h"
+#include "alloc.h"
+
+/* Current monotonic time in nanoseconds */
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+    tinycli_runtime_t *runtime;
+    tinycli_context_t **batch;
+    tinycli_mem_stats_t before, live;
+    size_t total = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+    size_t batch_size = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000;
+    size_t done = 0, i, n;
+    double start, create_ns = 0, free_ns = 0;
+    uint64_t batch_bytes = 0;
+
+    if (total == 0 || batch_size == 0) {
+        fprintf(stderr, "Usage: %s [total] [batch]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    runtime = tinycli_runtime_create();
+    batch = (tinycli_context_t **)malloc(batch_size * sizeof(*batch));
+    if (!runtime || !batch) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    tinycli_mem_get_total(&before);
+
+    while (done < total) {
+        n = total - done < batch_size ? total - done : batch_size;
+
+        /* Create a batch of contexts */
+        start = now_ns();
+        for (i = 0; i < n; i++) {
+            batch[i] = tinycli_init_with_runtime(runtime, "bench> ");
+            if (!batch[i]) {
+                fprintf(stderr, "Error: Failed to create context %zu\n", done + i);
+                return EXIT_FAILURE;
+            }
+        }
+        create_ns += now_ns() - start;
+
+        /* Measure the memory held by the live batch */
+        tinycli_mem_get_total(&live);
+        if (live.live_bytes - before.live_bytes > batch_bytes) {
+            batch_bytes = live.live_bytes - before.live_bytes;
+        }
+
+        /* Destroy the batch */
+        start = now_ns();
+        for (i = 0; i < n; i++) {
+            tinycli_cleanup(batch[i]);
+        }
+        free_ns += now_ns() - start;
+
+        done += n;
+    }
+
+    printf("Contexts created and destroyed: %zu (batches of %zu)\n", total, batch_size);
+    printf("  create:  %10.1f ns/context\n", create_ns / (double)total);
+    printf("  destroy: %10.1f ns/context\n", free_ns / (double)total);
+    printf("  memory:  %10.1f bytes/context\n",
+           (double)batch_bytes / (double)(total < batch_size ? total : batch_size));
+
+    free(batch);
+    tinycli_runtime_release(runtime);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,523 @@
+/**
+ * @file loadgen.c
+ * @brief Synthetic load generator for TinyCLI
+ *
+ * Usage: tinycli-loadgen [options]
+ *
+ *   --socket <path>     Connect to a server started with 'tinycli --listen'
+ *                       (default: run contexts in this process)
+ *   --clients <n>       Concurrent client sessions (default 4)
+ *   --rate <qps>        Target rate over all clients (default 0: as fast as possible)
+ *   --duration <s>      Measurement time in seconds (default 5)
+ *   --command [w:]line  Add a command line with weight w to the mix (default "noop")
+ *   --setup <line>      Run a line once per session before measuring
+ *                       (default "load plugin noop")
+ *
+ * With a target rate, requests are scheduled at fixed intervals and latency
+ * is measured from the scheduled time, so a stalled server shows up as
+ * latency instead of silently lowering the request rate.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "tinycli.h"
+#include "output.h"
+
+/* Maximum number of mix and setup lines */
+#define LOADGEN_MAX_LINES 64
+
+/* Histogram: 8 linear sub-buckets per power of two from 64 ns to 2^40 ns */
+#define HIST_SUB_BITS 3
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_MIN_SHIFT 6
+#define HIST_MAX_SHIFT 40
+#define HIST_BUCKETS ((HIST_MAX_SHIFT - HIST_MIN_SHIFT + 1) * HIST_SUB)
+
+/* Size of a socket client's receive buffer */
+#define LOADGEN_RECV_SIZE 65536
+
+/* Weighted command line */
+typedef struct {
+    unsigned int weight;            /* Relative weight */
+    const char *line;               /* Command line */
+} mix_entry_t;
+
+/* Load generator configuration */
+typedef struct {
+    const char *socket_path;        /* Server socket (NULL for in-process) */
+    unsigned int clients;           /* Concurrent sessions */
+    double rate;                    /* Target requests per second (0 for unlimited) */
+    double duration;                /* Measurement time in seconds */
+    mix_entry_t mix[LOADGEN_MAX_LINES]; /* Command mix */
+    unsigned int mix_count;         /* Lines in the mix */
+    unsigned int total_weight;      /* Sum of the weights */
+    const char *setup[LOADGEN_MAX_LINES]; /* Per-session setup lines */
+    unsigned int setup_count;       /* Number of setup lines */
+} loadgen_config_t;
+
+/* Client session state */
+typedef struct {
+    const loadgen_config_t *config; /* Configuration */
+    unsigned int id;                /* Client number */
+    pthread_barrier_t *barrier;     /* Start barrier */
+    tinycli_context_t *ctx;         /* In-process context */
+    int fd;                         /* Server connection */
+    char *buf;                      /* Receive buffer */
+    size_t buf_len;                 /* Unread bytes in the buffer */
+    uint64_t rng;                   /* Command selection state */
+    uint64_t requests;              /* Completed requests */
+    uint64_t errors;                /* Requests that returned an error */
+    uint64_t transport_errors;      /* Failed connections or replies */
+    uint64_t hist[HIST_BUCKETS];    /* Latency histogram */
+    uint64_t max_ns;                /* Largest latency */
+} loadgen_client_t;
+
+/* Current monotonic time in nanoseconds */
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Sleep until a monotonic time */
+static void sleep_until(uint64_t target_ns)
+{
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)(target_ns / 1000000000ull);
+    ts.tv_nsec = (long)(target_ns % 1000000000ull);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+/* Histogram bucket of a latency */
+static unsigned int hist_bucket(uint64_t ns)
+{
+    unsigned int msb;
+
+    if (ns < (1ull << HIST_MIN_SHIFT)) {
+        return 0;
+    }
+    msb = 63 - (unsigned int)__builtin_clzll(ns);
+    if (msb > HIST_MAX_SHIFT) {
+        return HIST_BUCKETS - 1;
+    }
+    return (msb - HIST_MIN_SHIFT) * HIST_SUB +
+           (unsigned int)((ns >> (msb - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+/* Upper bound of a histogram bucket */
+static uint64_t hist_upper(unsigned int bucket)
+{
+    unsigned int shift = HIST_MIN_SHIFT + bucket / HIST_SUB;
+    uint64_t sub = bucket % HIST_SUB;
+
+    return (((uint64_t)HIST_SUB + sub + 1) << (shift - HIST_SUB_BITS)) - 1;
+}
+
+/* Pick a command line from the mix */
+static const char *client_pick(loadgen_client_t *client)
+{
+    const loadgen_config_t *config = client->config;
+    unsigned int i, r;
+
+    /* xorshift64 */
+    client->rng ^= client->rng << 13;
+    client->rng ^= client->rng >> 7;
+    client->rng ^= client->rng << 17;
+
+    r = (unsigned int)(client->rng % config->total_weight);
+    for (i = 0; r >= config->mix[i].weight; i++) {
+        r -= config->mix[i].weight;
+    }
+
+    return config->mix[i].line;
+}
+
+/* Connect to the server */
+static int client_connect(loadgen_client_t *client)
+{
+    struct sockaddr_un addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, client->config->socket_path, sizeof(addr.sun_path) - 1);
+
+    client->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (client->fd < 0) {
+        return TINYCLI_ERROR_GENERAL;
+    }
+    if (connect(client->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(client->fd);
+        client->fd = -1;
+        return TINYCLI_ERROR_GENERAL;
+    }
+
+    client->buf = (char *)malloc(LOADGEN_RECV_SIZE);
+    return client->buf ? TINYCLI_SUCCESS : TINYCLI_ERROR_MEMORY;
+}
+
+/* Send a line to the server and wait for its reply */
+static int client_request(loadgen_client_t *client, const char *line, int *result)
+{
+    char request[4096];
+    size_t len = strlen(line), skip = 0;
+    bool have_header = false;
+    ssize_t n;
+
+    /* Send the line */
+    if (len + 1 > sizeof(request)) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+    memcpy(request, line, len);
+    request[len++] = '\n';
+    if (send(client->fd, request, len, MSG_NOSIGNAL) != (ssize_t)len) {
+        return TINYCLI_ERROR_GENERAL;
+    }
+
+    /* Read "<result> <length>\n" and skip the output */
+    for (;;) {
+        if (!have_header) {
+            char *nl = memchr(client->buf, '\n', client->buf_len);
+            if (nl) {
+                size_t used = (size_t)(nl - client->buf) + 1;
+
+                *nl = '\0';
+                if (sscanf(client->buf, "%d %zu", result, &skip) != 2) {
+                    return TINYCLI_ERROR_GENERAL;
+                }
+                client->buf_len -= used;
+                memmove(client->buf, client->buf + used, client->buf_len);
+                have_header = true;
+            }
+        }
+        if (have_header) {
+            size_t consumed = skip < client->buf_len ? skip : client->buf_len;
+
+            skip -= consumed;
+            client->buf_len -= consumed;
+            memmove(client->buf, client->buf + consumed, client->buf_len);
+            if (skip == 0) {
+                return TINYCLI_SUCCESS;
+            }
+        }
+
+        if (client->buf_len == LOADGEN_RECV_SIZE) {
+            return TINYCLI_ERROR_GENERAL;
+        }
+        n = recv(client->fd, client->buf + client->buf_len,
+                 LOADGEN_RECV_SIZE - client->buf_len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return TINYCLI_ERROR_GENERAL;
+        }
+        client->buf_len += (size_t)n;
+    }
+}
+
+/* Execute one line in the client's session */
+static int client_execute(loadgen_client_t *client, const char *line, int *result)
+{
+    if (client->ctx) {
+        *result = tinycli_execute_line(client->ctx, line);
+        return TINYCLI_SUCCESS;
+    }
+
+    return client_request(client, line, result);
+}
+
+/* Client session thread */
+static void *client_thread(void *arg)
+{
+    loadgen_client_t *client = (loadgen_client_t *)arg;
+    const loadgen_config_t *config = client->config;
+    uint64_t start, end, interval = 0, next;
+    unsigned int i;
+    int ret = TINYCLI_SUCCESS, result;
+
+    /* Open the session */
+    client->fd = -1;
+    client->rng = 0x9e3779b97f4a7c15ull * (client->id + 1);
+    if (config->socket_path) {
+        ret = client_connect(client);
+    } else {
+        client->ctx = tinycli_init("");
+        if (client->ctx) {
+            tinycli_output_set_stream(client->ctx, NULL);
+        } else {
+            ret = TINYCLI_ERROR_MEMORY;
+        }
+    }
+
+    /* Run setup lines (a plugin may already be loaded in a shared server) */
+    for (i = 0; ret == TINYCLI_SUCCESS && i < config->setup_count; i++) {
+        ret = client_execute(client, config->setup[i], &result);
+        if (ret == TINYCLI_SUCCESS && result != TINYCLI_SUCCESS &&
+            result != TINYCLI_ERROR_PLUGIN_EXISTS) {
+            fprintf(stderr, "Warning: setup '%s' failed with error code %d\n",
+                    config->setup[i], result);
+        }
+    }
+    if (ret != TINYCLI_SUCCESS) {
+        client->transport_errors++;
+    }
+
+    pthread_barrier_wait(client->barrier);
+
+    /* Spread clients evenly over the request interval */
+    start = now_ns();
+    end = start + (uint64_t)(config->duration * 1e9);
+    if (config->rate > 0) {
+        interval = (uint64_t)(1e9 * config->clients / config->rate);
+        start += interval * client->id / config->clients;
+    }
+
+    next = start;
+    while (ret == TINYCLI_SUCCESS) {
+        uint64_t t0, latency;
+
+        if (interval) {
+            if (next >= end) {
+                break;
+            }
+            sleep_until(next);
+            t0 = next;
+            next += interval;
+        } else {
+            t0 = now_ns();
+            if (t0 >= end) {
+                break;
+            }
+        }
+
+        ret = client_execute(client, client_pick(client), &result);
+        if (ret != TINYCLI_SUCCESS) {
+            client->transport_errors++;
+            break;
+        }
+
+        latency = now_ns() - t0;
+        client->hist[hist_bucket(latency)]++;
+        if (latency > client->max_ns) {
+            client->max_ns = latency;
+        }
+        client->requests++;
+        if (result != TINYCLI_SUCCESS) {
+            client->errors++;
+        }
+    }
+
+    /* Close the session */
+    if (client->ctx) {
+        tinycli_cleanup(client->ctx);
+    }
+    if (client->fd >= 0) {
+        close(client->fd);
+    }
+    free(client->buf);
+
+    return NULL;
+}
+
+/* Latency at a quantile of the merged histogram */
+static uint64_t hist_quantile(const uint64_t *hist, uint64_t total, double q)
+{
+    uint64_t rank = (uint64_t)((double)total * q), seen = 0;
+    unsigned int i;
+
+    for (i = 0; i < HIST_BUCKETS; i++) {
+        seen += hist[i];
+        if (seen > rank) {
+            return hist_upper(i);
+        }
+    }
+
+    return hist_upper(HIST_BUCKETS - 1);
+}
+
+/* Print the histogram with one row per power of two */
+static void hist_print(const uint64_t *hist, uint64_t total)
+{
+    unsigned int row, i;
+
+    printf("Histogram:\n");
+    for (row = 0; row < HIST_BUCKETS / HIST_SUB; row++) {
+        uint64_t count = 0;
+        double share;
+
+        for (i = 0; i < HIST_SUB; i++) {
+            count += hist[row * HIST_SUB + i];
+        }
+        if (count == 0) {
+            continue;
+        }
+
+        share = 100.0 * (double)count / (double)total;
+        printf("  < %10.1f us %10llu %6.2f%% ", (double)(1ull << (row + HIST_MIN_SHIFT + 1)) / 1e3,
+               (unsigned long long)count, share);
+        for (i = 0; i < (unsigned int)(share / 2 + 0.5); i++) {
+            putchar('#');
+        }
+        putchar('\n');
+    }
+}
+
+/* Print usage */
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [--socket <path>] [--clients <n>] [--rate <qps>] [--duration <s>]\n"
+                    "       [--command [<weight>:]<line>]... [--setup <line>]...\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    loadgen_config_t config;
+    loadgen_client_t *clients;
+    pthread_barrier_t barrier;
+    pthread_t *threads;
+    uint64_t hist[HIST_BUCKETS], requests = 0, errors = 0, transport_errors = 0, max_ns = 0;
+    uint64_t start;
+    double elapsed;
+    unsigned int i, j;
+
+    memset(&config, 0, sizeof(config));
+    config.clients = 4;
+    config.duration = 5;
+
+    /* Parse options */
+    for (i = 1; i < (unsigned int)argc; i++) {
+        const char *value = i + 1 < (unsigned int)argc ? argv[i + 1] : NULL;
+
+        if (!value) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        if (strcmp(argv[i], "--socket") == 0) {
+            config.socket_path = value;
+        } else if (strcmp(argv[i], "--clients") == 0) {
+            config.clients = (unsigned int)strtoul(value, NULL, 10);
+        } else if (strcmp(argv[i], "--rate") == 0) {
+            config.rate = strtod(value, NULL);
+        } else if (strcmp(argv[i], "--duration") == 0) {
+            config.duration = strtod(value, NULL);
+        } else if (strcmp(argv[i], "--command") == 0 && config.mix_count < LOADGEN_MAX_LINES) {
+            mix_entry_t *entry = &config.mix[config.mix_count++];
+            char *end;
+
+            entry->weight = (unsigned int)strtoul(value, &end, 10);
+            if (end != value && *end == ':') {
+                entry->line = end + 1;
+            } else {
+                entry->weight = 1;
+                entry->line = value;
+            }
+        } else if (strcmp(argv[i], "--setup") == 0 && config.setup_count < LOADGEN_MAX_LINES) {
+            config.setup[config.setup_count++] = value;
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        i++;
+    }
+
+    if (config.clients == 0 || config.duration <= 0 || config.rate < 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* Default to measuring the framework with the built-in no-op plugin */
+    if (config.mix_count == 0) {
+        config.mix[0].weight = 1;
+        config.mix[0].line = "noop";
+        config.mix_count = 1;
+    }
+    if (config.setup_count == 0) {
+        config.setup[0] = "load plugin noop";
+        config.setup_count = 1;
+    }
+    for (i = 0; i < config.mix_count; i++) {
+        config.total_weight += config.mix[i].weight;
+    }
+    if (config.total_weight == 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    clients = (loadgen_client_t *)calloc(config.clients, sizeof(*clients));
+    threads = (pthread_t *)malloc(config.clients * sizeof(*threads));
+    if (!clients || !threads) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    /* Start clients; they begin measuring together */
+    pthread_barrier_init(&barrier, NULL, config.clients + 1);
+    for (i = 0; i < config.clients; i++) {
+        clients[i].config = &config;
+        clients[i].id = i;
+        clients[i].barrier = &barrier;
+        if (pthread_create(&threads[i], NULL, client_thread, &clients[i]) != 0) {
+            fprintf(stderr, "Error: Failed to start client %u\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+    pthread_barrier_wait(&barrier);
+    start = now_ns();
+
+    /* Merge results */
+    memset(hist, 0, sizeof(hist));
+    for (i = 0; i < config.clients; i++) {
+        pthread_join(threads[i], NULL);
+        for (j = 0; j < HIST_BUCKETS; j++) {
+            hist[j] += clients[i].hist[j];
+        }
+        requests += clients[i].requests;
+        errors += clients[i].errors;
+        transport_errors += clients[i].transport_errors;
+        if (clients[i].max_ns > max_ns) {
+            max_ns = clients[i].max_ns;
+        }
+    }
+    elapsed = (double)(now_ns() - start) / 1e9;
+    pthread_barrier_destroy(&barrier);
+
+    /* Report */
+    printf("Target:      %s, %u clients, ", config.socket_path ? config.socket_path : "in-process",
+           config.clients);
+    if (config.rate > 0) {
+        printf("%.0f requests/s", config.rate);
+    } else {
+        printf("unlimited rate");
+    }
+    printf(", %.1f s\n", config.duration);
+    printf("Requests:    %llu\n", (unsigned long long)requests);
+    printf("Errors:      %llu command, %llu transport\n",
+           (unsigned long long)errors, (unsigned long long)transport_errors);
+    printf("QPS:         %.0f\n", elapsed > 0 ? (double)requests / elapsed : 0);
+    if (requests > 0) {
+        printf("Latency:     p50 %.1f us, p90 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n",
+               hist_quantile(hist, requests, 0.50) / 1e3, hist_quantile(hist, requests, 0.90) / 1e3,
+               hist_quantile(hist, requests, 0.99) / 1e3, hist_quantile(hist, requests, 0.999) / 1e3,
+               max_ns / 1e3);
+        hist_print(hist, requests);
+    }
+
+    free(threads);
+    free(clients);
+
+    return transport_errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,143 @@
+/**
+ * @file alias.h
+ * @brief Aliases and macros for the TinyCLI framework
+ *
+ * An alias names a command line; arguments given to the alias are appended
+ * to it. A macro is an alias whose expansion uses the words $1..$9 (one
+ * argument each) and $@ (all arguments); it takes no other arguments.
+ *
+ * Expansions are tokenized when they are defined and keep a pointer to the
+ * command they run, so invoking one only splices argv and dispatches.
+ */
+
+#ifndef TINYCLI_ALIAS_H
+#define TINYCLI_ALIAS_H
+
+#include <stdint.h>
+
+#include "tinycli.h"
+
+/**
+ * @brief Maximum number of words in an expanded alias that fit on the stack
+ */
+#define TINYCLI_ALIAS_STACK_ARGS 32
+
+/**
+ * @brief Word slot value for $@
+ */
+#define TINYCLI_ALIAS_ALL_ARGS -1
+
+/**
+ * @brief Word of an expansion
+ */
+typedef struct {
+    char *literal;                  /* Literal word (NULL for argument slots) */
+    int slot;                       /* Argument number, or TINYCLI_ALIAS_ALL_ARGS */
+} tinycli_alias_word_t;
+
+/**
+ * @brief Alias or macro
+ */
+typedef struct {
+    char *name;                     /* Alias name */
+    char *text;                     /* Expansion as written */
+    bool macro;                     /* Substitute arguments instead of appending them */
+    tinycli_alias_word_t *words;    /* Tokenized expansion (words[0] is the command) */
+    int word_count;                 /* Number of words */
+    char **tokens;                  /* Parsed tokens backing the literal words */
+    int token_count;                /* Number of parsed tokens */
+    int min_args;                   /* Highest $N used */
+    bool all_args;                  /* Whether $@ is used */
+    uint32_t hash;                  /* Hash of the name */
+    tinycli_command_t *target;      /* Resolved command (NULL until found) */
+} tinycli_alias_t;
+
+/**
+ * @brief Aliases of a context
+ */
+typedef struct {
+    tinycli_alias_t **items;        /* Aliases */
+    size_t count;                   /* Number of aliases */
+    size_t capacity;                /* Capacity of items */
+    uint32_t *index;                /* Open-addressing name index (position + 1) */
+    size_t index_size;              /* Index capacity (power of two) */
+    char *path;                     /* Startup file to save to (NULL if none) */
+} tinycli_alias_table_t;
+
+/**
+ * @brief Define or replace an alias
+ * @param ctx TinyCLI context
+ * @param name Alias name
+ * @param text Expansion
+ * @param macro Whether the alias is a macro
+ * @return Error code
+ */
+int tinycli_alias_define(tinycli_context_t *ctx, const char *name, const char *text, bool macro);
+
+/**
+ * @brief Remove an alias
+ * @param ctx TinyCLI context
+ * @param name Alias name
+ * @return Error code
+ */
+int tinycli_alias_remove(tinycli_context_t *ctx, const char *name);
+
+/**
+ * @brief Find an alias by name
+ * @param ctx TinyCLI context
+ * @param name Alias name
+ * @return Alias or NULL if not found
+ */
+tinycli_alias_t *tinycli_alias_find(tinycli_context_t *ctx, const char *name);
+
+/**
+ * @brief Run an alias
+ * @param ctx TinyCLI context
+ * @param alias Alias to run
+ * @param argc Number of arguments (argv[0] is the alias name)
+ * @param argv Arguments
+ * @return Result of the command
+ */
+int tinycli_alias_execute(tinycli_context_t *ctx, tinycli_alias_t *alias, int argc, char **argv);
+
+/**
+ * @brief Load definitions from a startup file and save later changes to it
+ * @param ctx TinyCLI context
+ * @param path Path to the file
+ * @return Error code
+ *
+ * The file holds one "alias|macro <name> = \"<text>\"" definition per line;
+ * blank lines and lines starting with '#' are ignored.
+ */
+int tinycli_alias_load_file(tinycli_context_t *ctx, const char *path);
+
+/**
+ * @brief Save all definitions to the startup file, if there is one
+ * @param ctx TinyCLI context
+ * @return Error code
+ */
+int tinycli_alias_save(tinycli_context_t *ctx);
+
+/**
+ * @brief Print definitions sorted by name
+ * @param ctx TinyCLI context
+ * @param name Only print this alias (NULL for all)
+ * @return Error code
+ */
+int tinycli_alias_list(tinycli_context_t *ctx, const char *name);
+
+/**
+ * @brief Forget the commands aliases were resolved to
+ * @param ctx TinyCLI context
+ *
+ * Called after commands are removed; targets are looked up again on use.
+ */
+void tinycli_alias_unresolve(tinycli_context_t *ctx);
+
+/**
+ * @brief Free the aliases of a context
+ * @param table Alias table (can be NULL)
+ */
+void tinycli_alias_table_free(tinycli_alias_table_t *table);
+
+#endif /* TINYCLI_ALIAS_H */
@@ -0,0 +1,106 @@
+/**
+ * @file alloc.h
+ * @brief Tagged memory allocation and accounting for the TinyCLI framework
+ */
+
+#ifndef TINYCLI_ALLOC_H
+#define TINYCLI_ALLOC_H
+
+#include <stdint.h>
+
+#include "tinycli.h"
+
+/**
+ * @brief Subsystem tags used to attribute allocations
+ */
+typedef enum {
+    TINYCLI_MEM_CORE = 0,       /* Context, prompt and miscellaneous state */
+    TINYCLI_MEM_COMMANDS,       /* Command registry */
+    TINYCLI_MEM_PLUGINS,        /* Plugin records and configuration */
+    TINYCLI_MEM_PARSER,         /* Command line parsing */
+    TINYCLI_MEM_COMPLETION,     /* Command completion */
+    TINYCLI_MEM_OUTPUT,         /* Output buffering */
+    TINYCLI_MEM_SCRIPT,         /* Compiled scripts */
+    TINYCLI_MEM_ALIAS,          /* Aliases and macros */
+    TINYCLI_MEM_TIMER,          /* Periodic commands */
+    TINYCLI_MEM_TAG_COUNT
+} tinycli_mem_tag_t;
+
+/**
+ * @brief Allocation statistics for a single tag
+ */
+typedef struct {
+    uint64_t live_bytes;        /* Bytes currently allocated */
+    uint64_t peak_bytes;        /* Highest value of live_bytes */
+    uint64_t allocs;            /* Number of allocations made */
+    uint64_t frees;             /* Number of allocations released */
+    uint64_t alloc_bytes;       /* Bytes allocated in total */
+} tinycli_mem_stats_t;
+
+/**
+ * @brief Allocate memory attributed to a subsystem
+ * @param tag Subsystem tag
+ * @param size Number of bytes
+ * @return Allocated memory or NULL on error
+ */
+void *tinycli_malloc(tinycli_mem_tag_t tag, size_t size);
+
+/**
+ * @brief Allocate zeroed memory attributed to a subsystem
+ * @param tag Subsystem tag
+ * @param count Number of elements
+ * @param size Size of each element
+ * @return Allocated memory or NULL on error
+ */
+void *tinycli_calloc(tinycli_mem_tag_t tag, size_t count, size_t size);
+
+/**
+ * @brief Resize memory allocated with tinycli_malloc
+ * @param tag Subsystem tag (used when ptr is NULL)
+ * @param ptr Memory to resize (can be NULL)
+ * @param size New size in bytes
+ * @return Resized memory or NULL on error (ptr is left untouched)
+ */
+void *tinycli_realloc(tinycli_mem_tag_t tag, void *ptr, size_t size);
+
+/**
+ * @brief Free memory allocated with tinycli_malloc
+ * @param ptr Memory to free (can be NULL)
+ */
+void tinycli_free(void *ptr);
+
+/**
+ * @brief Duplicate a string attributed to a subsystem
+ * @param tag Subsystem tag
+ * @param str String to duplicate
+ * @return Duplicated string (free with tinycli_free) or NULL on error
+ */
+char *tinycli_mem_strdup(tinycli_mem_tag_t tag, const char *str);
+
+/**
+ * @brief Get allocation statistics for a tag
+ * @param tag Subsystem tag
+ * @param stats Structure to fill
+ */
+void tinycli_mem_get_stats(tinycli_mem_tag_t tag, tinycli_mem_stats_t *stats);
+
+/**
+ * @brief Get allocation statistics summed over all tags
+ * @param stats Structure to fill (peak_bytes is the sum of per-tag peaks)
+ */
+void tinycli_mem_get_total(tinycli_mem_stats_t *stats);
+
+/**
+ * @brief Get the display name of a tag
+ * @param tag Subsystem tag
+ * @return Tag name
+ */
+const char *tinycli_mem_tag_name(tinycli_mem_tag_t tag);
+
+/**
+ * @brief Print allocation statistics for all tags
+ * @param ctx TinyCLI context
+ */
+void tinycli_mem_show(tinycli_context_t *ctx);
+
+#endif /* TINYCLI_ALLOC_H */
@@ -0,0 +1,103 @@
+/**
+ * @file cancel.h
+ * @brief Command cancellation for the TinyCLI framework
+ *
+ * Every top-level command runs with an invocation record that carries its
+ * cancellation token. tinycli_cancel() only bumps a counter in it and writes
+ * a byte to a pipe, so it can be called from a signal handler.
+ *
+ * With a grace period set, commands run on a worker thread while the calling
+ * thread waits on the pipe. When the command is cancelled the waiting thread
+ * runs its callbacks, and once the grace period is over (or at a second
+ * cancellation) it abandons the worker: the command keeps running on its own
+ * with its output discarded, and a new worker is started for the next one.
+ * Abandoned workers are joined once their command returns, and all of them
+ * before the context is freed.
+ *
+ * A command with a deadline arms it with the runtime's watchdog, which
+ * cancels the command the same way when the deadline passes.
+ */
+
+#ifndef TINYCLI_CANCEL_H
+#define TINYCLI_CANCEL_H
+
+#include "tinycli.h"
+
+/**
+ * @brief Maximum number of cancellation callbacks per command
+ */
+#define TINYCLI_CANCEL_MAX_CALLBACKS 8
+
+/**
+ * @brief Invocation of a command
+ */
+typedef struct tinycli_invocation tinycli_invocation_t;
+
+/**
+ * @brief Worker thread that runs commands
+ */
+typedef struct tinycli_worker tinycli_worker_t;
+
+/**
+ * @brief Function that runs a command
+ * @param ctx TinyCLI context
+ * @param target Command or alias to run
+ * @param argc Number of arguments
+ * @param argv Arguments
+ * @return Error code
+ */
+typedef int (*tinycli_invoke_func_t)(tinycli_context_t *ctx, void *target, int argc, char **argv);
+
+/**
+ * @brief Run a command with a cancellation token
+ * @param ctx TinyCLI context
+ * @param timeout_ms Default timeout of the command (0 for none)
+ * @param func Function that runs the command
+ * @param target Command or alias passed to func
+ * @param argc Number of arguments
+ * @param argv Arguments
+ * @return Error code of the command (TINYCLI_ERROR_TIMEOUT if its deadline
+ *         passed and it gave up, TINYCLI_ERROR_CANCELLED if it was abandoned)
+ *
+ * Commands run from within a command share its token and run directly; a
+ * default timeout then only applies if it is earlier than the current
+ * deadline, and not at all under a deadline set with tinycli_invoke_deadline().
+ */
+int tinycli_invoke(tinycli_context_t *ctx, unsigned int timeout_ms, tinycli_invoke_func_t func,
+                   void *target, int argc, char **argv);
+
+/**
+ * @brief Run a command with a deadline set by the caller
+ * @param ctx TinyCLI context
+ * @param timeout_ms Timeout, replacing the current deadline and the defaults
+ *                   of the commands run within
+ * @param func Function that runs the command
+ * @param target Command or alias passed to func
+ * @param argc Number of arguments
+ * @param argv Arguments
+ * @return Error code of the command
+ */
+int tinycli_invoke_deadline(tinycli_context_t *ctx, unsigned int timeout_ms,
+                            tinycli_invoke_func_t func, void *target, int argc, char **argv);
+
+/**
+ * @brief Check whether the calling thread runs an abandoned command
+ * @return true if the output of the calling thread should be discarded
+ */
+bool tinycli_invocation_abandoned(void);
+
+/**
+ * @brief Stop the worker thread of a context and release its pipe
+ * @param ctx TinyCLI context
+ */
+void tinycli_cancel_destroy(tinycli_context_t *ctx);
+
+/**
+ * @brief Reset the cancellation state of a context in a forked child
+ * @param ctx TinyCLI context
+ *
+ * The child has none of the parent's threads; commands run inline in it.
+ */
+void tinycli_cancel_after_fork(tinycli_context_t *ctx);
+
+#endif /* TINYCLI_CANCEL_H */
@@ -6,37 +6,147 @@
 #ifndef TINYCLI_COMMAND_H
 #define TINYCLI_COMMAND_H
 
+#include <stdint.h>
+
 #include "tinycli.h"
+#include "strpool.h"
+
+/* Size of the first storage chunk is 1 << TINYCLI_COMMAND_CHUNK_SHIFT; each next chunk doubles */
+#define TINYCLI_COMMAND_CHUNK_SHIFT 3
+
+/* Maximum number of storage chunks */
+#define TINYCLI_COMMAND_CHUNKS 29
+
+/**
+ * @brief Asynchronous completion provider of a command
+ */
+typedef struct tinycli_completion_provider tinycli_completion_provider_t;
+
+/**
+ * @brief Execution statistics of a command
+ */
+typedef struct {
+    uint64_t calls;                     /* Number of runs */
+    uint64_t failures;                  /* Runs that returned an error */
+    uint64_t timeouts;                  /* Runs stopped by their deadline */
+    uint64_t total_ns;                  /* Time spent in the command */
+    uint64_t max_ns;                    /* Longest run */
+} tinycli_command_stats_t;
+
+/**
+ * @brief Cold command data, only touched when running, describing or completing a command
+ */
+typedef struct tinycli_command_info {
+    const char *help;                   /* Help text (interned, can be NULL) */
+    tinycli_completion_func_t completion; /* Command completion function */
+    tinycli_completion_v2_func_t completion_v2; /* Context-aware completion callback */
+    void *completion_data;              /* User data of the completion callback */
+    tinycli_completion_provider_t *provider; /* Asynchronous completion provider (can be NULL) */
+    tinycli_plugin_t *plugin;           /* Parent plugin (NULL for built-in commands) */
+    unsigned int timeout_ms;            /* Default timeout (0 for none) */
+    tinycli_command_stats_t stats;      /* Execution statistics */
+    bool metrics_attached;              /* The metrics below were looked up */
+    tinycli_metric_t *calls_metric;     /* Process-wide invocation counter */
+    tinycli_metric_t *errors_metric;    /* Process-wide error counter */
+    tinycli_metric_t *duration_metric;  /* Process-wide latency histogram */
+} tinycli_command_info_t;
 
 /**
  * @brief Command structure
+ *
+ * Holds the fields scanned on lookup and dispatch; everything else lives in
+ * the cold info record. Records are stored in chunks of doubling size that
+ * never move, so command pointers stay valid for the lifetime of the context
+ * (or until the command is removed with the plugin that registered it)
+ * while small registries stay small.
  */
 struct tinycli_command {
-    char *name;                         /* Command name */
-    char *help;                         /* Help text */
+    uint32_t hash;                      /* Hash of the command name */
+    uint32_t name_len;                  /* Length of the command name */
+    const char *name;                   /* Command name (interned) */
     tinycli_cmd_handler_t handler;      /* Command handler function */
-    tinycli_completion_func_t completion; /* Command completion function */
-    struct tinycli_command *next;       /* Next command in linked list */
-    tinycli_plugin_t *plugin;           /* Parent plugin (NULL for built-in commands) */
+    tinycli_command_info_t *info;       /* Cold command data */
 };
 
 /**
- * @brief Create a new command
+ * @brief Command registry
+ */
+typedef struct {
+    tinycli_command_t *chunks[TINYCLI_COMMAND_CHUNKS]; /* Hot command records */
+    tinycli_command_info_t *info_chunks[TINYCLI_COMMAND_CHUNKS]; /* Cold records, parallel to chunks */
+    size_t count;                       /* Number of commands */
+    uint32_t *index;                    /* Open-addressing name index (position + 1) */
+    size_t index_size;                  /* Index capacity (power of two) */
+    tinycli_command_t **sorted;         /* Commands sorted by name, built on demand */
+    size_t sorted_count;                /* Number of commands in the sorted index */
+    size_t max_name_len;                /* Length of the longest command name */
+    tinycli_strpool_t strings;          /* Interned names and help texts */
+} tinycli_command_table_t;
+
+/**
+ * @brief Initialize a command registry
+ * @param table Registry to initialize
+ */
+void tinycli_command_table_init(tinycli_command_table_t *table);
+
+/**
+ * @brief Release all memory held by a command registry
+ * @param table Registry to destroy
+ */
+void tinycli_command_table_destroy(tinycli_command_table_t *table);
+
+/**
+ * @brief Add a command to a registry
+ * @param table Command registry
  * @param name Command name
- * @param help Help text
+ * @param help Help text (can be NULL)
  * @param handler Command handler function
  * @param completion Command completion function (can be NULL)
- * @return New command or NULL on error
+ * @param out Pointer to store the new command (can be NULL)
+ * @return Error code
  */
-tinycli_command_t *tinycli_command_create(const char *name, const char *help,
-                                         tinycli_cmd_handler_t handler,
-                                         tinycli_completion_func_t completion);
+int tinycli_command_table_add(tinycli_command_table_t *table, const char *name,
+                              const char *help, tinycli_cmd_handler_t handler,
+                              tinycli_completion_func_t completion,
+                              tinycli_command_t **out);
 
 /**
- * @brief Free a command
- * @param cmd Command to free
+ * @brief Remove the commands registered by a plugin
+ * @param table Command registry
+ * @param plugin Plugin whose commands to remove
+ * @return Number of commands removed
+ *
+ * Meant for a plugin whose init function failed: the commands it registered
+ * are the newest records, so they are dropped from the end and pointers to
+ * the other commands stay valid. Their interned strings are kept.
  */
-void tinycli_command_free(tinycli_command_t *cmd);
+size_t tinycli_command_table_remove_plugin(tinycli_command_table_t *table,
+                                           const tinycli_plugin_t *plugin);
+
+/**
+ * @brief Find a command in a registry by name
+ * @param table Command registry
+ * @param name Command name (need not be NUL-terminated)
+ * @param len Length of the command name
+ * @return Command or NULL if not found
+ */
+tinycli_command_t *tinycli_command_table_find(const tinycli_command_table_t *table,
+                                              const char *name, size_t len);
+
+/**
+ * @brief Get a command by registration order
+ * @param table Command registry
+ * @param pos Position (0 to count - 1)
+ * @return Command
+ */
+static inline tinycli_command_t *tinycli_command_table_at(const tinycli_command_table_t *table,
+                                                          size_t pos)
+{
+    size_t n = pos + ((size_t)1 << TINYCLI_COMMAND_CHUNK_SHIFT);
+    unsigned int bit = 63 - __builtin_clzll((unsigned long long)n);
+
+    return &table->chunks[bit - TINYCLI_COMMAND_CHUNK_SHIFT][n - ((size_t)1 << bit)];
+}
 
 /**
  * @brief Find a command by name
@@ -53,6 +163,9 @@ tinycli_command_t *tinycli_command_find(tinycli_context_t *ctx, const char *name
  * @param argc Number of arguments
  * @param argv Array of argument strings
  * @return Error code
+ *
+ * The command runs under its default timeout, if it has one, and its
+ * statistics are updated.
  */
 int tinycli_command_execute(tinycli_context_t *ctx, tinycli_command_t *cmd, 
                            int argc, char **argv);
@@ -63,15 +176,44 @@ int tinycli_command_execute(tinycli_context_t *ctx, tinycli_command_t *cmd,
  * @param text Text to complete
  * @param start Start index in the command line
  * @param end End index in the command line
- * @return Array of possible completions
+ * @return Readline match list (first entry is the common prefix), or NULL
+ *
+ * Candidates are cached in the context, so completing a longer prefix of the
+ * same word only filters the previous candidates.
  */
 char **tinycli_command_complete(tinycli_context_t *ctx, const char *text, 
                                int start, int end);
 
+/* Upper bound for the name column width in command listings */
+#define TINYCLI_LIST_NAME_WIDTH 24
+
+/**
+ * @brief Filter for command listings
+ */
+typedef struct {
+    const char *pattern;                /* Name prefix or glob pattern (NULL for all) */
+    const char *plugin;                 /* Only commands of this plugin (NULL for all) */
+    size_t limit;                       /* Maximum number of entries (0 for no limit) */
+    size_t page;                        /* Page of limit entries to show, starting at 1 */
+} tinycli_command_filter_t;
+
 /**
  * @brief List all available commands
  * @param ctx TinyCLI context
  */
 void tinycli_command_list(tinycli_context_t *ctx);
 
+/**
+ * @brief List the commands matching a filter
+ * @param ctx TinyCLI context
+ * @param filter Filter to apply (can be NULL)
+ * @return Error code
+ *
+ * Commands are listed in name order and streamed to the output as they are
+ * found. A name prefix narrows the scan through the sorted index, so
+ * entries outside the requested range or page are never formatted.
+ */
+int tinycli_command_list_filtered(tinycli_context_t *ctx,
+                                  const tinycli_command_filter_t *filter);
+
 #endif /* TINYCLI_COMMAND_H */ 
\ No newline at end of file
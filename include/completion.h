@@ -0,0 +1,193 @@
+/**
+ * @file completion.h
+ * @brief Completion candidate cache for the TinyCLI framework
+ */
+
+#ifndef TINYCLI_COMPLETION_H
+#define TINYCLI_COMPLETION_H
+
+#include <stdint.h>
+
+#include "tinycli.h"
+
+/* Number of asynchronous completion requests cached per context */
+#define TINYCLI_COMPLETION_ASYNC_CACHE 16
+
+/**
+ * @brief Candidates of the last completion
+ *
+ * Consecutive TAB presses usually extend the previous prefix, so the last
+ * candidate set is kept, keyed by the command path (the words before the one
+ * being completed) and the prefix. When the new prefix extends the cached
+ * one, the set is narrowed in place instead of being rebuilt. The cache is
+ * dropped when the context's registry generation changes.
+ *
+ * The buffers for words and emitted candidates are reused by every
+ * completion, so after warm-up a completion performs no allocation other
+ * than the match list handed to readline.
+ */
+typedef struct {
+    bool valid;                         /* Cache holds a candidate set */
+    uint64_t generation;                /* Registry generation of the candidates */
+    char *path;                         /* Command path */
+    size_t path_len;                    /* Length of the command path */
+    char *prefix;                       /* Prefix the candidates match */
+    size_t prefix_len;                  /* Length of the prefix */
+    size_t prefix_cap;                  /* Capacity of the prefix buffer */
+    const char **items;                 /* Candidates matching the prefix */
+    size_t count;                       /* Number of candidates */
+    size_t cap;                         /* Capacity of the candidate array */
+    char **owned;                       /* Provider result owning the strings (libc allocated) */
+    bool narrowable;                    /* All candidates start with the prefix */
+    char *arena;                        /* Candidates emitted by a completion callback */
+    size_t arena_len;                   /* Bytes used in the arena */
+    size_t arena_cap;                   /* Capacity of the arena */
+    size_t *offsets;                    /* Arena offsets of the emitted candidates */
+    size_t offsets_count;               /* Number of emitted candidates */
+    size_t offsets_cap;                 /* Capacity of the offset array */
+    char *words;                        /* Storage for the words of the line */
+    size_t words_cap;                   /* Capacity of the word storage */
+    char **argv;                        /* Words of the line */
+    size_t argv_cap;                    /* Capacity of the word array */
+} tinycli_completion_cache_t;
+
+/**
+ * @brief Initialize an empty completion cache
+ * @param cache Cache to initialize
+ */
+void tinycli_completion_cache_init(tinycli_completion_cache_t *cache);
+
+/**
+ * @brief Drop the cached candidates and release all memory
+ * @param cache Cache to destroy
+ */
+void tinycli_completion_cache_destroy(tinycli_completion_cache_t *cache);
+
+/**
+ * @brief Look up candidates for a command path and prefix
+ * @param cache Completion cache
+ * @param generation Current registry generation
+ * @param path Command path
+ * @param path_len Length of the command path
+ * @param prefix Prefix being completed
+ * @param prefix_len Length of the prefix
+ * @return true if the cache now holds exactly the candidates for the prefix
+ *
+ * A hit on an extended prefix narrows the cached set in place.
+ */
+bool tinycli_completion_cache_lookup(tinycli_completion_cache_t *cache, uint64_t generation,
+                                     const char *path, size_t path_len,
+                                     const char *prefix, size_t prefix_len);
+
+/**
+ * @brief Start a new candidate set for a command path and prefix
+ * @param cache Completion cache
+ * @param generation Current registry generation
+ * @param path Command path
+ * @param path_len Length of the command path
+ * @param prefix Prefix being completed
+ * @param prefix_len Length of the prefix
+ * @return Error code
+ */
+int tinycli_completion_cache_reset(tinycli_completion_cache_t *cache, uint64_t generation,
+                                   const char *path, size_t path_len,
+                                   const char *prefix, size_t prefix_len);
+
+/**
+ * @brief Append a candidate to the current set
+ * @param cache Completion cache
+ * @param item Candidate (must outlive the cache entry)
+ * @return Error code
+ */
+int tinycli_completion_cache_add(tinycli_completion_cache_t *cache, const char *item);
+
+/**
+ * @brief Take over a provider's NULL-terminated result as the current set
+ * @param cache Completion cache (just reset)
+ * @param matches Result allocated with the C library allocator (the cache frees it)
+ * @return Error code
+ *
+ * The result is in readline's format: with several candidates, the first
+ * entry is the common prefix and is not a candidate itself.
+ * If any candidate doesn't start with the prefix (e.g. a case-insensitive
+ * provider), the set is only reused for the same prefix, never narrowed.
+ */
+int tinycli_completion_cache_adopt(tinycli_completion_cache_t *cache, char **matches);
+
+/**
+ * @brief Split the start of a line into words
+ * @param cache Completion cache (owns the word storage)
+ * @param line Line being edited
+ * @param len Number of bytes before the word being completed
+ * @param text Word being completed (appended as the last word)
+ * @param argc Pointer to store the number of words
+ * @param argv Pointer to store the words (valid until the next call)
+ * @return Error code
+ *
+ * Words are split like tinycli_parse_line() does.
+ */
+int tinycli_completion_cache_tokenize(tinycli_completion_cache_t *cache, const char *line,
+                                      size_t len, const char *text, int *argc, char ***argv);
+
+/**
+ * @brief Run a context-aware completion callback into the current set
+ * @param cache Completion cache (just reset)
+ * @param ctx TinyCLI context
+ * @param func Completion callback
+ * @param user_data User data of the callback
+ * @param argc Number of words
+ * @param argv Words of the line
+ * @return Error code
+ */
+int tinycli_completion_cache_run(tinycli_completion_cache_t *cache, tinycli_context_t *ctx,
+                                 tinycli_completion_v2_func_t func, void *user_data,
+                                 int argc, char **argv);
+
+/**
+ * @brief Build a readline match list from the current set
+ * @param cache Completion cache
+ * @return Match list (first entry is the common prefix), or NULL if there are no candidates
+ *
+ * The list is released by readline with free(), so it uses the C library
+ * allocator.
+ */
+char **tinycli_completion_cache_matches(const tinycli_completion_cache_t *cache);
+
+/**
+ * @brief Asynchronous completion state of a context
+ *
+ * Holds the registered providers, the worker thread that runs them and the
+ * per-prefix cache of requests.
+ */
+typedef struct tinycli_completion_async tinycli_completion_async_t;
+
+/**
+ * @brief Attach an asynchronous completion provider to a command
+ * @param ctx TinyCLI context
+ * @param cmd Command
+ * @param func Completion provider
+ * @param user_data User data passed to the provider
+ * @param deadline_ms Time to wait for the provider
+ * @return Error code
+ */
+int tinycli_completion_async_register(tinycli_context_t *ctx, tinycli_command_t *cmd,
+                                      tinycli_async_completion_func_t func,
+                                      void *user_data, unsigned int deadline_ms);
+
+/**
+ * @brief Complete an argument with a command's asynchronous provider
+ * @param ctx TinyCLI context
+ * @param cmd Command with an asynchronous provider
+ * @param text Text to complete
+ * @return Readline match list of the candidates found by the deadline, or NULL
+ */
+char **tinycli_completion_async_complete(tinycli_context_t *ctx, tinycli_command_t *cmd,
+                                         const char *text);
+
+/**
+ * @brief Cancel pending requests, stop the worker and free the state
+ * @param async Asynchronous completion state (can be NULL)
+ */
+void tinycli_completion_async_destroy(tinycli_completion_async_t *async);
+
+#endif /* TINYCLI_COMPLETION_H */
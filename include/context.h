@@ -9,23 +9,54 @@
 #include "tinycli.h"
 #include "command.h"
 #include "plugin.h"
+#include "output.h"
+#include "session.h"
+#include "completion.h"
+#include "alias.h"
+#include "emit.h"
+#include "timer.h"
+#include "cancel.h"
+#include "pool.h"
 
 /**
  * @brief TinyCLI context structure
  */
 struct tinycli_context {
+    tinycli_runtime_t *runtime;     /* Shared runtime */
     char *prompt;                   /* Command prompt */
-    tinycli_command_t *commands;    /* Linked list of commands */
+    tinycli_command_table_t commands; /* Command registry */
+    uint64_t generation;            /* Registry generation, bumped on every change */
+    tinycli_completion_cache_t completion; /* Candidates of the last completion */
+    tinycli_completion_async_t *async_completion; /* Asynchronous completion state (NULL until used) */
     tinycli_plugin_t *plugins;      /* Linked list of plugins */
+    tinycli_plugin_t *current_plugin; /* Plugin being initialized (owns new commands) */
+    tinycli_output_t output;        /* Output state */
+    tinycli_emit_t emit;            /* Structured output state */
     bool running;                   /* Flag to control the command loop */
     void *user_data;                /* User-defined data */
+    struct _hist_state *history;    /* Saved readline history while not running */
+    tinycli_session_recorder_t *recorder; /* Session recorder (NULL when not recording) */
+    int script_depth;               /* Number of scripts being sourced */
+    tinycli_alias_table_t *aliases; /* Aliases and macros (NULL until defined) */
+    bool event_mode;                /* Terminal is driven by a host event loop */
+    bool event_handler;             /* Readline callback handler is installed */
+    int event_result;               /* Result of the last line run in event-loop mode */
+    int epoll_fd;                   /* Epoll instance the terminal is registered with (-1 if none) */
+    tinycli_timers_t *timers;       /* Periodic commands (NULL until scheduled) */
+    tinycli_invocation_t *invocation; /* Running top-level command (NULL if none) */
+    tinycli_worker_t *worker;       /* Worker thread for commands (NULL until used) */
+    tinycli_worker_t *abandoned;    /* Workers left running abandoned commands */
+    int cancel_grace_ms;            /* Grace period before abandoning a command (-1: no worker) */
+    int cancel_pipe[2];             /* Wakes the thread waiting for the worker (-1 until used) */
+    tinycli_pool_t *pool;           /* Worker processes for plugin commands (NULL unless isolated) */
 };
 
 /**
  * @brief Create a new TinyCLI context
+ * @param runtime Shared runtime (a reference is taken)
  * @return New context or NULL on error
  */
-tinycli_context_t *tinycli_context_create(void);
+tinycli_context_t *tinycli_context_create(tinycli_runtime_t *runtime);
 
 /**
  * @brief Free a TinyCLI context
@@ -36,10 +67,15 @@ void tinycli_context_free(tinycli_context_t *ctx);
 /**
  * @brief Add a command to a context
  * @param ctx TinyCLI context
- * @param cmd Command to add
+ * @param name Command name
+ * @param help Help text (can be NULL)
+ * @param handler Command handler function
+ * @param completion Command completion function (can be NULL)
  * @return Error code
  */
-int tinycli_context_add_command(tinycli_context_t *ctx, tinycli_command_t *cmd);
+int tinycli_context_add_command(tinycli_context_t *ctx, const char *name,
+                                const char *help, tinycli_cmd_handler_t handler,
+                                tinycli_completion_func_t completion);
 
 /**
  * @brief Add a plugin to a context
@@ -0,0 +1,99 @@
+/**
+ * @file emit.h
+ * @brief Structured output for the TinyCLI framework
+ *
+ * Handlers emit records of typed fields; the context renders them in its
+ * output format without going through text.
+ *
+ * The binary format is a sequence of frames, each starting with a type byte:
+ *
+ *     'T' <varint len> <name>              table begins
+ *     'R' <varint len> <fields>            record (len = size of the fields)
+ *     'E'                                  table ends
+ *
+ * and each field is:
+ *
+ *     <type> <varint len> <key> <value>
+ *
+ * where type is 'i' (zigzag varint), 's' (varint len + UTF-8 bytes),
+ * 'b' (one byte, 0 or 1) or 'x' (varint len + bytes). Varints are unsigned
+ * LEB128.
+ */
+
+#ifndef TINYCLI_EMIT_H
+#define TINYCLI_EMIT_H
+
+#include <stdint.h>
+
+#include "tinycli.h"
+
+/**
+ * @brief Maximum number of columns in a table
+ */
+#define TINYCLI_EMIT_MAX_COLUMNS 32
+
+/**
+ * @brief Maximum length of a field key
+ */
+#define TINYCLI_EMIT_MAX_KEY 64
+
+/**
+ * @brief Text cell of a buffered table
+ */
+typedef struct {
+    uint32_t row;                       /* Record number */
+    uint32_t column;                    /* Column number */
+    uint32_t offset;                    /* Offset of the text in the arena */
+    uint32_t len;                       /* Length of the text */
+} tinycli_emit_cell_t;
+
+/**
+ * @brief Column of a table
+ */
+typedef struct {
+    char key[TINYCLI_EMIT_MAX_KEY];     /* Field key */
+    int width;                          /* Fixed width (0 to fit) */
+    int max;                            /* Widest value seen */
+} tinycli_emit_column_t;
+
+/**
+ * @brief Structured output state of a context
+ */
+typedef struct {
+    tinycli_output_format_t format;     /* Output format */
+    bool in_table;                      /* A table is open */
+    bool in_record;                     /* A record is open */
+    bool streaming;                     /* Text rows are printed as they come */
+    bool header_done;                   /* Text header has been printed */
+    tinycli_emit_column_t columns[TINYCLI_EMIT_MAX_COLUMNS]; /* Table columns */
+    int column_count;                   /* Number of columns */
+    uint32_t rows;                      /* Records in the current table */
+    uint32_t record_start;              /* First cell of the current record */
+    uint32_t fields;                    /* Fields in the current record */
+    char *arena;                        /* Encoded record (JSON, binary) or text cells */
+    size_t arena_len, arena_cap;
+    tinycli_emit_cell_t *cells;         /* Text cells */
+    size_t cell_count, cell_cap;
+} tinycli_emit_t;
+
+/**
+ * @brief Initialize structured output state (text format)
+ * @param emit State to initialize
+ */
+void tinycli_emit_init(tinycli_emit_t *emit);
+
+/**
+ * @brief Release memory held by structured output state
+ * @param emit State to destroy
+ */
+void tinycli_emit_destroy(tinycli_emit_t *emit);
+
+/**
+ * @brief Parse an output format name
+ * @param name "text", "json" or "binary"
+ * @param format Pointer to store the format
+ * @return Error code
+ */
+int tinycli_output_format_parse(const char *name, tinycli_output_format_t *format);
+
+#endif /* TINYCLI_EMIT_H */
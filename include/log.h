@@ -0,0 +1,68 @@
+/**
+ * @file log.h
+ * @brief Asynchronous logging for the TinyCLI framework
+ *
+ * Every thread that logs gets a ring buffer of binary records (level,
+ * wall-clock time and message) that only it writes, so logging takes no
+ * locks and no system calls. A background thread, started with the first
+ * ring, merges what the rings hold by time, formats the records and writes
+ * them to stderr, a file or syslog. After a wakeup it lets records gather
+ * for a moment, so a burst costs one wakeup; producers only wake it (one
+ * write() on a pipe) when it is idle, for a warning or error, or when
+ * their ring is half full. A full ring drops records, and the number
+ * dropped is logged in their place.
+ *
+ * Messages are formatted on the calling thread: a format string can live
+ * in a plugin that is unloaded before the record is written out.
+ */
+
+#ifndef TINYCLI_LOG_H
+#define TINYCLI_LOG_H
+
+#include <stdint.h>
+
+#include "tinycli.h"
+
+/**
+ * @brief Size of the ring buffer of each thread (power of two)
+ */
+#define TINYCLI_LOG_RING_SIZE (64 * 1024)
+
+/**
+ * @brief Longest message kept (longer ones are truncated)
+ */
+#define TINYCLI_LOG_MAX_MESSAGE 1024
+
+/**
+ * @brief State of the logger
+ */
+typedef struct {
+    tinycli_log_level_t level;          /* Least severe level logged */
+    char target[256];                   /* Destination ("stderr", "syslog" or a path) */
+    uint64_t written;                   /* Records written out */
+    uint64_t dropped;                   /* Records dropped because a ring was full */
+    unsigned int threads;               /* Threads with a ring */
+} tinycli_log_status_t;
+
+/**
+ * @brief Parse a level name ("error", "warn", "info", "debug" or "trace")
+ * @param name Level name
+ * @param level Pointer to store the level
+ * @return Error code
+ */
+int tinycli_log_level_parse(const char *name, tinycli_log_level_t *level);
+
+/**
+ * @brief Get the name of a level
+ * @param level Log level
+ * @return Level name
+ */
+const char *tinycli_log_level_name(tinycli_log_level_t level);
+
+/**
+ * @brief Get the state of the logger
+ * @param status Structure to fill
+ */
+void tinycli_log_get_status(tinycli_log_status_t *status);
+
+#endif /* TINYCLI_LOG_H */
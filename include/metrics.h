@@ -0,0 +1,92 @@
+/**
+ * @file metrics.h
+ * @brief Metrics registry for the TinyCLI framework
+ *
+ * Metrics live in a process-wide registry shared by all runtimes and
+ * contexts. A metric is one series of a family: the family has the name,
+ * help text and type, the series its label pairs.
+ *
+ * Counters and histograms are sharded per thread: every thread that updates
+ * one gets its own slots, written without locks or atomic read-modify-write
+ * operations, and readers sum the slots of all threads. The slots of a
+ * thread that exits are folded into the totals. Gauges are single values
+ * updated atomically, since a gauge can be set as well as moved.
+ *
+ * The registry can be exported in the Prometheus text format with 'show
+ * metrics', to a textfile-collector file that is rewritten periodically,
+ * or over HTTP on a Unix socket (tinycli_metrics_export_file() and
+ * tinycli_metrics_export_socket()).
+ */
+
+#ifndef TINYCLI_METRICS_H
+#define TINYCLI_METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tinycli.h"
+#include "alloc.h"
+
+/**
+ * @brief Number of finite latency histogram buckets
+ */
+#define TINYCLI_METRICS_BUCKETS 11
+
+/**
+ * @brief Metrics maintained by the framework
+ */
+typedef struct {
+    tinycli_metric_t *sessions;         /* Open contexts */
+    tinycli_metric_t *plugins;          /* Loaded plugins */
+    tinycli_metric_t *memory[TINYCLI_MEM_TAG_COUNT]; /* Live bytes per allocation tag */
+} tinycli_metrics_builtin_t;
+
+/**
+ * @brief Get the metrics maintained by the framework, registering them on first use
+ * @return Built-in metrics (members are NULL if registration failed)
+ */
+const tinycli_metrics_builtin_t *tinycli_metrics_builtin(void);
+
+/**
+ * @brief Register a latency histogram, or find it if it exists
+ * @param name Family name
+ * @param help Help text (can be NULL)
+ * @param labels Label pairs such as 'command="ls"' (NULL for none)
+ * @return Metric or NULL on error
+ *
+ * Buckets go from 100 us to 10 s; the sum is exported in seconds.
+ */
+tinycli_metric_t *tinycli_metric_histogram(const char *name, const char *help, const char *labels);
+
+/**
+ * @brief Record a duration in a histogram
+ * @param metric Histogram (can be NULL)
+ * @param ns Duration in nanoseconds
+ */
+void tinycli_metric_observe_ns(tinycli_metric_t *metric, uint64_t ns);
+
+/**
+ * @brief Format a label value with the escapes of the text format
+ * @param key Label name
+ * @param value Label value
+ * @param buffer Buffer for the label pair
+ * @param size Size of the buffer
+ * @return The label pair, or NULL if it does not fit
+ */
+char *tinycli_metric_label(const char *key, const char *value, char *buffer, size_t size);
+
+/**
+ * @brief Render the registry in the Prometheus text format
+ * @param len Pointer to store the length of the text
+ * @return Text (free with free()) or NULL on error
+ */
+char *tinycli_metrics_render(size_t *len);
+
+/**
+ * @brief Print the registry in the Prometheus text format
+ * @param ctx TinyCLI context
+ * @return Error code
+ */
+int tinycli_metrics_show(tinycli_context_t *ctx);
+
+#endif /* TINYCLI_METRICS_H */
@@ -0,0 +1,98 @@
+/**
+ * @file output.h
+ * @brief Output layer for the TinyCLI framework
+ */
+
+#ifndef TINYCLI_OUTPUT_H
+#define TINYCLI_OUTPUT_H
+
+#include <stdarg.h>
+#include <stdint.h>
+
+#include "tinycli.h"
+
+/**
+ * @brief Output state of a context
+ *
+ * Output goes to a stdio stream by default. It can instead be captured into
+ * a memory buffer, or discarded entirely.
+ */
+typedef struct {
+    FILE *stream;                       /* Destination stream (NULL to discard) */
+    char *buf;                          /* Capture buffer */
+    size_t len;                         /* Bytes in the capture buffer */
+    size_t cap;                         /* Capacity of the capture buffer */
+    bool capturing;                     /* Output is being captured */
+    uint64_t epoch;                     /* Bumped on every write to the stream */
+} tinycli_output_t;
+
+/**
+ * @brief Initialize output state (writing to stdout)
+ * @param out Output state to initialize
+ */
+void tinycli_output_init(tinycli_output_t *out);
+
+/**
+ * @brief Release memory held by output state
+ * @param out Output state to destroy
+ */
+void tinycli_output_destroy(tinycli_output_t *out);
+
+/**
+ * @brief Set the destination stream of a context
+ * @param ctx TinyCLI context
+ * @param stream Destination stream, or NULL to discard output
+ */
+void tinycli_output_set_stream(tinycli_context_t *ctx, FILE *stream);
+
+/**
+ * @brief Write raw bytes to the output of a context
+ * @param ctx TinyCLI context
+ * @param data Bytes to write
+ * @param len Number of bytes
+ * @return Error code
+ */
+int tinycli_output_write(tinycli_context_t *ctx, const void *data, size_t len);
+
+/**
+ * @brief Write formatted text to the output of a context
+ * @param ctx TinyCLI context
+ * @param fmt Format string
+ * @param args Format arguments
+ * @return Error code
+ */
+int tinycli_output_vprintf(tinycli_context_t *ctx, const char *fmt, va_list args);
+
+/**
+ * @brief Flush buffered output to the destination stream
+ * @param ctx TinyCLI context
+ */
+void tinycli_output_flush(tinycli_context_t *ctx);
+
+/**
+ * @brief Get a file descriptor output can be written to directly
+ * @param ctx TinyCLI context
+ * @return File descriptor, or -1 if output is captured or discarded (or the
+ *         calling command was abandoned)
+ *
+ * Pending stream output is flushed first, so writes to the descriptor keep
+ * their order relative to earlier output.
+ */
+int tinycli_output_fd(tinycli_context_t *ctx);
+
+/**
+ * @brief Start capturing output into a memory buffer
+ * @param ctx TinyCLI context
+ * @return Error code (TINYCLI_ERROR_GENERAL if already capturing)
+ */
+int tinycli_output_capture_begin(tinycli_context_t *ctx);
+
+/**
+ * @brief Stop capturing output
+ * @param ctx TinyCLI context
+ * @param len Pointer to store the number of captured bytes (can be NULL)
+ * @return NUL-terminated captured output (free with tinycli_free), or NULL
+ */
+char *tinycli_output_capture_end(tinycli_context_t *ctx, size_t *len);
+
+#endif /* TINYCLI_OUTPUT_H */
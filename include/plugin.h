@@ -6,6 +6,8 @@
 #ifndef TINYCLI_PLUGIN_H
 #define TINYCLI_PLUGIN_H
 
+#include <stdint.h>
+
 #include "tinycli.h"
 
 /**
@@ -21,6 +23,11 @@ typedef int (*tinycli_plugin_init_t)(tinycli_context_t *ctx);
  */
 typedef void (*tinycli_plugin_cleanup_t)(tinycli_context_t *ctx);
 
+/**
+ * @brief Shared plugin library image (one per library file and process)
+ */
+typedef struct tinycli_plugin_image tinycli_plugin_image_t;
+
 /**
  * @brief Plugin structure
  */
@@ -29,8 +36,14 @@ struct tinycli_plugin {
     char *description;               /* Plugin description */
     char *version;                   /* Plugin version */
     void *handle;                    /* Dynamic library handle */
+    tinycli_plugin_image_t *image;   /* Shared library image (NULL for JSON plugins) */
     tinycli_plugin_init_t init;      /* Plugin initialization function */
     tinycli_plugin_cleanup_t cleanup; /* Plugin cleanup function */
+    unsigned int bind;               /* Binding flags of the library (TINYCLI_PLUGIN_BIND_*) */
+    bool shared;                     /* The library was loaded already, by another request */
+    uint64_t open_ns;                /* Time the library took to open */
+    uint64_t sym_ns;                 /* Time the entry points took to look up */
+    uint64_t init_ns;                /* Time the init function took */
     struct tinycli_plugin *next;     /* Next plugin in linked list */
 };
 
@@ -47,6 +60,9 @@ tinycli_plugin_t *tinycli_plugin_create(const char *name, const char *descriptio
 /**
  * @brief Free a plugin
  * @param plugin Plugin to free
+ *
+ * The plugin's cleanup function is not called here; the context calls it
+ * before freeing its plugins. The library is closed once no context uses it.
  */
 void tinycli_plugin_free(tinycli_plugin_t *plugin);
 
@@ -63,9 +79,40 @@ tinycli_plugin_t *tinycli_plugin_find(tinycli_context_t *ctx, const char *name);
  * @param ctx TinyCLI context
  * @param plugin_path Path to the plugin shared library
  * @return Error code
+ *
+ * Libraries are cached process-wide by file identity, so loading a plugin
+ * that another context already uses only runs its init function. Bare names
+ * of built-in plugins (such as "noop") don't load a library at all.
  */
 int tinycli_plugin_load(tinycli_context_t *ctx, const char *plugin_path);
 
+/**
+ * @brief Load a plugin from a shared library with explicit binding flags
+ * @param ctx TinyCLI context
+ * @param plugin_path Path to the plugin shared library
+ * @param bind TINYCLI_PLUGIN_BIND_* flags
+ * @return Error code
+ */
+int tinycli_plugin_load_bind(tinycli_context_t *ctx, const char *plugin_path, unsigned int bind);
+
+/**
+ * @brief Parse binding flags
+ * @param text Comma-separated list of now, lazy, local, global, deepbind
+ *             and nodelete
+ * @param bind Parsed TINYCLI_PLUGIN_BIND_* flags
+ * @return Error code (TINYCLI_ERROR_INVALID_ARGUMENT for unknown words)
+ */
+int tinycli_plugin_bind_parse(const char *text, unsigned int *bind);
+
+/**
+ * @brief Format binding flags as text
+ * @param bind TINYCLI_PLUGIN_BIND_* flags
+ * @param buffer Buffer for the text
+ * @param size Size of the buffer
+ * @return buffer
+ */
+char *tinycli_plugin_bind_format(unsigned int bind, char *buffer, size_t size);
+
 /**
  * @brief Load a plugin from a JSON configuration
  * @param ctx TinyCLI context
@@ -77,8 +124,16 @@ int tinycli_plugin_load_json(tinycli_context_t *ctx, const char *json_path);
 /**
  * @brief List all loaded plugins
  * @param ctx TinyCLI context
+ * @return Error code
+ */
+int tinycli_plugin_list(tinycli_context_t *ctx);
+
+/**
+ * @brief List how long loading each plugin took
+ * @param ctx TinyCLI context
+ * @return Error code
  */
-void tinycli_plugin_list(tinycli_context_t *ctx);
+int tinycli_plugin_list_timing(tinycli_context_t *ctx);
 
 /**
  * @brief Get the plugin directory path
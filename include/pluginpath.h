@@ -0,0 +1,42 @@
+/**
+ * @file pluginpath.h
+ * @brief Plugin search path for the TinyCLI framework
+ *
+ * The plugin search path is a colon-separated list of directories. Each
+ * directory is read once into an index mapping plugin names (file names
+ * without ".so") to paths, so resolving a name costs one stat() per
+ * directory to check its modification time and a hash lookup. A directory
+ * whose modification time changed is read again.
+ *
+ * The index is shared by all runtimes and threads.
+ */
+
+#ifndef TINYCLI_PLUGINPATH_H
+#define TINYCLI_PLUGINPATH_H
+
+#include <stddef.h>
+
+#include "tinycli.h"
+
+/**
+ * @brief Find a plugin library on a search path
+ * @param search_path Colon-separated directories
+ * @param name Plugin name (without directory or ".so")
+ * @param path Buffer for the path of the library
+ * @param size Size of the buffer
+ * @return true if the plugin was found in one of the directories; the first
+ *         directory that has it wins
+ */
+bool tinycli_plugin_path_find(const char *search_path, const char *name, char *path, size_t size);
+
+/**
+ * @brief Emit the plugin names on a search path that start with a prefix
+ * @param search_path Colon-separated directories
+ * @param prefix Prefix of the names
+ * @param emitter Completion emitter
+ * @return Error code
+ */
+int tinycli_plugin_path_complete(const char *search_path, const char *prefix,
+                                 tinycli_completion_emitter_t *emitter);
+
+#endif /* TINYCLI_PLUGINPATH_H */
@@ -0,0 +1,95 @@
+/**
+ * @file pool.h
+ * @brief Isolated plugin commands for the TinyCLI framework
+ *
+ * In isolation mode plugin commands run in pre-forked worker processes. The
+ * workers are forked from the context after its plugins are loaded, so they
+ * run the handlers from their copy of the context without loading anything.
+ *
+ * Each worker shares one memory region with the shell holding two
+ * single-producer, single-consumer byte rings, each with a pair of
+ * process-shared semaphores to wait for data and for space:
+ *
+ *     request:   <u32 len> <u32 format> <u32 argc> <name> NUL <argv...> NUL
+ *     response:  'O' <u32 len> <bytes>      output
+ *                'R' <u32 len = 4> <i32>    result, ends the command
+ *
+ * A worker that dies mid-command (or is killed because the command was
+ * cancelled) is reaped and respawned; the command fails with
+ * TINYCLI_ERROR_PLUGIN. Workers forked before the registry changed are
+ * replaced once the command that changed it returns.
+ *
+ * Workers are only forked by the thread that set up the pool, never by the
+ * thread running a command: fork() there would copy a process whose helper
+ * threads may hold locks. A command on the worker thread that needs a fresh
+ * worker asks the owner, which is waiting for it, through the cancellation
+ * pipe.
+ *
+ * Commands only run in parallel when several threads or contexts dispatch
+ * through the pool; a single shell context runs one command at a time.
+ */
+
+#ifndef TINYCLI_POOL_H
+#define TINYCLI_POOL_H
+
+#include <stdint.h>
+
+#include "tinycli.h"
+
+/**
+ * @brief Capacity of the request ring of a worker
+ */
+#define TINYCLI_POOL_REQUEST_RING (16 * 1024)
+
+/**
+ * @brief Capacity of the response ring of a worker
+ */
+#define TINYCLI_POOL_RESPONSE_RING (64 * 1024)
+
+/**
+ * @brief Maximum number of worker processes
+ */
+#define TINYCLI_POOL_MAX_WORKERS 64
+
+/**
+ * @brief Pool of worker processes
+ */
+typedef struct tinycli_pool tinycli_pool_t;
+
+/**
+ * @brief Run a command in a worker process
+ * @param ctx TinyCLI context with a pool
+ * @param cmd Command to run
+ * @param argc Number of arguments
+ * @param argv Arguments
+ * @return Error code of the command (TINYCLI_ERROR_PLUGIN if the worker died)
+ *
+ * Safe to call from several threads at once; each call takes an idle worker
+ * or waits for one.
+ */
+int tinycli_pool_execute(tinycli_context_t *ctx, tinycli_command_t *cmd, int argc, char **argv);
+
+/**
+ * @brief Fork the workers a pool is missing (on the thread that set it up)
+ * @param ctx TinyCLI context
+ *
+ * Replaces idle workers that died or were forked before the registry
+ * changed, and those requested by callers on other threads. Does nothing
+ * on other threads or without a pool.
+ */
+void tinycli_pool_service(tinycli_context_t *ctx);
+
+/**
+ * @brief List the workers of a pool as a structured table
+ * @param ctx TinyCLI context
+ * @return Error code
+ */
+int tinycli_pool_list(tinycli_context_t *ctx);
+
+/**
+ * @brief Stop the workers of a pool and free it
+ * @param pool Pool (can be NULL)
+ */
+void tinycli_pool_destroy(tinycli_pool_t *pool);
+
+#endif /* TINYCLI_POOL_H */
@@ -0,0 +1,42 @@
+/**
+ * @file runtime.h
+ * @brief Shared runtime for TinyCLI contexts
+ */
+
+#ifndef TINYCLI_RUNTIME_H
+#define TINYCLI_RUNTIME_H
+
+#include <pthread.h>
+
+#include "tinycli.h"
+#include "watchdog.h"
+
+/**
+ * @brief Runtime structure
+ *
+ * Holds the state shared by all contexts created with the runtime. Fields
+ * are protected by the lock.
+ */
+struct tinycli_runtime {
+    pthread_mutex_t lock;           /* Protects the fields below */
+    unsigned int refs;              /* Reference count */
+    bool is_default;                /* Process-wide default runtime (never freed) */
+    char *plugin_dir;               /* Plugin search path (colon-separated directories) */
+    unsigned int plugin_bind;       /* Default binding flags of plugin libraries */
+    tinycli_watchdog_t *watchdog;   /* Deadline watchdog (NULL until a deadline is armed) */
+};
+
+/**
+ * @brief Get the process-wide default runtime
+ * @return Default runtime
+ */
+tinycli_runtime_t *tinycli_runtime_default(void);
+
+/**
+ * @brief Take a reference to a runtime
+ * @param runtime Runtime to retain
+ * @return The runtime
+ */
+tinycli_runtime_t *tinycli_runtime_retain(tinycli_runtime_t *runtime);
+
+#endif /* TINYCLI_RUNTIME_H */
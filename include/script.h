@@ -0,0 +1,98 @@
+/**
+ * @file script.h
+ * @brief Compiled scripts for the TinyCLI framework
+ *
+ * A script is a sequence of command lines plus a few statements:
+ *
+ *     # comment
+ *     set <var> = <value> [<+|-|*|/|%> <value>]
+ *     if <value> [<==|!=|<|<=|>|>=> <value>] ... [else ...] end
+ *     while <value> [<op> <value>] ... end
+ *     for <var> in <from>..<to> ... end
+ *     for <var> in <word>... ... end
+ *     break
+ *     continue
+ *
+ * Words are split like command lines. $name and ${name} expand variables,
+ * $1..$9 and $# are the script arguments, $? is the result code of the last
+ * command and $$ is a literal '$'. Comparisons are numeric when both sides
+ * are integers and textual otherwise; a lone value is true unless it is
+ * empty or "0".
+ *
+ * Scripts are compiled once into bytecode: commands are looked up once per
+ * run, argument vectors without variables are built at load time, and
+ * variables live in numbered slots.
+ */
+
+#ifndef TINYCLI_SCRIPT_H
+#define TINYCLI_SCRIPT_H
+
+#include "tinycli.h"
+
+/**
+ * @brief Magic bytes at the start of a compiled script cache file
+ */
+#define TINYCLI_SCRIPT_MAGIC "TCLISCR1"
+
+/**
+ * @brief Suffix appended to a script path to name its cache file
+ */
+#define TINYCLI_SCRIPT_CACHE_SUFFIX ".tcc"
+
+/**
+ * @brief Maximum nesting depth of blocks
+ */
+#define TINYCLI_SCRIPT_MAX_DEPTH 32
+
+/**
+ * @brief Compiled script
+ */
+typedef struct tinycli_script tinycli_script_t;
+
+/**
+ * @brief Compile a script
+ * @param source Script text
+ * @param len Length of the script text
+ * @param error Buffer for an error message (can be NULL)
+ * @param error_size Size of the error buffer
+ * @return Compiled script or NULL on error
+ */
+tinycli_script_t *tinycli_script_compile(const char *source, size_t len,
+                                         char *error, size_t error_size);
+
+/**
+ * @brief Load a script file, using its compiled cache when it is up to date
+ * @param path Path of the script
+ * @param script Pointer to store the compiled script
+ * @param error Buffer for an error message (can be NULL)
+ * @param error_size Size of the error buffer
+ * @return Error code
+ *
+ * The cache lives next to the script (path + TINYCLI_SCRIPT_CACHE_SUFFIX) and
+ * is valid while the script's size and modification time are unchanged. A
+ * cache that can't be written is silently skipped. Set TINYCLI_SCRIPT_CACHE=0
+ * to disable it.
+ */
+int tinycli_script_load(const char *path, tinycli_script_t **script,
+                        char *error, size_t error_size);
+
+/**
+ * @brief Run a compiled script
+ * @param ctx TinyCLI context
+ * @param script Compiled script
+ * @param argc Number of script arguments (argv[0] is the script name)
+ * @param argv Script arguments
+ * @return Result code of the last command, or an error code if the script failed
+ *
+ * A script can be run any number of times, on any context.
+ */
+int tinycli_script_run(tinycli_context_t *ctx, const tinycli_script_t *script,
+                       int argc, char **argv);
+
+/**
+ * @brief Free a compiled script
+ * @param script Script to free
+ */
+void tinycli_script_free(tinycli_script_t *script);
+
+#endif /* TINYCLI_SCRIPT_H */
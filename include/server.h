@@ -0,0 +1,56 @@
+/**
+ * @file server.h
+ * @brief Unix socket server for the TinyCLI framework
+ */
+
+#ifndef TINYCLI_SERVER_H
+#define TINYCLI_SERVER_H
+
+#include "tinycli.h"
+
+/**
+ * @brief Maximum length of a request line
+ */
+#define TINYCLI_SERVER_MAX_LINE 65536
+
+/**
+ * @brief Unix socket server
+ *
+ * Each client connection gets its own context. Clients send command lines
+ * terminated by '\n'; for every line the server replies with a header line
+ * "<result> <length>\n" followed by <length> bytes of command output.
+ * The connection is closed when the client runs 'exit'.
+ */
+typedef struct tinycli_server tinycli_server_t;
+
+/**
+ * @brief Create a server listening on a Unix socket
+ * @param runtime Runtime for client contexts (NULL for the default runtime)
+ * @param socket_path Path of the socket (an existing socket file is replaced)
+ * @return New server or NULL on error
+ */
+tinycli_server_t *tinycli_server_create(tinycli_runtime_t *runtime, const char *socket_path);
+
+/**
+ * @brief Accept and serve clients until the server is stopped
+ * @param server Server
+ * @return Error code
+ */
+int tinycli_server_run(tinycli_server_t *server);
+
+/**
+ * @brief Stop a running server
+ * @param server Server
+ *
+ * Safe to call from a signal handler. Open client connections are shut down
+ * before tinycli_server_run() returns.
+ */
+void tinycli_server_stop(tinycli_server_t *server);
+
+/**
+ * @brief Close the socket and free a server
+ * @param server Server (must not be running)
+ */
+void tinycli_server_destroy(tinycli_server_t *server);
+
+#endif /* TINYCLI_SERVER_H */
@@ -0,0 +1,91 @@
+/**
+ * @file session.h
+ * @brief Session recording and replay for the TinyCLI framework
+ */
+
+#ifndef TINYCLI_SESSION_H
+#define TINYCLI_SESSION_H
+
+#include <stdint.h>
+
+#include "tinycli.h"
+
+/**
+ * @brief Magic bytes at the start of a session log
+ *
+ * The magic is followed by the wall-clock start time (8 bytes, little endian,
+ * nanoseconds since the epoch) and one record per executed line. Records are
+ * LEB128 varints: time since the previous record (ns), duration (ns),
+ * zigzag-encoded result code and line length, followed by the line bytes.
+ */
+#define TINYCLI_SESSION_MAGIC "TCLISES1"
+
+/**
+ * @brief Session recorder attached to a context
+ */
+typedef struct tinycli_session_recorder tinycli_session_recorder_t;
+
+/**
+ * @brief Replay options
+ */
+typedef struct {
+    double speed;                   /* Playback speed multiplier (0 replays as fast as possible) */
+    unsigned int concurrency;       /* Number of contexts replaying the log concurrently */
+    tinycli_runtime_t *runtime;     /* Runtime for replay contexts (NULL for the default) */
+} tinycli_replay_options_t;
+
+/**
+ * @brief Replay results
+ */
+typedef struct {
+    uint64_t commands;              /* Commands executed */
+    uint64_t errors;                /* Commands that returned an error */
+    uint64_t mismatches;            /* Commands whose result differs from the recording */
+    double elapsed;                 /* Wall time in seconds */
+    double throughput;              /* Commands per second */
+    uint64_t p50_ns;                /* Latency percentiles in nanoseconds */
+    uint64_t p90_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+    uint64_t max_ns;
+} tinycli_replay_report_t;
+
+/**
+ * @brief Start recording the lines executed by a context
+ * @param ctx TinyCLI context
+ * @param path Path of the session log to create
+ * @return Error code
+ */
+int tinycli_session_record_start(tinycli_context_t *ctx, const char *path);
+
+/**
+ * @brief Stop recording and close the session log
+ * @param ctx TinyCLI context
+ */
+void tinycli_session_record_stop(tinycli_context_t *ctx);
+
+/**
+ * @brief Append an executed line to the session log of a context
+ * @param ctx TinyCLI context (must be recording)
+ * @param line Command line
+ * @param start_ns Monotonic time the line started executing
+ * @param duration_ns Execution time
+ * @param result Result code
+ */
+void tinycli_session_record_line(tinycli_context_t *ctx, const char *line,
+                                 uint64_t start_ns, uint64_t duration_ns, int result);
+
+/**
+ * @brief Replay a session log and measure throughput and latency
+ * @param path Path of the session log
+ * @param options Replay options (NULL replays once, as fast as possible)
+ * @param report Structure to fill with the results
+ * @return Error code
+ *
+ * Each of the concurrent workers replays the whole log against its own
+ * context, with output discarded.
+ */
+int tinycli_session_replay(const char *path, const tinycli_replay_options_t *options,
+                           tinycli_replay_report_t *report);
+
+#endif /* TINYCLI_SESSION_H */
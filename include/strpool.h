@@ -0,0 +1,63 @@
+/**
+ * @file strpool.h
+ * @brief Interned string arena for the TinyCLI framework
+ */
+
+#ifndef TINYCLI_STRPOOL_H
+#define TINYCLI_STRPOOL_H
+
+#include <stdint.h>
+
+#include "tinycli.h"
+#include "alloc.h"
+
+/**
+ * @brief Interned string entry in the pool's hash set
+ */
+typedef struct {
+    uint32_t hash;                      /* Hash of the string */
+    uint32_t len;                       /* Length of the string */
+    const char *str;                    /* String stored in the arena */
+} tinycli_strpool_entry_t;
+
+/**
+ * @brief String pool structure
+ *
+ * Strings are copied once into large arena blocks and deduplicated, so equal
+ * strings share storage and can be compared by pointer. Interned strings stay
+ * valid until the pool is destroyed.
+ */
+typedef struct {
+    struct tinycli_strpool_block *blocks; /* Arena blocks, newest first */
+    tinycli_strpool_entry_t *entries;   /* Open-addressing hash set */
+    size_t capacity;                    /* Hash set capacity (power of two) */
+    size_t count;                       /* Number of interned strings */
+    size_t bytes;                       /* Bytes used by interned strings */
+    tinycli_mem_tag_t tag;              /* Allocation tag */
+} tinycli_strpool_t;
+
+/**
+ * @brief Initialize a string pool
+ * @param pool Pool to initialize
+ * @param tag Allocation tag for arena memory
+ */
+void tinycli_strpool_init(tinycli_strpool_t *pool, tinycli_mem_tag_t tag);
+
+/**
+ * @brief Release all memory held by a string pool
+ * @param pool Pool to destroy
+ */
+void tinycli_strpool_destroy(tinycli_strpool_t *pool);
+
+/**
+ * @brief Intern a string
+ * @param pool String pool
+ * @param str String to intern (need not be NUL-terminated)
+ * @param len Length of the string
+ * @param hash Hash of the string as computed by tinycli_hash
+ * @return Interned NUL-terminated copy or NULL on error
+ */
+const char *tinycli_strpool_intern(tinycli_strpool_t *pool, const char *str,
+                                   size_t len, uint32_t hash);
+
+#endif /* TINYCLI_STRPOOL_H */
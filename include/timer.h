@@ -0,0 +1,125 @@
+/**
+ * @file timer.h
+ * @brief Periodic commands for the TinyCLI framework
+ *
+ * Scheduled command lines ('every' and 'watch') live in a hierarchical
+ * timer wheel: TINYCLI_TIMER_LEVELS levels of TINYCLI_TIMER_SLOTS slots,
+ * each level TINYCLI_TIMER_SLOTS times coarser than the one below. Adding,
+ * cancelling and expiring a timer are O(1); timers on the upper levels move
+ * down a level when the level below wraps around.
+ *
+ * Timers fire from the event loop (tinycli_poll_once() and tinycli_run()),
+ * on the thread that drives it.
+ */
+
+#ifndef TINYCLI_TIMER_H
+#define TINYCLI_TIMER_H
+
+#include <stdint.h>
+
+#include "tinycli.h"
+
+/**
+ * @brief Length of a wheel tick in milliseconds
+ */
+#define TINYCLI_TIMER_TICK_MS 10
+
+/**
+ * @brief log2 of the number of slots per level
+ */
+#define TINYCLI_TIMER_SLOT_BITS 6
+
+/**
+ * @brief Number of slots per level
+ */
+#define TINYCLI_TIMER_SLOTS (1 << TINYCLI_TIMER_SLOT_BITS)
+
+/**
+ * @brief Number of levels (64^4 ticks of 10 ms is about 46 hours)
+ */
+#define TINYCLI_TIMER_LEVELS 4
+
+/**
+ * @brief Kinds of timer
+ */
+typedef enum {
+    TINYCLI_TIMER_EVERY,                /* Print the output on every run */
+    TINYCLI_TIMER_WATCH                 /* Redraw the lines that changed */
+} tinycli_timer_kind_t;
+
+/**
+ * @brief Scheduled command
+ */
+typedef struct tinycli_timer {
+    struct tinycli_timer *prev;         /* Previous timer in the slot */
+    struct tinycli_timer *next;         /* Next timer in the slot */
+    struct tinycli_timer *all_next;     /* Next timer by id */
+    uint64_t expires;                   /* Tick the timer is due at */
+    uint64_t interval;                  /* Period in ticks */
+    uint64_t runs;                      /* Number of times run */
+    unsigned int id;                    /* Timer number */
+    tinycli_timer_kind_t kind;          /* Kind of timer */
+    bool cancelled;                     /* Cancelled while running */
+    char *line;                         /* Command line */
+    char *last;                         /* Last output of a watch (NULL before the first run) */
+    size_t last_len;                    /* Length of the last output */
+    unsigned int last_lines;            /* Number of lines on screen for the last output */
+    uint64_t last_epoch;                /* Output epoch after the last redraw */
+} tinycli_timer_t;
+
+/**
+ * @brief Timer wheel of a context
+ */
+typedef struct {
+    tinycli_timer_t *slots[TINYCLI_TIMER_LEVELS][TINYCLI_TIMER_SLOTS]; /* Slot lists */
+    tinycli_timer_t *all;               /* All timers, by id */
+    uint64_t start_ns;                  /* Time of tick 0 */
+    uint64_t now;                       /* Current tick */
+    size_t count;                       /* Number of timers */
+    unsigned int next_id;               /* Number of the next timer */
+    tinycli_timer_t *running;           /* Timer being run (NULL if none) */
+    tinycli_timer_t *due;               /* Timers of the tick being run, not yet run */
+} tinycli_timers_t;
+
+/**
+ * @brief Schedule a command line
+ * @param ctx TinyCLI context
+ * @param kind Kind of timer
+ * @param interval_ms Period in milliseconds
+ * @param line Command line
+ * @param id Pointer to store the timer number (can be NULL)
+ * @return Error code
+ */
+int tinycli_timer_add(tinycli_context_t *ctx, tinycli_timer_kind_t kind,
+                      unsigned long interval_ms, const char *line, unsigned int *id);
+
+/**
+ * @brief Cancel a timer
+ * @param ctx TinyCLI context
+ * @param id Timer number (0 for all timers)
+ * @return Error code
+ */
+int tinycli_timer_cancel(tinycli_context_t *ctx, unsigned int id);
+
+/**
+ * @brief List timers as a structured table
+ * @param ctx TinyCLI context
+ * @return Error code
+ */
+int tinycli_timer_list(tinycli_context_t *ctx);
+
+/**
+ * @brief Parse an interval such as "500ms", "2s", "1.5m" or "1h" (bare numbers are seconds)
+ * @param text Interval text
+ * @param interval_ms Pointer to store the interval in milliseconds
+ * @return Error code
+ */
+int tinycli_timer_parse_interval(const char *text, unsigned long *interval_ms);
+
+/**
+ * @brief Free the timers of a context
+ * @param timers Timer wheel (can be NULL)
+ */
+void tinycli_timers_free(tinycli_timers_t *timers);
+
+#endif /* TINYCLI_TIMER_H */
@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /**
  * @brief Version information for TinyCLI
@@ -29,7 +30,9 @@ typedef enum {
     TINYCLI_ERROR_NOT_FOUND = -4,
     TINYCLI_ERROR_PLUGIN = -5,
     TINYCLI_ERROR_COMMAND_EXISTS = -6,
-    TINYCLI_ERROR_PLUGIN_EXISTS = -7
+    TINYCLI_ERROR_PLUGIN_EXISTS = -7,
+    TINYCLI_ERROR_CANCELLED = -8,
+    TINYCLI_ERROR_TIMEOUT = -9
 } tinycli_error_t;
 
 /**
@@ -38,6 +41,7 @@ typedef enum {
 typedef struct tinycli_context tinycli_context_t;
 typedef struct tinycli_command tinycli_command_t;
 typedef struct tinycli_plugin tinycli_plugin_t;
+typedef struct tinycli_runtime tinycli_runtime_t;
 
 /**
  * @brief Command handler function type
@@ -57,6 +61,73 @@ typedef int (*tinycli_cmd_handler_t)(int argc, char **argv, tinycli_context_t *c
  */
 typedef char** (*tinycli_completion_func_t)(const char *text, int start, int end);
 
+/**
+ * @brief Sink that completion callbacks add candidates to
+ */
+typedef struct tinycli_completion_emitter tinycli_completion_emitter_t;
+
+/**
+ * @brief Context-aware completion callback type
+ * @param ctx TinyCLI context
+ * @param argc Number of words, including the one being completed
+ * @param argv Words of the line; argv[0] is the command and argv[argc - 1] the
+ *             (possibly empty) word being completed
+ * @param emitter Sink for candidates (see tinycli_completion_emit())
+ * @param user_data User data given at registration
+ * @return Error code
+ */
+typedef int (*tinycli_completion_v2_func_t)(tinycli_context_t *ctx, int argc, char **argv,
+                                            tinycli_completion_emitter_t *emitter,
+                                            void *user_data);
+
+/**
+ * @brief Asynchronous completion request
+ */
+typedef struct tinycli_completion_request tinycli_completion_request_t;
+
+/**
+ * @brief Asynchronous completion provider type
+ * @param request Completion request to add candidates to
+ * @param text Text to complete
+ * @param user_data User data given at registration
+ *
+ * Runs on the context's completion worker thread, never on the thread that
+ * reads the terminal, so it must not use the context.
+ */
+typedef void (*tinycli_async_completion_func_t)(tinycli_completion_request_t *request,
+                                                const char *text, void *user_data);
+
+/**
+ * @brief Cancellation callback type
+ * @param user_data User data given at registration
+ *
+ * Runs once, when the cancellation of the command that registered it is
+ * noticed (see tinycli_on_cancel()).
+ */
+typedef void (*tinycli_cancel_func_t)(void *user_data);
+
+/**
+ * @brief Memory allocator hooks
+ *
+ * All framework allocations are routed through these functions. Each hook
+ * receives the user_data pointer given here.
+ */
+typedef struct {
+    void *(*malloc_fn)(size_t size, void *user_data);             /* Allocate memory */
+    void *(*realloc_fn)(void *ptr, size_t size, void *user_data); /* Resize memory */
+    void (*free_fn)(void *ptr, void *user_data);                  /* Free memory */
+    void *user_data;                                              /* User-defined data */
+} tinycli_allocator_t;
+
+/**
+ * @brief Set the allocator used by the TinyCLI framework
+ * @param allocator Allocator hooks, or NULL to restore the C library allocator
+ * @return Error code (TINYCLI_ERROR_GENERAL if framework memory is still allocated)
+ *
+ * The allocator is process-wide and must be set before any context is created.
+ */
+int tinycli_set_allocator(const tinycli_allocator_t *allocator);
+
 /**
  * @brief Initialize the TinyCLI framework
  * @param prompt Command prompt string
@@ -64,6 +135,90 @@ typedef char** (*tinycli_completion_func_t)(const char *text, int start, int end
  */
 tinycli_context_t *tinycli_init(const char *prompt);
 
+/**
+ * @brief Initialize a TinyCLI context that uses a given runtime
+ * @param runtime Shared runtime (NULL for the process-wide default runtime)
+ * @param prompt Command prompt string
+ * @return TinyCLI context or NULL on error
+ *
+ * Contexts are independent of each other and may be used from different
+ * threads, as long as each context is used by one thread at a time.
+ */
+tinycli_context_t *tinycli_init_with_runtime(tinycli_runtime_t *runtime, const char *prompt);
+
+/**
+ * @brief Create a runtime shared by a group of contexts
+ * @return New runtime or NULL on error
+ *
+ * The runtime holds state shared between contexts, such as the plugin
+ * directory. It is reference counted: each context holds a reference, and
+ * the runtime is freed when the creator and all contexts have released it.
+ */
+tinycli_runtime_t *tinycli_runtime_create(void);
+
+/**
+ * @brief Release a reference to a runtime
+ * @param runtime Runtime to release
+ */
+void tinycli_runtime_release(tinycli_runtime_t *runtime);
+
+/**
+ * @brief Get the runtime of a context
+ * @param ctx TinyCLI context
+ * @return Runtime
+ */
+tinycli_runtime_t *tinycli_get_runtime(tinycli_context_t *ctx);
+
+/**
+ * @brief Set the plugin directory of a runtime
+ * @param runtime Runtime (NULL for the default runtime)
+ * @param dir Plugin directory path, or a colon-separated list of directories
+ *            searched in order
+ *
+ * Defaults to TINYCLI_PLUGIN_PATH, then TINYCLI_PLUGIN_DIR, then the
+ * directory of the executable.
+ */
+void tinycli_runtime_set_plugin_dir(tinycli_runtime_t *runtime, const char *dir);
+
+/**
+ * @brief How plugin libraries are bound when loaded (flags)
+ *
+ * Only the first load of a library decides how it is bound; later loads of
+ * the same file share it.
+ */
+typedef enum {
+    TINYCLI_PLUGIN_BIND_NOW = 0,            /* Resolve all symbols at load, keep them local (default) */
+    TINYCLI_PLUGIN_BIND_LAZY = 1 << 0,      /* Resolve functions on their first call */
+    TINYCLI_PLUGIN_BIND_GLOBAL = 1 << 1,    /* Make symbols available to libraries loaded later */
+    TINYCLI_PLUGIN_BIND_DEEPBIND = 1 << 2,  /* Prefer the library's own symbols over global ones */
+    TINYCLI_PLUGIN_BIND_NODELETE = 1 << 3   /* Keep the library mapped after it is closed */
+} tinycli_plugin_bind_t;
+
+/**
+ * @brief Set how a runtime binds plugin libraries by default
+ * @param runtime Runtime (NULL for the default runtime)
+ * @param bind TINYCLI_PLUGIN_BIND_* flags
+ *
+ * Defaults to the flags in TINYCLI_PLUGIN_BIND (see tinycli_load_plugin_bind()).
+ */
+void tinycli_runtime_set_plugin_bind(tinycli_runtime_t *runtime, unsigned int bind);
+
+/**
+ * @brief Get how a runtime binds plugin libraries by default
+ * @param runtime Runtime (NULL for the default runtime)
+ * @return TINYCLI_PLUGIN_BIND_* flags
+ */
+unsigned int tinycli_runtime_get_plugin_bind(tinycli_runtime_t *runtime);
+
+/**
+ * @brief Copy the plugin directory of a runtime
+ * @param runtime Runtime (NULL for the default runtime)
+ * @param buffer Buffer to store the directory path
+ * @param size Size of the buffer
+ * @return Buffer pointer, or NULL if no directory is set or it doesn't fit
+ */
+char *tinycli_runtime_get_plugin_dir(tinycli_runtime_t *runtime, char *buffer, size_t size);
+
 /**
  * @brief Clean up and free TinyCLI resources
  * @param ctx TinyCLI context
@@ -74,9 +229,167 @@ void tinycli_cleanup(tinycli_context_t *ctx);
  * @brief Run the TinyCLI command loop
  * @param ctx TinyCLI context
  * @return Error code
+ *
+ * The terminal is process-wide, so only one context can run the command loop
+ * at a time; other callers get TINYCLI_ERROR_GENERAL.
  */
 int tinycli_run(tinycli_context_t *ctx);
 
+/**
+ * @brief Take over the terminal for event-loop use
+ * @param ctx TinyCLI context
+ * @return Error code
+ *
+ * Shows the prompt and installs a readline callback handler instead of
+ * blocking in readline(). From then on the host calls
+ * tinycli_event_process() whenever tinycli_event_fd() is readable (or just
+ * calls tinycli_poll_once()), until tinycli_is_running() returns false.
+ * Completed lines are executed from inside those calls, on the host's thread.
+ */
+int tinycli_event_begin(tinycli_context_t *ctx);
+
+/**
+ * @brief Get the file descriptor the terminal is read from
+ * @param ctx TinyCLI context
+ * @return File descriptor, or -1 if the context isn't in event-loop mode
+ */
+int tinycli_event_fd(tinycli_context_t *ctx);
+
+/**
+ * @brief Consume terminal input that is ready
+ * @param ctx TinyCLI context
+ * @return Error code
+ */
+int tinycli_event_process(tinycli_context_t *ctx);
+
+/**
+ * @brief Wait for terminal input and consume it
+ * @param ctx TinyCLI context
+ * @param timeout_ms Time to wait in milliseconds (-1 to wait forever, 0 to poll)
+ * @return 1 if input was consumed, 0 on timeout or interruption, or an error code
+ *
+ * Periodic commands that fall due while waiting are run before returning.
+ */
+int tinycli_poll_once(tinycli_context_t *ctx, int timeout_ms);
+
+/**
+ * @brief Get the time until the next periodic command is due
+ * @param ctx TinyCLI context
+ * @return Milliseconds to wait before calling tinycli_timers_run(), or -1 if nothing is scheduled
+ *
+ * Hosts driving the terminal from their own loop use this as (an upper bound
+ * for) their poll timeout; tinycli_poll_once() already does.
+ */
+int tinycli_timers_next_ms(tinycli_context_t *ctx);
+
+/**
+ * @brief Run the periodic commands that are due
+ * @param ctx TinyCLI context
+ * @return Error code
+ */
+int tinycli_timers_run(tinycli_context_t *ctx);
+
+/**
+ * @brief Cancel the running command
+ * @param ctx TinyCLI context
+ * @return Error code (TINYCLI_ERROR_NOT_FOUND if no command is running)
+ *
+ * Async-signal-safe: meant to be called from a SIGINT handler. The command
+ * sees tinycli_cancelled() turn true. A command running on a worker thread
+ * (see tinycli_set_cancel_grace()) has its cancellation callbacks run right
+ * away and is abandoned once the grace period is over, or at the second call.
+ */
+int tinycli_cancel(tinycli_context_t *ctx);
+
+/**
+ * @brief Check whether the running command was cancelled
+ * @param ctx TinyCLI context
+ * @return true once the command was cancelled
+ *
+ * Long-running handlers poll this and return TINYCLI_ERROR_CANCELLED. The
+ * first check that sees the cancellation also runs the callbacks registered
+ * with tinycli_on_cancel() if nothing else has yet.
+ */
+bool tinycli_cancelled(tinycli_context_t *ctx);
+
+/**
+ * @brief Register a callback to run when the running command is cancelled
+ * @param ctx TinyCLI context
+ * @param func Callback
+ * @param user_data User data passed to the callback
+ * @return Error code (TINYCLI_ERROR_NOT_FOUND outside a command)
+ *
+ * Useful to unblock a handler waiting on something, e.g. by shutting down a
+ * socket. For a command on a worker thread the callback runs on the thread
+ * that supervises it; otherwise it runs at the next tinycli_cancelled()
+ * check. If the command was already cancelled the callback runs at once.
+ * Callbacks are dropped when the command returns.
+ */
+int tinycli_on_cancel(tinycli_context_t *ctx, tinycli_cancel_func_t func, void *user_data);
+
+/**
+ * @brief Run commands on a worker thread that can be abandoned
+ * @param ctx TinyCLI context
+ * @param grace_ms Time a cancelled command gets to return before it is
+ *                 abandoned, or -1 to run commands on the calling thread
+ *                 (the default)
+ * @return Error code
+ *
+ * An abandoned command keeps running in the background with its output
+ * discarded, and the caller gets TINYCLI_ERROR_CANCELLED. It must not touch
+ * the context once it has been freed.
+ */
+int tinycli_set_cancel_grace(tinycli_context_t *ctx, int grace_ms);
+
+/**
+ * @brief Run plugin commands in pre-forked worker processes
+ * @param ctx TinyCLI context
+ * @param workers Number of worker processes, or 0 to run plugin commands in
+ *                the shell again (the default)
+ * @return Error code
+ *
+ * A plugin command that crashes only takes its worker down: the command
+ * fails with TINYCLI_ERROR_PLUGIN and the worker is respawned. Cancelling
+ * or timing out an isolated command kills its worker. The workers are
+ * forked from the context as it is, so set this up after loading plugins
+ * (workers are refreshed when plugins change, at a cost) and not while
+ * commands are running. Workers are forked by the calling thread only.
+ */
+int tinycli_set_isolation(tinycli_context_t *ctx, unsigned int workers);
+
+/**
+ * @brief Register the terminal with an epoll instance
+ * @param ctx TinyCLI context
+ * @param epfd Epoll instance
+ * @return Error code
+ *
+ * The event's data.ptr is the context, so the host can tell it apart from its
+ * own descriptors and pass it to tinycli_event_process(). The registration is
+ * removed by tinycli_event_end().
+ */
+int tinycli_event_epoll_add(tinycli_context_t *ctx, int epfd);
+
+/**
+ * @brief Check whether the command loop should keep going
+ * @param ctx TinyCLI context
+ * @return false after 'exit' or the end of input
+ */
+bool tinycli_is_running(tinycli_context_t *ctx);
+
+/**
+ * @brief Release the terminal after tinycli_event_begin()
+ * @param ctx TinyCLI context
+ */
+void tinycli_event_end(tinycli_context_t *ctx);
+
+/**
+ * @brief Parse and execute a single command line
+ * @param ctx TinyCLI context
+ * @param line Command line
+ * @return Error code of the command (TINYCLI_ERROR_NOT_FOUND for unknown commands)
+ */
+int tinycli_execute_line(tinycli_context_t *ctx, const char *line);
+
 /**
  * @brief Register a command with TinyCLI
  * @param ctx TinyCLI context
@@ -90,6 +403,95 @@ int tinycli_register_command(tinycli_context_t *ctx, const char *name,
                             const char *help, tinycli_cmd_handler_t handler,
                             tinycli_completion_func_t completion);
 
+/**
+ * @brief Register a command with a default timeout
+ * @param ctx TinyCLI context
+ * @param name Command name
+ * @param help Help text for the command
+ * @param handler Command handler function
+ * @param completion Command completion function (can be NULL)
+ * @param timeout_ms Default timeout in milliseconds (0 for none)
+ * @return Error code
+ *
+ * When the timeout passes the command is cancelled (see tinycli_cancel()),
+ * and it fails with TINYCLI_ERROR_TIMEOUT once it gives up or is abandoned.
+ * Callers can set another timeout for one run with 'timeout <interval> cmd'.
+ */
+int tinycli_register_command_timeout(tinycli_context_t *ctx, const char *name,
+                                     const char *help, tinycli_cmd_handler_t handler,
+                                     tinycli_completion_func_t completion,
+                                     unsigned int timeout_ms);
+
+/**
+ * @brief Set the default timeout of a command
+ * @param ctx TinyCLI context
+ * @param name Command name
+ * @param timeout_ms Default timeout in milliseconds (0 for none)
+ * @return Error code
+ */
+int tinycli_set_command_timeout(tinycli_context_t *ctx, const char *name, unsigned int timeout_ms);
+
+/**
+ * @brief Attach a context-aware completion callback to a command
+ * @param ctx TinyCLI context
+ * @param name Command name
+ * @param completion Completion callback
+ * @param user_data User data passed to the callback
+ * @return Error code
+ *
+ * The callback replaces the command's completion function. It gets the line
+ * already split into words, and its candidates are copied into a buffer owned
+ * by the context, so it allocates nothing per candidate.
+ */
+int tinycli_register_completion(tinycli_context_t *ctx, const char *name,
+                                tinycli_completion_v2_func_t completion, void *user_data);
+
+/**
+ * @brief Add a completion candidate
+ * @param emitter Emitter passed to the completion callback
+ * @param candidate Candidate (copied)
+ * @return Error code
+ */
+int tinycli_completion_emit(tinycli_completion_emitter_t *emitter, const char *candidate);
+
+/**
+ * @brief Attach an asynchronous completion provider to a command
+ * @param ctx TinyCLI context
+ * @param name Command name
+ * @param provider Completion provider
+ * @param user_data User data passed to the provider
+ * @param deadline_ms Time to wait for the provider before showing the candidates found so far
+ * @return Error code
+ *
+ * The provider replaces the command's completion function. It runs on a
+ * worker thread and adds candidates with tinycli_completion_add() as it finds
+ * them. Completion waits until the provider returns or the deadline passes;
+ * a provider that is still running keeps adding to the same request, and its
+ * results are cached per argument prefix, so pressing TAB again shows them
+ * without running the lookup again.
+ */
+int tinycli_register_async_completion(tinycli_context_t *ctx, const char *name,
+                                      tinycli_async_completion_func_t provider,
+                                      void *user_data, unsigned int deadline_ms);
+
+/**
+ * @brief Add a candidate to an asynchronous completion request
+ * @param request Completion request
+ * @param candidate Candidate (copied)
+ * @return Error code (TINYCLI_ERROR_GENERAL once the request is cancelled)
+ */
+int tinycli_completion_add(tinycli_completion_request_t *request, const char *candidate);
+
+/**
+ * @brief Check whether a completion request was cancelled
+ * @param request Completion request
+ * @return true if the provider should stop
+ *
+ * Requests are cancelled when they are evicted from the cache, when the
+ * command registry changes and when the context is freed.
+ */
+bool tinycli_completion_cancelled(const tinycli_completion_request_t *request);
+
 /**
  * @brief Load a plugin from a shared library
  * @param ctx TinyCLI context
@@ -106,6 +508,29 @@ int tinycli_load_plugin(tinycli_context_t *ctx, const char *plugin_path);
  */
 int tinycli_load_plugin_json(tinycli_context_t *ctx, const char *json_path);
 
+/**
+ * @brief Load a plugin from a shared library with explicit binding flags
+ * @param ctx TinyCLI context
+ * @param plugin_path Path to the plugin shared library
+ * @param bind TINYCLI_PLUGIN_BIND_* flags, replacing the runtime's default
+ * @return Error code
+ *
+ * Written as text (in TINYCLI_PLUGIN_BIND and "load plugin <n> --bind"),
+ * the flags are a comma-separated list of now, lazy, local, global,
+ * deepbind and nodelete.
+ */
+int tinycli_load_plugin_bind(tinycli_context_t *ctx, const char *plugin_path, unsigned int bind);
+
+/**
+ * @brief Load alias and macro definitions from a startup file
+ * @param ctx TinyCLI context
+ * @param path Path to the file (a missing file counts as empty)
+ * @return Error code
+ *
+ * Aliases defined afterwards are saved back to the same file.
+ */
+int tinycli_load_aliases(tinycli_context_t *ctx, const char *path);
+
 /**
  * @brief Print a message to the TinyCLI output
  * @param ctx TinyCLI context
@@ -115,15 +540,273 @@ int tinycli_load_plugin_json(tinycli_context_t *ctx, const char *json_path);
 void tinycli_printf(tinycli_context_t *ctx, const char *fmt, ...);
 
 /**
- * @brief Get the plugin directory path
+ * @brief Formats for structured output
+ */
+typedef enum {
+    TINYCLI_FORMAT_TEXT = 0,            /* Aligned columns for humans */
+    TINYCLI_FORMAT_JSON,                /* One JSON object per record (JSON Lines) */
+    TINYCLI_FORMAT_BINARY               /* Length-prefixed binary frames (see emit.h) */
+} tinycli_output_format_t;
+
+/**
+ * @brief Set the format structured output is rendered in
+ * @param ctx TinyCLI context
+ * @param format Output format
+ * @return Error code
+ */
+int tinycli_set_output_format(tinycli_context_t *ctx, tinycli_output_format_t format);
+
+/**
+ * @brief Get the format structured output is rendered in
+ * @param ctx TinyCLI context
+ * @return Output format
+ *
+ * Handlers should only print human decorations (titles, hints) with
+ * tinycli_printf() when this is TINYCLI_FORMAT_TEXT.
+ */
+tinycli_output_format_t tinycli_get_output_format(tinycli_context_t *ctx);
+
+/**
+ * @brief Start a table of records
+ * @param ctx TinyCLI context
+ * @param name Table name
+ * @return Error code
+ *
+ * Text tables are printed with a header row and aligned columns at
+ * tinycli_table_end(), unless every column but the last has a fixed width
+ * (see tinycli_table_column()), in which case rows are printed as they come.
+ */
+int tinycli_table_begin(tinycli_context_t *ctx, const char *name);
+
+/**
+ * @brief Declare a column of the current table
+ * @param ctx TinyCLI context
+ * @param key Field key
+ * @param width Fixed text width, or 0 to fit the widest value
+ * @return Error code
+ *
+ * Columns are ordered by declaration, then by first use.
+ */
+int tinycli_table_column(tinycli_context_t *ctx, const char *key, int width);
+
+/**
+ * @brief Finish the current table
+ * @param ctx TinyCLI context
+ * @return Error code
+ */
+int tinycli_table_end(tinycli_context_t *ctx);
+
+/**
+ * @brief Start a record
+ * @param ctx TinyCLI context
+ * @return Error code
+ *
+ * A record outside a table is printed on its own, as "key: value" lines in
+ * text format.
+ */
+int tinycli_record_begin(tinycli_context_t *ctx);
+
+/**
+ * @brief Add an integer field to the current record
+ * @param ctx TinyCLI context
+ * @param key Field key
+ * @param value Value
+ * @return Error code
+ */
+int tinycli_emit_int(tinycli_context_t *ctx, const char *key, long long value);
+
+/**
+ * @brief Add a string field to the current record
+ * @param ctx TinyCLI context
+ * @param key Field key
+ * @param value Value (NULL is emitted as an empty string)
+ * @return Error code
+ */
+int tinycli_emit_string(tinycli_context_t *ctx, const char *key, const char *value);
+
+/**
+ * @brief Add a boolean field to the current record
+ * @param ctx TinyCLI context
+ * @param key Field key
+ * @param value Value
+ * @return Error code
+ */
+int tinycli_emit_bool(tinycli_context_t *ctx, const char *key, bool value);
+
+/**
+ * @brief Add a byte string field to the current record
+ * @param ctx TinyCLI context
+ * @param key Field key
+ * @param data Bytes
+ * @param len Number of bytes
+ * @return Error code
+ *
+ * Rendered as hex in text, base64 in JSON and raw in binary format.
+ */
+int tinycli_emit_bytes(tinycli_context_t *ctx, const char *key, const void *data, size_t len);
+
+/**
+ * @brief Finish the current record
+ * @param ctx TinyCLI context
+ * @return Error code
+ */
+int tinycli_record_end(tinycli_context_t *ctx);
+
+/**
+ * @brief Get the plugin directory path of the default runtime
  * @return Plugin directory path or NULL if not set
+ *
+ * The returned string is only valid until the directory is changed; use
+ * tinycli_runtime_get_plugin_dir() when other threads may change it.
  */
 const char *tinycli_get_plugin_dir(void);
 
 /**
- * @brief Set the plugin directory path
+ * @brief Set the plugin directory path of the default runtime
  * @param dir Plugin directory path
  */
 void tinycli_set_plugin_dir(const char *dir);
 
+/**
+ * @brief Metric in the process-wide registry
+ */
+typedef struct tinycli_metric tinycli_metric_t;
+
+/**
+ * @brief Register a counter, or find it if it exists
+ * @param name Family name ([a-zA-Z_:][a-zA-Z0-9_:]*)
+ * @param help Help text (can be NULL)
+ * @param labels Label pairs such as 'device="sda",op="read"' (NULL for none)
+ * @return Metric or NULL on error (bad name, or the family has another type)
+ *
+ * Metrics live until the process exits, so a plugin that is loaded again
+ * gets its earlier counters back.
+ */
+tinycli_metric_t *tinycli_metric_counter(const char *name, const char *help, const char *labels);
+
+/**
+ * @brief Register a gauge, or find it if it exists
+ * @param name Family name ([a-zA-Z_:][a-zA-Z0-9_:]*)
+ * @param help Help text (can be NULL)
+ * @param labels Label pairs (NULL for none)
+ * @return Metric or NULL on error
+ */
+tinycli_metric_t *tinycli_metric_gauge(const char *name, const char *help, const char *labels);
+
+/**
+ * @brief Increment a counter
+ * @param metric Counter (can be NULL)
+ * @param value Amount to add
+ *
+ * Lock-free: each thread counts in its own slot.
+ */
+void tinycli_metric_inc(tinycli_metric_t *metric, uint64_t value);
+
+/**
+ * @brief Set a gauge
+ * @param metric Gauge (can be NULL)
+ * @param value New value
+ */
+void tinycli_metric_set(tinycli_metric_t *metric, int64_t value);
+
+/**
+ * @brief Move a gauge up or down
+ * @param metric Gauge (can be NULL)
+ * @param delta Amount to add
+ */
+void tinycli_metric_add(tinycli_metric_t *metric, int64_t delta);
+
+/**
+ * @brief Rewrite a Prometheus textfile-collector file periodically
+ * @param path File to write (replaced atomically; NULL to stop)
+ * @param interval_ms Time between writes
+ * @return Error code
+ */
+int tinycli_metrics_export_file(const char *path, unsigned int interval_ms);
+
+/**
+ * @brief Serve the metrics over HTTP on a Unix socket
+ * @param socket_path Path of the socket (an existing socket file is replaced; NULL to stop)
+ * @return Error code
+ *
+ * Every request gets the registry in the Prometheus text format, whatever
+ * its path, e.g. curl --unix-socket <path> http://localhost/metrics.
+ */
+int tinycli_metrics_export_socket(const char *socket_path);
+
+/**
+ * @brief Stop exporting metrics to a file or socket
+ */
+void tinycli_metrics_export_stop(void);
+
+/**
+ * @brief Log levels, from the most to the least severe
+ */
+typedef enum {
+    TINYCLI_LOG_ERROR = 0,
+    TINYCLI_LOG_WARN,
+    TINYCLI_LOG_INFO,
+    TINYCLI_LOG_DEBUG,
+    TINYCLI_LOG_TRACE
+} tinycli_log_level_t;
+
+/**
+ * @brief Least severe level that is logged (read by TINYCLI_LOG; set it with tinycli_log_set_level())
+ */
+extern int tinycli_log_threshold;
+
+/**
+ * @brief Log a message if its level passes the threshold
+ *
+ * Filtered messages cost one load and one branch; their arguments are not
+ * evaluated, so debug logging can stay in production builds.
+ */
+#define TINYCLI_LOG(level, ...) \
+    do { \
+        if ((int)(level) <= __atomic_load_n(&tinycli_log_threshold, __ATOMIC_RELAXED)) { \
+            tinycli_log_write((level), __VA_ARGS__); \
+        } \
+    } while (0)
+
+/**
+ * @brief Log a message regardless of the threshold (use TINYCLI_LOG instead)
+ * @param level Log level
+ * @param fmt Format string
+ * @param ... Format arguments
+ *
+ * The record goes into a ring buffer of the calling thread without locks
+ * or system calls; a background thread writes it out. When the ring is
+ * full the record is dropped and counted.
+ */
+void tinycli_log_write(tinycli_log_level_t level, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Set the least severe level that is logged
+ * @param level Log level
+ * @return Error code
+ */
+int tinycli_log_set_level(tinycli_log_level_t level);
+
+/**
+ * @brief Send log records to a new destination
+ * @param target "stderr" (the default), "syslog", or the path of a file to append to
+ * @return Error code
+ *
+ * Records logged before the call go to the old destination.
+ */
+int tinycli_log_open(const char *target);
+
+/**
+ * @brief Write out the records logged so far
+ */
+void tinycli_log_flush(void);
+
+/**
+ * @brief Flush the log and stop the background thread
+ *
+ * Logging again starts a new one.
+ */
+void tinycli_log_close(void);
+
 #endif /* TINYCLI_H */ 
\ No newline at end of file
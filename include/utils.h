@@ -6,6 +6,8 @@
 #ifndef TINYCLI_UTILS_H
 #define TINYCLI_UTILS_H
 
+#include <stdint.h>
+
 #include "tinycli.h"
 
 /**
@@ -27,10 +29,27 @@ void tinycli_free_args(int argc, char **argv);
 /**
  * @brief Duplicate a string
  * @param str String to duplicate
- * @return Duplicated string or NULL on error
+ * @return Duplicated string (free with free()) or NULL on error
+ *
+ * The copy comes from the C library allocator, so it is also safe to hand
+ * to readline. Core code uses tinycli_mem_strdup() for tracked copies.
  */
 char *tinycli_strdup(const char *str);
 
+/**
+ * @brief Hash a string (32-bit FNV-1a)
+ * @param str String to hash (need not be NUL-terminated)
+ * @param len Length of the string
+ * @return Hash value
+ */
+uint32_t tinycli_hash(const char *str, size_t len);
+
+/**
+ * @brief Get the current monotonic time
+ * @return Time in nanoseconds
+ */
+uint64_t tinycli_time_ns(void);
+
 /**
  * @brief Check if a string starts with a prefix
  * @param str String to check
@@ -0,0 +1,70 @@
+/**
+ * @file watchdog.h
+ * @brief Command deadlines for the TinyCLI framework
+ *
+ * One watchdog thread per runtime keeps the armed deadlines of all its
+ * contexts in a binary min-heap and sleeps until the earliest one. Arming,
+ * moving and disarming a deadline are O(log n); the thread is only woken
+ * when the earliest deadline changes.
+ */
+
+#ifndef TINYCLI_WATCHDOG_H
+#define TINYCLI_WATCHDOG_H
+
+#include <stdint.h>
+
+#include "tinycli.h"
+
+/**
+ * @brief Watchdog thread and its deadline heap
+ */
+typedef struct tinycli_watchdog tinycli_watchdog_t;
+
+/**
+ * @brief Deadline, embedded in the object it guards
+ */
+typedef struct tinycli_deadline {
+    uint64_t due_ns;                    /* Monotonic time the deadline passes at */
+    size_t pos;                         /* Position in the heap + 1 (0 when not armed) */
+    void (*expire)(struct tinycli_deadline *deadline); /* Run on the watchdog thread when due */
+} tinycli_deadline_t;
+
+/**
+ * @brief Arm a deadline, or move it if it is armed already
+ * @param runtime Runtime whose watchdog to use
+ * @param deadline Deadline with expire set
+ * @param due_ns Monotonic time (see tinycli_time_ns()) the deadline passes at
+ * @return Error code
+ *
+ * The expire callback runs on the watchdog thread with the heap locked, so
+ * it must be quick and must not arm or disarm deadlines. Once it has run the
+ * deadline is disarmed.
+ */
+int tinycli_watchdog_arm(tinycli_runtime_t *runtime, tinycli_deadline_t *deadline, uint64_t due_ns);
+
+/**
+ * @brief Disarm a deadline
+ * @param runtime Runtime the deadline was armed with
+ * @param deadline Deadline (may be disarmed already)
+ *
+ * Once this returns the expire callback is not running and will not run.
+ */
+void tinycli_watchdog_disarm(tinycli_runtime_t *runtime, tinycli_deadline_t *deadline);
+
+/**
+ * @brief Forget the watchdog of a runtime in a forked child
+ * @param runtime Runtime
+ *
+ * The thread only exists in the parent and the locks may have been held by
+ * another thread at fork time; the next deadline armed in the child starts
+ * a watchdog of its own.
+ */
+void tinycli_watchdog_after_fork(tinycli_runtime_t *runtime);
+
+/**
+ * @brief Stop a watchdog thread and free it
+ * @param watchdog Watchdog (can be NULL)
+ */
+void tinycli_watchdog_destroy(tinycli_watchdog_t *watchdog);
+
+#endif /* TINYCLI_WATCHDOG_H */
@@ -5,16 +5,588 @@
  * @date 2025-07-09
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#endif
 
 #include "tinycli.h"
 #include "context.h"
 #include "command.h"
 #include "plugin.h"
+#include "output.h"
+#include "alloc.h"
 #include "utils.h"
 
+/* Directory entries read per getdents64 call (and listed per batch when unsorted) */
+#define LS_DENTS_SIZE (256 * 1024)
+
+/* Most threads that stat entries for a long listing */
+#define LS_STAT_THREADS 4
+
+/* Batches smaller than this are stat'ed by the listing thread alone */
+#define LS_STAT_PARALLEL_MIN 256
+
+/* Entries a stat thread claims at a time */
+#define LS_STAT_CLAIM 64
+
+/* Sort order of an ls listing */
+typedef enum {
+    LS_SORT_NONE = 0,               /* Directory order, streamed */
+    LS_SORT_NAME,                   /* By name */
+    LS_SORT_SIZE,                   /* By size, largest first */
+    LS_SORT_TIME                    /* By modification time, newest first */
+} ls_sort_t;
+
+/* Directory entry being listed */
+typedef struct {
+    size_t name;                    /* Offset of the name in the name arena */
+    bool stat_ok;                   /* The fields below are valid */
+    uint32_t mode;                  /* Type and permissions */
+    uint32_t nlink;                 /* Number of hard links */
+    uint64_t size;                  /* Size in bytes */
+    int64_t mtime;                  /* Modification time (seconds) */
+} ls_entry_t;
+
+/* Sort key: the entry's order-deciding value next to its index */
+typedef struct {
+    uint64_t key;                   /* Size, time or the first 8 bytes of the name */
+    uint32_t index;                 /* Entry index */
+} ls_key_t;
+
+/* Listing in progress */
+typedef struct {
+    tinycli_context_t *ctx;         /* Context of the command */
+    int dirfd;                      /* Directory being listed */
+    bool all;                       /* Include dot files */
+    bool lng;                       /* Long listing */
+    bool reverse;                   /* Reverse the sort order */
+    ls_sort_t sort;                 /* Sort order */
+    ls_entry_t *entries;            /* Entries of the batch (or all, when sorting) */
+    size_t count, cap;
+    char *names;                    /* Name arena */
+    size_t names_len, names_cap;
+    size_t next;                    /* Next entry to stat (claimed atomically) */
+    int error;                      /* errno of a failed directory read (0 if none) */
+} ls_listing_t;
+
+/* Threads that stat the entries of listings, kept while the plugin is loaded */
+typedef struct {
+    pthread_t threads[LS_STAT_THREADS]; /* Stat threads */
+    unsigned int count;             /* Number of threads */
+    pthread_mutex_t lock;           /* Protects the fields below */
+    pthread_cond_t work;            /* Signalled when a batch is posted or on stop */
+    pthread_cond_t done;            /* Signalled when a thread finishes a batch */
+    ls_listing_t *listing;          /* Listing whose batch to stat (NULL when idle) */
+    unsigned int batch;             /* Batch number, bumped per batch */
+    unsigned int busy;              /* Threads still working on the batch */
+    bool started;                   /* Threads were started (or there are none to start) */
+    bool stop;                      /* Threads should exit */
+} ls_pool_t;
+
+/* Stat threads shared by every listing of the process, started on the first long one */
+static ls_pool_t g_ls_pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .work = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+/* Contexts the plugin is initialized in; the last cleanup stops the pool */
+static unsigned int g_system_users = 0;
+static pthread_mutex_t g_system_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t g_system_once = PTHREAD_ONCE_INIT;
+
+/* Bytes handed to the kernel per sendfile/splice call (cancellation is checked in between) */
+#define CAT_SEND_CHUNK (8 * 1024 * 1024)
+
+/* Bytes mapped at a time when output goes through the context */
+#define CAT_MAP_WINDOW (64 * 1024 * 1024)
+
+/* Bytes written to the context output at a time */
+#define CAT_WRITE_CHUNK (64 * 1024)
+
+/* Time between checks for new data when following a file */
+#define CAT_FOLLOW_MS 100
+
+/* Byte range and mode of a cat command */
+typedef struct {
+    long long offset;               /* Start offset (negative: from the end) */
+    long long length;               /* Bytes to copy (-1 for all) */
+    bool follow;                    /* Keep copying data appended to the file */
+} cat_options_t;
+
+/* Get the metadata of an entry */
+static void ls_stat(ls_listing_t *listing, ls_entry_t *entry)
+{
+    const char *name = listing->names + entry->name;
+#ifdef STATX_BASIC_STATS
+    struct statx stx;
+
+    /* Only the fields the listing shows; no automount or sync */
+    if (statx(listing->dirfd, name, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT | AT_STATX_DONT_SYNC,
+              STATX_TYPE | STATX_MODE | STATX_NLINK | STATX_SIZE | STATX_MTIME, &stx) == 0) {
+        entry->mode = stx.stx_mode;
+        entry->nlink = stx.stx_nlink;
+        entry->size = stx.stx_size;
+        entry->mtime = stx.stx_mtime.tv_sec;
+        entry->stat_ok = true;
+    }
+#else
+    struct stat st;
+
+    if (fstatat(listing->dirfd, name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+        entry->mode = st.st_mode;
+        entry->nlink = (uint32_t)st.st_nlink;
+        entry->size = (uint64_t)st.st_size;
+        entry->mtime = st.st_mtime;
+        entry->stat_ok = true;
+    }
+#endif
+}
+
+/* Stat entries of a listing until none are left to claim */
+static void ls_stat_claim(ls_listing_t *listing)
+{
+    size_t start, end;
+
+    for (;;) {
+        start = __atomic_fetch_add(&listing->next, LS_STAT_CLAIM, __ATOMIC_RELAXED);
+        if (start >= listing->count) {
+            break;
+        }
+        end = start + LS_STAT_CLAIM < listing->count ? start + LS_STAT_CLAIM : listing->count;
+        for (; start < end; start++) {
+            ls_stat(listing, &listing->entries[start]);
+        }
+    }
+}
+
+/* Stat thread: works on each batch as it is posted */
+static void *ls_pool_thread(void *arg)
+{
+    ls_pool_t *pool = (ls_pool_t *)arg;
+    unsigned int seen;
+
+    pthread_mutex_lock(&pool->lock);
+    seen = pool->batch;
+    for (;;) {
+        while (!pool->stop && pool->batch == seen) {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+        if (pool->stop) {
+            break;
+        }
+        seen = pool->batch;
+        pthread_mutex_unlock(&pool->lock);
+
+        ls_stat_claim(pool->listing);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+/* Get the stat threads, starting them on first use (NULL on a single CPU) */
+static ls_pool_t *ls_pool_get(void)
+{
+    ls_pool_t *pool = &g_ls_pool;
+    long cpus;
+    unsigned int wanted;
+    sigset_t all, saved;
+
+    pthread_mutex_lock(&pool->lock);
+    if (!pool->started) {
+        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        wanted = cpus > 1 ? (unsigned int)(cpus - 1) : 0;
+        if (wanted > LS_STAT_THREADS) {
+            wanted = LS_STAT_THREADS;
+        }
+
+        /* Keep signals for the threads running commands */
+        sigfillset(&all);
+        pthread_sigmask(SIG_SETMASK, &all, &saved);
+        while (pool->count < wanted &&
+               pthread_create(&pool->threads[pool->count], NULL, ls_pool_thread, pool) == 0) {
+            pool->count++;
+        }
+        pthread_sigmask(SIG_SETMASK, &saved, NULL);
+        pool->started = true;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return pool->count > 0 ? pool : NULL;
+}
+
+/* Stop the stat threads; the next long listing starts them again */
+static void ls_pool_stop(ls_pool_t *pool)
+{
+    unsigned int i;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->count = 0;
+    pool->started = false;
+    pool->stop = false;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* In a forked child (an isolation worker) the threads are gone: start over */
+static void ls_pool_atfork_child(void)
+{
+    ls_pool_t *pool = &g_ls_pool;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->count = 0;
+    pool->listing = NULL;
+    pool->busy = 0;
+    pool->started = false;
+    pool->stop = false;
+    pthread_mutex_init(&g_system_lock, NULL);
+}
+
+/* Register the fork handler once per process */
+static void system_once(void)
+{
+    pthread_atfork(NULL, NULL, ls_pool_atfork_child);
+}
+
+/* Stat the current entries, fanning out over the pool for large batches */
+static void ls_stat_all(ls_listing_t *listing, ls_pool_t *pool)
+{
+    listing->next = 0;
+
+    if (!pool || listing->count < LS_STAT_PARALLEL_MIN) {
+        ls_stat_claim(listing);
+        return;
+    }
+
+    /* One batch at a time: a listing that finds the threads busy works alone */
+    pthread_mutex_lock(&pool->lock);
+    if (pool->listing) {
+        pthread_mutex_unlock(&pool->lock);
+        ls_stat_claim(listing);
+        return;
+    }
+    pool->listing = listing;
+    pool->busy = pool->count;
+    pool->batch++;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    /* Work alongside the threads, then wait for their last claims */
+    ls_stat_claim(listing);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pool->listing = NULL;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* Format a mode as ls does */
+static void ls_format_mode(uint32_t mode, char *buf)
+{
+    static const char rwx[] = "rwxrwxrwx";
+    int i;
+
+    buf[0] = S_ISDIR(mode) ? 'd' : S_ISLNK(mode) ? 'l' : S_ISCHR(mode) ? 'c' :
+             S_ISBLK(mode) ? 'b' : S_ISFIFO(mode) ? 'p' : S_ISSOCK(mode) ? 's' : '-';
+    for (i = 0; i < 9; i++) {
+        buf[i + 1] = (mode & (0400u >> i)) ? rwx[i] : '-';
+    }
+    buf[10] = '\0';
+}
+
+/* Start the listing table; fixed widths let text rows stream */
+static int ls_begin(ls_listing_t *listing)
+{
+    tinycli_context_t *ctx = listing->ctx;
+    int ret;
+
+    ret = tinycli_table_begin(ctx, "ls");
+    if (ret == TINYCLI_SUCCESS && listing->lng) {
+        ret = tinycli_table_column(ctx, "mode", 10);
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_table_column(ctx, "links", 5);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_table_column(ctx, "size", 12);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_table_column(ctx, "mtime", 16);
+        }
+    }
+    if (ret == TINYCLI_SUCCESS) {
+        ret = tinycli_table_column(ctx, "name", 0);
+    }
+
+    return ret;
+}
+
+/* Emit one entry */
+static int ls_emit(ls_listing_t *listing, const ls_entry_t *entry)
+{
+    tinycli_context_t *ctx = listing->ctx;
+    char mode[11], mtime[32];
+    time_t t;
+    struct tm tm;
+    int ret;
+
+    ret = tinycli_record_begin(ctx);
+    if (ret == TINYCLI_SUCCESS && listing->lng) {
+        if (entry->stat_ok) {
+            ls_format_mode(entry->mode, mode);
+            t = (time_t)entry->mtime;
+            localtime_r(&t, &tm);
+            strftime(mtime, sizeof(mtime), "%Y-%m-%d %H:%M", &tm);
+        } else {
+            strcpy(mode, "?");
+            strcpy(mtime, "?");
+        }
+        ret = tinycli_emit_string(ctx, "mode", mode);
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_int(ctx, "links", entry->nlink);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_int(ctx, "size", (long long)entry->size);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_string(ctx, "mtime", mtime);
+        }
+    }
+    if (ret == TINYCLI_SUCCESS) {
+        ret = tinycli_emit_string(ctx, "name", listing->names + entry->name);
+    }
+    if (ret == TINYCLI_SUCCESS) {
+        ret = tinycli_record_end(ctx);
+    } else {
+        tinycli_record_end(ctx);
+    }
+
+    return ret;
+}
+
+/* Add a name to the listing */
+static int ls_add(ls_listing_t *listing, const char *name)
+{
+    size_t len = strlen(name) + 1;
+    ls_entry_t *entry;
+
+    if (!listing->all && name[0] == '.') {
+        return TINYCLI_SUCCESS;
+    }
+
+    if (listing->count == listing->cap) {
+        size_t cap = listing->cap ? listing->cap * 2 : 1024;
+        ls_entry_t *entries = (ls_entry_t *)tinycli_realloc(TINYCLI_MEM_PLUGINS, listing->entries,
+                                                            cap * sizeof(*entries));
+        if (!entries) {
+            return TINYCLI_ERROR_MEMORY;
+        }
+        listing->entries = entries;
+        listing->cap = cap;
+    }
+    if (listing->names_len + len > listing->names_cap) {
+        size_t cap = listing->names_cap ? listing->names_cap * 2 : 64 * 1024;
+        char *names;
+        while (cap < listing->names_len + len) {
+            cap *= 2;
+        }
+        names = (char *)tinycli_realloc(TINYCLI_MEM_PLUGINS, listing->names, cap);
+        if (!names) {
+            return TINYCLI_ERROR_MEMORY;
+        }
+        listing->names = names;
+        listing->names_cap = cap;
+    }
+
+    entry = &listing->entries[listing->count++];
+    memset(entry, 0, sizeof(*entry));
+    entry->name = listing->names_len;
+    memcpy(listing->names + listing->names_len, name, len);
+    listing->names_len += len;
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Emit the entries read so far and start a new batch (unsorted listings) */
+static int ls_flush(ls_listing_t *listing, ls_pool_t *pool)
+{
+    size_t i;
+    int ret = TINYCLI_SUCCESS;
+
+    if (listing->lng) {
+        ls_stat_all(listing, pool);
+    }
+    for (i = 0; i < listing->count && ret == TINYCLI_SUCCESS; i++) {
+        ret = ls_emit(listing, &listing->entries[i]);
+    }
+    tinycli_output_flush(listing->ctx);
+
+    listing->count = 0;
+    listing->names_len = 0;
+
+    return ret;
+}
+
+/* Read the directory; unsorted listings are emitted a buffer at a time */
+static int ls_read(ls_listing_t *listing, ls_pool_t *pool)
+{
+    char *buf;
+    int ret = TINYCLI_SUCCESS;
+#ifdef __linux__
+    long n = 0, pos;
+
+    buf = (char *)tinycli_malloc(TINYCLI_MEM_PLUGINS, LS_DENTS_SIZE);
+    if (!buf) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    /* Many entries per system call, straight from the kernel's records */
+    while (ret == TINYCLI_SUCCESS &&
+           (n = syscall(SYS_getdents64, listing->dirfd, buf, LS_DENTS_SIZE)) > 0) {
+        for (pos = 0; pos < n && ret == TINYCLI_SUCCESS;) {
+            struct dirent64 *dent = (struct dirent64 *)(buf + pos);
+            ret = ls_add(listing, dent->d_name);
+            pos += dent->d_reclen;
+        }
+        if (ret == TINYCLI_SUCCESS && listing->sort == LS_SORT_NONE) {
+            ret = ls_flush(listing, pool);
+        }
+        if (ret == TINYCLI_SUCCESS && tinycli_cancelled(listing->ctx)) {
+            ret = TINYCLI_ERROR_CANCELLED;
+        }
+    }
+    if (n < 0 && ret == TINYCLI_SUCCESS) {
+        listing->error = errno;
+        ret = TINYCLI_ERROR_GENERAL;
+    }
+    tinycli_free(buf);
+#else
+    struct dirent *dent;
+    DIR *dir;
+
+    (void)buf;
+    dir = fdopendir(dup(listing->dirfd));
+    if (!dir) {
+        listing->error = errno;
+        return TINYCLI_ERROR_GENERAL;
+    }
+    while (ret == TINYCLI_SUCCESS && (dent = readdir(dir)) != NULL) {
+        ret = ls_add(listing, dent->d_name);
+    }
+    closedir(dir);
+    if (ret == TINYCLI_SUCCESS && listing->sort == LS_SORT_NONE) {
+        ret = ls_flush(listing, pool);
+    }
+#endif
+
+    /* Sorted listings need every entry, with metadata for size and time order */
+    if (ret == TINYCLI_SUCCESS && listing->sort != LS_SORT_NONE &&
+        (listing->lng || listing->sort != LS_SORT_NAME)) {
+        ls_stat_all(listing, pool);
+    }
+
+    return ret;
+}
+
+/* Names of the entries being sorted (qsort has no user data) */
+static __thread const char *t_ls_names;
+static __thread const ls_entry_t *t_ls_entries;
+
+/* Compare sort keys; equal name prefixes fall back to the full names */
+static int ls_compare(const void *a, const void *b)
+{
+    const ls_key_t *ka = (const ls_key_t *)a, *kb = (const ls_key_t *)b;
+
+    if (ka->key != kb->key) {
+        return ka->key < kb->key ? -1 : 1;
+    }
+
+    return strcmp(t_ls_names + t_ls_entries[ka->index].name, t_ls_names + t_ls_entries[kb->index].name);
+}
+
+/* Sort the entries on a compact key array and emit them */
+static int ls_emit_sorted(ls_listing_t *listing)
+{
+    const ls_entry_t *entry;
+    const unsigned char *name;
+    ls_key_t *keys;
+    size_t i, j;
+    int ret = TINYCLI_SUCCESS;
+
+    keys = (ls_key_t *)tinycli_malloc(TINYCLI_MEM_PLUGINS, (listing->count + 1) * sizeof(*keys));
+    if (!keys) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    /* Most comparisons are decided by the key alone, without touching the entries */
+    for (i = 0; i < listing->count; i++) {
+        entry = &listing->entries[i];
+        keys[i].index = (uint32_t)i;
+        switch (listing->sort) {
+        case LS_SORT_SIZE:
+            keys[i].key = ~entry->size;
+            break;
+        case LS_SORT_TIME:
+            keys[i].key = ~((uint64_t)entry->mtime ^ (1ull << 63));
+            break;
+        default:
+            name = (const unsigned char *)listing->names + entry->name;
+            keys[i].key = 0;
+            for (j = 0; j < 8 && name[j] != '\0'; j++) {
+                keys[i].key |= (uint64_t)name[j] << (56 - 8 * j);
+            }
+            break;
+        }
+    }
+
+    t_ls_names = listing->names;
+    t_ls_entries = listing->entries;
+    qsort(keys, listing->count, sizeof(*keys), ls_compare);
+
+    for (i = 0; i < listing->count && ret == TINYCLI_SUCCESS; i++) {
+        j = listing->reverse ? listing->count - 1 - i : i;
+        ret = ls_emit(listing, &listing->entries[keys[j].index]);
+        if (ret == TINYCLI_SUCCESS && (i & 4095) == 4095 && tinycli_cancelled(listing->ctx)) {
+            ret = TINYCLI_ERROR_CANCELLED;
+        }
+    }
+
+    tinycli_free(keys);
+    return ret;
+}
+
 /**
  * @brief Handler for ls command
  * @param argc Number of arguments
@@ -24,9 +596,78 @@
  */
 static int system_ls_handler(int argc, char **argv, tinycli_context_t *ctx)
 {
-    // TODO: Implement ls command
-    tinycli_printf(ctx, "Command 'ls' not implemented yet\n");
-    return TINYCLI_SUCCESS;
+    ls_listing_t listing;
+    ls_pool_t *pool = NULL;
+    const char *path = ".";
+    bool have_path = false;
+    int i, ret;
+
+    memset(&listing, 0, sizeof(listing));
+    listing.ctx = ctx;
+
+    /* Parse options */
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-l") == 0) {
+            listing.lng = true;
+        } else if (strcmp(argv[i], "-a") == 0) {
+            listing.all = true;
+        } else if (strcmp(argv[i], "-r") == 0) {
+            listing.reverse = true;
+        } else if (strcmp(argv[i], "--sort") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "name") == 0) {
+                listing.sort = LS_SORT_NAME;
+            } else if (strcmp(argv[i], "size") == 0) {
+                listing.sort = LS_SORT_SIZE;
+            } else if (strcmp(argv[i], "time") == 0) {
+                listing.sort = LS_SORT_TIME;
+            } else {
+                break;
+            }
+        } else if (argv[i][0] != '-' && argv[i][0] != '\0' && !have_path) {
+            path = argv[i];
+            have_path = true;
+        } else {
+            break;
+        }
+    }
+    if (i < argc || (listing.reverse && listing.sort == LS_SORT_NONE)) {
+        tinycli_printf(ctx, "Usage: ls [-l] [-a] [--sort name|size|time [-r]] [<directory>]\n");
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    listing.dirfd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (listing.dirfd < 0) {
+        tinycli_printf(ctx, "ls: %s: %s\n", path, strerror(errno));
+        return errno == ENOENT ? TINYCLI_ERROR_NOT_FOUND : TINYCLI_ERROR_GENERAL;
+    }
+
+    /* Metadata is only needed for long listings and size or time order */
+    if (listing.lng || listing.sort == LS_SORT_SIZE || listing.sort == LS_SORT_TIME) {
+        pool = ls_pool_get();
+    }
+
+    ret = ls_begin(&listing);
+    if (ret == TINYCLI_SUCCESS) {
+        ret = ls_read(&listing, pool);
+    }
+    if (ret == TINYCLI_SUCCESS && listing.sort != LS_SORT_NONE) {
+        ret = ls_emit_sorted(&listing);
+    }
+    if (ret == TINYCLI_SUCCESS) {
+        ret = tinycli_table_end(ctx);
+    } else {
+        tinycli_table_end(ctx);
+        if (listing.error) {
+            tinycli_printf(ctx, "ls: %s: %s\n", path, strerror(listing.error));
+        }
+    }
+
+    close(listing.dirfd);
+    tinycli_free(listing.entries);
+    tinycli_free(listing.names);
+
+    return ret;
 }
 
 /**
@@ -57,6 +698,306 @@ static int system_pwd_handler(int argc, char **argv, tinycli_context_t *ctx)
     return TINYCLI_SUCCESS;
 }
 
+/* Parse a byte count with an optional k, m or g suffix */
+static int cat_parse_size(const char *text, bool allow_negative, long long *value)
+{
+    char *end;
+    long long n;
+
+    errno = 0;
+    n = strtoll(text, &end, 10);
+    if (end == text || errno != 0 || (n < 0 && !allow_negative)) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    switch (*end) {
+    case 'g': case 'G': n *= 1024;  /* fall through */
+    case 'm': case 'M': n *= 1024;  /* fall through */
+    case 'k': case 'K': n *= 1024; end++; break;
+    default: break;
+    }
+    if (*end != '\0') {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    *value = n;
+    return TINYCLI_SUCCESS;
+}
+
+/* Write a whole buffer to a descriptor (errno of a failure goes to *error) */
+static int cat_write_fd(tinycli_context_t *ctx, int fd, const char *data, size_t len, int *error)
+{
+    struct pollfd pfd;
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(fd, data, len);
+        if (n > 0) {
+            data += n;
+            len -= (size_t)n;
+        } else if (n < 0 && errno == EAGAIN) {
+            pfd.fd = fd;
+            pfd.events = POLLOUT;
+            poll(&pfd, 1, CAT_FOLLOW_MS);
+        } else if (n < 0 && errno != EINTR) {
+            *error = errno;
+            return TINYCLI_ERROR_GENERAL;
+        }
+        if (tinycli_cancelled(ctx)) {
+            return TINYCLI_ERROR_CANCELLED;
+        }
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Wait until a stream has data, polling so a cancellation isn't missed */
+static int cat_wait_readable(tinycli_context_t *ctx, int fd)
+{
+    struct pollfd pfd;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    while (poll(&pfd, 1, CAT_FOLLOW_MS) <= 0) {
+        if (tinycli_cancelled(ctx)) {
+            return TINYCLI_ERROR_CANCELLED;
+        }
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Copy bytes through a buffer, for files that can't be mapped or sent */
+static int cat_read(tinycli_context_t *ctx, int fd, int out_fd, off_t *offset, off_t end,
+                    int *error)
+{
+    char buf[CAT_WRITE_CHUNK];
+    size_t want;
+    ssize_t n;
+    int ret;
+
+    while (end < 0 || *offset < end) {
+        want = sizeof(buf);
+        if (end >= 0 && (off_t)want > end - *offset) {
+            want = (size_t)(end - *offset);
+        }
+        n = pread(fd, buf, want, *offset);
+        if (n < 0 && errno == EINTR && !tinycli_cancelled(ctx)) {
+            continue;
+        }
+        if (n < 0 && errno == ESPIPE) {
+            /* Pipes and character devices can only be read in order, until EOF */
+            ret = cat_wait_readable(ctx, fd);
+            if (ret != TINYCLI_SUCCESS) {
+                return ret;
+            }
+            n = read(fd, buf, want);
+            if (n < 0 && (errno == EINTR || errno == EAGAIN) && !tinycli_cancelled(ctx)) {
+                continue;
+            }
+        }
+        if (n < 0) {
+            if (tinycli_cancelled(ctx)) {
+                return TINYCLI_ERROR_CANCELLED;
+            }
+            *error = errno;
+            return TINYCLI_ERROR_GENERAL;
+        }
+        if (n == 0) {
+            break;
+        }
+
+        ret = out_fd >= 0 ? cat_write_fd(ctx, out_fd, buf, (size_t)n, error) :
+                            tinycli_output_write(ctx, buf, (size_t)n);
+        if (ret != TINYCLI_SUCCESS) {
+            return ret;
+        }
+        *offset += n;
+        if (tinycli_cancelled(ctx)) {
+            return TINYCLI_ERROR_CANCELLED;
+        }
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Map a file a window at a time and write it to the context output */
+static int cat_map(tinycli_context_t *ctx, int fd, off_t *offset, off_t end, int *error)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    off_t base, pos;
+    size_t span, chunk;
+    char *map;
+    int ret = TINYCLI_SUCCESS;
+
+    while (*offset < end && ret == TINYCLI_SUCCESS) {
+        /* Windows start on a page boundary */
+        base = *offset - *offset % page;
+        span = (size_t)(end - base < CAT_MAP_WINDOW ? end - base : CAT_MAP_WINDOW);
+        map = (char *)mmap(NULL, span, PROT_READ, MAP_PRIVATE, fd, base);
+        if (map == MAP_FAILED) {
+            return cat_read(ctx, fd, -1, offset, end, error);
+        }
+        madvise(map, span, MADV_SEQUENTIAL);
+
+        for (pos = *offset - base; pos < (off_t)span && ret == TINYCLI_SUCCESS; pos += chunk) {
+            chunk = span - (size_t)pos < CAT_WRITE_CHUNK ? span - (size_t)pos : CAT_WRITE_CHUNK;
+            ret = tinycli_output_write(ctx, map + pos, chunk);
+            if (ret == TINYCLI_SUCCESS && tinycli_cancelled(ctx)) {
+                ret = TINYCLI_ERROR_CANCELLED;
+            }
+            if (ret == TINYCLI_SUCCESS) {
+                *offset = base + pos + (off_t)chunk;
+            }
+        }
+        munmap(map, span);
+    }
+
+    return ret;
+}
+
+/* Copy bytes between descriptors in the kernel */
+static int cat_send(tinycli_context_t *ctx, int fd, int out_fd, off_t *offset, off_t end,
+                    int *error)
+{
+#ifdef __linux__
+    struct pollfd pfd;
+    size_t want;
+    ssize_t n;
+    loff_t in_off;
+
+    while (*offset < end) {
+        want = end - *offset < CAT_SEND_CHUNK ? (size_t)(end - *offset) : CAT_SEND_CHUNK;
+        n = sendfile(out_fd, fd, offset, want);
+        if (n < 0 && errno == EINVAL) {
+            /* Older kernels only send to sockets; pipes take splice */
+            in_off = *offset;
+            n = splice(fd, &in_off, out_fd, NULL, want, SPLICE_F_MORE);
+            if (n > 0) {
+                *offset = in_off;
+            }
+        }
+        if (n < 0 && errno == EAGAIN) {
+            pfd.fd = out_fd;
+            pfd.events = POLLOUT;
+            poll(&pfd, 1, CAT_FOLLOW_MS);
+        } else if (n < 0 && errno == EINVAL) {
+            /* Neither works for this pair: copy through a buffer */
+            return cat_read(ctx, fd, out_fd, offset, end, error);
+        } else if (n < 0 && errno != EINTR) {
+            *error = errno;
+            return TINYCLI_ERROR_GENERAL;
+        } else if (n == 0) {
+            break;
+        }
+        if (tinycli_cancelled(ctx)) {
+            return TINYCLI_ERROR_CANCELLED;
+        }
+    }
+
+    return TINYCLI_SUCCESS;
+#else
+    return cat_read(ctx, fd, out_fd, offset, end, error);
+#endif
+}
+
+/* Copy a byte range of a regular file to the output (errno of a failure goes to *error) */
+static int cat_range(tinycli_context_t *ctx, int fd, off_t *offset, off_t end, int *error)
+{
+    int out_fd;
+
+    if (*offset >= end) {
+        return TINYCLI_SUCCESS;
+    }
+
+    /* Straight to the terminal, file or pipe when there is one */
+    out_fd = tinycli_output_fd(ctx);
+    if (out_fd >= 0) {
+        return cat_send(ctx, fd, out_fd, offset, end, error);
+    }
+
+    return cat_map(ctx, fd, offset, end, error);
+}
+
+/* Copy a file, or the requested part of it, to the output */
+static int cat_file(tinycli_context_t *ctx, const char *path, const cat_options_t *options)
+{
+    struct stat st;
+    off_t offset, end;
+    int fd, ret, error = 0;
+
+    /* Non-blocking, so a FIFO without a writer is waited for in poll(), cancellably */
+    fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        error = errno;
+        tinycli_printf(ctx, "cat: %s: %s\n", path, strerror(error));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return error == ENOENT ? TINYCLI_ERROR_NOT_FOUND : TINYCLI_ERROR_GENERAL;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        tinycli_printf(ctx, "cat: %s: %s\n", path, strerror(EISDIR));
+        close(fd);
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    /*
+     * Pipes, devices and synthetic files (size 0) are read as a stream until
+     * EOF or cancellation. An empty regular file being followed is a log that
+     * will grow, so it goes through the follow loop below instead.
+     */
+    if (!S_ISREG(st.st_mode) || (st.st_size == 0 && !options->follow)) {
+        if (options->offset < 0) {
+            tinycli_printf(ctx, "cat: %s: a negative offset needs a regular file\n", path);
+            close(fd);
+            return TINYCLI_ERROR_INVALID_ARGUMENT;
+        }
+        offset = options->offset;
+        end = options->length >= 0 ? offset + options->length : -1;
+        ret = cat_read(ctx, fd, tinycli_output_fd(ctx), &offset, end, &error);
+    } else {
+        /* Resolve the range against the current size */
+        offset = options->offset;
+        if (offset < 0) {
+            offset = st.st_size + offset > 0 ? st.st_size + offset : 0;
+        }
+        end = st.st_size;
+        if (options->length >= 0 && offset + options->length < end) {
+            end = offset + options->length;
+        }
+
+        ret = cat_range(ctx, fd, &offset, end, &error);
+
+        /* Follow: copy whatever is appended until cancelled */
+        while (ret == TINYCLI_SUCCESS && options->follow) {
+            tinycli_output_flush(ctx);
+            poll(NULL, 0, CAT_FOLLOW_MS);
+            if (tinycli_cancelled(ctx)) {
+                ret = TINYCLI_ERROR_CANCELLED;
+                break;
+            }
+            if (fstat(fd, &st) != 0) {
+                error = errno;
+                ret = TINYCLI_ERROR_GENERAL;
+                break;
+            }
+            if (st.st_size < offset) {
+                /* Truncated: start over, like tail -f */
+                offset = 0;
+            }
+            ret = cat_range(ctx, fd, &offset, st.st_size, &error);
+        }
+    }
+
+    if (ret == TINYCLI_ERROR_GENERAL && error != 0) {
+        tinycli_printf(ctx, "cat: %s: %s\n", path, strerror(error));
+    }
+    close(fd);
+
+    return ret;
+}
+
 /**
  * @brief Handler for cat command
  * @param argc Number of arguments
@@ -66,9 +1007,38 @@ static int system_pwd_handler(int argc, char **argv, tinycli_context_t *ctx)
  */
 static int system_cat_handler(int argc, char **argv, tinycli_context_t *ctx)
 {
-    // TODO: Implement cat command
-    tinycli_printf(ctx, "Command 'cat' not implemented yet\n");
-    return TINYCLI_SUCCESS;
+    cat_options_t options = { 0, -1, false };
+    int i, ret = TINYCLI_SUCCESS;
+
+    /* Parse options */
+    for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc &&
+            cat_parse_size(argv[i + 1], true, &options.offset) == TINYCLI_SUCCESS) {
+            i++;
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc &&
+                   cat_parse_size(argv[i + 1], false, &options.length) == TINYCLI_SUCCESS) {
+            i++;
+        } else if (strcmp(argv[i], "-f") == 0) {
+            options.follow = true;
+        } else {
+            i = argc;
+            break;
+        }
+    }
+    if (i >= argc || (options.follow && (argc - i != 1 || options.length >= 0))) {
+        tinycli_printf(ctx, "Usage: cat [-o <offset>] [-n <length> | -f] <file>...\n");
+        tinycli_printf(ctx, "  A negative offset counts from the end of a regular file; sizes take a k, m or g suffix\n");
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    for (; i < argc && ret != TINYCLI_ERROR_CANCELLED; i++) {
+        int file_ret = cat_file(ctx, argv[i], &options);
+        if (file_ret != TINYCLI_SUCCESS) {
+            ret = file_ret;
+        }
+    }
+
+    return ret;
 }
 
 /**
@@ -95,7 +1065,7 @@ int tinycli_plugin_init(tinycli_context_t *ctx)
 {
     int ret;
 
-    printf("Initializing system plugin (v1.0.0)\n");
+    TINYCLI_LOG(TINYCLI_LOG_INFO, "Initializing system plugin (v1.0.0)");
 
     /* Register ls command */
     ret = tinycli_register_command(ctx, "ls", "List directory contents", system_ls_handler, NULL);
@@ -127,6 +1097,10 @@ int tinycli_plugin_init(tinycli_context_t *ctx)
         return ret;
     }
 
+    pthread_once(&g_system_once, system_once);
+    pthread_mutex_lock(&g_system_lock);
+    g_system_users++;
+    pthread_mutex_unlock(&g_system_lock);
 
     return TINYCLI_SUCCESS;
 }
@@ -137,5 +1111,12 @@ int tinycli_plugin_init(tinycli_context_t *ctx)
  */
 void tinycli_plugin_cleanup(tinycli_context_t *ctx)
 {
-    printf("Cleaning up system plugin\n");
+    TINYCLI_LOG(TINYCLI_LOG_INFO, "Cleaning up system plugin");
+
+    /* The stat threads run plugin code: stop them before the last unload */
+    pthread_mutex_lock(&g_system_lock);
+    if (--g_system_users == 0) {
+        ls_pool_stop(&g_ls_pool);
+    }
+    pthread_mutex_unlock(&g_system_lock);
 }
@@ -0,0 +1,588 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "alias.h"
+#include "alloc.h"
+#include "context.h"
+#include "command.h"
+#include "utils.h"
+
+/* Free an alias */
+static void alias_free(tinycli_alias_t *alias)
+{
+    if (!alias) {
+        return;
+    }
+
+    tinycli_free(alias->name);
+    tinycli_free(alias->text);
+    tinycli_free(alias->words);
+    if (alias->tokens) {
+        tinycli_free_args(alias->token_count, alias->tokens);
+    }
+    tinycli_free(alias);
+}
+
+/* Parse "$N" or "$@" into a slot number; returns false for literal words */
+static bool alias_slot(const char *word, int *slot)
+{
+    if (word[0] != '$') {
+        return false;
+    }
+    if (strcmp(word, "$@") == 0) {
+        *slot = TINYCLI_ALIAS_ALL_ARGS;
+        return true;
+    }
+    if (word[1] >= '1' && word[1] <= '9' && word[2] == '\0') {
+        *slot = word[1] - '0';
+        return true;
+    }
+
+    return false;
+}
+
+/* Tokenize an expansion */
+static int alias_create(tinycli_context_t *ctx, const char *name, const char *text, bool macro,
+                        tinycli_alias_t **out)
+{
+    tinycli_alias_t *alias;
+    int i, ret;
+
+    alias = (tinycli_alias_t *)tinycli_calloc(TINYCLI_MEM_ALIAS, 1, sizeof(*alias));
+    if (!alias) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    alias->macro = macro;
+    alias->hash = tinycli_hash(name, strlen(name));
+    alias->name = tinycli_mem_strdup(TINYCLI_MEM_ALIAS, name);
+    alias->text = tinycli_mem_strdup(TINYCLI_MEM_ALIAS, text);
+    if (!alias->name || !alias->text) {
+        alias_free(alias);
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    /* Split the expansion once */
+    ret = tinycli_parse_line(text, &alias->token_count, &alias->tokens);
+    if (ret != TINYCLI_SUCCESS) {
+        alias_free(alias);
+        return ret;
+    }
+    if (alias->token_count == 0) {
+        tinycli_printf(ctx, "Empty expansion for %s\n", name);
+        alias_free(alias);
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    alias->words = (tinycli_alias_word_t *)tinycli_calloc(TINYCLI_MEM_ALIAS, alias->token_count,
+                                                          sizeof(tinycli_alias_word_t));
+    if (!alias->words) {
+        alias_free(alias);
+        return TINYCLI_ERROR_MEMORY;
+    }
+    alias->word_count = alias->token_count;
+
+    for (i = 0; i < alias->token_count; i++) {
+        tinycli_alias_word_t *word = &alias->words[i];
+
+        if (macro && alias_slot(alias->tokens[i], &word->slot)) {
+            if (i == 0) {
+                tinycli_printf(ctx, "Macro %s must start with a command name\n", name);
+                alias_free(alias);
+                return TINYCLI_ERROR_INVALID_ARGUMENT;
+            }
+            if (word->slot == TINYCLI_ALIAS_ALL_ARGS) {
+                alias->all_args = true;
+            } else if (word->slot > alias->min_args) {
+                alias->min_args = word->slot;
+            }
+        } else {
+            word->literal = alias->tokens[i];
+        }
+    }
+
+    /* Link the target now if it already exists */
+    alias->target = tinycli_command_find(ctx, alias->words[0].literal);
+
+    *out = alias;
+    return TINYCLI_SUCCESS;
+}
+
+/* Insert position pos into the name index (which must have a free slot) */
+static void alias_index_insert(tinycli_alias_table_t *table, size_t pos)
+{
+    size_t mask = table->index_size - 1;
+    size_t i;
+
+    for (i = table->items[pos]->hash & mask; table->index[i]; i = (i + 1) & mask) {
+    }
+    table->index[i] = (uint32_t)(pos + 1);
+}
+
+/* Rebuild the name index with at least new_size slots */
+static int alias_index_rebuild(tinycli_alias_table_t *table, size_t new_size)
+{
+    uint32_t *index;
+    size_t pos;
+
+    index = (uint32_t *)tinycli_calloc(TINYCLI_MEM_ALIAS, new_size, sizeof(uint32_t));
+    if (!index) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    tinycli_free(table->index);
+    table->index = index;
+    table->index_size = new_size;
+
+    for (pos = 0; pos < table->count; pos++) {
+        alias_index_insert(table, pos);
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Find the position of an alias */
+static bool alias_table_lookup(const tinycli_alias_table_t *table, const char *name, size_t *pos)
+{
+    size_t i, mask;
+    uint32_t hash;
+
+    if (!table || table->index_size == 0) {
+        return false;
+    }
+
+    hash = tinycli_hash(name, strlen(name));
+    mask = table->index_size - 1;
+    for (i = hash & mask; table->index[i]; i = (i + 1) & mask) {
+        tinycli_alias_t *alias = table->items[table->index[i] - 1];
+        if (alias->hash == hash && strcmp(alias->name, name) == 0) {
+            *pos = table->index[i] - 1;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Get the alias table of a context, creating it on first use */
+static tinycli_alias_table_t *alias_table(tinycli_context_t *ctx)
+{
+    if (!ctx->aliases) {
+        ctx->aliases = (tinycli_alias_table_t *)tinycli_calloc(TINYCLI_MEM_ALIAS, 1,
+                                                               sizeof(tinycli_alias_table_t));
+    }
+
+    return ctx->aliases;
+}
+
+/* Check that a name can be used for an alias */
+static bool alias_name_valid(const char *name)
+{
+    const char *p;
+
+    if (name[0] == '\0' || strcmp(name, "alias") == 0 || strcmp(name, "macro") == 0 ||
+        strcmp(name, "unalias") == 0) {
+        return false;
+    }
+    for (p = name; *p; p++) {
+        if (isspace((unsigned char)*p) || *p == '"') {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Define without saving */
+static int alias_define(tinycli_context_t *ctx, const char *name, const char *text, bool macro)
+{
+    tinycli_alias_table_t *table;
+    tinycli_alias_t *alias;
+    size_t pos;
+    int ret;
+
+    if (!alias_name_valid(name)) {
+        tinycli_printf(ctx, "Invalid alias name: %s\n", name);
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    table = alias_table(ctx);
+    if (!table) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    ret = alias_create(ctx, name, text, macro, &alias);
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
+    }
+
+    /* Replace an existing definition in place */
+    if (alias_table_lookup(table, name, &pos)) {
+        alias_free(table->items[pos]);
+        table->items[pos] = alias;
+        return TINYCLI_SUCCESS;
+    }
+
+    /* Append */
+    if (table->count == table->capacity) {
+        size_t new_capacity = table->capacity ? table->capacity * 2 : 16;
+        tinycli_alias_t **items = (tinycli_alias_t **)tinycli_realloc(
+            TINYCLI_MEM_ALIAS, table->items, new_capacity * sizeof(tinycli_alias_t *));
+        if (!items) {
+            alias_free(alias);
+            return TINYCLI_ERROR_MEMORY;
+        }
+        table->items = items;
+        table->capacity = new_capacity;
+    }
+    table->items[table->count++] = alias;
+
+    /* Keep the index at most half full */
+    if (table->count * 2 > table->index_size) {
+        ret = alias_index_rebuild(table, table->index_size ? table->index_size * 2 : 32);
+        if (ret != TINYCLI_SUCCESS) {
+            alias_free(table->items[--table->count]);
+            return ret;
+        }
+    } else {
+        alias_index_insert(table, table->count - 1);
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+int tinycli_alias_define(tinycli_context_t *ctx, const char *name, const char *text, bool macro)
+{
+    int ret;
+
+    if (!ctx || !name || !text) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    ret = alias_define(ctx, name, text, macro);
+    if (ret == TINYCLI_SUCCESS) {
+        ret = tinycli_alias_save(ctx);
+    }
+
+    return ret;
+}
+
+int tinycli_alias_remove(tinycli_context_t *ctx, const char *name)
+{
+    tinycli_alias_table_t *table;
+    size_t pos;
+    int ret;
+
+    if (!ctx || !name) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    table = ctx->aliases;
+    if (!alias_table_lookup(table, name, &pos)) {
+        return TINYCLI_ERROR_NOT_FOUND;
+    }
+
+    /* Move the last alias into the hole and rebuild the index */
+    alias_free(table->items[pos]);
+    table->items[pos] = table->items[--table->count];
+    ret = alias_index_rebuild(table, table->index_size);
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
+    }
+
+    return tinycli_alias_save(ctx);
+}
+
+tinycli_alias_t *tinycli_alias_find(tinycli_context_t *ctx, const char *name)
+{
+    size_t pos;
+
+    if (!ctx || !name || !alias_table_lookup(ctx->aliases, name, &pos)) {
+        return NULL;
+    }
+
+    return ctx->aliases->items[pos];
+}
+
+int tinycli_alias_execute(tinycli_context_t *ctx, tinycli_alias_t *alias, int argc, char **argv)
+{
+    char *stack_argv[TINYCLI_ALIAS_STACK_ARGS];
+    char **out = stack_argv;
+    int extra = argc - 1;
+    int count, i, j, n, ret;
+
+    if (!ctx || !alias || argc < 1 || !argv) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    /* Targets are forgotten when commands are removed, so a resolved one stays valid */
+    if (!alias->target) {
+        alias->target = tinycli_command_find(ctx, alias->words[0].literal);
+        if (!alias->target) {
+            tinycli_printf(ctx, "Unknown command: %s\n", alias->words[0].literal);
+            return TINYCLI_ERROR_NOT_FOUND;
+        }
+    }
+
+    if (alias->macro && (extra < alias->min_args || (extra > alias->min_args && !alias->all_args))) {
+        tinycli_printf(ctx, "Usage: %s takes %s%d argument%s\n", alias->name,
+                       alias->all_args ? "at least " : "", alias->min_args,
+                       alias->min_args == 1 ? "" : "s");
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    /* Size the spliced vector */
+    count = alias->macro ? 0 : extra;
+    for (i = 0; i < alias->word_count; i++) {
+        count += alias->words[i].slot == TINYCLI_ALIAS_ALL_ARGS ? extra : 1;
+    }
+    if (count + 1 > TINYCLI_ALIAS_STACK_ARGS) {
+        out = (char **)tinycli_malloc(TINYCLI_MEM_ALIAS, (size_t)(count + 1) * sizeof(char *));
+        if (!out) {
+            return TINYCLI_ERROR_MEMORY;
+        }
+    }
+
+    /* Splice */
+    n = 0;
+    for (i = 0; i < alias->word_count; i++) {
+        const tinycli_alias_word_t *word = &alias->words[i];
+
+        if (word->literal) {
+            out[n++] = word->literal;
+        } else if (word->slot == TINYCLI_ALIAS_ALL_ARGS) {
+            for (j = 1; j < argc; j++) {
+                out[n++] = argv[j];
+            }
+        } else {
+            out[n++] = argv[word->slot];
+        }
+    }
+    if (!alias->macro) {
+        for (j = 1; j < argc; j++) {
+            out[n++] = argv[j];
+        }
+    }
+    out[n] = NULL;
+
+    ret = tinycli_command_execute(ctx, alias->target, n, out);
+    if (ret != TINYCLI_SUCCESS && ret != TINYCLI_ERROR_CANCELLED && ret != TINYCLI_ERROR_TIMEOUT) {
+        tinycli_printf(ctx, "Command failed with error code %d\n", ret);
+    }
+
+    if (out != stack_argv) {
+        tinycli_free(out);
+    }
+
+    return ret;
+}
+
+int tinycli_alias_load_file(tinycli_context_t *ctx, const char *path)
+{
+    tinycli_alias_table_t *table;
+    struct stat st;
+    char *data, *line, *next;
+    size_t len;
+    unsigned int line_no = 0;
+    FILE *file;
+    int ret = TINYCLI_SUCCESS;
+
+    if (!ctx || !path) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    table = alias_table(ctx);
+    if (!table) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    /* Remember where to save */
+    tinycli_free(table->path);
+    table->path = tinycli_mem_strdup(TINYCLI_MEM_ALIAS, path);
+    if (!table->path) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    file = fopen(path, "r");
+    if (!file) {
+        return errno == ENOENT ? TINYCLI_SUCCESS : TINYCLI_ERROR_GENERAL;
+    }
+
+    /* Read the whole file at once */
+    if (fstat(fileno(file), &st) != 0) {
+        fclose(file);
+        return TINYCLI_ERROR_GENERAL;
+    }
+    data = (char *)tinycli_malloc(TINYCLI_MEM_ALIAS, (size_t)st.st_size + 1);
+    if (!data) {
+        fclose(file);
+        return TINYCLI_ERROR_MEMORY;
+    }
+    len = fread(data, 1, (size_t)st.st_size, file);
+    data[len] = '\0';
+    fclose(file);
+
+    for (line = data; line && *line && ret != TINYCLI_ERROR_MEMORY; line = next) {
+        int argc;
+        char **argv;
+
+        next = strchr(line, '\n');
+        if (next) {
+            *next++ = '\0';
+        }
+        line_no++;
+
+        while (isspace((unsigned char)*line)) {
+            line++;
+        }
+        if (*line == '\0' || *line == '#') {
+            continue;
+        }
+
+        ret = tinycli_parse_line(line, &argc, &argv);
+        if (ret != TINYCLI_SUCCESS) {
+            break;
+        }
+        if (argc == 4 && strcmp(argv[2], "=") == 0 &&
+            (strcmp(argv[0], "alias") == 0 || strcmp(argv[0], "macro") == 0)) {
+            ret = alias_define(ctx, argv[1], argv[3], argv[0][0] == 'm');
+        } else {
+            tinycli_printf(ctx, "%s:%u: Expected alias|macro <name> = \"<text>\"\n", path, line_no);
+        }
+        tinycli_free_args(argc, argv);
+    }
+    tinycli_free(data);
+
+    return ret == TINYCLI_ERROR_MEMORY ? ret : TINYCLI_SUCCESS;
+}
+
+int tinycli_alias_save(tinycli_context_t *ctx)
+{
+    tinycli_alias_table_t *table;
+    char tmp_path[4096];
+    FILE *file;
+    size_t i;
+    bool ok = true;
+
+    if (!ctx) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    table = ctx->aliases;
+    if (!table || !table->path) {
+        return TINYCLI_SUCCESS;
+    }
+
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.%ld", table->path, (long)getpid()) >=
+        (int)sizeof(tmp_path)) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    file = fopen(tmp_path, "w");
+    if (!file) {
+        tinycli_printf(ctx, "Failed to save aliases to %s\n", table->path);
+        return TINYCLI_ERROR_GENERAL;
+    }
+    for (i = 0; i < table->count && ok; i++) {
+        const tinycli_alias_t *alias = table->items[i];
+        ok = fprintf(file, "%s %s = \"%s\"\n", alias->macro ? "macro" : "alias",
+                     alias->name, alias->text) > 0;
+    }
+    ok = fclose(file) == 0 && ok;
+
+    /* Replace the file atomically */
+    if (!ok || rename(tmp_path, table->path) != 0) {
+        unlink(tmp_path);
+        tinycli_printf(ctx, "Failed to save aliases to %s\n", table->path);
+        return TINYCLI_ERROR_GENERAL;
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Compare aliases by name */
+static int alias_compare(const void *a, const void *b)
+{
+    const tinycli_alias_t *x = *(const tinycli_alias_t *const *)a;
+    const tinycli_alias_t *y = *(const tinycli_alias_t *const *)b;
+
+    return strcmp(x->name, y->name);
+}
+
+int tinycli_alias_list(tinycli_context_t *ctx, const char *name)
+{
+    tinycli_alias_table_t *table;
+    tinycli_alias_t **sorted;
+    size_t i;
+
+    if (!ctx) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    table = ctx->aliases;
+    if (name) {
+        tinycli_alias_t *alias = tinycli_alias_find(ctx, name);
+        if (!alias) {
+            tinycli_printf(ctx, "No such alias: %s\n", name);
+            return TINYCLI_ERROR_NOT_FOUND;
+        }
+        tinycli_printf(ctx, "%s %s = \"%s\"\n", alias->macro ? "macro" : "alias",
+                       alias->name, alias->text);
+        return TINYCLI_SUCCESS;
+    }
+
+    if (!table || table->count == 0) {
+        return TINYCLI_SUCCESS;
+    }
+
+    sorted = (tinycli_alias_t **)tinycli_malloc(TINYCLI_MEM_ALIAS,
+                                                table->count * sizeof(tinycli_alias_t *));
+    if (!sorted) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+    memcpy(sorted, table->items, table->count * sizeof(tinycli_alias_t *));
+    qsort(sorted, table->count, sizeof(tinycli_alias_t *), alias_compare);
+
+    for (i = 0; i < table->count; i++) {
+        tinycli_printf(ctx, "%s %s = \"%s\"\n", sorted[i]->macro ? "macro" : "alias",
+                       sorted[i]->name, sorted[i]->text);
+    }
+    tinycli_free(sorted);
+
+    return TINYCLI_SUCCESS;
+}
+
+void tinycli_alias_unresolve(tinycli_context_t *ctx)
+{
+    size_t i;
+
+    if (!ctx || !ctx->aliases) {
+        return;
+    }
+
+    for (i = 0; i < ctx->aliases->count; i++) {
+        ctx->aliases->items[i]->target = NULL;
+    }
+}
+
+void tinycli_alias_table_free(tinycli_alias_table_t *table)
+{
+    size_t i;
+
+    if (!table) {
+        return;
+    }
+
+    for (i = 0; i < table->count; i++) {
+        alias_free(table->items[i]);
+    }
+    tinycli_free(table->items);
+    tinycli_free(table->index);
+    tinycli_free(table->path);
+    tinycli_free(table);
+}
@@ -0,0 +1,307 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "alloc.h"
+
+/* Block header stored in front of every allocation */
+typedef union tinycli_mem_header {
+    struct {
+        size_t size;                /* Requested size in bytes */
+        unsigned int tag;           /* Subsystem tag */
+    } info;
+    long double align;              /* Keep the payload maximally aligned */
+    void *align_ptr;
+} tinycli_mem_header_t;
+
+/* Per-tag counters, updated atomically */
+typedef struct {
+    uint64_t live_bytes;
+    uint64_t peak_bytes;
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t alloc_bytes;
+} tinycli_mem_counters_t;
+
+/* Default allocator hooks */
+static void *default_malloc(size_t size, void *user_data)
+{
+    (void)user_data;
+    return malloc(size);
+}
+
+static void *default_realloc(void *ptr, size_t size, void *user_data)
+{
+    (void)user_data;
+    return realloc(ptr, size);
+}
+
+static void default_free(void *ptr, void *user_data)
+{
+    (void)user_data;
+    free(ptr);
+}
+
+/* Current allocator */
+static tinycli_allocator_t g_allocator = {
+    default_malloc, default_realloc, default_free, NULL
+};
+
+/* Accounting per tag */
+static tinycli_mem_counters_t g_mem_counters[TINYCLI_MEM_TAG_COUNT];
+
+/* Tag names */
+static const char *g_mem_tag_names[TINYCLI_MEM_TAG_COUNT] = {
+    "core",
+    "commands",
+    "plugins",
+    "parser",
+    "completion",
+    "output",
+    "script",
+    "alias",
+    "timer"
+};
+
+/* Record an allocation of size bytes */
+static void mem_account_alloc(unsigned int tag, size_t size)
+{
+    tinycli_mem_counters_t *c = &g_mem_counters[tag];
+    uint64_t live, peak;
+
+    __atomic_add_fetch(&c->allocs, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&c->alloc_bytes, size, __ATOMIC_RELAXED);
+    live = __atomic_add_fetch(&c->live_bytes, size, __ATOMIC_RELAXED);
+
+    /* Raise the peak if we passed it */
+    peak = __atomic_load_n(&c->peak_bytes, __ATOMIC_RELAXED);
+    while (live > peak &&
+           !__atomic_compare_exchange_n(&c->peak_bytes, &peak, live, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        /* peak was reloaded by the failed exchange */
+    }
+}
+
+/* Record a release of size bytes */
+static void mem_account_free(unsigned int tag, size_t size)
+{
+    tinycli_mem_counters_t *c = &g_mem_counters[tag];
+
+    __atomic_add_fetch(&c->frees, 1, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&c->live_bytes, size, __ATOMIC_RELAXED);
+}
+
+int tinycli_set_allocator(const tinycli_allocator_t *allocator)
+{
+    tinycli_mem_stats_t total;
+
+    if (allocator && (!allocator->malloc_fn || !allocator->realloc_fn ||
+                      !allocator->free_fn)) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    /* Blocks from the old allocator can't be released through the new one */
+    tinycli_mem_get_total(&total);
+    if (total.live_bytes > 0 || total.allocs != total.frees) {
+        return TINYCLI_ERROR_GENERAL;
+    }
+
+    if (allocator) {
+        g_allocator = *allocator;
+    } else {
+        g_allocator.malloc_fn = default_malloc;
+        g_allocator.realloc_fn = default_realloc;
+        g_allocator.free_fn = default_free;
+        g_allocator.user_data = NULL;
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+void *tinycli_malloc(tinycli_mem_tag_t tag, size_t size)
+{
+    tinycli_mem_header_t *hdr;
+
+    if ((unsigned int)tag >= TINYCLI_MEM_TAG_COUNT ||
+        size > (size_t)-1 - sizeof(tinycli_mem_header_t)) {
+        return NULL;
+    }
+
+    /* Allocate block with header */
+    hdr = (tinycli_mem_header_t *)g_allocator.malloc_fn(sizeof(tinycli_mem_header_t) + size,
+                                                       g_allocator.user_data);
+    if (!hdr) {
+        return NULL;
+    }
+
+    hdr->info.size = size;
+    hdr->info.tag = tag;
+    mem_account_alloc(tag, size);
+
+    return hdr + 1;
+}
+
+void *tinycli_calloc(tinycli_mem_tag_t tag, size_t count, size_t size)
+{
+    void *ptr;
+
+    if (size != 0 && count > (size_t)-1 / size) {
+        return NULL;
+    }
+
+    ptr = tinycli_malloc(tag, count * size);
+    if (ptr) {
+        memset(ptr, 0, count * size);
+    }
+
+    return ptr;
+}
+
+void *tinycli_realloc(tinycli_mem_tag_t tag, void *ptr, size_t size)
+{
+    tinycli_mem_header_t *hdr, *new_hdr;
+    size_t old_size;
+
+    if (!ptr) {
+        return tinycli_malloc(tag, size);
+    }
+
+    if (size > (size_t)-1 - sizeof(tinycli_mem_header_t)) {
+        return NULL;
+    }
+
+    hdr = (tinycli_mem_header_t *)ptr - 1;
+    old_size = hdr->info.size;
+
+    /* Resize block with header; the tag of the original block is kept */
+    new_hdr = (tinycli_mem_header_t *)g_allocator.realloc_fn(hdr,
+                                                            sizeof(tinycli_mem_header_t) + size,
+                                                            g_allocator.user_data);
+    if (!new_hdr) {
+        return NULL;
+    }
+
+    /* Account the resize as a release plus an allocation */
+    mem_account_free(new_hdr->info.tag, old_size);
+    new_hdr->info.size = size;
+    mem_account_alloc(new_hdr->info.tag, size);
+
+    return new_hdr + 1;
+}
+
+void tinycli_free(void *ptr)
+{
+    tinycli_mem_header_t *hdr;
+
+    if (!ptr) {
+        return;
+    }
+
+    hdr = (tinycli_mem_header_t *)ptr - 1;
+    mem_account_free(hdr->info.tag, hdr->info.size);
+    g_allocator.free_fn(hdr, g_allocator.user_data);
+}
+
+char *tinycli_mem_strdup(tinycli_mem_tag_t tag, const char *str)
+{
+    char *dup;
+    size_t len;
+
+    if (!str) {
+        return NULL;
+    }
+
+    len = strlen(str) + 1;
+    dup = (char *)tinycli_malloc(tag, len);
+    if (dup) {
+        memcpy(dup, str, len);
+    }
+
+    return dup;
+}
+
+void tinycli_mem_get_stats(tinycli_mem_tag_t tag, tinycli_mem_stats_t *stats)
+{
+    tinycli_mem_counters_t *c;
+
+    if (!stats) {
+        return;
+    }
+
+    if ((unsigned int)tag >= TINYCLI_MEM_TAG_COUNT) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+
+    c = &g_mem_counters[tag];
+    stats->live_bytes = __atomic_load_n(&c->live_bytes, __ATOMIC_RELAXED);
+    stats->peak_bytes = __atomic_load_n(&c->peak_bytes, __ATOMIC_RELAXED);
+    stats->allocs = __atomic_load_n(&c->allocs, __ATOMIC_RELAXED);
+    stats->frees = __atomic_load_n(&c->frees, __ATOMIC_RELAXED);
+    stats->alloc_bytes = __atomic_load_n(&c->alloc_bytes, __ATOMIC_RELAXED);
+}
+
+void tinycli_mem_get_total(tinycli_mem_stats_t *stats)
+{
+    tinycli_mem_stats_t tag_stats;
+    int i;
+
+    if (!stats) {
+        return;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    for (i = 0; i < TINYCLI_MEM_TAG_COUNT; i++) {
+        tinycli_mem_get_stats((tinycli_mem_tag_t)i, &tag_stats);
+        stats->live_bytes += tag_stats.live_bytes;
+        stats->peak_bytes += tag_stats.peak_bytes;
+        stats->allocs += tag_stats.allocs;
+        stats->frees += tag_stats.frees;
+        stats->alloc_bytes += tag_stats.alloc_bytes;
+    }
+}
+
+const char *tinycli_mem_tag_name(tinycli_mem_tag_t tag)
+{
+    if ((unsigned int)tag >= TINYCLI_MEM_TAG_COUNT) {
+        return "unknown";
+    }
+
+    return g_mem_tag_names[tag];
+}
+
+void tinycli_mem_show(tinycli_context_t *ctx)
+{
+    tinycli_mem_stats_t stats;
+    int i;
+
+    if (!ctx) {
+        return;
+    }
+
+    /* Print header */
+    tinycli_printf(ctx, "Memory usage by subsystem:\n");
+    tinycli_printf(ctx, "  %-10s  %12s  %12s  %10s  %10s\n",
+                  "TAG", "LIVE", "PEAK", "ALLOCS", "FREES");
+    tinycli_printf(ctx, "  ----------  ------------  ------------  ----------  ----------\n");
+
+    /* Print one line per tag */
+    for (i = 0; i < TINYCLI_MEM_TAG_COUNT; i++) {
+        tinycli_mem_get_stats((tinycli_mem_tag_t)i, &stats);
+        tinycli_printf(ctx, "  %-10s  %12llu  %12llu  %10llu  %10llu\n",
+                      tinycli_mem_tag_name((tinycli_mem_tag_t)i),
+                      (unsigned long long)stats.live_bytes,
+                      (unsigned long long)stats.peak_bytes,
+                      (unsigned long long)stats.allocs,
+                      (unsigned long long)stats.frees);
+    }
+
+    /* Print totals */
+    tinycli_mem_get_total(&stats);
+    tinycli_printf(ctx, "  %-10s  %12llu  %12s  %10llu  %10llu\n",
+                  "total",
+                  (unsigned long long)stats.live_bytes, "-",
+                  (unsigned long long)stats.allocs,
+                  (unsigned long long)stats.frees);
+}
@@ -0,0 +1,661 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "cancel.h"
+#include "context.h"
+#include "alloc.h"
+#include "utils.h"
+#include "watchdog.h"
+
+/* Cancellation callback */
+typedef struct {
+    tinycli_cancel_func_t func;     /* Callback */
+    void *user_data;                /* User data passed to the callback */
+} tinycli_cancel_callback_t;
+
+/* Invocation of a command */
+struct tinycli_invocation {
+    int refs;                       /* References (caller and worker) */
+    int cancelled;                  /* Cancellation requests so far */
+    bool abandoned;                 /* Caller stopped waiting for the command */
+    bool done;                      /* Command returned (protected by the worker lock) */
+    bool on_worker;                 /* Command runs on the worker thread */
+    bool timed_out;                 /* Cancelled by its deadline */
+    bool override;                  /* Deadline set by the caller; command defaults don't apply */
+    int wake_fd;                    /* Pipe to wake the waiting thread with (-1 if none) */
+    pthread_mutex_t lock;           /* Protects the callbacks and arming the deadline */
+    bool armed;                     /* Deadline is armed */
+    tinycli_deadline_t deadline;    /* Deadline of the command */
+    tinycli_runtime_t *runtime;     /* Runtime whose watchdog guards the deadline */
+    bool callbacks_run;             /* Callbacks have been run */
+    tinycli_cancel_callback_t callbacks[TINYCLI_CANCEL_MAX_CALLBACKS]; /* Registered callbacks */
+    int callback_count;             /* Number of callbacks */
+    tinycli_context_t *ctx;         /* Context the command runs in */
+    tinycli_invoke_func_t func;     /* Function that runs the command */
+    void *target;                   /* Command or alias */
+    int argc;                       /* Number of arguments */
+    char **argv;                    /* Arguments (owned by worker invocations) */
+    int result;                     /* Error code of the command */
+};
+
+/* Worker thread that runs commands */
+struct tinycli_worker {
+    pthread_t thread;               /* Worker thread */
+    pthread_mutex_t lock;           /* Protects the job and flags */
+    pthread_cond_t cond;            /* Signalled when a job is posted */
+    tinycli_invocation_t *job;      /* Command to run (NULL when idle) */
+    bool stop;                      /* Worker should exit */
+    bool abandoned;                 /* Worker exits after its job instead of reporting it */
+    bool finished;                  /* Abandoned job returned and the thread is exiting */
+    int done_fd;                    /* Pipe to report finished jobs on */
+    struct tinycli_worker *next;    /* Next abandoned worker of the context */
+};
+
+/* Invocation run by the calling thread (NULL outside commands) */
+static __thread tinycli_invocation_t *t_invocation = NULL;
+
+/* Get the invocation of the calling thread, or the context's */
+static tinycli_invocation_t *cancel_current(tinycli_context_t *ctx)
+{
+    if (t_invocation) {
+        return t_invocation;
+    }
+
+    return ctx ? __atomic_load_n(&ctx->invocation, __ATOMIC_ACQUIRE) : NULL;
+}
+
+/* Run the callbacks of a cancelled invocation once */
+static void cancel_run_callbacks(tinycli_invocation_t *inv)
+{
+    tinycli_cancel_callback_t callbacks[TINYCLI_CANCEL_MAX_CALLBACKS];
+    int i, count;
+
+    pthread_mutex_lock(&inv->lock);
+    if (inv->callbacks_run) {
+        pthread_mutex_unlock(&inv->lock);
+        return;
+    }
+    inv->callbacks_run = true;
+    count = inv->callback_count;
+    memcpy(callbacks, inv->callbacks, (size_t)count * sizeof(callbacks[0]));
+    pthread_mutex_unlock(&inv->lock);
+
+    for (i = 0; i < count; i++) {
+        callbacks[i].func(callbacks[i].user_data);
+    }
+}
+
+/* Request cancellation of an invocation (async-signal-safe) */
+static void cancel_request(tinycli_invocation_t *inv)
+{
+    __atomic_add_fetch(&inv->cancelled, 1, __ATOMIC_ACQ_REL);
+
+    if (inv->wake_fd >= 0) {
+        ssize_t n = write(inv->wake_fd, "c", 1);
+        (void)n;
+    }
+}
+
+/* Cancel an invocation whose deadline passed (on the watchdog thread) */
+static void invocation_expire(tinycli_deadline_t *deadline)
+{
+    tinycli_invocation_t *inv = (tinycli_invocation_t *)
+        ((char *)deadline - offsetof(tinycli_invocation_t, deadline));
+
+    __atomic_store_n(&inv->timed_out, true, __ATOMIC_RELEASE);
+    cancel_request(inv);
+}
+
+/* Set up the fields shared by both kinds of invocation */
+static void invocation_init(tinycli_invocation_t *inv, tinycli_context_t *ctx)
+{
+    pthread_mutex_init(&inv->lock, NULL);
+    inv->ctx = ctx;
+    inv->runtime = ctx->runtime;
+    inv->wake_fd = -1;
+    inv->deadline.expire = invocation_expire;
+}
+
+/* Arm or move the deadline of an invocation, unless it was abandoned */
+static void invocation_arm(tinycli_invocation_t *inv, uint64_t due_ns)
+{
+    pthread_mutex_lock(&inv->lock);
+    if (!__atomic_load_n(&inv->abandoned, __ATOMIC_ACQUIRE) &&
+        tinycli_watchdog_arm(inv->runtime, &inv->deadline, due_ns) == TINYCLI_SUCCESS) {
+        inv->armed = true;
+    }
+    pthread_mutex_unlock(&inv->lock);
+}
+
+/* Disarm the deadline of an invocation */
+static void invocation_disarm(tinycli_invocation_t *inv)
+{
+    pthread_mutex_lock(&inv->lock);
+    if (inv->armed) {
+        tinycli_watchdog_disarm(inv->runtime, &inv->deadline);
+        inv->armed = false;
+    }
+    pthread_mutex_unlock(&inv->lock);
+}
+
+/* Report a cancellation caused by the deadline as a timeout */
+static int invocation_result(tinycli_invocation_t *inv, int ret)
+{
+    if (ret == TINYCLI_ERROR_CANCELLED && __atomic_load_n(&inv->timed_out, __ATOMIC_ACQUIRE)) {
+        return TINYCLI_ERROR_TIMEOUT;
+    }
+
+    return ret;
+}
+
+/* Drop a reference to a worker invocation */
+static void invocation_release(tinycli_invocation_t *inv)
+{
+    if (__atomic_sub_fetch(&inv->refs, 1, __ATOMIC_ACQ_REL) != 0) {
+        return;
+    }
+
+    pthread_mutex_destroy(&inv->lock);
+    tinycli_free(inv);
+}
+
+/* Create a worker invocation with its own copy of the arguments */
+static tinycli_invocation_t *invocation_create(tinycli_context_t *ctx, tinycli_invoke_func_t func,
+                                               void *target, int argc, char **argv)
+{
+    tinycli_invocation_t *inv;
+    size_t size = sizeof(*inv) + (size_t)(argc + 1) * sizeof(char *);
+    char *p;
+    int i;
+
+    for (i = 0; i < argc; i++) {
+        size += strlen(argv[i]) + 1;
+    }
+
+    /* One block: the record, the argument vector, then the strings */
+    inv = (tinycli_invocation_t *)tinycli_calloc(TINYCLI_MEM_CORE, 1, size);
+    if (!inv) {
+        return NULL;
+    }
+    inv->argv = (char **)(inv + 1);
+    p = (char *)(inv->argv + argc + 1);
+    for (i = 0; i < argc; i++) {
+        size_t len = strlen(argv[i]) + 1;
+        memcpy(p, argv[i], len);
+        inv->argv[i] = p;
+        p += len;
+    }
+    inv->argv[argc] = NULL;
+
+    invocation_init(inv, ctx);
+    inv->refs = 2;
+    inv->on_worker = true;
+    inv->wake_fd = ctx->cancel_pipe[1];
+    inv->func = func;
+    inv->target = target;
+    inv->argc = argc;
+
+    return inv;
+}
+
+/* Free a worker */
+static void worker_free(tinycli_worker_t *worker)
+{
+    pthread_cond_destroy(&worker->cond);
+    pthread_mutex_destroy(&worker->lock);
+    tinycli_free(worker);
+}
+
+/* Run commands posted to a worker */
+static void *cancel_worker(void *arg)
+{
+    tinycli_worker_t *worker = (tinycli_worker_t *)arg;
+    tinycli_invocation_t *inv;
+    bool abandoned;
+
+    for (;;) {
+        pthread_mutex_lock(&worker->lock);
+        while (!worker->stop && !worker->job) {
+            pthread_cond_wait(&worker->cond, &worker->lock);
+        }
+        if (worker->stop) {
+            pthread_mutex_unlock(&worker->lock);
+            break;
+        }
+        inv = worker->job;
+        pthread_mutex_unlock(&worker->lock);
+
+        t_invocation = inv;
+        inv->result = inv->func(inv->ctx, inv->target, inv->argc, inv->argv);
+        t_invocation = NULL;
+
+        /* Report back, unless the caller has moved on; the context joins abandoned workers */
+        pthread_mutex_lock(&worker->lock);
+        worker->job = NULL;
+        inv->done = true;
+        abandoned = worker->abandoned;
+        if (!abandoned) {
+            ssize_t n = write(worker->done_fd, "d", 1);
+            (void)n;
+        }
+        worker->finished = abandoned;
+        pthread_mutex_unlock(&worker->lock);
+        invocation_release(inv);
+
+        if (abandoned) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/* Join the abandoned workers whose command returned, or all of them if wait is set */
+static void cancel_reap(tinycli_context_t *ctx, bool wait)
+{
+    tinycli_worker_t **link, *worker;
+    bool finished;
+
+    for (link = &ctx->abandoned; (worker = *link) != NULL;) {
+        pthread_mutex_lock(&worker->lock);
+        finished = worker->finished;
+        pthread_mutex_unlock(&worker->lock);
+        if (!finished && !wait) {
+            link = &worker->next;
+            continue;
+        }
+
+        pthread_join(worker->thread, NULL);
+        *link = worker->next;
+        worker_free(worker);
+    }
+}
+
+/* Get the worker of a context, starting it on first use */
+static tinycli_worker_t *cancel_worker_get(tinycli_context_t *ctx)
+{
+    tinycli_worker_t *worker;
+    sigset_t all, saved;
+    int ret;
+
+    if (ctx->worker) {
+        return ctx->worker;
+    }
+
+    /* Replacing an abandoned worker: collect the ones that are done */
+    cancel_reap(ctx, false);
+
+    if (ctx->cancel_pipe[0] < 0) {
+        if (pipe2(ctx->cancel_pipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+            ctx->cancel_pipe[0] = ctx->cancel_pipe[1] = -1;
+            return NULL;
+        }
+    }
+
+    worker = (tinycli_worker_t *)tinycli_calloc(TINYCLI_MEM_CORE, 1, sizeof(*worker));
+    if (!worker) {
+        return NULL;
+    }
+    pthread_mutex_init(&worker->lock, NULL);
+    pthread_cond_init(&worker->cond, NULL);
+    worker->done_fd = ctx->cancel_pipe[1];
+
+    /* Signals go to the thread that waits, never to the worker */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &saved);
+    ret = pthread_create(&worker->thread, NULL, cancel_worker, worker);
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+    if (ret != 0) {
+        worker_free(worker);
+        return NULL;
+    }
+
+    ctx->worker = worker;
+    return worker;
+}
+
+/* Empty the cancellation pipe */
+static void cancel_drain(tinycli_context_t *ctx)
+{
+    char buf[64];
+
+    while (read(ctx->cancel_pipe[0], buf, sizeof(buf)) > 0) {
+    }
+}
+
+/* Run a command on the worker and wait for it, or for its cancellation */
+static int cancel_run_on_worker(tinycli_context_t *ctx, tinycli_worker_t *worker,
+                                tinycli_invocation_t *inv)
+{
+    struct pollfd pfd;
+    uint64_t deadline_ns = 0, now_ns;
+    int timeout_ms, cancelled;
+    bool done;
+
+    cancel_drain(ctx);
+
+    pthread_mutex_lock(&worker->lock);
+    worker->job = inv;
+    pthread_cond_signal(&worker->cond);
+    pthread_mutex_unlock(&worker->lock);
+
+    for (;;) {
+        /* Wait for the command, a cancellation or the end of the grace period */
+        timeout_ms = -1;
+        if (deadline_ns) {
+            now_ns = tinycli_time_ns();
+            timeout_ms = now_ns >= deadline_ns ? 0 : (int)((deadline_ns - now_ns + 999999) / 1000000);
+        }
+        pfd.fd = ctx->cancel_pipe[0];
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, timeout_ms) < 0 && errno != EINTR) {
+            timeout_ms = 10;
+        }
+        cancel_drain(ctx);
+
+        /* The command may be waiting for a pool worker only this thread can fork */
+        tinycli_pool_service(ctx);
+
+        pthread_mutex_lock(&worker->lock);
+        done = inv->done;
+        pthread_mutex_unlock(&worker->lock);
+        if (done) {
+            return inv->result;
+        }
+
+        cancelled = __atomic_load_n(&inv->cancelled, __ATOMIC_ACQUIRE);
+        if (cancelled == 0) {
+            continue;
+        }
+
+        /* First notice: unblock the command and start the grace period */
+        if (!deadline_ns) {
+            cancel_run_callbacks(inv);
+            deadline_ns = tinycli_time_ns() + (uint64_t)ctx->cancel_grace_ms * 1000000ull;
+        }
+
+        if (cancelled > 1 || tinycli_time_ns() >= deadline_ns) {
+            break;
+        }
+    }
+
+    /* Give up on the command: the worker cleans up after itself */
+    pthread_mutex_lock(&worker->lock);
+    if (inv->done) {
+        pthread_mutex_unlock(&worker->lock);
+        return inv->result;
+    }
+    worker->abandoned = true;
+    __atomic_store_n(&inv->abandoned, true, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&worker->lock);
+
+    /* Kept until it returns: it still uses the context and the plugins */
+    worker->next = ctx->abandoned;
+    ctx->abandoned = worker;
+    ctx->worker = NULL;
+
+    return TINYCLI_ERROR_CANCELLED;
+}
+
+/* Run a command within another, with a deadline of its own if it needs one */
+static int invoke_nested(tinycli_invocation_t *inv, unsigned int timeout_ms, bool force,
+                         tinycli_invoke_func_t func, void *target, int argc, char **argv)
+{
+    tinycli_context_t *ctx = inv->ctx;
+    uint64_t saved_ns = inv->deadline.due_ns, due_ns;
+    bool armed = inv->armed, saved_override = inv->override;
+    int ret;
+
+    /* An abandoned command must not run anything more against the context */
+    if (__atomic_load_n(&inv->abandoned, __ATOMIC_ACQUIRE)) {
+        return TINYCLI_ERROR_CANCELLED;
+    }
+
+    /* No deadline, or the caller's deadline wins over the command's default */
+    if (timeout_ms == 0 || (inv->override && !force)) {
+        return invocation_result(inv, func(ctx, target, argc, argv));
+    }
+
+    /* A default can only bring the deadline forward */
+    due_ns = tinycli_time_ns() + (uint64_t)timeout_ms * 1000000ull;
+    if (!force && armed && saved_ns <= due_ns) {
+        return invocation_result(inv, func(ctx, target, argc, argv));
+    }
+
+    invocation_arm(inv, due_ns);
+    inv->override = inv->override || force;
+    ret = func(ctx, target, argc, argv);
+    inv->override = saved_override;
+
+    /* Put the outer deadline back, unless it no longer matters */
+    if (armed && !__atomic_load_n(&inv->timed_out, __ATOMIC_ACQUIRE)) {
+        invocation_arm(inv, saved_ns);
+    } else {
+        invocation_disarm(inv);
+    }
+
+    return invocation_result(inv, ret);
+}
+
+/* Run a top-level command, or a nested one under the outer token */
+static int invoke(tinycli_context_t *ctx, unsigned int timeout_ms, bool force,
+                  tinycli_invoke_func_t func, void *target, int argc, char **argv)
+{
+    tinycli_invocation_t local, *inv;
+    tinycli_worker_t *worker;
+    int ret;
+
+    if (!ctx || !func) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    /* Nested commands share the token of the outer one */
+    inv = t_invocation ? t_invocation : ctx->invocation;
+    if (inv) {
+        return invoke_nested(inv, timeout_ms, force, func, target, argc, argv);
+    }
+
+    worker = ctx->cancel_grace_ms >= 0 ? cancel_worker_get(ctx) : NULL;
+    if (!worker) {
+        /* Run on this thread */
+        memset(&local, 0, sizeof(local));
+        invocation_init(&local, ctx);
+        t_invocation = &local;
+        __atomic_store_n(&ctx->invocation, &local, __ATOMIC_RELEASE);
+        if (timeout_ms) {
+            invocation_arm(&local, tinycli_time_ns() + (uint64_t)timeout_ms * 1000000ull);
+        }
+
+        ret = func(ctx, target, argc, argv);
+
+        invocation_disarm(&local);
+        __atomic_store_n(&ctx->invocation, NULL, __ATOMIC_RELEASE);
+        t_invocation = NULL;
+        ret = invocation_result(&local, ret);
+        pthread_mutex_destroy(&local.lock);
+        tinycli_pool_service(ctx);
+        return ret;
+    }
+
+    inv = invocation_create(ctx, func, target, argc, argv);
+    if (!inv) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+    __atomic_store_n(&ctx->invocation, inv, __ATOMIC_RELEASE);
+    if (timeout_ms) {
+        invocation_arm(inv, tinycli_time_ns() + (uint64_t)timeout_ms * 1000000ull);
+    }
+
+    ret = cancel_run_on_worker(ctx, worker, inv);
+
+    invocation_disarm(inv);
+    __atomic_store_n(&ctx->invocation, NULL, __ATOMIC_RELEASE);
+    ret = invocation_result(inv, ret);
+    invocation_release(inv);
+
+    /* Replace pool workers the command made stale before the next one needs them */
+    tinycli_pool_service(ctx);
+
+    return ret;
+}
+
+int tinycli_invoke(tinycli_context_t *ctx, unsigned int timeout_ms, tinycli_invoke_func_t func,
+                   void *target, int argc, char **argv)
+{
+    return invoke(ctx, timeout_ms, false, func, target, argc, argv);
+}
+
+int tinycli_invoke_deadline(tinycli_context_t *ctx, unsigned int timeout_ms,
+                            tinycli_invoke_func_t func, void *target, int argc, char **argv)
+{
+    return invoke(ctx, timeout_ms, true, func, target, argc, argv);
+}
+
+bool tinycli_invocation_abandoned(void)
+{
+    return t_invocation && __atomic_load_n(&t_invocation->abandoned, __ATOMIC_ACQUIRE);
+}
+
+void tinycli_cancel_destroy(tinycli_context_t *ctx)
+{
+    tinycli_worker_t *worker;
+
+    if (!ctx) {
+        return;
+    }
+
+    worker = ctx->worker;
+    if (worker) {
+        pthread_mutex_lock(&worker->lock);
+        worker->stop = true;
+        pthread_cond_signal(&worker->cond);
+        pthread_mutex_unlock(&worker->lock);
+        pthread_join(worker->thread, NULL);
+        worker_free(worker);
+        ctx->worker = NULL;
+    }
+
+    /* Abandoned commands were cancelled; wait for them to return */
+    cancel_reap(ctx, true);
+
+    if (ctx->cancel_pipe[0] >= 0) {
+        close(ctx->cancel_pipe[0]);
+        close(ctx->cancel_pipe[1]);
+        ctx->cancel_pipe[0] = ctx->cancel_pipe[1] = -1;
+    }
+}
+
+void tinycli_cancel_after_fork(tinycli_context_t *ctx)
+{
+    if (!ctx) {
+        return;
+    }
+
+    /* The worker thread and the invocations belong to the parent */
+    t_invocation = NULL;
+    ctx->invocation = NULL;
+    ctx->worker = NULL;
+    ctx->abandoned = NULL;
+    ctx->cancel_grace_ms = -1;
+
+    /* So does the watchdog: nested deadlines in the child need one of their own */
+    tinycli_watchdog_after_fork(ctx->runtime);
+
+    if (ctx->cancel_pipe[0] >= 0) {
+        close(ctx->cancel_pipe[0]);
+        close(ctx->cancel_pipe[1]);
+        ctx->cancel_pipe[0] = ctx->cancel_pipe[1] = -1;
+    }
+}
+
+int tinycli_cancel(tinycli_context_t *ctx)
+{
+    tinycli_invocation_t *inv;
+
+    if (!ctx) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    /* Only atomics and write(2): this runs in signal handlers */
+    inv = __atomic_load_n(&ctx->invocation, __ATOMIC_ACQUIRE);
+    if (!inv) {
+        return TINYCLI_ERROR_NOT_FOUND;
+    }
+    cancel_request(inv);
+
+    return TINYCLI_SUCCESS;
+}
+
+bool tinycli_cancelled(tinycli_context_t *ctx)
+{
+    tinycli_invocation_t *inv = cancel_current(ctx);
+
+    if (!inv || __atomic_load_n(&inv->cancelled, __ATOMIC_ACQUIRE) == 0) {
+        return false;
+    }
+
+    /* A worker's callbacks are run by the thread waiting for it */
+    if (!inv->on_worker) {
+        cancel_run_callbacks(inv);
+    }
+
+    return true;
+}
+
+int tinycli_on_cancel(tinycli_context_t *ctx, tinycli_cancel_func_t func, void *user_data)
+{
+    tinycli_invocation_t *inv;
+
+    if (!func) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    inv = cancel_current(ctx);
+    if (!inv) {
+        return TINYCLI_ERROR_NOT_FOUND;
+    }
+
+    pthread_mutex_lock(&inv->lock);
+    if (inv->callbacks_run) {
+        /* Too late to wait for the cancellation */
+        pthread_mutex_unlock(&inv->lock);
+        func(user_data);
+        return TINYCLI_SUCCESS;
+    }
+    if (inv->callback_count == TINYCLI_CANCEL_MAX_CALLBACKS) {
+        pthread_mutex_unlock(&inv->lock);
+        return TINYCLI_ERROR_MEMORY;
+    }
+    inv->callbacks[inv->callback_count].func = func;
+    inv->callbacks[inv->callback_count].user_data = user_data;
+    inv->callback_count++;
+    pthread_mutex_unlock(&inv->lock);
+
+    return TINYCLI_SUCCESS;
+}
+
+int tinycli_set_cancel_grace(tinycli_context_t *ctx, int grace_ms)
+{
+    if (!ctx || grace_ms < -1) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    ctx->cancel_grace_ms = grace_ms;
+
+    /* Back to the calling thread: the worker is no longer needed */
+    if (grace_ms < 0 && !ctx->invocation) {
+        tinycli_cancel_destroy(ctx);
+    }
+
+    return TINYCLI_SUCCESS;
+}
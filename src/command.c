@@ -1,86 +1,262 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fnmatch.h>
 #include <readline/readline.h>
 
+#include "alloc.h"
 #include "command.h"
 #include "context.h"
 #include "utils.h"
+#include "cancel.h"
+#include "metrics.h"
 
-tinycli_command_t *tinycli_command_create(const char *name, const char *help,
-                                         tinycli_cmd_handler_t handler,
-                                         tinycli_completion_func_t completion)
+/* Initial name index capacity */
+#define COMMAND_INDEX_INITIAL 16
+
+/* Bring the sorted index up to date with the registry */
+static int command_sorted_refresh(tinycli_command_table_t *table);
+
+/* Find the first sorted position whose name is not less than prefix */
+static size_t command_sorted_lower_bound(const tinycli_command_table_t *table,
+                                         const char *prefix, size_t len);
+
+void tinycli_command_table_init(tinycli_command_table_t *table)
+{
+    if (!table) {
+        return;
+    }
+
+    memset(table, 0, sizeof(*table));
+    tinycli_strpool_init(&table->strings, TINYCLI_MEM_COMMANDS);
+}
+
+void tinycli_command_table_destroy(tinycli_command_table_t *table)
+{
+    size_t i;
+
+    if (!table) {
+        return;
+    }
+
+    /* Free chunks */
+    for (i = 0; i < TINYCLI_COMMAND_CHUNKS; i++) {
+        tinycli_free(table->chunks[i]);
+        tinycli_free(table->info_chunks[i]);
+    }
+
+    /* Free indexes and strings */
+    tinycli_free(table->index);
+    tinycli_free(table->sorted);
+    tinycli_strpool_destroy(&table->strings);
+
+    memset(table, 0, sizeof(*table));
+}
+
+/* Insert position pos into the name index (which must have a free slot) */
+static void command_index_insert(tinycli_command_table_t *table, size_t pos)
+{
+    size_t mask = table->index_size - 1;
+    size_t i;
+
+    for (i = tinycli_command_table_at(table, pos)->hash & mask; table->index[i];
+         i = (i + 1) & mask) {
+    }
+    table->index[i] = (uint32_t)(pos + 1);
+}
+
+/* Grow the name index to new_size slots */
+static int command_index_grow(tinycli_command_table_t *table, size_t new_size)
+{
+    uint32_t *index;
+    size_t pos;
+
+    index = (uint32_t *)tinycli_calloc(TINYCLI_MEM_COMMANDS, new_size, sizeof(uint32_t));
+    if (!index) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    tinycli_free(table->index);
+    table->index = index;
+    table->index_size = new_size;
+
+    /* Reinsert all commands */
+    for (pos = 0; pos < table->count; pos++) {
+        command_index_insert(table, pos);
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Get the cold record stored at a position */
+static tinycli_command_info_t *command_table_info_at(tinycli_command_table_t *table, size_t pos)
+{
+    size_t n = pos + ((size_t)1 << TINYCLI_COMMAND_CHUNK_SHIFT);
+    unsigned int bit = 63 - __builtin_clzll((unsigned long long)n);
+
+    return &table->info_chunks[bit - TINYCLI_COMMAND_CHUNK_SHIFT][n - ((size_t)1 << bit)];
+}
+
+/* Make room for one more command record */
+static int command_table_reserve(tinycli_command_table_t *table)
+{
+    size_t n = table->count + ((size_t)1 << TINYCLI_COMMAND_CHUNK_SHIFT);
+    unsigned int bit = 63 - __builtin_clzll((unsigned long long)n);
+    size_t chunk = bit - TINYCLI_COMMAND_CHUNK_SHIFT;
+    size_t size = (size_t)1 << bit;
+
+    if (table->count >= UINT32_MAX - 1 || chunk >= TINYCLI_COMMAND_CHUNKS) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    /* Keep the index load factor at or below one half */
+    if ((table->count + 1) * 2 > table->index_size) {
+        size_t new_size = table->index_size ? table->index_size * 2 : COMMAND_INDEX_INITIAL;
+        if (command_index_grow(table, new_size) != TINYCLI_SUCCESS) {
+            return TINYCLI_ERROR_MEMORY;
+        }
+    }
+
+    /* Current chunk still has room */
+    if (table->chunks[chunk]) {
+        return TINYCLI_SUCCESS;
+    }
+
+    /* Allocate the next chunk pair */
+    table->chunks[chunk] = (tinycli_command_t *)tinycli_malloc(TINYCLI_MEM_COMMANDS,
+                                                               size * sizeof(tinycli_command_t));
+    if (!table->chunks[chunk]) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    table->info_chunks[chunk] = (tinycli_command_info_t *)tinycli_malloc(TINYCLI_MEM_COMMANDS,
+                                                                         size * sizeof(tinycli_command_info_t));
+    if (!table->info_chunks[chunk]) {
+        tinycli_free(table->chunks[chunk]);
+        table->chunks[chunk] = NULL;
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+int tinycli_command_table_add(tinycli_command_table_t *table, const char *name,
+                              const char *help, tinycli_cmd_handler_t handler,
+                              tinycli_completion_func_t completion,
+                              tinycli_command_t **out)
 {
     tinycli_command_t *cmd;
+    tinycli_command_info_t *info;
+    size_t name_len, pos;
+    uint32_t hash;
 
-    if (!name || !handler) {
-        return NULL;
+    if (!table || !name || !handler) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
     }
 
-    /* Allocate command */
-    cmd = (tinycli_command_t *)malloc(sizeof(tinycli_command_t));
-    if (!cmd) {
-        return NULL;
+    /* Check if command already exists */
+    name_len = strlen(name);
+    if (tinycli_command_table_find(table, name, name_len)) {
+        return TINYCLI_ERROR_COMMAND_EXISTS;
     }
 
-    /* Initialize command */
-    memset(cmd, 0, sizeof(tinycli_command_t));
+    if (command_table_reserve(table) != TINYCLI_SUCCESS) {
+        return TINYCLI_ERROR_MEMORY;
+    }
 
-    /* Set name */
-    cmd->name = tinycli_strdup(name);
+    pos = table->count;
+    cmd = tinycli_command_table_at(table, pos);
+    info = command_table_info_at(table, pos);
+    memset(info, 0, sizeof(*info));
+
+    /* Intern name and help */
+    hash = tinycli_hash(name, name_len);
+    cmd->name = tinycli_strpool_intern(&table->strings, name, name_len, hash);
     if (!cmd->name) {
-        free(cmd);
-        return NULL;
+        return TINYCLI_ERROR_MEMORY;
     }
 
-    /* Set help (if provided) */
     if (help) {
-        cmd->help = tinycli_strdup(help);
-        if (!cmd->help) {
-            free(cmd->name);
-            free(cmd);
-            return NULL;
+        size_t help_len = strlen(help);
+        info->help = tinycli_strpool_intern(&table->strings, help, help_len,
+                                            tinycli_hash(help, help_len));
+        if (!info->help) {
+            return TINYCLI_ERROR_MEMORY;
         }
     }
 
-    /* Set handler and completion */
+    /* Set hot and cold fields */
+    cmd->hash = hash;
+    cmd->name_len = (uint32_t)name_len;
     cmd->handler = handler;
-    cmd->completion = completion;
+    cmd->info = info;
+    info->completion = completion;
 
-    return cmd;
+    /* Publish the command */
+    table->count++;
+    command_index_insert(table, pos);
+    if (name_len > table->max_name_len) {
+        table->max_name_len = name_len;
+    }
+
+    if (out) {
+        *out = cmd;
+    }
+
+    return TINYCLI_SUCCESS;
 }
 
-void tinycli_command_free(tinycli_command_t *cmd)
+size_t tinycli_command_table_remove_plugin(tinycli_command_table_t *table,
+                                           const tinycli_plugin_t *plugin)
 {
-    if (!cmd) {
-        return;
+    size_t removed = 0, pos;
+
+    if (!table || !plugin) {
+        return 0;
     }
 
-    /* Free name */
-    if (cmd->name) {
-        free(cmd->name);
+    /* Drop the plugin's records from the end */
+    while (table->count > 0 &&
+           tinycli_command_table_at(table, table->count - 1)->info->plugin == plugin) {
+        table->count--;
+        removed++;
+    }
+    if (removed == 0) {
+        return 0;
     }
 
-    /* Free help */
-    if (cmd->help) {
-        free(cmd->help);
+    /* Rebuild the name index and the longest name without them */
+    memset(table->index, 0, table->index_size * sizeof(uint32_t));
+    table->max_name_len = 0;
+    for (pos = 0; pos < table->count; pos++) {
+        command_index_insert(table, pos);
+        if (tinycli_command_table_at(table, pos)->name_len > table->max_name_len) {
+            table->max_name_len = tinycli_command_table_at(table, pos)->name_len;
+        }
     }
 
-    /* Free command */
-    free(cmd);
+    /* The sorted index is rebuilt on next use */
+    table->sorted_count = 0;
+
+    return removed;
 }
 
-tinycli_command_t *tinycli_command_find(tinycli_context_t *ctx, const char *name)
+tinycli_command_t *tinycli_command_table_find(const tinycli_command_table_t *table,
+                                              const char *name, size_t len)
 {
-    tinycli_command_t *cmd;
+    size_t i, mask;
+    uint32_t hash;
 
-    if (!ctx || !name) {
+    if (!table || !name || table->index_size == 0) {
         return NULL;
     }
 
-    /* Search for command */
-    for (cmd = ctx->commands; cmd != NULL; cmd = cmd->next) {
-        if (strcmp(cmd->name, name) == 0) {
+    /* Probe the name index */
+    hash = tinycli_hash(name, len);
+    mask = table->index_size - 1;
+    for (i = hash & mask; table->index[i]; i = (i + 1) & mask) {
+        tinycli_command_t *cmd = tinycli_command_table_at(table, table->index[i] - 1);
+        if (cmd->hash == hash && cmd->name_len == len && memcmp(cmd->name, name, len) == 0) {
             return cmd;
         }
     }
@@ -88,105 +264,384 @@ tinycli_command_t *tinycli_command_find(tinycli_context_t *ctx, const char *name
     return NULL;
 }
 
+tinycli_command_t *tinycli_command_find(tinycli_context_t *ctx, const char *name)
+{
+    if (!ctx || !name) {
+        return NULL;
+    }
+
+    return tinycli_command_table_find(&ctx->commands, name, strlen(name));
+}
+
+/* Run a command handler for tinycli_invoke() */
+static int command_invoke(tinycli_context_t *ctx, void *target, int argc, char **argv)
+{
+    tinycli_command_t *cmd = (tinycli_command_t *)target;
+
+    /* Plugin commands run in a worker process when isolated */
+    if (ctx->pool && cmd->info->plugin) {
+        return tinycli_pool_execute(ctx, cmd, argc, argv);
+    }
+
+    return cmd->handler(argc, argv, ctx);
+}
+
+/* Look up the process-wide metrics of a command */
+static void command_metrics_attach(tinycli_command_t *cmd)
+{
+    tinycli_command_info_t *info = cmd->info;
+    char label[256];
+
+    /* Names too long for a label go without metrics */
+    info->metrics_attached = true;
+    if (!tinycli_metric_label("command", cmd->name, label, sizeof(label))) {
+        return;
+    }
+
+    info->calls_metric = tinycli_metric_counter("tinycli_command_invocations_total",
+                                                "Commands run", label);
+    info->errors_metric = tinycli_metric_counter("tinycli_command_errors_total",
+                                                 "Commands that returned an error", label);
+    info->duration_metric = tinycli_metric_histogram("tinycli_command_duration_seconds",
+                                                     "Time spent in commands", label);
+}
+
 int tinycli_command_execute(tinycli_context_t *ctx, tinycli_command_t *cmd, 
                            int argc, char **argv)
 {
+    tinycli_command_stats_t *stats;
+    uint64_t start_ns, elapsed_ns;
+    int ret;
+
     if (!ctx || !cmd || !cmd->handler) {
         return TINYCLI_ERROR_INVALID_ARGUMENT;
     }
 
-    /* Execute command handler */
-    return cmd->handler(argc, argv, ctx);
+    /* Nothing to run, or count, for an abandoned caller */
+    if (tinycli_invocation_abandoned()) {
+        return TINYCLI_ERROR_CANCELLED;
+    }
+
+    /* Execute command handler under its deadline */
+    start_ns = tinycli_time_ns();
+    ret = tinycli_invoke(ctx, cmd->info->timeout_ms, command_invoke, cmd, argc, argv);
+    elapsed_ns = tinycli_time_ns() - start_ns;
+
+    /* Update statistics */
+    stats = &cmd->info->stats;
+    stats->calls++;
+    stats->total_ns += elapsed_ns;
+    if (elapsed_ns > stats->max_ns) {
+        stats->max_ns = elapsed_ns;
+    }
+    if (ret != TINYCLI_SUCCESS) {
+        stats->failures++;
+    }
+    if (ret == TINYCLI_ERROR_TIMEOUT) {
+        stats->timeouts++;
+    }
+
+    /* Update the process-wide metrics */
+    if (!cmd->info->metrics_attached) {
+        command_metrics_attach(cmd);
+    }
+    tinycli_metric_inc(cmd->info->calls_metric, 1);
+    if (ret != TINYCLI_SUCCESS) {
+        tinycli_metric_inc(cmd->info->errors_metric, 1);
+    }
+    tinycli_metric_observe_ns(cmd->info->duration_metric, elapsed_ns);
+
+    return ret;
 }
 
 char **tinycli_command_complete(tinycli_context_t *ctx, const char *text, 
                                int start, int end)
 {
-    tinycli_command_t *cmd;
-    char **matches = NULL;
+    tinycli_completion_cache_t *cache;
+    tinycli_command_t *cmd = NULL;
+    const char *line = rl_line_buffer;
+    size_t text_len, path_len, pos;
+    char **argv = NULL;
+    int argc = 0;
+
+    if (!ctx || !text) {
+        return NULL;
+    }
+
+    cache = &ctx->completion;
+    text_len = strlen(text);
+    if (!line || start < 0) {
+        line = "";
+        start = 0;
+    }
+
+    /* The command path is everything before the word being completed */
+    path_len = (size_t)start;
+    while (path_len > 0 && (line[path_len - 1] == ' ' || line[path_len - 1] == '\t')) {
+        path_len--;
+    }
+
+    /* Split the line once; the first word names the command */
+    if (start > 0) {
+        if (tinycli_completion_cache_tokenize(cache, line, (size_t)start, text,
+                                              &argc, &argv) != TINYCLI_SUCCESS) {
+            return NULL;
+        }
+        cmd = tinycli_command_table_find(&ctx->commands, argv[0], strlen(argv[0]));
+        if (!cmd) {
+            return NULL;
+        }
+
+        /* Asynchronous providers keep their own per-prefix cache */
+        if (cmd->info->provider) {
+            return tinycli_completion_async_complete(ctx, cmd, text);
+        }
+    }
+
+    /* Extending the previous prefix only narrows the cached set */
+    if (tinycli_completion_cache_lookup(cache, ctx->generation, line, path_len,
+                                        text, text_len)) {
+        return tinycli_completion_cache_matches(cache);
+    }
+
+    if (tinycli_completion_cache_reset(cache, ctx->generation, line, path_len,
+                                       text, text_len) != TINYCLI_SUCCESS) {
+        return NULL;
+    }
 
-    /* If this is the first word, complete command names */
     if (start == 0) {
-        matches = (char **)malloc(sizeof(char *));
-        if (!matches) {
+        /* Complete command names from the sorted index */
+        if (command_sorted_refresh(&ctx->commands) != TINYCLI_SUCCESS) {
             return NULL;
         }
-        matches[0] = NULL;
-
-        /* Add matching commands to matches */
-        int count = 0;
-        for (cmd = ctx->commands; cmd != NULL; cmd = cmd->next) {
-            if (tinycli_starts_with(cmd->name, text)) {
-                /* Reallocate matches array */
-                char **new_matches = (char **)realloc(matches, (count + 2) * sizeof(char *));
-                if (!new_matches) {
-                    /* Free existing matches */
-                    int i;
-                    for (i = 0; i < count; i++) {
-                        free(matches[i]);
-                    }
-                    free(matches);
-                    return NULL;
-                }
-                matches = new_matches;
-
-                /* Add match */
-                matches[count] = tinycli_strdup(cmd->name);
-                if (!matches[count]) {
-                    /* Free existing matches */
-                    int i;
-                    for (i = 0; i < count; i++) {
-                        free(matches[i]);
-                    }
-                    free(matches);
-                    return NULL;
-                }
-                count++;
-                matches[count] = NULL;
+        for (pos = command_sorted_lower_bound(&ctx->commands, text, text_len);
+             pos < ctx->commands.sorted_count; pos++) {
+            cmd = ctx->commands.sorted[pos];
+            if (cmd->name_len < text_len || memcmp(cmd->name, text, text_len) != 0) {
+                break;
             }
-        }
-    } else {
-        /* Find the command */
-        char *cmd_name = rl_line_buffer;
-        char *space = strchr(cmd_name, ' ');
-        if (space) {
-            *space = '\0';
-            cmd = tinycli_command_find(ctx, cmd_name);
-            *space = ' ';
-
-            /* If the command has a completion function, use it */
-            if (cmd && cmd->completion) {
-                matches = cmd->completion(text, start, end);
+            if (tinycli_completion_cache_add(cache, cmd->name) != TINYCLI_SUCCESS) {
+                return NULL;
             }
         }
+    } else if (cmd->info->completion_v2) {
+        /* Complete arguments with the command's context-aware callback */
+        if (tinycli_completion_cache_run(cache, ctx, cmd->info->completion_v2,
+                                         cmd->info->completion_data, argc, argv) != TINYCLI_SUCCESS) {
+            return NULL;
+        }
+    } else if (cmd->info->completion) {
+        /* Complete arguments with the command's completion function */
+        if (tinycli_completion_cache_adopt(cache, cmd->info->completion(text, start, end)) !=
+            TINYCLI_SUCCESS) {
+            return NULL;
+        }
+    }
+
+    return tinycli_completion_cache_matches(cache);
+}
+
+/* Order commands by name */
+static int command_name_compare(const void *a, const void *b)
+{
+    const tinycli_command_t *ca = *(const tinycli_command_t * const *)a;
+    const tinycli_command_t *cb = *(const tinycli_command_t * const *)b;
+
+    return strcmp(ca->name, cb->name);
+}
+
+/* Bring the sorted index up to date with the registry */
+static int command_sorted_refresh(tinycli_command_table_t *table)
+{
+    tinycli_command_t **sorted;
+    size_t pos;
+
+    if (table->sorted_count == table->count) {
+        return TINYCLI_SUCCESS;
+    }
+
+    sorted = (tinycli_command_t **)tinycli_realloc(TINYCLI_MEM_COMMANDS, table->sorted,
+                                                   table->count * sizeof(*sorted));
+    if (!sorted) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+    table->sorted = sorted;
+
+    /* Append new commands and re-sort */
+    for (pos = table->sorted_count; pos < table->count; pos++) {
+        sorted[pos] = tinycli_command_table_at(table, pos);
+    }
+    qsort(sorted, table->count, sizeof(*sorted), command_name_compare);
+    table->sorted_count = table->count;
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Find the first sorted position whose name is not less than prefix */
+static size_t command_sorted_lower_bound(const tinycli_command_table_t *table,
+                                         const char *prefix, size_t len)
+{
+    size_t lo = 0, hi = table->sorted_count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strncmp(table->sorted[mid]->name, prefix, len) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
     }
 
-    return matches;
+    return lo;
 }
 
 void tinycli_command_list(tinycli_context_t *ctx)
 {
-    tinycli_command_t *cmd;
-    int max_name_len = 0;
+    tinycli_command_list_filtered(ctx, NULL);
+}
+
+int tinycli_command_list_filtered(tinycli_context_t *ctx,
+                                  const tinycli_command_filter_t *filter)
+{
+    tinycli_command_table_t *table;
+    tinycli_plugin_t *plugin = NULL, *owner;
+    const char *pattern = "";
+    size_t literal_len, pos, skip = 0, limit = 0, shown = 0;
+    bool glob, text, more = false;
+    int width, plugin_width = (int)strlen("plugin"), ret;
 
     if (!ctx) {
-        return;
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    table = &ctx->commands;
+    if (command_sorted_refresh(table) != TINYCLI_SUCCESS) {
+        return TINYCLI_ERROR_MEMORY;
     }
 
-    /* Find maximum command name length */
-    for (cmd = ctx->commands; cmd != NULL; cmd = cmd->next) {
-        int name_len = strlen(cmd->name);
-        if (name_len > max_name_len) {
-            max_name_len = name_len;
+    /* Resolve filter */
+    if (filter) {
+        if (filter->pattern) {
+            pattern = filter->pattern;
+        }
+        if (filter->plugin) {
+            plugin = tinycli_plugin_find(ctx, filter->plugin);
+            if (!plugin) {
+                tinycli_printf(ctx, "Unknown plugin: %s\n", filter->plugin);
+                return TINYCLI_ERROR_NOT_FOUND;
+            }
+        }
+        limit = filter->limit;
+        if (limit > 0 && filter->page > 1) {
+            skip = (filter->page - 1) * limit;
+        }
+    }
+
+    /* The literal part of the pattern selects a range of the sorted index */
+    literal_len = strcspn(pattern, "*?[");
+    glob = pattern[literal_len] != '\0';
+
+    /* The name column is bounded, so no pass over the registry is needed */
+    width = (int)(table->max_name_len < TINYCLI_LIST_NAME_WIDTH ?
+                  table->max_name_len : TINYCLI_LIST_NAME_WIDTH);
+
+    /* Plugins are few, so their column is sized up front too */
+    for (owner = ctx->plugins; owner != NULL; owner = owner->next) {
+        int len = (int)strlen(owner->name);
+        if (len > plugin_width) {
+            plugin_width = len;
         }
     }
 
     /* Print command list header */
-    tinycli_printf(ctx, "Available commands:\n");
+    text = tinycli_get_output_format(ctx) == TINYCLI_FORMAT_TEXT;
+    if (text) {
+        tinycli_printf(ctx, "Available commands:\n");
+    }
 
-    /* Print commands */
-    for (cmd = ctx->commands; cmd != NULL; cmd = cmd->next) {
-        tinycli_printf(ctx, "  %-*s  %s\n", max_name_len, cmd->name, 
-                      cmd->help ? cmd->help : "");
+    /* Fixed widths let text rows stream */
+    ret = tinycli_table_begin(ctx, "commands");
+    if (ret == TINYCLI_SUCCESS) {
+        ret = tinycli_table_column(ctx, "name", width);
     }
+    if (ret == TINYCLI_SUCCESS) {
+        ret = tinycli_table_column(ctx, "plugin", plugin_width);
+    }
+    if (ret == TINYCLI_SUCCESS) {
+        ret = tinycli_table_column(ctx, "help", 0);
+    }
+
+    /* Stream matching commands */
+    for (pos = command_sorted_lower_bound(table, pattern, literal_len);
+         ret == TINYCLI_SUCCESS && pos < table->sorted_count; pos++) {
+        tinycli_command_t *cmd = table->sorted[pos];
+
+        if (strncmp(cmd->name, pattern, literal_len) != 0) {
+            break;
+        }
+        if (glob && fnmatch(pattern, cmd->name, 0) != 0) {
+            continue;
+        }
+        if (plugin && cmd->info->plugin != plugin) {
+            continue;
+        }
+        if (skip > 0) {
+            skip--;
+            continue;
+        }
+        if (limit > 0 && shown == limit) {
+            more = true;
+            break;
+        }
+
+        ret = tinycli_record_begin(ctx);
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_string(ctx, "name", cmd->name);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_string(ctx, "plugin",
+                                      cmd->info->plugin ? cmd->info->plugin->name : "");
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_string(ctx, "help", cmd->info->help);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_record_end(ctx);
+        }
+        shown++;
+    }
+
+    if (ret != TINYCLI_SUCCESS) {
+        /* Leave the emitter usable */
+        if (ctx->emit.in_record) {
+            tinycli_record_end(ctx);
+        }
+        tinycli_table_end(ctx);
+        return ret;
+    }
+    ret = tinycli_table_end(ctx);
+
+    if (text && shown == 0) {
+        tinycli_printf(ctx, "  No matching commands\n");
+    }
+
+    if (more) {
+        size_t next_page = (filter->page > 1 ? filter->page : 1) + 1;
+
+        if (text) {
+            tinycli_printf(ctx, "\nMore commands available, use '--page %zu' to continue\n",
+                           next_page);
+        } else if (ret == TINYCLI_SUCCESS) {
+            /* Tell machines where to continue */
+            ret = tinycli_record_begin(ctx);
+            if (ret == TINYCLI_SUCCESS) {
+                ret = tinycli_emit_int(ctx, "next_page", (long long)next_page);
+                tinycli_record_end(ctx);
+            }
+        }
+    }
+
+    tinycli_output_flush(ctx);
+
+    return ret;
 }
@@ -0,0 +1,809 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include "completion.h"
+#include "context.h"
+#include "command.h"
+#include "alloc.h"
+
+/* Initial candidate array capacity */
+#define COMPLETION_INITIAL_CAPACITY 16
+
+void tinycli_completion_cache_init(tinycli_completion_cache_t *cache)
+{
+    if (!cache) {
+        return;
+    }
+
+    memset(cache, 0, sizeof(*cache));
+}
+
+/* Free a provider result */
+static void completion_free_owned(tinycli_completion_cache_t *cache)
+{
+    size_t i;
+
+    if (cache->owned) {
+        for (i = 0; cache->owned[i] != NULL; i++) {
+            free(cache->owned[i]);
+        }
+        free(cache->owned);
+        cache->owned = NULL;
+    }
+}
+
+void tinycli_completion_cache_destroy(tinycli_completion_cache_t *cache)
+{
+    if (!cache) {
+        return;
+    }
+
+    completion_free_owned(cache);
+    tinycli_free(cache->path);
+    tinycli_free(cache->prefix);
+    tinycli_free(cache->items);
+    tinycli_free(cache->arena);
+    tinycli_free(cache->offsets);
+    tinycli_free(cache->words);
+    tinycli_free(cache->argv);
+
+    memset(cache, 0, sizeof(*cache));
+}
+
+/* Store the prefix of the current set */
+static int completion_set_prefix(tinycli_completion_cache_t *cache,
+                                 const char *prefix, size_t prefix_len)
+{
+    if (prefix_len + 1 > cache->prefix_cap) {
+        char *buf = (char *)tinycli_realloc(TINYCLI_MEM_COMPLETION, cache->prefix, prefix_len + 1);
+        if (!buf) {
+            return TINYCLI_ERROR_MEMORY;
+        }
+        cache->prefix = buf;
+        cache->prefix_cap = prefix_len + 1;
+    }
+
+    memcpy(cache->prefix, prefix, prefix_len);
+    cache->prefix[prefix_len] = '\0';
+    cache->prefix_len = prefix_len;
+
+    return TINYCLI_SUCCESS;
+}
+
+bool tinycli_completion_cache_lookup(tinycli_completion_cache_t *cache, uint64_t generation,
+                                     const char *path, size_t path_len,
+                                     const char *prefix, size_t prefix_len)
+{
+    size_t i, kept;
+
+    if (!cache || !cache->valid || cache->generation != generation ||
+        cache->path_len != path_len || memcmp(cache->path, path, path_len) != 0) {
+        return false;
+    }
+
+    /* Same prefix: reuse as is */
+    if (cache->prefix_len == prefix_len && memcmp(cache->prefix, prefix, prefix_len) == 0) {
+        return true;
+    }
+
+    /* Longer prefix: narrow the set in place */
+    if (!cache->narrowable || prefix_len < cache->prefix_len ||
+        memcmp(cache->prefix, prefix, cache->prefix_len) != 0) {
+        return false;
+    }
+    if (completion_set_prefix(cache, prefix, prefix_len) != TINYCLI_SUCCESS) {
+        cache->valid = false;
+        return false;
+    }
+
+    for (i = 0, kept = 0; i < cache->count; i++) {
+        if (strncmp(cache->items[i], prefix, prefix_len) == 0) {
+            cache->items[kept++] = cache->items[i];
+        }
+    }
+    cache->count = kept;
+
+    return true;
+}
+
+int tinycli_completion_cache_reset(tinycli_completion_cache_t *cache, uint64_t generation,
+                                   const char *path, size_t path_len,
+                                   const char *prefix, size_t prefix_len)
+{
+    char *buf;
+
+    if (!cache || !path || !prefix) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    completion_free_owned(cache);
+    cache->valid = false;
+    cache->count = 0;
+    cache->arena_len = 0;
+    cache->offsets_count = 0;
+
+    /* Store the key */
+    buf = (char *)tinycli_realloc(TINYCLI_MEM_COMPLETION, cache->path, path_len + 1);
+    if (!buf) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+    memcpy(buf, path, path_len);
+    buf[path_len] = '\0';
+    cache->path = buf;
+    cache->path_len = path_len;
+
+    if (completion_set_prefix(cache, prefix, prefix_len) != TINYCLI_SUCCESS) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    cache->generation = generation;
+    cache->narrowable = true;
+    cache->valid = true;
+
+    return TINYCLI_SUCCESS;
+}
+
+int tinycli_completion_cache_add(tinycli_completion_cache_t *cache, const char *item)
+{
+    if (!cache || !cache->valid || !item) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (cache->count == cache->cap) {
+        size_t new_cap = cache->cap ? cache->cap * 2 : COMPLETION_INITIAL_CAPACITY;
+        const char **items = (const char **)tinycli_realloc(TINYCLI_MEM_COMPLETION, cache->items,
+                                                            new_cap * sizeof(*items));
+        if (!items) {
+            cache->valid = false;
+            return TINYCLI_ERROR_MEMORY;
+        }
+        cache->items = items;
+        cache->cap = new_cap;
+    }
+
+    if (strncmp(item, cache->prefix, cache->prefix_len) != 0) {
+        cache->narrowable = false;
+    }
+    cache->items[cache->count++] = item;
+
+    return TINYCLI_SUCCESS;
+}
+
+int tinycli_completion_cache_adopt(tinycli_completion_cache_t *cache, char **matches)
+{
+    size_t i;
+    int ret;
+
+    if (!cache || !cache->valid) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    cache->owned = matches;
+    if (!matches || !matches[0]) {
+        return TINYCLI_SUCCESS;
+    }
+
+    /* Skip the common prefix entry of a multi-candidate result */
+    for (i = matches[1] ? 1 : 0; matches[i] != NULL; i++) {
+        ret = tinycli_completion_cache_add(cache, matches[i]);
+        if (ret != TINYCLI_SUCCESS) {
+            return ret;
+        }
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Sink for candidates of a completion callback */
+struct tinycli_completion_emitter {
+    tinycli_completion_cache_t *cache;  /* Cache receiving the candidates */
+    int error;                          /* First error, reported after the callback */
+};
+
+/* Grow a buffer to hold at least need elements */
+static int completion_reserve(void **buf, size_t *cap, size_t need, size_t elem)
+{
+    size_t new_cap;
+    void *new_buf;
+
+    if (need <= *cap) {
+        return TINYCLI_SUCCESS;
+    }
+
+    new_cap = *cap ? *cap : COMPLETION_INITIAL_CAPACITY;
+    while (new_cap < need) {
+        new_cap *= 2;
+    }
+
+    new_buf = tinycli_realloc(TINYCLI_MEM_COMPLETION, *buf, new_cap * elem);
+    if (!new_buf) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+    *buf = new_buf;
+    *cap = new_cap;
+
+    return TINYCLI_SUCCESS;
+}
+
+int tinycli_completion_cache_tokenize(tinycli_completion_cache_t *cache, const char *line,
+                                      size_t len, const char *text, int *argc, char ***argv)
+{
+    size_t text_len, i = 0, j = 0;
+    int count = 0;
+    bool in_quotes = false;
+
+    if (!cache || !line || !text || !argc || !argv) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    /* Separators become terminators, so the line length bounds the storage */
+    text_len = strlen(text);
+    if (completion_reserve((void **)&cache->words, &cache->words_cap,
+                           len + text_len + 2, sizeof(char)) != TINYCLI_SUCCESS ||
+        completion_reserve((void **)&cache->argv, &cache->argv_cap,
+                           len / 2 + 3, sizeof(char *)) != TINYCLI_SUCCESS) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    /* Split the words before the one being completed */
+    while (i < len) {
+        if (!in_quotes && isspace((unsigned char)line[i])) {
+            i++;
+            continue;
+        }
+
+        cache->argv[count++] = &cache->words[j];
+        while (i < len) {
+            if (line[i] == '"') {
+                in_quotes = !in_quotes;
+                i++;
+            } else if (!in_quotes && isspace((unsigned char)line[i])) {
+                break;
+            } else {
+                cache->words[j++] = line[i++];
+            }
+        }
+        cache->words[j++] = '\0';
+    }
+
+    /* Append the word being completed */
+    cache->argv[count++] = &cache->words[j];
+    memcpy(&cache->words[j], text, text_len + 1);
+    cache->argv[count] = NULL;
+
+    *argc = count;
+    *argv = cache->argv;
+
+    return TINYCLI_SUCCESS;
+}
+
+int tinycli_completion_emit(tinycli_completion_emitter_t *emitter, const char *candidate)
+{
+    tinycli_completion_cache_t *cache;
+    size_t len;
+
+    if (!emitter || !candidate) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    /* Copy into the arena; offsets stay valid when it grows */
+    cache = emitter->cache;
+    len = strlen(candidate) + 1;
+    if (completion_reserve((void **)&cache->arena, &cache->arena_cap,
+                           cache->arena_len + len, sizeof(char)) != TINYCLI_SUCCESS ||
+        completion_reserve((void **)&cache->offsets, &cache->offsets_cap,
+                           cache->offsets_count + 1, sizeof(size_t)) != TINYCLI_SUCCESS) {
+        emitter->error = TINYCLI_ERROR_MEMORY;
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    memcpy(cache->arena + cache->arena_len, candidate, len);
+    cache->offsets[cache->offsets_count++] = cache->arena_len;
+    cache->arena_len += len;
+
+    return TINYCLI_SUCCESS;
+}
+
+int tinycli_completion_cache_run(tinycli_completion_cache_t *cache, tinycli_context_t *ctx,
+                                 tinycli_completion_v2_func_t func, void *user_data,
+                                 int argc, char **argv)
+{
+    tinycli_completion_emitter_t emitter;
+    size_t i;
+    int ret;
+
+    if (!cache || !cache->valid || !func) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    emitter.cache = cache;
+    emitter.error = TINYCLI_SUCCESS;
+
+    ret = func(ctx, argc, argv, &emitter, user_data);
+    if (ret == TINYCLI_SUCCESS) {
+        ret = emitter.error;
+    }
+    if (ret != TINYCLI_SUCCESS) {
+        cache->valid = false;
+        return ret;
+    }
+
+    /* The arena no longer moves, so candidates can be referenced directly */
+    for (i = 0; i < cache->offsets_count; i++) {
+        ret = tinycli_completion_cache_add(cache, cache->arena + cache->offsets[i]);
+        if (ret != TINYCLI_SUCCESS) {
+            return ret;
+        }
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Build a readline match list from candidates */
+static char **completion_build_matches(const char *const *items, size_t count)
+{
+    char **matches;
+    size_t i, j, lcd_len;
+
+    if (count == 0) {
+        return NULL;
+    }
+
+    matches = (char **)malloc((count + 2) * sizeof(char *));
+    if (!matches) {
+        return NULL;
+    }
+
+    /* A single candidate replaces the text directly */
+    if (count == 1) {
+        matches[0] = strdup(items[0]);
+        matches[1] = NULL;
+        if (!matches[0]) {
+            free(matches);
+            return NULL;
+        }
+        return matches;
+    }
+
+    /* Otherwise the first entry is the longest common prefix */
+    lcd_len = strlen(items[0]);
+    for (i = 1; i < count; i++) {
+        for (j = 0; j < lcd_len && items[i][j] == items[0][j]; j++) {
+        }
+        lcd_len = j;
+    }
+
+    matches[0] = strndup(items[0], lcd_len);
+    for (i = 0; i < count && matches[i] != NULL; i++) {
+        matches[i + 1] = strdup(items[i]);
+    }
+    if (i < count || !matches[i]) {
+        /* Free the entries copied so far */
+        for (j = 0; j < i + 1 && matches[j] != NULL; j++) {
+            free(matches[j]);
+        }
+        free(matches);
+        return NULL;
+    }
+    matches[count + 1] = NULL;
+
+    return matches;
+}
+
+char **tinycli_completion_cache_matches(const tinycli_completion_cache_t *cache)
+{
+    if (!cache || !cache->valid) {
+        return NULL;
+    }
+
+    return completion_build_matches(cache->items, cache->count);
+}
+
+/* Asynchronous completion provider */
+struct tinycli_completion_provider {
+    tinycli_async_completion_func_t func; /* Provider function */
+    void *user_data;                /* User data passed to the provider */
+    unsigned int deadline_ms;       /* Time to wait for the provider */
+    struct tinycli_completion_provider *next; /* Next registered provider */
+};
+
+/* Asynchronous completion request (one per command and argument prefix) */
+struct tinycli_completion_request {
+    pthread_mutex_t lock;           /* Protects the candidates and done */
+    pthread_cond_t cond;            /* Signalled when the provider returns */
+    unsigned int refs;              /* Cache and worker references */
+    bool done;                      /* Provider has returned */
+    bool cancelled;                 /* Provider should stop */
+    tinycli_command_t *cmd;         /* Completed command */
+    tinycli_completion_provider_t *provider; /* Provider of the command */
+    char *text;                     /* Argument prefix */
+    size_t text_len;                /* Length of the prefix */
+    char **items;                   /* Candidates found so far */
+    size_t count;                   /* Number of candidates */
+    size_t cap;                     /* Capacity of the candidate array */
+    struct tinycli_completion_request *next; /* Next request in the cache */
+    struct tinycli_completion_request *queue_next; /* Next request in the worker queue */
+};
+
+/* Asynchronous completion state of a context */
+struct tinycli_completion_async {
+    pthread_mutex_t lock;           /* Protects the queue and stop */
+    pthread_cond_t cond;            /* Signalled when work is queued */
+    pthread_t worker;               /* Worker thread */
+    bool started;                   /* Worker thread is running */
+    bool stop;                      /* Worker should exit */
+    tinycli_completion_request_t *queue_head; /* Requests waiting for the worker */
+    tinycli_completion_request_t *queue_tail;
+    tinycli_completion_request_t *cache; /* Recent requests, most recent first */
+    uint64_t generation;            /* Registry generation of the cached requests */
+    tinycli_completion_provider_t *providers; /* Registered providers */
+};
+
+/* Get the current monotonic time as a timespec offset by ms milliseconds */
+static void completion_deadline(struct timespec *ts, unsigned int ms)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+/* Drop a reference to a request */
+static void completion_request_release(tinycli_completion_request_t *req)
+{
+    size_t i;
+
+    if (__atomic_sub_fetch(&req->refs, 1, __ATOMIC_ACQ_REL) != 0) {
+        return;
+    }
+
+    for (i = 0; i < req->count; i++) {
+        tinycli_free(req->items[i]);
+    }
+    tinycli_free(req->items);
+    tinycli_free(req->text);
+    pthread_cond_destroy(&req->cond);
+    pthread_mutex_destroy(&req->lock);
+    tinycli_free(req);
+}
+
+/* Cancel a request and drop the cache's reference */
+static void completion_request_discard(tinycli_completion_request_t *req)
+{
+    __atomic_store_n(&req->cancelled, true, __ATOMIC_RELEASE);
+    completion_request_release(req);
+}
+
+/* Run queued requests */
+static void *completion_worker(void *arg)
+{
+    tinycli_completion_async_t *async = (tinycli_completion_async_t *)arg;
+    tinycli_completion_request_t *req;
+
+    for (;;) {
+        pthread_mutex_lock(&async->lock);
+        while (!async->stop && !async->queue_head) {
+            pthread_cond_wait(&async->cond, &async->lock);
+        }
+        if (async->stop) {
+            pthread_mutex_unlock(&async->lock);
+            break;
+        }
+        req = async->queue_head;
+        async->queue_head = req->queue_next;
+        if (!async->queue_head) {
+            async->queue_tail = NULL;
+        }
+        pthread_mutex_unlock(&async->lock);
+
+        if (!tinycli_completion_cancelled(req)) {
+            req->provider->func(req, req->text, req->provider->user_data);
+        }
+
+        pthread_mutex_lock(&req->lock);
+        __atomic_store_n(&req->done, true, __ATOMIC_RELEASE);
+        pthread_cond_broadcast(&req->cond);
+        pthread_mutex_unlock(&req->lock);
+        completion_request_release(req);
+    }
+
+    return NULL;
+}
+
+int tinycli_completion_async_register(tinycli_context_t *ctx, tinycli_command_t *cmd,
+                                      tinycli_async_completion_func_t func,
+                                      void *user_data, unsigned int deadline_ms)
+{
+    tinycli_completion_async_t *async = ctx->async_completion;
+    tinycli_completion_provider_t *provider;
+
+    /* Create the state on first use */
+    if (!async) {
+        async = (tinycli_completion_async_t *)tinycli_calloc(TINYCLI_MEM_COMPLETION, 1,
+                                                            sizeof(*async));
+        if (!async) {
+            return TINYCLI_ERROR_MEMORY;
+        }
+        pthread_mutex_init(&async->lock, NULL);
+        pthread_cond_init(&async->cond, NULL);
+        ctx->async_completion = async;
+    }
+
+    provider = (tinycli_completion_provider_t *)tinycli_malloc(TINYCLI_MEM_COMPLETION,
+                                                               sizeof(*provider));
+    if (!provider) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+    provider->func = func;
+    provider->user_data = user_data;
+    provider->deadline_ms = deadline_ms;
+    provider->next = async->providers;
+    async->providers = provider;
+
+    cmd->info->provider = provider;
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Find a cached request that can answer a prefix */
+static tinycli_completion_request_t *completion_async_lookup(tinycli_completion_async_t *async,
+                                                             tinycli_command_t *cmd,
+                                                             const char *text, size_t text_len)
+{
+    tinycli_completion_request_t *req, **link, *best = NULL, **best_link = NULL;
+
+    for (link = &async->cache; (req = *link) != NULL; link = &req->next) {
+        if (req->cmd != cmd || req->text_len > text_len ||
+            memcmp(req->text, text, req->text_len) != 0) {
+            continue;
+        }
+
+        /* Exact prefix, or a finished lookup of a shorter prefix to filter */
+        if (req->text_len == text_len ||
+            (__atomic_load_n(&req->done, __ATOMIC_ACQUIRE) &&
+             (!best || req->text_len > best->text_len))) {
+            best = req;
+            best_link = link;
+            if (req->text_len == text_len) {
+                break;
+            }
+        }
+    }
+
+    /* Move to the front */
+    if (best && best_link != &async->cache) {
+        *best_link = best->next;
+        best->next = async->cache;
+        async->cache = best;
+    }
+
+    return best;
+}
+
+/* Start a request for a prefix and queue it for the worker */
+static tinycli_completion_request_t *completion_async_start(tinycli_completion_async_t *async,
+                                                            tinycli_command_t *cmd,
+                                                            const char *text, size_t text_len)
+{
+    tinycli_completion_request_t *req, **link;
+    pthread_condattr_t attr;
+    sigset_t all, saved;
+    size_t cached = 0;
+    int ret;
+
+    /* Start the worker on first use; signals stay with the shell's threads */
+    if (!async->started) {
+        sigfillset(&all);
+        pthread_sigmask(SIG_SETMASK, &all, &saved);
+        ret = pthread_create(&async->worker, NULL, completion_worker, async);
+        pthread_sigmask(SIG_SETMASK, &saved, NULL);
+        if (ret != 0) {
+            return NULL;
+        }
+        async->started = true;
+    }
+
+    req = (tinycli_completion_request_t *)tinycli_calloc(TINYCLI_MEM_COMPLETION, 1, sizeof(*req));
+    if (!req) {
+        return NULL;
+    }
+    req->text = (char *)tinycli_malloc(TINYCLI_MEM_COMPLETION, text_len + 1);
+    if (!req->text) {
+        tinycli_free(req);
+        return NULL;
+    }
+    memcpy(req->text, text, text_len);
+    req->text[text_len] = '\0';
+    req->text_len = text_len;
+    req->cmd = cmd;
+    req->provider = cmd->info->provider;
+    req->refs = 2;
+
+    pthread_mutex_init(&req->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&req->cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    /* Add to the cache, evicting the least recent request */
+    req->next = async->cache;
+    async->cache = req;
+    for (link = &async->cache; *link != NULL; link = &(*link)->next) {
+        if (++cached > TINYCLI_COMPLETION_ASYNC_CACHE) {
+            completion_request_discard(*link);
+            *link = NULL;
+            break;
+        }
+    }
+
+    /* Queue for the worker */
+    pthread_mutex_lock(&async->lock);
+    if (async->queue_tail) {
+        async->queue_tail->queue_next = req;
+    } else {
+        async->queue_head = req;
+    }
+    async->queue_tail = req;
+    pthread_cond_signal(&async->cond);
+    pthread_mutex_unlock(&async->lock);
+
+    return req;
+}
+
+/* Drop all cached requests */
+static void completion_async_flush(tinycli_completion_async_t *async)
+{
+    tinycli_completion_request_t *req, *next;
+
+    for (req = async->cache; req != NULL; req = next) {
+        next = req->next;
+        completion_request_discard(req);
+    }
+    async->cache = NULL;
+}
+
+char **tinycli_completion_async_complete(tinycli_context_t *ctx, tinycli_command_t *cmd,
+                                         const char *text)
+{
+    tinycli_completion_async_t *async = ctx->async_completion;
+    tinycli_completion_request_t *req;
+    const char **items;
+    struct timespec deadline;
+    size_t text_len = strlen(text), i, count = 0;
+    char **matches;
+
+    if (!async || !cmd->info->provider) {
+        return NULL;
+    }
+
+    /* Results of an older registry may come from a replaced provider */
+    if (async->generation != ctx->generation) {
+        completion_async_flush(async);
+        async->generation = ctx->generation;
+    }
+
+    req = completion_async_lookup(async, cmd, text, text_len);
+    if (!req) {
+        req = completion_async_start(async, cmd, text, text_len);
+        if (!req) {
+            return NULL;
+        }
+    }
+
+    /* Wait for the provider until its deadline */
+    pthread_mutex_lock(&req->lock);
+    completion_deadline(&deadline, req->provider->deadline_ms);
+    while (!req->done) {
+        if (pthread_cond_timedwait(&req->cond, &req->lock, &deadline) != 0) {
+            break;
+        }
+    }
+
+    /* Show the candidates found so far that match the text */
+    items = (const char **)tinycli_malloc(TINYCLI_MEM_COMPLETION,
+                                          (req->count ? req->count : 1) * sizeof(*items));
+    if (!items) {
+        pthread_mutex_unlock(&req->lock);
+        return NULL;
+    }
+    for (i = 0; i < req->count; i++) {
+        if (strncmp(req->items[i], text, text_len) == 0 || req->text_len == text_len) {
+            items[count++] = req->items[i];
+        }
+    }
+    matches = completion_build_matches(items, count);
+    pthread_mutex_unlock(&req->lock);
+
+    tinycli_free(items);
+    return matches;
+}
+
+void tinycli_completion_async_destroy(tinycli_completion_async_t *async)
+{
+    tinycli_completion_request_t *req, *next;
+    tinycli_completion_provider_t *provider, *next_provider;
+
+    if (!async) {
+        return;
+    }
+
+    /* Cancel everything, then wait for the running provider */
+    pthread_mutex_lock(&async->lock);
+    async->stop = true;
+    for (req = async->queue_head; req != NULL; req = req->queue_next) {
+        __atomic_store_n(&req->cancelled, true, __ATOMIC_RELEASE);
+    }
+    for (req = async->cache; req != NULL; req = req->next) {
+        __atomic_store_n(&req->cancelled, true, __ATOMIC_RELEASE);
+    }
+    pthread_cond_signal(&async->cond);
+    pthread_mutex_unlock(&async->lock);
+
+    if (async->started) {
+        pthread_join(async->worker, NULL);
+    }
+
+    /* Release requests the worker never picked up, then the cache */
+    for (req = async->queue_head; req != NULL; req = next) {
+        next = req->queue_next;
+        completion_request_release(req);
+    }
+    completion_async_flush(async);
+
+    for (provider = async->providers; provider != NULL; provider = next_provider) {
+        next_provider = provider->next;
+        tinycli_free(provider);
+    }
+
+    pthread_cond_destroy(&async->cond);
+    pthread_mutex_destroy(&async->lock);
+    tinycli_free(async);
+}
+
+int tinycli_completion_add(tinycli_completion_request_t *request, const char *candidate)
+{
+    char *copy;
+
+    if (!request || !candidate) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+    if (tinycli_completion_cancelled(request)) {
+        return TINYCLI_ERROR_GENERAL;
+    }
+
+    copy = tinycli_mem_strdup(TINYCLI_MEM_COMPLETION, candidate);
+    if (!copy) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    pthread_mutex_lock(&request->lock);
+    if (request->count == request->cap) {
+        size_t new_cap = request->cap ? request->cap * 2 : COMPLETION_INITIAL_CAPACITY;
+        char **items = (char **)tinycli_realloc(TINYCLI_MEM_COMPLETION, request->items,
+                                                new_cap * sizeof(*items));
+        if (!items) {
+            pthread_mutex_unlock(&request->lock);
+            tinycli_free(copy);
+            return TINYCLI_ERROR_MEMORY;
+        }
+        request->items = items;
+        request->cap = new_cap;
+    }
+    request->items[request->count++] = copy;
+    pthread_mutex_unlock(&request->lock);
+
+    return TINYCLI_SUCCESS;
+}
+
+bool tinycli_completion_cancelled(const tinycli_completion_request_t *request)
+{
+    return !request || __atomic_load_n(&request->cancelled, __ATOMIC_ACQUIRE);
+}
@@ -1,27 +1,55 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <fnmatch.h>
+#include <sys/resource.h>
 #include <readline/readline.h>
 #include <readline/history.h>
 
+#include "alloc.h"
 #include "context.h"
 #include "command.h"
 #include "plugin.h"
 #include "utils.h"
+#include "runtime.h"
+#include "pluginpath.h"
+#include "script.h"
+#include "metrics.h"
+#include "log.h"
 
 /* Built-in command handlers */
 static int cmd_help_handler(int argc, char **argv, tinycli_context_t *ctx);
 static int cmd_exit_handler(int argc, char **argv, tinycli_context_t *ctx);
 static int cmd_load_handler(int argc, char **argv, tinycli_context_t *ctx);
 static int cmd_show_handler(int argc, char **argv, tinycli_context_t *ctx);
+static int cmd_source_handler(int argc, char **argv, tinycli_context_t *ctx);
+static int cmd_alias_handler(int argc, char **argv, tinycli_context_t *ctx);
+static int cmd_unalias_handler(int argc, char **argv, tinycli_context_t *ctx);
+static int cmd_format_handler(int argc, char **argv, tinycli_context_t *ctx);
+static int cmd_every_handler(int argc, char **argv, tinycli_context_t *ctx);
+static int cmd_timers_handler(int argc, char **argv, tinycli_context_t *ctx);
+static int cmd_timeout_handler(int argc, char **argv, tinycli_context_t *ctx);
+static int cmd_time_handler(int argc, char **argv, tinycli_context_t *ctx);
+static int cmd_log_handler(int argc, char **argv, tinycli_context_t *ctx);
+static int cmd_load_complete(tinycli_context_t *ctx, int argc, char **argv,
+                             tinycli_completion_emitter_t *emitter, void *user_data);
+static int cmd_show_complete(tinycli_context_t *ctx, int argc, char **argv,
+                             tinycli_completion_emitter_t *emitter, void *user_data);
+static int cmd_format_complete(tinycli_context_t *ctx, int argc, char **argv,
+                               tinycli_completion_emitter_t *emitter, void *user_data);
+static int cmd_timers_complete(tinycli_context_t *ctx, int argc, char **argv,
+                               tinycli_completion_emitter_t *emitter, void *user_data);
+static int cmd_log_complete(tinycli_context_t *ctx, int argc, char **argv,
+                            tinycli_completion_emitter_t *emitter, void *user_data);
 
 /* Create context */
-tinycli_context_t *tinycli_context_create(void)
+tinycli_context_t *tinycli_context_create(tinycli_runtime_t *runtime)
 {
     tinycli_context_t *ctx;
 
     /* Allocate context */
-    ctx = (tinycli_context_t *)malloc(sizeof(tinycli_context_t));
+    ctx = (tinycli_context_t *)tinycli_malloc(TINYCLI_MEM_CORE, sizeof(tinycli_context_t));
     if (!ctx) {
         return NULL;
     }
@@ -29,8 +57,22 @@ tinycli_context_t *tinycli_context_create(void)
     /* Initialize context */
     memset(ctx, 0, sizeof(tinycli_context_t));
 
+    /* Take a reference to the runtime */
+    ctx->runtime = tinycli_runtime_retain(runtime);
+
+    /* Initialize command registry, completion cache and output */
+    tinycli_command_table_init(&ctx->commands);
+    tinycli_completion_cache_init(&ctx->completion);
+    tinycli_output_init(&ctx->output);
+    tinycli_emit_init(&ctx->emit);
+
     /* Set running flag */
     ctx->running = 1;
+    ctx->epoll_fd = -1;
+    ctx->cancel_grace_ms = -1;
+    ctx->cancel_pipe[0] = ctx->cancel_pipe[1] = -1;
+
+    tinycli_metric_add(tinycli_metrics_builtin()->sessions, 1);
 
     return ctx;
 }
@@ -38,53 +80,82 @@ tinycli_context_t *tinycli_context_create(void)
 /* Free context */
 void tinycli_context_free(tinycli_context_t *ctx)
 {
-    tinycli_command_t *cmd, *next_cmd;
     tinycli_plugin_t *plugin, *next_plugin;
 
     if (!ctx) {
         return;
     }
 
+    /* Close session log */
+    tinycli_session_record_stop(ctx);
+
     /* Free prompt */
     if (ctx->prompt) {
-        free(ctx->prompt);
+        tinycli_free(ctx->prompt);
     }
 
-    /* Free commands */
-    for (cmd = ctx->commands; cmd != NULL; cmd = next_cmd) {
-        next_cmd = cmd->next;
-        tinycli_command_free(cmd);
+    /* Stop completion providers, the command worker and the worker processes
+       before their plugins go away */
+    tinycli_completion_async_destroy(ctx->async_completion);
+    tinycli_cancel_destroy(ctx);
+    tinycli_pool_destroy(ctx->pool);
+    ctx->pool = NULL;
+
+    /* Let plugins clean up while their commands still exist */
+    for (plugin = ctx->plugins; plugin != NULL; plugin = plugin->next) {
+        if (plugin->cleanup) {
+            plugin->cleanup(ctx);
+        }
     }
 
+    /* Free timers, aliases, commands and cached completions */
+    tinycli_timers_free(ctx->timers);
+    tinycli_alias_table_free(ctx->aliases);
+    tinycli_completion_cache_destroy(&ctx->completion);
+    tinycli_command_table_destroy(&ctx->commands);
+
     /* Free plugins */
     for (plugin = ctx->plugins; plugin != NULL; plugin = next_plugin) {
         next_plugin = plugin->next;
         tinycli_plugin_free(plugin);
     }
 
+    /* Flush and free output */
+    tinycli_output_flush(ctx);
+    tinycli_output_destroy(&ctx->output);
+    tinycli_emit_destroy(&ctx->emit);
+
+    /* Release runtime */
+    tinycli_runtime_release(ctx->runtime);
+
     /* Free context */
-    free(ctx);
+    tinycli_free(ctx);
+    tinycli_metric_add(tinycli_metrics_builtin()->sessions, -1);
 }
 
 /* Add command to context */
-int tinycli_context_add_command(tinycli_context_t *ctx, tinycli_command_t *cmd)
+int tinycli_context_add_command(tinycli_context_t *ctx, const char *name,
+                                const char *help, tinycli_cmd_handler_t handler,
+                                tinycli_completion_func_t completion)
 {
-    tinycli_command_t *c;
+    tinycli_command_t *cmd;
+    int ret;
 
-    if (!ctx || !cmd) {
+    if (!ctx || !name || !handler) {
         return TINYCLI_ERROR_INVALID_ARGUMENT;
     }
 
-    /* Check if command already exists */
-    for (c = ctx->commands; c != NULL; c = c->next) {
-        if (strcmp(c->name, cmd->name) == 0) {
-            return TINYCLI_ERROR_COMMAND_EXISTS;
-        }
+    /* Add command to registry (fails if it already exists) */
+    ret = tinycli_command_table_add(&ctx->commands, name, help, handler, completion, &cmd);
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
     }
 
-    /* Add command to list */
-    cmd->next = ctx->commands;
-    ctx->commands = cmd;
+    /* Commands registered from a plugin's init function belong to it */
+    cmd->info->plugin = ctx->current_plugin;
+
+    /* Invalidate cached completions */
+    ctx->generation++;
 
     return TINYCLI_SUCCESS;
 }
@@ -115,20 +186,12 @@ int tinycli_context_add_plugin(tinycli_context_t *ctx, tinycli_plugin_t *plugin)
 /* Find command in context */
 tinycli_command_t *tinycli_context_find_command(tinycli_context_t *ctx, const char *name)
 {
-    tinycli_command_t *cmd;
-
     if (!ctx || !name) {
         return NULL;
     }
 
     /* Search for command */
-    for (cmd = ctx->commands; cmd != NULL; cmd = cmd->next) {
-        if (strcmp(cmd->name, name) == 0) {
-            return cmd;
-        }
-    }
-
-    return NULL;
+    return tinycli_command_table_find(&ctx->commands, name, strlen(name));
 }
 
 /* Register built-in commands */
@@ -163,12 +226,93 @@ int tinycli_register_builtins(tinycli_context_t *ctx)
     if (ret != TINYCLI_SUCCESS) {
         return ret;
     }
+    ret = tinycli_register_completion(ctx, "load", cmd_load_complete, NULL);
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
+    }
 
     /* Register show command */
     ret = tinycli_register_command(ctx, "show", "Show information", cmd_show_handler, NULL);
     if (ret != TINYCLI_SUCCESS) {
         return ret;
     }
+    ret = tinycli_register_completion(ctx, "show", cmd_show_complete, NULL);
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
+    }
+
+    /* Register source command */
+    ret = tinycli_register_command(ctx, "source", "Run a script", cmd_source_handler, NULL);
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
+    }
+
+    /* Register alias commands */
+    ret = tinycli_register_command(ctx, "alias", "Define or list aliases", cmd_alias_handler, NULL);
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
+    }
+    ret = tinycli_register_command(ctx, "macro", "Define a macro with $1..$9 and $@ arguments",
+                                   cmd_alias_handler, NULL);
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
+    }
+    ret = tinycli_register_command(ctx, "unalias", "Remove an alias or macro", cmd_unalias_handler, NULL);
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
+    }
+
+    /* Register format command */
+    ret = tinycli_register_command(ctx, "format", "Show or set the output format", cmd_format_handler, NULL);
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
+    }
+    ret = tinycli_register_completion(ctx, "format", cmd_format_complete, NULL);
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
+    }
+
+    /* Register periodic commands */
+    ret = tinycli_register_command(ctx, "every", "Run a command periodically", cmd_every_handler, NULL);
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
+    }
+    ret = tinycli_register_command(ctx, "watch", "Run a command periodically and show what changes",
+                                   cmd_every_handler, NULL);
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
+    }
+    ret = tinycli_register_command(ctx, "timers", "List or cancel periodic commands",
+                                   cmd_timers_handler, NULL);
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
+    }
+    ret = tinycli_register_completion(ctx, "timers", cmd_timers_complete, NULL);
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
+    }
+
+    /* Register timeout command */
+    ret = tinycli_register_command(ctx, "timeout", "Run a command with a deadline", cmd_timeout_handler, NULL);
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
+    }
+
+    /* Register time command */
+    ret = tinycli_register_command(ctx, "time", "Measure a command", cmd_time_handler, NULL);
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
+    }
+
+    /* Register log command */
+    ret = tinycli_register_command(ctx, "log", "Show or configure logging", cmd_log_handler, NULL);
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
+    }
+    ret = tinycli_register_completion(ctx, "log", cmd_log_complete, NULL);
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
+    }
 
     return TINYCLI_SUCCESS;
 }
@@ -194,17 +338,23 @@ static int cmd_exit_handler(int argc, char **argv, tinycli_context_t *ctx)
 /* Load command handler */
 static int cmd_load_handler(int argc, char **argv, tinycli_context_t *ctx)
 {
+    unsigned int bind;
+
     if (argc < 2) {
         tinycli_printf(ctx, "Usage: load <plugin|json> <path>\n");
         return TINYCLI_ERROR_INVALID_ARGUMENT;
     }
 
     if (strcmp(argv[1], "plugin") == 0) {
-        if (argc < 3) {
-            tinycli_printf(ctx, "Usage: load plugin <name>\n");
+        if (argc == 3) {
+            return tinycli_plugin_load(ctx, argv[2]);
+        }
+        if (argc != 5 || strcmp(argv[3], "--bind") != 0 ||
+            tinycli_plugin_bind_parse(argv[4], &bind) != TINYCLI_SUCCESS) {
+            tinycli_printf(ctx, "Usage: load plugin <name> [--bind now|lazy,local|global,deepbind,nodelete]\n");
             return TINYCLI_ERROR_INVALID_ARGUMENT;
         }
-        return tinycli_plugin_load(ctx, argv[2]);
+        return tinycli_plugin_load_bind(ctx, argv[2], bind);
     } else if (strcmp(argv[1], "json") == 0) {
         if (argc < 3) {
             tinycli_printf(ctx, "Usage: load json <path>\n");
@@ -218,23 +368,705 @@ static int cmd_load_handler(int argc, char **argv, tinycli_context_t *ctx)
     }
 }
 
+/* Source command handler: source <file> [args] */
+static int cmd_source_handler(int argc, char **argv, tinycli_context_t *ctx)
+{
+    tinycli_script_t *script;
+    char error[256];
+    int ret;
+
+    if (argc < 2) {
+        tinycli_printf(ctx, "Usage: source <file> [args]\n");
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    /* Scripts can source scripts, but not forever */
+    if (ctx->script_depth >= TINYCLI_SCRIPT_MAX_DEPTH) {
+        tinycli_printf(ctx, "Scripts nested too deeply: %s\n", argv[1]);
+        return TINYCLI_ERROR_GENERAL;
+    }
+
+    ret = tinycli_script_load(argv[1], &script, error, sizeof(error));
+    if (ret != TINYCLI_SUCCESS) {
+        tinycli_printf(ctx, "Failed to load script %s: %s\n", argv[1], error);
+        return ret;
+    }
+
+    ctx->script_depth++;
+    ret = tinycli_script_run(ctx, script, argc - 1, argv + 1);
+    ctx->script_depth--;
+    tinycli_script_free(script);
+
+    return ret;
+}
+
+/* Alias and macro command handler: alias|macro [<name> [= "<text>"]] */
+static int cmd_alias_handler(int argc, char **argv, tinycli_context_t *ctx)
+{
+    if (argc == 1) {
+        return tinycli_alias_list(ctx, NULL);
+    }
+    if (argc == 2) {
+        return tinycli_alias_list(ctx, argv[1]);
+    }
+    if (argc != 4 || strcmp(argv[2], "=") != 0) {
+        tinycli_printf(ctx, "Usage: %s [<name> [= \"<text>\"]]\n", argv[0]);
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    return tinycli_alias_define(ctx, argv[1], argv[3], strcmp(argv[0], "macro") == 0);
+}
+
+/* Unalias command handler */
+static int cmd_unalias_handler(int argc, char **argv, tinycli_context_t *ctx)
+{
+    int ret;
+
+    if (argc != 2) {
+        tinycli_printf(ctx, "Usage: unalias <name>\n");
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    ret = tinycli_alias_remove(ctx, argv[1]);
+    if (ret == TINYCLI_ERROR_NOT_FOUND) {
+        tinycli_printf(ctx, "No such alias: %s\n", argv[1]);
+    }
+
+    return ret;
+}
+
+/* Format command handler: format [text|json|binary] */
+static int cmd_format_handler(int argc, char **argv, tinycli_context_t *ctx)
+{
+    static const char *const names[] = { "text", "json", "binary" };
+    tinycli_output_format_t format;
+
+    if (argc == 1) {
+        tinycli_printf(ctx, "%s\n", names[tinycli_get_output_format(ctx)]);
+        return TINYCLI_SUCCESS;
+    }
+
+    if (argc != 2 || tinycli_output_format_parse(argv[1], &format) != TINYCLI_SUCCESS) {
+        tinycli_printf(ctx, "Usage: format [text|json|binary]\n");
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    return tinycli_set_output_format(ctx, format);
+}
+
+/* Every and watch command handler: every|watch <interval> <command> [args] */
+static int cmd_every_handler(int argc, char **argv, tinycli_context_t *ctx)
+{
+    unsigned long interval_ms;
+    unsigned int id;
+    size_t len = 0, pos = 0;
+    char *line;
+    int i, ret;
+
+    if (argc < 3) {
+        tinycli_printf(ctx, "Usage: %s <interval> <command> [args]\n", argv[0]);
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (tinycli_timer_parse_interval(argv[1], &interval_ms) != TINYCLI_SUCCESS) {
+        tinycli_printf(ctx, "Invalid interval: %s (at least %dms)\n", argv[1], TINYCLI_TIMER_TICK_MS);
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    /* Join the command back into a line, quoting words with spaces */
+    for (i = 2; i < argc; i++) {
+        len += strlen(argv[i]) + 3;
+    }
+    line = (char *)tinycli_malloc(TINYCLI_MEM_TIMER, len + 1);
+    if (!line) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+    for (i = 2; i < argc; i++) {
+        bool quote = argv[i][0] == '\0' || strpbrk(argv[i], " \t\n\r\f\v") != NULL;
+        pos += (size_t)sprintf(line + pos, quote ? "%s\"%s\"" : "%s%s", i > 2 ? " " : "", argv[i]);
+    }
+
+    ret = tinycli_timer_add(ctx, strcmp(argv[0], "watch") == 0 ? TINYCLI_TIMER_WATCH : TINYCLI_TIMER_EVERY,
+                            interval_ms, line, &id);
+    tinycli_free(line);
+    if (ret == TINYCLI_SUCCESS) {
+        tinycli_printf(ctx, "Timer %u scheduled\n", id);
+    }
+
+    return ret;
+}
+
+/* Timers command handler: timers [list] | timers cancel <id|all> */
+static int cmd_timers_handler(int argc, char **argv, tinycli_context_t *ctx)
+{
+    unsigned long id = 0;
+    char *end;
+    int ret;
+
+    if (argc == 1 || (argc == 2 && strcmp(argv[1], "list") == 0)) {
+        return tinycli_timer_list(ctx);
+    }
+
+    if (argc != 3 || strcmp(argv[1], "cancel") != 0) {
+        tinycli_printf(ctx, "Usage: timers [list] | timers cancel <id|all>\n");
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (strcmp(argv[2], "all") != 0) {
+        id = strtoul(argv[2], &end, 10);
+        if (*argv[2] == '-' || *end != '\0' || id == 0 || id > UINT_MAX) {
+            tinycli_printf(ctx, "Invalid timer: %s\n", argv[2]);
+            return TINYCLI_ERROR_INVALID_ARGUMENT;
+        }
+    }
+
+    ret = tinycli_timer_cancel(ctx, (unsigned int)id);
+    if (ret == TINYCLI_ERROR_NOT_FOUND && id != 0) {
+        tinycli_printf(ctx, "No such timer: %s\n", argv[2]);
+    } else if (ret == TINYCLI_ERROR_NOT_FOUND) {
+        /* Nothing to cancel is fine */
+        ret = TINYCLI_SUCCESS;
+    }
+
+    return ret;
+}
+
+/* Run an alias for tinycli_invoke_deadline() */
+static int timeout_run_alias(tinycli_context_t *ctx, void *target, int argc, char **argv)
+{
+    return tinycli_alias_execute(ctx, (tinycli_alias_t *)target, argc, argv);
+}
+
+/* Run a command for tinycli_invoke_deadline() */
+static int timeout_run_command(tinycli_context_t *ctx, void *target, int argc, char **argv)
+{
+    return tinycli_command_execute(ctx, (tinycli_command_t *)target, argc, argv);
+}
+
+/* Timeout command handler: timeout <interval> <command> [args] */
+static int cmd_timeout_handler(int argc, char **argv, tinycli_context_t *ctx)
+{
+    unsigned long timeout_ms;
+    tinycli_alias_t *alias;
+    tinycli_command_t *cmd;
+
+    if (argc < 3) {
+        tinycli_printf(ctx, "Usage: timeout <interval> <command> [args]\n");
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (tinycli_timer_parse_interval(argv[1], &timeout_ms) != TINYCLI_SUCCESS || timeout_ms > UINT_MAX) {
+        tinycli_printf(ctx, "Invalid interval: %s\n", argv[1]);
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    /* The deadline replaces the command's own default */
+    alias = ctx->aliases ? tinycli_alias_find(ctx, argv[2]) : NULL;
+    if (alias) {
+        return tinycli_invoke_deadline(ctx, (unsigned int)timeout_ms, timeout_run_alias, alias,
+                                       argc - 2, argv + 2);
+    }
+
+    cmd = tinycli_command_find(ctx, argv[2]);
+    if (!cmd) {
+        tinycli_printf(ctx, "Unknown command: %s\n", argv[2]);
+        return TINYCLI_ERROR_NOT_FOUND;
+    }
+
+    return tinycli_invoke_deadline(ctx, (unsigned int)timeout_ms, timeout_run_command, cmd,
+                                   argc - 2, argv + 2);
+}
+
+/* Order run times for time -n */
+static int time_compare(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* Microseconds in a timeval */
+static long long time_us(const struct timeval *tv)
+{
+    return (long long)tv->tv_sec * 1000000 + tv->tv_usec;
+}
+
+/* Time command handler: time [-n <runs>] <command> [args] */
+static int cmd_time_handler(int argc, char **argv, tinycli_context_t *ctx)
+{
+    struct rusage usage_before, usage_after;
+    tinycli_mem_stats_t mem_before, mem_after;
+    tinycli_alias_t *alias;
+    tinycli_command_t *cmd = NULL;
+    unsigned long runs = 1, done;
+    uint64_t *times, start_ns, total_ns = 0;
+    char *end;
+    int first = 1, ret = TINYCLI_SUCCESS, report;
+
+    if (argc >= 3 && strcmp(argv[1], "-n") == 0) {
+        runs = strtoul(argv[2], &end, 10);
+        if (end == argv[2] || *end != '\0' || runs == 0 || runs > UINT32_MAX) {
+            tinycli_printf(ctx, "Invalid run count: %s\n", argv[2]);
+            return TINYCLI_ERROR_INVALID_ARGUMENT;
+        }
+        first = 3;
+    }
+    if (first >= argc) {
+        tinycli_printf(ctx, "Usage: time [-n <runs>] <command> [args]\n");
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    alias = ctx->aliases ? tinycli_alias_find(ctx, argv[first]) : NULL;
+    if (!alias) {
+        cmd = tinycli_command_find(ctx, argv[first]);
+        if (!cmd) {
+            tinycli_printf(ctx, "Unknown command: %s\n", argv[first]);
+            return TINYCLI_ERROR_NOT_FOUND;
+        }
+    }
+
+    times = (uint64_t *)tinycli_malloc(TINYCLI_MEM_CORE, runs * sizeof(*times));
+    if (!times) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    /* Run in place, in the warm context, stopping at the first failure */
+    getrusage(RUSAGE_SELF, &usage_before);
+    tinycli_mem_get_total(&mem_before);
+    for (done = 0; done < runs && ret == TINYCLI_SUCCESS; done++) {
+        start_ns = tinycli_time_ns();
+        ret = alias ? tinycli_alias_execute(ctx, alias, argc - first, argv + first) :
+                      tinycli_command_execute(ctx, cmd, argc - first, argv + first);
+        times[done] = tinycli_time_ns() - start_ns;
+        total_ns += times[done];
+        if (ret == TINYCLI_SUCCESS && tinycli_cancelled(ctx)) {
+            ret = TINYCLI_ERROR_CANCELLED;
+        }
+    }
+    tinycli_mem_get_total(&mem_after);
+    getrusage(RUSAGE_SELF, &usage_after);
+
+    /* Process-wide counters: other threads' work shows up too */
+    report = tinycli_record_begin(ctx);
+    if (report == TINYCLI_SUCCESS) {
+        report = tinycli_emit_int(ctx, "runs", (long long)done);
+    }
+    if (report == TINYCLI_SUCCESS) {
+        report = tinycli_emit_int(ctx, "wall_us", (long long)(total_ns / 1000));
+    }
+    if (report == TINYCLI_SUCCESS && done > 1) {
+        qsort(times, done, sizeof(*times), time_compare);
+        report = tinycli_emit_int(ctx, "min_us", (long long)(times[0] / 1000));
+        if (report == TINYCLI_SUCCESS) {
+            report = tinycli_emit_int(ctx, "mean_us", (long long)(total_ns / done / 1000));
+        }
+        if (report == TINYCLI_SUCCESS) {
+            report = tinycli_emit_int(ctx, "p99_us", (long long)(times[(done * 99 + 99) / 100 - 1] / 1000));
+        }
+        if (report == TINYCLI_SUCCESS) {
+            report = tinycli_emit_int(ctx, "max_us", (long long)(times[done - 1] / 1000));
+        }
+    }
+    if (report == TINYCLI_SUCCESS) {
+        report = tinycli_emit_int(ctx, "user_us",
+                                  time_us(&usage_after.ru_utime) - time_us(&usage_before.ru_utime));
+    }
+    if (report == TINYCLI_SUCCESS) {
+        report = tinycli_emit_int(ctx, "sys_us",
+                                  time_us(&usage_after.ru_stime) - time_us(&usage_before.ru_stime));
+    }
+    if (report == TINYCLI_SUCCESS) {
+        report = tinycli_emit_int(ctx, "voluntary_switches", usage_after.ru_nvcsw - usage_before.ru_nvcsw);
+    }
+    if (report == TINYCLI_SUCCESS) {
+        report = tinycli_emit_int(ctx, "involuntary_switches", usage_after.ru_nivcsw - usage_before.ru_nivcsw);
+    }
+    if (report == TINYCLI_SUCCESS) {
+        report = tinycli_emit_int(ctx, "minor_faults", usage_after.ru_minflt - usage_before.ru_minflt);
+    }
+    if (report == TINYCLI_SUCCESS) {
+        report = tinycli_emit_int(ctx, "major_faults", usage_after.ru_majflt - usage_before.ru_majflt);
+    }
+    if (report == TINYCLI_SUCCESS) {
+        report = tinycli_emit_int(ctx, "allocs", (long long)(mem_after.allocs - mem_before.allocs));
+    }
+    if (report == TINYCLI_SUCCESS) {
+        report = tinycli_emit_int(ctx, "alloc_bytes",
+                                  (long long)(mem_after.alloc_bytes - mem_before.alloc_bytes));
+    }
+    if (report == TINYCLI_SUCCESS) {
+        report = tinycli_record_end(ctx);
+    } else {
+        tinycli_record_end(ctx);
+    }
+
+    tinycli_free(times);
+
+    return ret != TINYCLI_SUCCESS ? ret : report;
+}
+
+/* Log command handler: log [level <level> | to <stderr|syslog|file>] */
+static int cmd_log_handler(int argc, char **argv, tinycli_context_t *ctx)
+{
+    tinycli_log_status_t status;
+    tinycli_log_level_t level;
+    int ret;
+
+    if (argc == 3 && strcmp(argv[1], "level") == 0) {
+        if (tinycli_log_level_parse(argv[2], &level) != TINYCLI_SUCCESS) {
+            tinycli_printf(ctx, "Unknown log level: %s\n", argv[2]);
+            return TINYCLI_ERROR_INVALID_ARGUMENT;
+        }
+        return tinycli_log_set_level(level);
+    }
+    if (argc == 3 && strcmp(argv[1], "to") == 0) {
+        ret = tinycli_log_open(argv[2]);
+        if (ret != TINYCLI_SUCCESS) {
+            tinycli_printf(ctx, "Failed to open log %s\n", argv[2]);
+        }
+        return ret;
+    }
+    if (argc != 1) {
+        tinycli_printf(ctx, "Usage: log [level <error|warn|info|debug|trace> | to <stderr|syslog|file>]\n");
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    tinycli_log_get_status(&status);
+    ret = tinycli_record_begin(ctx);
+    if (ret == TINYCLI_SUCCESS) {
+        ret = tinycli_emit_string(ctx, "level", tinycli_log_level_name(status.level));
+    }
+    if (ret == TINYCLI_SUCCESS) {
+        ret = tinycli_emit_string(ctx, "target", status.target);
+    }
+    if (ret == TINYCLI_SUCCESS) {
+        ret = tinycli_emit_int(ctx, "written", (long long)status.written);
+    }
+    if (ret == TINYCLI_SUCCESS) {
+        ret = tinycli_emit_int(ctx, "dropped", (long long)status.dropped);
+    }
+    if (ret == TINYCLI_SUCCESS) {
+        ret = tinycli_emit_int(ctx, "threads", status.threads);
+    }
+    if (ret == TINYCLI_SUCCESS) {
+        ret = tinycli_record_end(ctx);
+    } else {
+        tinycli_record_end(ctx);
+    }
+
+    return ret;
+}
+
+/* Show command statistics: show stats [filter] */
+static int show_stats(tinycli_context_t *ctx, int argc, char **argv)
+{
+    tinycli_command_table_t *table = &ctx->commands;
+    tinycli_command_stats_t *stats;
+    tinycli_command_t *cmd;
+    size_t pos;
+    int ret;
+
+    if (argc > 1) {
+        tinycli_printf(ctx, "Usage: show stats [filter]\n");
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    ret = tinycli_table_begin(ctx, "stats");
+    for (pos = 0; pos < table->count && ret == TINYCLI_SUCCESS; pos++) {
+        cmd = tinycli_command_table_at(table, pos);
+        stats = &cmd->info->stats;
+
+        /* Only commands that ran or have a deadline */
+        if ((stats->calls == 0 && cmd->info->timeout_ms == 0) ||
+            (argc == 1 && fnmatch(argv[0], cmd->name, 0) != 0)) {
+            continue;
+        }
+
+        ret = tinycli_record_begin(ctx);
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_string(ctx, "name", cmd->name);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_int(ctx, "calls", (long long)stats->calls);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_int(ctx, "failures", (long long)stats->failures);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_int(ctx, "timeouts", (long long)stats->timeouts);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_int(ctx, "avg_us", stats->calls ?
+                                   (long long)(stats->total_ns / stats->calls / 1000) : 0);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_int(ctx, "max_us", (long long)(stats->max_ns / 1000));
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_int(ctx, "timeout_ms", cmd->info->timeout_ms);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_record_end(ctx);
+        } else {
+            tinycli_record_end(ctx);
+        }
+    }
+    if (ret != TINYCLI_SUCCESS) {
+        tinycli_table_end(ctx);
+        return ret;
+    }
+
+    return tinycli_table_end(ctx);
+}
+
+/* Parse a positive count for a show option */
+static int parse_count(tinycli_context_t *ctx, const char *option, const char *value,
+                       size_t *count)
+{
+    char *end;
+    unsigned long n;
+
+    n = strtoul(value, &end, 10);
+    if (*value == '-' || *end != '\0' || n == 0) {
+        tinycli_printf(ctx, "Invalid value for %s: %s\n", option, value);
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    *count = (size_t)n;
+    return TINYCLI_SUCCESS;
+}
+
+/* Show commands: show commands [filter] [--plugin P] [--limit N] [--page K] */
+static int show_commands(tinycli_context_t *ctx, int argc, char **argv)
+{
+    tinycli_command_filter_t filter;
+    int i;
+
+    memset(&filter, 0, sizeof(filter));
+
+    for (i = 0; i < argc; i++) {
+        const char *option = argv[i];
+        int ret = TINYCLI_SUCCESS;
+
+        /* Positional filter */
+        if (option[0] != '-') {
+            if (filter.pattern) {
+                tinycli_printf(ctx, "Usage: show commands [filter] [--plugin P] [--limit N] [--page K]\n");
+                return TINYCLI_ERROR_INVALID_ARGUMENT;
+            }
+            filter.pattern = option;
+            continue;
+        }
+
+        /* Options with a value */
+        if (i + 1 >= argc) {
+            tinycli_printf(ctx, "Missing value for %s\n", option);
+            return TINYCLI_ERROR_INVALID_ARGUMENT;
+        }
+        i++;
+
+        if (strcmp(option, "--plugin") == 0) {
+            filter.plugin = argv[i];
+        } else if (strcmp(option, "--limit") == 0) {
+            ret = parse_count(ctx, option, argv[i], &filter.limit);
+        } else if (strcmp(option, "--page") == 0) {
+            ret = parse_count(ctx, option, argv[i], &filter.page);
+        } else {
+            tinycli_printf(ctx, "Unknown option: %s\n", option);
+            ret = TINYCLI_ERROR_INVALID_ARGUMENT;
+        }
+
+        if (ret != TINYCLI_SUCCESS) {
+            return ret;
+        }
+    }
+
+    if (filter.page > 1 && filter.limit == 0) {
+        tinycli_printf(ctx, "--page requires --limit\n");
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    return tinycli_command_list_filtered(ctx, &filter);
+}
+
 /* Show command handler */
 static int cmd_show_handler(int argc, char **argv, tinycli_context_t *ctx)
 {
     if (argc < 2) {
-        tinycli_printf(ctx, "Usage: show <commands|plugins>\n");
+        tinycli_printf(ctx, "Usage: show <commands|plugins|memory|stats|workers|metrics>\n");
         return TINYCLI_ERROR_INVALID_ARGUMENT;
     }
 
     if (strcmp(argv[1], "commands") == 0) {
-        tinycli_command_list(ctx);
+        return show_commands(ctx, argc - 2, argv + 2);
     } else if (strcmp(argv[1], "plugins") == 0) {
-        tinycli_plugin_list(ctx);
+        if (argc == 3 && strcmp(argv[2], "--timing") == 0) {
+            return tinycli_plugin_list_timing(ctx);
+        }
+        return tinycli_plugin_list(ctx);
+    } else if (strcmp(argv[1], "memory") == 0) {
+        tinycli_mem_show(ctx);
+    } else if (strcmp(argv[1], "stats") == 0) {
+        return show_stats(ctx, argc - 2, argv + 2);
+    } else if (strcmp(argv[1], "workers") == 0) {
+        return tinycli_pool_list(ctx);
+    } else if (strcmp(argv[1], "metrics") == 0) {
+        return tinycli_metrics_show(ctx);
     } else {
         tinycli_printf(ctx, "Unknown show target: %s\n", argv[1]);
-        tinycli_printf(ctx, "Usage: show <commands|plugins>\n");
+        tinycli_printf(ctx, "Usage: show <commands|plugins|memory|stats|workers|metrics>\n");
         return TINYCLI_ERROR_INVALID_ARGUMENT;
     }
 
     return TINYCLI_SUCCESS;
 }
+
+/* Emit the words that start with a prefix */
+static int complete_words(tinycli_completion_emitter_t *emitter, const char *prefix,
+                          const char *const *words)
+{
+    size_t len = strlen(prefix);
+    int ret;
+
+    for (; *words != NULL; words++) {
+        if (strncmp(*words, prefix, len) == 0) {
+            ret = tinycli_completion_emit(emitter, *words);
+            if (ret != TINYCLI_SUCCESS) {
+                return ret;
+            }
+        }
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Load command completion */
+static int cmd_load_complete(tinycli_context_t *ctx, int argc, char **argv,
+                             tinycli_completion_emitter_t *emitter, void *user_data)
+{
+    static const char *const kinds[] = { "plugin", "json", NULL };
+    static const char *const bind_options[] = { "--bind", NULL };
+    char dir_buf[PATH_MAX];
+    const char *plugin_dir;
+
+    (void)user_data;
+
+    if (argc == 2) {
+        return complete_words(emitter, argv[1], kinds);
+    }
+
+    if (argc == 4 && strcmp(argv[1], "plugin") == 0) {
+        return complete_words(emitter, argv[3], bind_options);
+    }
+
+    /* Plugin names come from the indexed search path */
+    if (argc == 3 && strcmp(argv[1], "plugin") == 0) {
+        plugin_dir = tinycli_runtime_get_plugin_dir(ctx->runtime, dir_buf, sizeof(dir_buf));
+        if (plugin_dir) {
+            return tinycli_plugin_path_complete(plugin_dir, argv[2], emitter);
+        }
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Show command completion */
+static int cmd_show_complete(tinycli_context_t *ctx, int argc, char **argv,
+                             tinycli_completion_emitter_t *emitter, void *user_data)
+{
+    static const char *const topics[] = { "commands", "plugins", "memory", "stats", "workers", "metrics", NULL };
+    static const char *const options[] = { "--plugin", "--limit", "--page", NULL };
+    static const char *const plugin_options[] = { "--timing", NULL };
+    const char *prefix = argv[argc - 1];
+    tinycli_plugin_t *plugin;
+    size_t len;
+    int ret;
+
+    (void)user_data;
+
+    if (argc == 2) {
+        return complete_words(emitter, prefix, topics);
+    }
+    if (argc == 3 && strcmp(argv[1], "plugins") == 0) {
+        return complete_words(emitter, prefix, plugin_options);
+    }
+    if (strcmp(argv[1], "commands") != 0) {
+        return TINYCLI_SUCCESS;
+    }
+
+    /* Plugin names after --plugin, options otherwise */
+    if (strcmp(argv[argc - 2], "--plugin") == 0) {
+        len = strlen(prefix);
+        for (plugin = ctx->plugins; plugin != NULL; plugin = plugin->next) {
+            if (strncmp(plugin->name, prefix, len) == 0) {
+                ret = tinycli_completion_emit(emitter, plugin->name);
+                if (ret != TINYCLI_SUCCESS) {
+                    return ret;
+                }
+            }
+        }
+        return TINYCLI_SUCCESS;
+    }
+
+    return prefix[0] == '-' ? complete_words(emitter, prefix, options) : TINYCLI_SUCCESS;
+}
+
+/* Format command completion */
+static int cmd_format_complete(tinycli_context_t *ctx, int argc, char **argv,
+                               tinycli_completion_emitter_t *emitter, void *user_data)
+{
+    static const char *const formats[] = { "text", "json", "binary", NULL };
+
+    (void)ctx;
+    (void)user_data;
+
+    if (argc == 2) {
+        return complete_words(emitter, argv[1], formats);
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Log command completion */
+static int cmd_log_complete(tinycli_context_t *ctx, int argc, char **argv,
+                            tinycli_completion_emitter_t *emitter, void *user_data)
+{
+    static const char *const actions[] = { "level", "to", NULL };
+    static const char *const levels[] = { "error", "warn", "info", "debug", "trace", NULL };
+    static const char *const targets[] = { "stderr", "syslog", NULL };
+
+    (void)ctx;
+    (void)user_data;
+
+    if (argc == 2) {
+        return complete_words(emitter, argv[1], actions);
+    }
+    if (argc == 3 && strcmp(argv[1], "level") == 0) {
+        return complete_words(emitter, argv[2], levels);
+    }
+    if (argc == 3 && strcmp(argv[1], "to") == 0) {
+        return complete_words(emitter, argv[2], targets);
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Timers command completion */
+static int cmd_timers_complete(tinycli_context_t *ctx, int argc, char **argv,
+                               tinycli_completion_emitter_t *emitter, void *user_data)
+{
+    static const char *const actions[] = { "list", "cancel", NULL };
+    static const char *const all[] = { "all", NULL };
+
+    (void)ctx;
+    (void)user_data;
+
+    if (argc == 2) {
+        return complete_words(emitter, argv[1], actions);
+    }
+    if (argc == 3 && strcmp(argv[1], "cancel") == 0) {
+        return complete_words(emitter, argv[2], all);
+    }
+
+    return TINYCLI_SUCCESS;
+}
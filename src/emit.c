@@ -0,0 +1,755 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "emit.h"
+#include "context.h"
+#include "output.h"
+#include "alloc.h"
+#include "cancel.h"
+
+/* Initial arena size */
+#define EMIT_ARENA_INITIAL 256
+
+void tinycli_emit_init(tinycli_emit_t *emit)
+{
+    if (!emit) {
+        return;
+    }
+
+    memset(emit, 0, sizeof(*emit));
+    emit->format = TINYCLI_FORMAT_TEXT;
+}
+
+void tinycli_emit_destroy(tinycli_emit_t *emit)
+{
+    if (!emit) {
+        return;
+    }
+
+    tinycli_free(emit->arena);
+    tinycli_free(emit->cells);
+    tinycli_emit_init(emit);
+}
+
+int tinycli_output_format_parse(const char *name, tinycli_output_format_t *format)
+{
+    if (!name || !format) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (strcmp(name, "text") == 0) {
+        *format = TINYCLI_FORMAT_TEXT;
+    } else if (strcmp(name, "json") == 0) {
+        *format = TINYCLI_FORMAT_JSON;
+    } else if (strcmp(name, "binary") == 0) {
+        *format = TINYCLI_FORMAT_BINARY;
+    } else {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+int tinycli_set_output_format(tinycli_context_t *ctx, tinycli_output_format_t format)
+{
+    /* Abandoned commands must not touch state the next command uses */
+    if (tinycli_invocation_abandoned()) {
+        return TINYCLI_ERROR_CANCELLED;
+    }
+
+    if (!ctx || format > TINYCLI_FORMAT_BINARY || ctx->emit.in_table || ctx->emit.in_record) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    ctx->emit.format = format;
+    return TINYCLI_SUCCESS;
+}
+
+tinycli_output_format_t tinycli_get_output_format(tinycli_context_t *ctx)
+{
+    return ctx ? ctx->emit.format : TINYCLI_FORMAT_TEXT;
+}
+
+/* Make room for len more bytes in the arena */
+static int emit_reserve(tinycli_emit_t *emit, size_t len)
+{
+    size_t cap;
+    char *arena;
+
+    if (emit->arena_len + len <= emit->arena_cap) {
+        return TINYCLI_SUCCESS;
+    }
+    if (emit->arena_len + len > UINT32_MAX) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    cap = emit->arena_cap ? emit->arena_cap : EMIT_ARENA_INITIAL;
+    while (cap < emit->arena_len + len) {
+        cap *= 2;
+    }
+
+    arena = (char *)tinycli_realloc(TINYCLI_MEM_OUTPUT, emit->arena, cap);
+    if (!arena) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+    emit->arena = arena;
+    emit->arena_cap = cap;
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Append bytes to the arena */
+static int emit_put(tinycli_emit_t *emit, const void *data, size_t len)
+{
+    if (emit_reserve(emit, len) != TINYCLI_SUCCESS) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    memcpy(emit->arena + emit->arena_len, data, len);
+    emit->arena_len += len;
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Append an unsigned LEB128 varint to a buffer; returns its length */
+static size_t emit_encode_varint(unsigned char *buf, uint64_t value)
+{
+    size_t n = 0;
+
+    while (value >= 0x80) {
+        buf[n++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    buf[n++] = (unsigned char)value;
+
+    return n;
+}
+
+/* Append an unsigned LEB128 varint to the arena */
+static int emit_put_varint(tinycli_emit_t *emit, uint64_t value)
+{
+    unsigned char buf[10];
+
+    return emit_put(emit, buf, emit_encode_varint(buf, value));
+}
+
+/* Append a JSON string literal to the arena */
+static int emit_put_json_string(tinycli_emit_t *emit, const char *str, size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+    size_t i, start = 0;
+    int ret;
+
+    ret = emit_put(emit, "\"", 1);
+    for (i = 0; i < len && ret == TINYCLI_SUCCESS; i++) {
+        unsigned char c = (unsigned char)str[i];
+        char esc[6];
+        size_t esc_len = 2;
+
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+
+        /* Flush the plain run before the escape */
+        ret = emit_put(emit, str + start, i - start);
+        start = i + 1;
+
+        esc[0] = '\\';
+        switch (c) {
+        case '"':  esc[1] = '"'; break;
+        case '\\': esc[1] = '\\'; break;
+        case '\n': esc[1] = 'n'; break;
+        case '\r': esc[1] = 'r'; break;
+        case '\t': esc[1] = 't'; break;
+        default:
+            esc[1] = 'u';
+            esc[2] = '0';
+            esc[3] = '0';
+            esc[4] = hex[c >> 4];
+            esc[5] = hex[c & 15];
+            esc_len = 6;
+            break;
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = emit_put(emit, esc, esc_len);
+        }
+    }
+    if (ret == TINYCLI_SUCCESS) {
+        ret = emit_put(emit, str + start, len - start);
+    }
+    if (ret == TINYCLI_SUCCESS) {
+        ret = emit_put(emit, "\"", 1);
+    }
+
+    return ret;
+}
+
+/* Append base64 text to the arena */
+static int emit_put_base64(tinycli_emit_t *emit, const unsigned char *data, size_t len)
+{
+    static const char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t i;
+    char *out;
+
+    if (emit_reserve(emit, (len + 2) / 3 * 4) != TINYCLI_SUCCESS) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    out = emit->arena + emit->arena_len;
+    for (i = 0; i + 2 < len; i += 3) {
+        uint32_t v = ((uint32_t)data[i] << 16) | ((uint32_t)data[i + 1] << 8) | data[i + 2];
+        *out++ = alphabet[v >> 18];
+        *out++ = alphabet[(v >> 12) & 63];
+        *out++ = alphabet[(v >> 6) & 63];
+        *out++ = alphabet[v & 63];
+    }
+    if (i < len) {
+        uint32_t v = (uint32_t)data[i] << 16;
+        if (i + 1 < len) {
+            v |= (uint32_t)data[i + 1] << 8;
+        }
+        *out++ = alphabet[v >> 18];
+        *out++ = alphabet[(v >> 12) & 63];
+        *out++ = i + 1 < len ? alphabet[(v >> 6) & 63] : '=';
+        *out++ = '=';
+    }
+    emit->arena_len = (size_t)(out - emit->arena);
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Find a column, adding it if needed; returns -1 if there are too many */
+static int emit_column(tinycli_emit_t *emit, const char *key)
+{
+    int i;
+
+    for (i = 0; i < emit->column_count; i++) {
+        if (strcmp(emit->columns[i].key, key) == 0) {
+            return i;
+        }
+    }
+
+    if (emit->column_count == TINYCLI_EMIT_MAX_COLUMNS) {
+        return -1;
+    }
+
+    memset(&emit->columns[i], 0, sizeof(emit->columns[i]));
+    snprintf(emit->columns[i].key, sizeof(emit->columns[i].key), "%s", key);
+    emit->column_count++;
+
+    return i;
+}
+
+/* Record the text appended to the arena since start as a cell of key */
+static int emit_add_cell(tinycli_emit_t *emit, const char *key, size_t start)
+{
+    tinycli_emit_cell_t *cell;
+    int column, len;
+
+    column = emit_column(emit, key);
+    if (column < 0) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (emit->cell_count == emit->cell_cap) {
+        size_t cap = emit->cell_cap ? emit->cell_cap * 2 : 32;
+        tinycli_emit_cell_t *cells = (tinycli_emit_cell_t *)tinycli_realloc(
+            TINYCLI_MEM_OUTPUT, emit->cells, cap * sizeof(tinycli_emit_cell_t));
+        if (!cells) {
+            return TINYCLI_ERROR_MEMORY;
+        }
+        emit->cells = cells;
+        emit->cell_cap = cap;
+    }
+
+    len = (int)(emit->arena_len - start);
+    cell = &emit->cells[emit->cell_count++];
+    cell->row = emit->rows;
+    cell->column = (uint32_t)column;
+    cell->offset = (uint32_t)start;
+    cell->len = (uint32_t)len;
+    if (len > emit->columns[column].max) {
+        emit->columns[column].max = len;
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Field types of the binary format */
+enum {
+    EMIT_INT = 'i',
+    EMIT_STRING = 's',
+    EMIT_BOOL = 'b',
+    EMIT_BYTES = 'x'
+};
+
+/* Add a field to the current record */
+static int emit_field(tinycli_context_t *ctx, int type, const char *key, long long num,
+                      const void *data, size_t len)
+{
+    tinycli_emit_t *emit;
+    size_t start;
+    char buf[32];
+    int n, ret = TINYCLI_SUCCESS;
+
+    if (tinycli_invocation_abandoned()) {
+        return TINYCLI_ERROR_CANCELLED;
+    }
+
+    if (!ctx || !key || !ctx->emit.in_record || strlen(key) >= TINYCLI_EMIT_MAX_KEY) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+    emit = &ctx->emit;
+    start = emit->arena_len;
+
+    switch (emit->format) {
+    case TINYCLI_FORMAT_TEXT:
+        switch (type) {
+        case EMIT_INT:
+            n = snprintf(buf, sizeof(buf), "%lld", num);
+            ret = emit_put(emit, buf, (size_t)n);
+            break;
+        case EMIT_BOOL:
+            ret = num ? emit_put(emit, "true", 4) : emit_put(emit, "false", 5);
+            break;
+        case EMIT_STRING:
+            ret = emit_put(emit, data, len);
+            break;
+        default:
+            /* Hex */
+            ret = emit_reserve(emit, len * 2);
+            if (ret == TINYCLI_SUCCESS) {
+                static const char hex[] = "0123456789abcdef";
+                const unsigned char *bytes = (const unsigned char *)data;
+                size_t i;
+
+                for (i = 0; i < len; i++) {
+                    emit->arena[emit->arena_len++] = hex[bytes[i] >> 4];
+                    emit->arena[emit->arena_len++] = hex[bytes[i] & 15];
+                }
+            }
+            break;
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = emit_add_cell(emit, key, start);
+        }
+        break;
+
+    case TINYCLI_FORMAT_JSON:
+        if (emit->fields > 0) {
+            ret = emit_put(emit, ",", 1);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = emit_put_json_string(emit, key, strlen(key));
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = emit_put(emit, ":", 1);
+        }
+        if (ret != TINYCLI_SUCCESS) {
+            break;
+        }
+        switch (type) {
+        case EMIT_INT:
+            n = snprintf(buf, sizeof(buf), "%lld", num);
+            ret = emit_put(emit, buf, (size_t)n);
+            break;
+        case EMIT_BOOL:
+            ret = num ? emit_put(emit, "true", 4) : emit_put(emit, "false", 5);
+            break;
+        case EMIT_STRING:
+            ret = emit_put_json_string(emit, data, len);
+            break;
+        default:
+            ret = emit_put(emit, "\"", 1);
+            if (ret == TINYCLI_SUCCESS) {
+                ret = emit_put_base64(emit, data, len);
+            }
+            if (ret == TINYCLI_SUCCESS) {
+                ret = emit_put(emit, "\"", 1);
+            }
+            break;
+        }
+        break;
+
+    default: {
+        unsigned char tag = (unsigned char)type;
+        size_t key_len = strlen(key);
+
+        ret = emit_put(emit, &tag, 1);
+        if (ret == TINYCLI_SUCCESS) {
+            ret = emit_put_varint(emit, key_len);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = emit_put(emit, key, key_len);
+        }
+        if (ret != TINYCLI_SUCCESS) {
+            break;
+        }
+        switch (type) {
+        case EMIT_INT:
+            ret = emit_put_varint(emit, ((uint64_t)num << 1) ^ (uint64_t)(num >> 63));
+            break;
+        case EMIT_BOOL:
+            tag = num ? 1 : 0;
+            ret = emit_put(emit, &tag, 1);
+            break;
+        default:
+            ret = emit_put_varint(emit, len);
+            if (ret == TINYCLI_SUCCESS) {
+                ret = emit_put(emit, data, len);
+            }
+            break;
+        }
+        break;
+    }
+    }
+
+    if (ret != TINYCLI_SUCCESS) {
+        /* Drop the partial field */
+        emit->arena_len = start;
+        return ret;
+    }
+    emit->fields++;
+
+    return TINYCLI_SUCCESS;
+}
+
+int tinycli_emit_int(tinycli_context_t *ctx, const char *key, long long value)
+{
+    return emit_field(ctx, EMIT_INT, key, value, NULL, 0);
+}
+
+int tinycli_emit_string(tinycli_context_t *ctx, const char *key, const char *value)
+{
+    if (!value) {
+        value = "";
+    }
+
+    return emit_field(ctx, EMIT_STRING, key, 0, value, strlen(value));
+}
+
+int tinycli_emit_bool(tinycli_context_t *ctx, const char *key, bool value)
+{
+    return emit_field(ctx, EMIT_BOOL, key, value ? 1 : 0, NULL, 0);
+}
+
+int tinycli_emit_bytes(tinycli_context_t *ctx, const char *key, const void *data, size_t len)
+{
+    if (!data && len > 0) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    return emit_field(ctx, EMIT_BYTES, key, 0, data ? data : "", len);
+}
+
+/* Print the header of a text table */
+static void emit_text_header(tinycli_context_t *ctx)
+{
+    tinycli_emit_t *emit = &ctx->emit;
+    char key[TINYCLI_EMIT_MAX_KEY];
+    int i, j, width;
+
+    for (i = 0; i < emit->column_count; i++) {
+        width = emit->columns[i].width;
+        for (j = 0; emit->columns[i].key[j]; j++) {
+            key[j] = (char)toupper((unsigned char)emit->columns[i].key[j]);
+        }
+        key[j] = '\0';
+        if (i + 1 < emit->column_count) {
+            tinycli_printf(ctx, "  %-*s", width, key);
+        } else {
+            tinycli_printf(ctx, "  %s\n", key);
+        }
+    }
+
+    for (i = 0; i < emit->column_count; i++) {
+        width = emit->columns[i].width;
+        if (i + 1 == emit->column_count) {
+            width = emit->columns[i].max > (int)strlen(emit->columns[i].key) ?
+                    emit->columns[i].max : (int)strlen(emit->columns[i].key);
+        }
+        tinycli_printf(ctx, "  ");
+        for (j = 0; j < width; j++) {
+            tinycli_output_write(ctx, "-", 1);
+        }
+    }
+    tinycli_printf(ctx, "\n");
+    emit->header_done = true;
+}
+
+/* Print one row of a text table from its cells (indexed by column) */
+static void emit_text_row(tinycli_context_t *ctx, const tinycli_emit_cell_t *const *row)
+{
+    tinycli_emit_t *emit = &ctx->emit;
+    int i, last = emit->column_count - 1;
+
+    /* Trailing empty cells aren't padded */
+    while (last > 0 && !row[last]) {
+        last--;
+    }
+
+    for (i = 0; i <= last; i++) {
+        const tinycli_emit_cell_t *cell = row[i];
+        int len = cell ? (int)cell->len : 0;
+        const char *text = cell ? emit->arena + cell->offset : "";
+
+        if (i < last) {
+            tinycli_printf(ctx, "  %.*s%*s", len, text,
+                           emit->columns[i].width > len ? emit->columns[i].width - len : 0, "");
+        } else {
+            tinycli_printf(ctx, "  %.*s\n", len, text);
+        }
+    }
+}
+
+/* Gather the cells of the current record by column */
+static void emit_text_gather(tinycli_emit_t *emit, size_t first, size_t end,
+                             const tinycli_emit_cell_t **row)
+{
+    size_t i;
+
+    memset(row, 0, sizeof(*row) * TINYCLI_EMIT_MAX_COLUMNS);
+    for (i = first; i < end; i++) {
+        row[emit->cells[i].column] = &emit->cells[i];
+    }
+}
+
+int tinycli_table_begin(tinycli_context_t *ctx, const char *name)
+{
+    tinycli_emit_t *emit;
+    unsigned char tag = 'T';
+    int ret;
+
+    if (tinycli_invocation_abandoned()) {
+        return TINYCLI_ERROR_CANCELLED;
+    }
+
+    if (!ctx || !name || ctx->emit.in_table || ctx->emit.in_record) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+    emit = &ctx->emit;
+
+    emit->in_table = true;
+    emit->streaming = false;
+    emit->header_done = false;
+    emit->column_count = 0;
+    emit->rows = 0;
+    emit->arena_len = 0;
+    emit->cell_count = 0;
+
+    if (emit->format != TINYCLI_FORMAT_BINARY) {
+        return TINYCLI_SUCCESS;
+    }
+
+    ret = emit_put(emit, &tag, 1);
+    if (ret == TINYCLI_SUCCESS) {
+        ret = emit_put_varint(emit, strlen(name));
+    }
+    if (ret == TINYCLI_SUCCESS) {
+        ret = emit_put(emit, name, strlen(name));
+    }
+    if (ret == TINYCLI_SUCCESS) {
+        ret = tinycli_output_write(ctx, emit->arena, emit->arena_len);
+    }
+    emit->arena_len = 0;
+
+    return ret;
+}
+
+int tinycli_table_column(tinycli_context_t *ctx, const char *key, int width)
+{
+    int column;
+
+    if (tinycli_invocation_abandoned()) {
+        return TINYCLI_ERROR_CANCELLED;
+    }
+
+    if (!ctx || !key || !ctx->emit.in_table || ctx->emit.rows > 0 || ctx->emit.in_record ||
+        strlen(key) >= TINYCLI_EMIT_MAX_KEY || width < 0) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    column = emit_column(&ctx->emit, key);
+    if (column < 0) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+    ctx->emit.columns[column].width = width;
+
+    return TINYCLI_SUCCESS;
+}
+
+int tinycli_record_begin(tinycli_context_t *ctx)
+{
+    tinycli_emit_t *emit;
+    int i;
+
+    if (tinycli_invocation_abandoned()) {
+        return TINYCLI_ERROR_CANCELLED;
+    }
+
+    if (!ctx || ctx->emit.in_record) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+    emit = &ctx->emit;
+
+    /* Stream text rows when all widths but the last are known up front */
+    if (emit->in_table && emit->rows == 0 && emit->format == TINYCLI_FORMAT_TEXT) {
+        emit->streaming = emit->column_count > 0;
+        for (i = 0; i + 1 < emit->column_count; i++) {
+            int key_len = (int)strlen(emit->columns[i].key);
+
+            if (emit->columns[i].width == 0) {
+                emit->streaming = false;
+            } else if (emit->columns[i].width < key_len) {
+                emit->columns[i].width = key_len;
+            }
+        }
+    }
+
+    if (!emit->in_table) {
+        emit->column_count = 0;
+        emit->arena_len = 0;
+        emit->cell_count = 0;
+    }
+
+    emit->in_record = true;
+    emit->fields = 0;
+    emit->record_start = (uint32_t)emit->cell_count;
+
+    if (emit->format == TINYCLI_FORMAT_JSON) {
+        emit->arena_len = 0;
+        return emit_put(emit, "{", 1);
+    }
+    if (emit->format == TINYCLI_FORMAT_BINARY) {
+        emit->arena_len = 0;
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+int tinycli_record_end(tinycli_context_t *ctx)
+{
+    const tinycli_emit_cell_t *row[TINYCLI_EMIT_MAX_COLUMNS];
+    tinycli_emit_t *emit;
+    unsigned char header[11];
+    size_t i, n;
+    int width = 0, ret = TINYCLI_SUCCESS;
+
+    if (tinycli_invocation_abandoned()) {
+        return TINYCLI_ERROR_CANCELLED;
+    }
+
+    if (!ctx || !ctx->emit.in_record) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+    emit = &ctx->emit;
+    emit->in_record = false;
+
+    switch (emit->format) {
+    case TINYCLI_FORMAT_JSON:
+        ret = emit_put(emit, "}\n", 2);
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_output_write(ctx, emit->arena, emit->arena_len);
+        }
+        emit->arena_len = 0;
+        break;
+
+    case TINYCLI_FORMAT_BINARY:
+        header[0] = 'R';
+        n = 1 + emit_encode_varint(header + 1, emit->arena_len);
+        ret = tinycli_output_write(ctx, header, n);
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_output_write(ctx, emit->arena, emit->arena_len);
+        }
+        emit->arena_len = 0;
+        break;
+
+    default:
+        if (!emit->in_table) {
+            /* A lone record is printed as key: value lines */
+            for (i = 0; i < (size_t)emit->column_count; i++) {
+                int len = (int)strlen(emit->columns[i].key) + 1;
+                if (len > width) {
+                    width = len;
+                }
+            }
+            for (i = 0; i < emit->cell_count; i++) {
+                const tinycli_emit_cell_t *cell = &emit->cells[i];
+                tinycli_printf(ctx, "%s:%*s %.*s\n", emit->columns[cell->column].key,
+                               width - (int)strlen(emit->columns[cell->column].key) - 1, "",
+                               (int)cell->len, emit->arena + cell->offset);
+            }
+            emit->arena_len = 0;
+            emit->cell_count = 0;
+            emit->column_count = 0;
+        } else if (emit->streaming) {
+            if (!emit->header_done) {
+                emit_text_header(ctx);
+            }
+            emit_text_gather(emit, emit->record_start, emit->cell_count, row);
+            emit_text_row(ctx, row);
+            emit->arena_len = 0;
+            emit->cell_count = 0;
+        }
+        break;
+    }
+
+    emit->rows++;
+
+    return ret;
+}
+
+int tinycli_table_end(tinycli_context_t *ctx)
+{
+    const tinycli_emit_cell_t *row[TINYCLI_EMIT_MAX_COLUMNS];
+    tinycli_emit_t *emit;
+    unsigned char tag = 'E';
+    size_t i, first;
+    uint32_t r;
+    int ret = TINYCLI_SUCCESS;
+
+    if (tinycli_invocation_abandoned()) {
+        return TINYCLI_ERROR_CANCELLED;
+    }
+
+    if (!ctx || !ctx->emit.in_table || ctx->emit.in_record) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+    emit = &ctx->emit;
+
+    if (emit->format == TINYCLI_FORMAT_BINARY) {
+        ret = tinycli_output_write(ctx, &tag, 1);
+    } else if (emit->format == TINYCLI_FORMAT_TEXT && !emit->streaming && emit->rows > 0) {
+        /* Fit the columns to their widest values */
+        for (i = 0; i < (size_t)emit->column_count; i++) {
+            tinycli_emit_column_t *column = &emit->columns[i];
+            int key_len = (int)strlen(column->key);
+
+            if (column->width == 0) {
+                column->width = column->max > key_len ? column->max : key_len;
+            }
+        }
+        emit_text_header(ctx);
+
+        /* Cells are in row order */
+        for (r = 0, first = 0; r < emit->rows; r++) {
+            for (i = first; i < emit->cell_count && emit->cells[i].row == r; i++) {
+            }
+            emit_text_gather(emit, first, i, row);
+            emit_text_row(ctx, row);
+            first = i;
+        }
+    }
+
+    emit->in_table = false;
+    emit->streaming = false;
+    emit->column_count = 0;
+    emit->rows = 0;
+    emit->arena_len = 0;
+    emit->cell_count = 0;
+
+    return ret;
+}
@@ -0,0 +1,633 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "log.h"
+
+/*
+ * Rings live as long as their thread, which can outlive every context, and
+ * are freed by the background thread. Taking them from tinycli_malloc would
+ * make tinycli_set_allocator() fail once anything has logged, and they need
+ * a cache-line alignment the allocator's header doesn't give, so the logger
+ * allocates from the C library (like the metrics registry).
+ */
+
+/* Records are aligned to their header size, so padding at the end of a ring always fits a header */
+#define LOGGER_ALIGN 16
+
+/* Formatted text gathered before a write() */
+#define LOGGER_BATCH_SIZE (64 * 1024)
+
+/* Longest the background thread sleeps without being woken */
+#define LOGGER_IDLE_MS 1000
+
+/* Time records gather after a wakeup before they are written out */
+#define LOGGER_FLUSH_MS 50
+
+/* States of the background thread seen by producers */
+#define LOGGER_AWAKE 0                  /* Draining the rings */
+#define LOGGER_NAPPING 1                /* Letting records gather: wake only for a warning or a filling ring */
+#define LOGGER_IDLE 2                   /* The rings were empty: wake for any record */
+
+/* Message length marking padding up to the end of a ring */
+#define LOGGER_PADDING 0xffff
+
+/* Record header; the message follows */
+typedef struct {
+    uint32_t size;                  /* Bytes taken in the ring, header included */
+    uint16_t len;                   /* Message length (LOGGER_PADDING for padding) */
+    uint8_t level;                  /* Log level */
+    uint8_t reserved;
+    uint64_t time_ns;               /* Wall-clock time */
+} logger_record_t;
+
+/* Ring buffer of one thread: the owner writes tail, the background thread head */
+typedef struct logger_ring {
+    uint64_t tail;                  /* Write position */
+    uint64_t dropped;               /* Records dropped because the ring was full */
+    uint64_t unreported;            /* Drops not yet noted in the ring (owner only) */
+    uint64_t head __attribute__((aligned(64))); /* Read position */
+    uint64_t dropped_seen;          /* Drops already reported */
+    bool orphaned;                  /* The owner exited */
+    int tid;                        /* Thread id of the owner */
+    struct logger_ring *next;       /* Next ring */
+    unsigned char data[TINYCLI_LOG_RING_SIZE] __attribute__((aligned(LOGGER_ALIGN)));
+} logger_ring_t;
+
+int tinycli_log_threshold = TINYCLI_LOG_WARN;
+
+/* Level names and syslog priorities */
+static const char *const g_log_level_names[] = { "error", "warn", "info", "debug", "trace" };
+static const int g_log_priorities[] = { LOG_ERR, LOG_WARNING, LOG_INFO, LOG_DEBUG, LOG_DEBUG };
+
+/* Logger; the lock protects the ring list, the destination and the read side of the rings */
+static pthread_mutex_t g_log_lock = PTHREAD_MUTEX_INITIALIZER;
+static logger_ring_t *g_log_rings = NULL;
+static bool g_log_started = false;  /* The background thread runs */
+static bool g_log_stopping = false; /* The background thread was asked to exit */
+static pthread_t g_log_thread;
+static int g_log_fd = STDERR_FILENO; /* Destination (-1 for syslog) */
+static char g_log_target[256] = "stderr";
+static uint64_t g_log_written = 0;
+static uint64_t g_log_dropped = 0;
+
+/* Text formatted for the destination */
+static char g_log_batch[LOGGER_BATCH_SIZE];
+static size_t g_log_batch_len = 0;
+static time_t g_log_stamp_sec = (time_t)-1;
+static char g_log_stamp[32];
+
+/* Wakeup of the background thread: producers write the pipe only while it sleeps */
+static int g_log_wake[2] = { -1, -1 };
+static int g_log_sleeping = LOGGER_AWAKE;
+
+/* Ring of the calling thread */
+static pthread_once_t g_log_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_log_key;
+static __thread logger_ring_t *t_log_ring = NULL;
+
+/* Wall-clock time in nanoseconds */
+static uint64_t log_now_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+/* Wake the background thread if it sleeps and the record can't wait for the next flush */
+static void log_wake(bool urgent)
+{
+    char byte = 0;
+    ssize_t n;
+    int state;
+
+    /* Pairs with the fence in log_thread(): either it sees our record or we see it idle */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    state = __atomic_load_n(&g_log_sleeping, __ATOMIC_RELAXED);
+    if ((state == LOGGER_IDLE || (state == LOGGER_NAPPING && urgent)) &&
+        __atomic_exchange_n(&g_log_sleeping, LOGGER_AWAKE, __ATOMIC_ACQ_REL) != LOGGER_AWAKE) {
+        n = write(g_log_wake[1], &byte, 1);
+        (void)n;
+    }
+}
+
+/* Hand the ring of an exiting thread to the background thread */
+static void log_ring_detach(void *arg)
+{
+    logger_ring_t *ring = (logger_ring_t *)arg;
+
+    __atomic_store_n(&ring->orphaned, true, __ATOMIC_RELEASE);
+    t_log_ring = NULL;
+    log_wake(false);
+}
+
+/* Forget the parent's logger in a forked child; its rings belong to the parent */
+static void log_atfork_child(void)
+{
+    pthread_mutex_init(&g_log_lock, NULL);
+    g_log_rings = NULL;
+    g_log_started = false;
+    g_log_stopping = false;
+    g_log_sleeping = LOGGER_AWAKE;
+    g_log_batch_len = 0;
+    t_log_ring = NULL;
+    pthread_setspecific(g_log_key, NULL);
+
+    close(g_log_wake[0]);
+    close(g_log_wake[1]);
+    if (pipe2(g_log_wake, O_CLOEXEC | O_NONBLOCK) != 0) {
+        g_log_wake[0] = g_log_wake[1] = -1;
+    }
+}
+
+/* Create the ring key and the wakeup pipe, which live as long as the process */
+static void log_init(void)
+{
+    pthread_key_create(&g_log_key, log_ring_detach);
+    if (pipe2(g_log_wake, O_CLOEXEC | O_NONBLOCK) != 0) {
+        g_log_wake[0] = g_log_wake[1] = -1;
+    }
+    pthread_atfork(NULL, NULL, log_atfork_child);
+}
+
+/* Flush the formatted text (lock held) */
+static void log_batch_flush(void)
+{
+    size_t off = 0;
+    ssize_t n;
+
+    while (off < g_log_batch_len) {
+        n = write(g_log_fd, g_log_batch + off, g_log_batch_len - off);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        off += (size_t)n;
+    }
+    g_log_batch_len = 0;
+}
+
+/* Format one record for the destination (lock held) */
+static void log_emit(int tid, unsigned int level, uint64_t time_ns, const char *message, size_t len)
+{
+    time_t sec = (time_t)(time_ns / 1000000000);
+    struct tm tm;
+    int n;
+
+    g_log_written++;
+
+    if (g_log_fd < 0) {
+        syslog(g_log_priorities[level], "[%d] %.*s", tid, (int)len, message);
+        return;
+    }
+
+    if (g_log_batch_len + len + 64 > sizeof(g_log_batch)) {
+        log_batch_flush();
+    }
+
+    /* Consecutive records mostly share the second */
+    if (sec != g_log_stamp_sec) {
+        gmtime_r(&sec, &tm);
+        strftime(g_log_stamp, sizeof(g_log_stamp), "%Y-%m-%dT%H:%M:%S", &tm);
+        g_log_stamp_sec = sec;
+    }
+
+    n = snprintf(g_log_batch + g_log_batch_len, sizeof(g_log_batch) - g_log_batch_len,
+                 "%s.%06uZ %-5s [%d] ", g_log_stamp,
+                 (unsigned int)(time_ns % 1000000000 / 1000), g_log_level_names[level], tid);
+    if (n < 0) {
+        return;
+    }
+    g_log_batch_len += (size_t)n;
+    memcpy(g_log_batch + g_log_batch_len, message, len);
+    g_log_batch_len += len;
+    g_log_batch[g_log_batch_len++] = '\n';
+}
+
+/* Get the oldest unread record of a ring, skipping padding (lock held) */
+static logger_record_t *log_ring_peek(logger_ring_t *ring)
+{
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    logger_record_t *record;
+
+    while (ring->head < tail) {
+        record = (logger_record_t *)(ring->data + (ring->head & (TINYCLI_LOG_RING_SIZE - 1)));
+        if (record->len != LOGGER_PADDING) {
+            return record;
+        }
+        __atomic_store_n(&ring->head, ring->head + record->size, __ATOMIC_RELEASE);
+    }
+
+    return NULL;
+}
+
+/* Write out all records in time order and free the rings of exited threads (lock held) */
+static void log_drain(void)
+{
+    logger_ring_t *ring, *oldest_ring, **link;
+    logger_record_t *record, *oldest;
+    uint64_t dropped;
+
+    /* Producers note drops in their rings; only the totals are kept here */
+    for (ring = g_log_rings; ring != NULL; ring = ring->next) {
+        dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+        g_log_dropped += dropped - ring->dropped_seen;
+        ring->dropped_seen = dropped;
+    }
+
+    /* Merge the rings by time */
+    for (;;) {
+        oldest = NULL;
+        oldest_ring = NULL;
+        for (ring = g_log_rings; ring != NULL; ring = ring->next) {
+            record = log_ring_peek(ring);
+            if (record && (!oldest || record->time_ns < oldest->time_ns)) {
+                oldest = record;
+                oldest_ring = ring;
+            }
+        }
+        if (!oldest) {
+            break;
+        }
+
+        log_emit(oldest_ring->tid, oldest->level, oldest->time_ns,
+                 (const char *)(oldest + 1), oldest->len);
+        __atomic_store_n(&oldest_ring->head, oldest_ring->head + oldest->size, __ATOMIC_RELEASE);
+    }
+    log_batch_flush();
+
+    /* The owner set orphaned after its last record, so an empty orphan stays empty */
+    for (link = &g_log_rings; (ring = *link) != NULL;) {
+        if (__atomic_load_n(&ring->orphaned, __ATOMIC_ACQUIRE) && !log_ring_peek(ring)) {
+            *link = ring->next;
+            free(ring);
+        } else {
+            link = &ring->next;
+        }
+    }
+}
+
+/* Check whether there is anything to write out or free (lock held) */
+static bool log_pending(void)
+{
+    logger_ring_t *ring;
+
+    for (ring = g_log_rings; ring != NULL; ring = ring->next) {
+        if (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) != ring->head ||
+            __atomic_load_n(&ring->orphaned, __ATOMIC_ACQUIRE)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Consume pending wakeups */
+static void log_wake_drain(void)
+{
+    char buf[64];
+
+    while (read(g_log_wake[0], buf, sizeof(buf)) > 0) {
+    }
+}
+
+/* Background thread: drain the rings, then sleep until a producer wakes it */
+static void *log_thread(void *arg)
+{
+    struct pollfd pfd;
+    bool pending;
+
+    (void)arg;
+
+    pfd.fd = g_log_wake[0];
+    pfd.events = POLLIN;
+
+    for (;;) {
+        pthread_mutex_lock(&g_log_lock);
+        log_drain();
+        pthread_mutex_unlock(&g_log_lock);
+        if (__atomic_load_n(&g_log_stopping, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+
+        /* Announce the sleep, then look once more for records published meanwhile */
+        __atomic_store_n(&g_log_sleeping, LOGGER_IDLE, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        pthread_mutex_lock(&g_log_lock);
+        pending = log_pending();
+        pthread_mutex_unlock(&g_log_lock);
+        if (!pending && !__atomic_load_n(&g_log_stopping, __ATOMIC_ACQUIRE)) {
+            poll(&pfd, 1, LOGGER_IDLE_MS);
+        }
+        log_wake_drain();
+
+        /* Let a burst gather, so its producers don't each pay for a wakeup */
+        __atomic_store_n(&g_log_sleeping, LOGGER_NAPPING, __ATOMIC_RELAXED);
+        if (!__atomic_load_n(&g_log_stopping, __ATOMIC_ACQUIRE)) {
+            poll(&pfd, 1, LOGGER_FLUSH_MS);
+        }
+        __atomic_store_n(&g_log_sleeping, LOGGER_AWAKE, __ATOMIC_RELAXED);
+        log_wake_drain();
+    }
+
+    return NULL;
+}
+
+/* Start the background thread (lock held) */
+static int log_start(void)
+{
+    sigset_t all, old;
+    int ret;
+
+    if (g_log_wake[0] < 0) {
+        return TINYCLI_ERROR_GENERAL;
+    }
+
+    /* Signals are for the threads running commands */
+    __atomic_store_n(&g_log_stopping, false, __ATOMIC_RELEASE);
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    ret = pthread_create(&g_log_thread, NULL, log_thread, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (ret != 0) {
+        return TINYCLI_ERROR_GENERAL;
+    }
+    __atomic_store_n(&g_log_started, true, __ATOMIC_RELEASE);
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Get the ring of the calling thread, making sure something drains it */
+static logger_ring_t *log_ring_get(void)
+{
+    logger_ring_t *ring = t_log_ring;
+    void *mem;
+
+    pthread_once(&g_log_once, log_init);
+
+    if (!ring) {
+        if (posix_memalign(&mem, 64, sizeof(logger_ring_t)) != 0) {
+            return NULL;
+        }
+        ring = (logger_ring_t *)mem;
+        memset(ring, 0, offsetof(logger_ring_t, data));
+#ifdef __linux__
+        ring->tid = (int)syscall(SYS_gettid);
+#else
+        ring->tid = (int)getpid();
+#endif
+    }
+
+    pthread_mutex_lock(&g_log_lock);
+    if (!g_log_started && log_start() != TINYCLI_SUCCESS) {
+        pthread_mutex_unlock(&g_log_lock);
+        if (ring != t_log_ring) {
+            free(ring);
+        }
+        return NULL;
+    }
+    if (ring != t_log_ring) {
+        ring->next = g_log_rings;
+        g_log_rings = ring;
+        t_log_ring = ring;
+        pthread_setspecific(g_log_key, ring);
+    }
+    pthread_mutex_unlock(&g_log_lock);
+
+    return ring;
+}
+
+/* Copy a record into the ring of the calling thread; false if it is full */
+static bool log_ring_put(logger_ring_t *ring, unsigned int level, uint64_t time_ns,
+                         const char *message, size_t len, bool *urgent)
+{
+    logger_record_t *record;
+    uint64_t tail, head, pos, room, size;
+
+    /* Reserve contiguous space, padding out the end of the ring if needed */
+    size = (sizeof(logger_record_t) + len + LOGGER_ALIGN - 1) & ~(uint64_t)(LOGGER_ALIGN - 1);
+    tail = ring->tail;
+    head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    pos = tail & (TINYCLI_LOG_RING_SIZE - 1);
+    room = TINYCLI_LOG_RING_SIZE - pos;
+    if (tail + size + (room < size ? room : 0) - head > TINYCLI_LOG_RING_SIZE) {
+        return false;
+    }
+    if (room < size) {
+        record = (logger_record_t *)(ring->data + pos);
+        record->size = (uint32_t)room;
+        record->len = LOGGER_PADDING;
+        tail += room;
+        pos = 0;
+    }
+
+    record = (logger_record_t *)(ring->data + pos);
+    record->size = (uint32_t)size;
+    record->len = (uint16_t)len;
+    record->level = (uint8_t)level;
+    record->time_ns = time_ns;
+    memcpy(record + 1, message, len);
+    __atomic_store_n(&ring->tail, tail + size, __ATOMIC_RELEASE);
+
+    /* Get the ring drained before it fills up */
+    if (tail + size - head > TINYCLI_LOG_RING_SIZE / 2) {
+        *urgent = true;
+    }
+
+    return true;
+}
+
+void tinycli_log_write(tinycli_log_level_t level, const char *fmt, ...)
+{
+    char message[TINYCLI_LOG_MAX_MESSAGE], note[64];
+    logger_ring_t *ring = t_log_ring;
+    bool urgent = level <= TINYCLI_LOG_WARN;
+    uint64_t time_ns;
+    va_list args;
+    int n;
+
+    if ((unsigned int)level > TINYCLI_LOG_TRACE || !fmt) {
+        return;
+    }
+    if (!ring || !__atomic_load_n(&g_log_started, __ATOMIC_ACQUIRE)) {
+        ring = log_ring_get();
+        if (!ring) {
+            return;
+        }
+    }
+
+    va_start(args, fmt);
+    n = vsnprintf(message, sizeof(message), fmt, args);
+    va_end(args);
+    if (n < 0) {
+        return;
+    }
+    if ((size_t)n >= sizeof(message)) {
+        n = (int)sizeof(message) - 1;
+    }
+    if (n > 0 && message[n - 1] == '\n') {
+        n--;
+    }
+    time_ns = log_now_ns();
+
+    /* Drops are noted in place, between the records around them */
+    if (ring->unreported) {
+        int len = snprintf(note, sizeof(note), "%llu log records dropped",
+                           (unsigned long long)ring->unreported);
+        if (log_ring_put(ring, TINYCLI_LOG_WARN, time_ns, note, (size_t)len, &urgent)) {
+            ring->unreported = 0;
+        }
+    }
+    if (ring->unreported || !log_ring_put(ring, level, time_ns, message, (size_t)n, &urgent)) {
+        ring->unreported++;
+        __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+        urgent = true;
+    }
+
+    log_wake(urgent);
+}
+
+int tinycli_log_set_level(tinycli_log_level_t level)
+{
+    if ((unsigned int)level > TINYCLI_LOG_TRACE) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    __atomic_store_n(&tinycli_log_threshold, (int)level, __ATOMIC_RELAXED);
+
+    return TINYCLI_SUCCESS;
+}
+
+int tinycli_log_open(const char *target)
+{
+    int fd, old_fd;
+
+    if (!target || strlen(target) >= sizeof(g_log_target)) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (strcmp(target, "stderr") == 0) {
+        fd = STDERR_FILENO;
+    } else if (strcmp(target, "syslog") == 0) {
+        fd = -1;
+        openlog("tinycli", LOG_PID, LOG_USER);
+    } else {
+        fd = open(target, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return TINYCLI_ERROR_GENERAL;
+        }
+    }
+
+    /* Earlier records go to the old destination */
+    pthread_mutex_lock(&g_log_lock);
+    log_drain();
+    old_fd = g_log_fd;
+    g_log_fd = fd;
+    strcpy(g_log_target, target);
+    pthread_mutex_unlock(&g_log_lock);
+
+    if (old_fd > STDERR_FILENO) {
+        close(old_fd);
+    } else if (old_fd < 0 && fd >= 0) {
+        closelog();
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+void tinycli_log_flush(void)
+{
+    pthread_mutex_lock(&g_log_lock);
+    log_drain();
+    pthread_mutex_unlock(&g_log_lock);
+}
+
+void tinycli_log_close(void)
+{
+    char byte = 0;
+    ssize_t n;
+
+    pthread_mutex_lock(&g_log_lock);
+    if (!g_log_started || g_log_stopping) {
+        pthread_mutex_unlock(&g_log_lock);
+        return;
+    }
+    __atomic_store_n(&g_log_stopping, true, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&g_log_lock);
+
+    n = write(g_log_wake[1], &byte, 1);
+    (void)n;
+    pthread_join(g_log_thread, NULL);
+
+    /* Records logged while the thread stopped */
+    pthread_mutex_lock(&g_log_lock);
+    log_drain();
+    __atomic_store_n(&g_log_started, false, __ATOMIC_RELEASE);
+    __atomic_store_n(&g_log_stopping, false, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&g_log_lock);
+}
+
+int tinycli_log_level_parse(const char *name, tinycli_log_level_t *level)
+{
+    int i;
+
+    if (!name || !level) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    for (i = 0; i <= TINYCLI_LOG_TRACE; i++) {
+        if (strcmp(name, g_log_level_names[i]) == 0) {
+            *level = (tinycli_log_level_t)i;
+            return TINYCLI_SUCCESS;
+        }
+    }
+
+    return TINYCLI_ERROR_INVALID_ARGUMENT;
+}
+
+const char *tinycli_log_level_name(tinycli_log_level_t level)
+{
+    if ((unsigned int)level > TINYCLI_LOG_TRACE) {
+        return "unknown";
+    }
+
+    return g_log_level_names[level];
+}
+
+void tinycli_log_get_status(tinycli_log_status_t *status)
+{
+    logger_ring_t *ring;
+
+    if (!status) {
+        return;
+    }
+
+    pthread_mutex_lock(&g_log_lock);
+    status->level = (tinycli_log_level_t)__atomic_load_n(&tinycli_log_threshold, __ATOMIC_RELAXED);
+    strcpy(status->target, g_log_target);
+    status->written = g_log_written;
+    status->dropped = g_log_dropped;
+    status->threads = 0;
+    for (ring = g_log_rings; ring != NULL; ring = ring->next) {
+        status->threads++;
+    }
+    pthread_mutex_unlock(&g_log_lock);
+}
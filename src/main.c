@@ -9,22 +9,262 @@
 #include "command.h"
 #include "plugin.h"
 #include "utils.h"
+#include "session.h"
+#include "server.h"
+#include "script.h"
+#include "emit.h"
+#include "log.h"
 
 /* Global context for signal handlers */
 static tinycli_context_t *g_ctx = NULL;
 
+/* Global server for signal handlers */
+static tinycli_server_t *g_server = NULL;
+
+/* Time a cancelled command gets to return before it is abandoned */
+#define MAIN_CANCEL_GRACE_MS 2000
+
+/* Time between rewrites of the metrics file */
+#define MAIN_METRICS_INTERVAL_MS 15000
+
 /* Signal handler */
 static void signal_handler(int sig)
 {
-    if (g_ctx && sig == SIGINT) {
-        printf("\n");
+    if (g_server) {
+        tinycli_server_stop(g_server);
+    } else if (g_ctx && sig == SIGINT) {
+        /* Cancel the running command, or just start a new line at the prompt */
+        if (tinycli_cancel(g_ctx) != TINYCLI_SUCCESS) {
+            ssize_t n = write(STDOUT_FILENO, "\n", 1);
+            (void)n;
+        }
     }
 }
 
-int main(int argc, char **argv)
+/* Print usage */
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [--format text|json|binary] [--record <log>] [--isolate <N>]\n", prog);
+    fprintf(stderr, "       %s --replay <log> [--speed <N>x|max] [--concurrency <K>]\n", prog);
+    fprintf(stderr, "       %s --listen <socket>\n", prog);
+    fprintf(stderr, "       %s [--format text|json|binary] --script <file> [args]\n", prog);
+    fprintf(stderr, "Metrics can be exported in any mode with [--metrics-file <path>] "
+                    "[--metrics-socket <socket>]\n");
+    fprintf(stderr, "Logging is set up in any mode with [--log stderr|syslog|<file>] "
+                    "[--log-level error|warn|info|debug|trace]\n");
+}
+
+/* Start exporting metrics, and stop when the process exits */
+static int export_metrics(const char *file, const char *socket_path)
+{
+    static bool registered = false;
+    int ret;
+
+    if (!registered) {
+        atexit(tinycli_metrics_export_stop);
+        registered = true;
+    }
+
+    ret = file ? tinycli_metrics_export_file(file, MAIN_METRICS_INTERVAL_MS) :
+                 tinycli_metrics_export_socket(socket_path);
+    if (ret != TINYCLI_SUCCESS) {
+        fprintf(stderr, "Error: Failed to export metrics to %s\n", file ? file : socket_path);
+    }
+
+    return ret;
+}
+
+/* Serve clients on a Unix socket until interrupted */
+static int serve(const char *path)
+{
+    tinycli_server_t *server;
+    int ret;
+
+    server = tinycli_server_create(NULL, path);
+    if (!server) {
+        fprintf(stderr, "Error: Failed to listen on %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    g_server = server;
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    printf("Listening on %s\n", path);
+    fflush(stdout);
+    ret = tinycli_server_run(server);
+
+    g_server = NULL;
+    tinycli_server_destroy(server);
+
+    return ret == TINYCLI_SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Run a script and exit with its result */
+static int run_script(tinycli_output_format_t format, int argc, char **argv)
 {
     tinycli_context_t *ctx;
+    tinycli_script_t *script;
+    char error[256];
     int ret;
+
+    ret = tinycli_script_load(argv[0], &script, error, sizeof(error));
+    if (ret != TINYCLI_SUCCESS) {
+        fprintf(stderr, "Error: Failed to load script %s: %s\n", argv[0], error);
+        return EXIT_FAILURE;
+    }
+
+    ctx = tinycli_init("tinycli> ");
+    if (!ctx) {
+        fprintf(stderr, "Error: Failed to initialize TinyCLI\n");
+        tinycli_script_free(script);
+        return EXIT_FAILURE;
+    }
+
+    tinycli_set_output_format(ctx, format);
+    ret = tinycli_script_run(ctx, script, argc, argv);
+    tinycli_output_flush(ctx);
+    tinycli_script_free(script);
+    tinycli_cleanup(ctx);
+
+    return ret == TINYCLI_SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Load the alias startup file ($TINYCLI_ALIASES or ~/.tinycli_aliases) */
+static void load_aliases(tinycli_context_t *ctx)
+{
+    const char *path = getenv("TINYCLI_ALIASES");
+    const char *home = getenv("HOME");
+    char buffer[4096];
+
+    if (!path) {
+        if (!home || !tinycli_path_join(home, ".tinycli_aliases", buffer, sizeof(buffer))) {
+            return;
+        }
+        path = buffer;
+    }
+
+    if (tinycli_load_aliases(ctx, path) != TINYCLI_SUCCESS) {
+        fprintf(stderr, "Warning: Failed to load aliases from %s\n", path);
+    }
+    tinycli_output_flush(ctx);
+}
+
+/* Replay a session log and print the report */
+static int replay(const char *path, const tinycli_replay_options_t *options)
+{
+    tinycli_replay_report_t report;
+    int ret;
+
+    ret = tinycli_session_replay(path, options, &report);
+    if (ret != TINYCLI_SUCCESS) {
+        fprintf(stderr, "Error: Failed to replay %s (error code %d)\n", path, ret);
+        return EXIT_FAILURE;
+    }
+
+    printf("Commands:    %llu (%u contexts)\n",
+           (unsigned long long)report.commands, options->concurrency);
+    printf("Errors:      %llu\n", (unsigned long long)report.errors);
+    printf("Mismatches:  %llu\n", (unsigned long long)report.mismatches);
+    printf("Elapsed:     %.3f s\n", report.elapsed);
+    printf("Throughput:  %.0f commands/s\n", report.throughput);
+    printf("Latency:     p50 %.1f us, p90 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n",
+           report.p50_ns / 1e3, report.p90_ns / 1e3, report.p99_ns / 1e3,
+           report.p999_ns / 1e3, report.max_ns / 1e3);
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+    tinycli_context_t *ctx;
+    tinycli_replay_options_t options = { 1.0, 1, NULL };
+    struct sigaction action;
+    tinycli_output_format_t format = TINYCLI_FORMAT_TEXT;
+    const char *record_path = NULL;
+    const char *replay_path = NULL;
+    const char *listen_path = NULL;
+    unsigned int isolate = 0;
+    int i, ret;
+
+    /* Write out pending log records on the way out */
+    atexit(tinycli_log_close);
+
+    /* Parse options */
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (strcmp(argv[i], "--listen") == 0 && i + 1 < argc) {
+            listen_path = argv[++i];
+        } else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc) {
+            /* The remaining arguments belong to the script */
+            return run_script(format, argc - i - 1, argv + i + 1);
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            if (tinycli_output_format_parse(argv[++i], &format) != TINYCLI_SUCCESS) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+            char *end;
+            i++;
+            if (strcmp(argv[i], "max") == 0) {
+                options.speed = 0;
+            } else {
+                options.speed = strtod(argv[i], &end);
+                if (end == argv[i] || (*end != '\0' && strcmp(end, "x") != 0) ||
+                    options.speed <= 0) {
+                    usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+            }
+        } else if (strcmp(argv[i], "--concurrency") == 0 && i + 1 < argc) {
+            int value = atoi(argv[++i]);
+            if (value <= 0) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            options.concurrency = (unsigned int)value;
+        } else if (strcmp(argv[i], "--metrics-file") == 0 && i + 1 < argc) {
+            if (export_metrics(argv[++i], NULL) != TINYCLI_SUCCESS) {
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--metrics-socket") == 0 && i + 1 < argc) {
+            if (export_metrics(NULL, argv[++i]) != TINYCLI_SUCCESS) {
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--log") == 0 && i + 1 < argc) {
+            if (tinycli_log_open(argv[++i]) != TINYCLI_SUCCESS) {
+                fprintf(stderr, "Error: Failed to open log %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+            tinycli_log_level_t level;
+            if (tinycli_log_level_parse(argv[++i], &level) != TINYCLI_SUCCESS) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            tinycli_log_set_level(level);
+        } else if (strcmp(argv[i], "--isolate") == 0 && i + 1 < argc) {
+            int value = atoi(argv[++i]);
+            if (value <= 0) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            isolate = (unsigned int)value;
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (replay_path) {
+        return replay(replay_path, &options);
+    }
+    if (listen_path) {
+        return serve(listen_path);
+    }
     
     /* Initialize TinyCLI */
     ctx = tinycli_init("tinycli> ");
@@ -33,9 +273,34 @@ int main(int argc, char **argv)
         return EXIT_FAILURE;
     }
 
-    /* Set global context for signal handlers */
+    /* Load aliases */
+    load_aliases(ctx);
+    tinycli_set_output_format(ctx, format);
+
+    /* Start recording */
+    if (record_path && tinycli_session_record_start(ctx, record_path) != TINYCLI_SUCCESS) {
+        fprintf(stderr, "Error: Failed to open session log %s\n", record_path);
+        tinycli_cleanup(ctx);
+        return EXIT_FAILURE;
+    }
+
+    /* Run commands on a worker so Ctrl-C can abandon a runaway one */
+    tinycli_set_cancel_grace(ctx, MAIN_CANCEL_GRACE_MS);
+
+    /* Run plugin commands in worker processes so a crash can't take the shell down */
+    if (isolate && tinycli_set_isolation(ctx, isolate) != TINYCLI_SUCCESS) {
+        fprintf(stderr, "Error: Failed to start %u worker processes\n", isolate);
+        tinycli_cleanup(ctx);
+        return EXIT_FAILURE;
+    }
+
+    /* Set global context for signal handlers; no SA_RESTART, so Ctrl-C
+       interrupts blocking calls in commands */
     g_ctx = ctx;
-    signal(SIGINT, signal_handler);
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = signal_handler;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
 
     /* Print welcome message */
     printf("TinyCLI v%d.%d.%d\n", 
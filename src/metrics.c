@@ -0,0 +1,993 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "metrics.h"
+#include "output.h"
+#include "utils.h"
+
+/*
+ * The registry outlives contexts and allocator changes, so it allocates
+ * from the C library rather than through tinycli_malloc.
+ */
+
+/* Slots per shard chunk */
+#define METRICS_CHUNK_SLOTS 1024
+
+/* Maximum number of chunks per shard (65536 slots) */
+#define METRICS_CHUNKS 64
+
+/* Initial size of the series hash table */
+#define METRICS_HASH_INITIAL 64
+
+/* Initial size of the rendered text */
+#define METRICS_TEXT_INITIAL 4096
+
+/* Time a socket client gets to send its request */
+#define METRICS_REQUEST_MS 1000
+
+/* Pending socket connections queued by the kernel */
+#define METRICS_BACKLOG 16
+
+/* Histogram slots: one per finite bucket, +Inf, then the sum in nanoseconds */
+#define METRICS_HISTOGRAM_SLOTS (TINYCLI_METRICS_BUCKETS + 2)
+
+/* Metric types */
+typedef enum {
+    METRIC_COUNTER,
+    METRIC_GAUGE,
+    METRIC_HISTOGRAM
+} metric_type_t;
+
+/* Type names in the text format */
+static const char *const g_metric_type_names[] = { "counter", "gauge", "histogram" };
+
+/* Upper bounds of the histogram buckets */
+static const uint64_t g_metric_bucket_ns[TINYCLI_METRICS_BUCKETS] = {
+    100000ULL, 500000ULL, 1000000ULL, 5000000ULL, 10000000ULL, 50000000ULL,
+    100000000ULL, 500000000ULL, 1000000000ULL, 5000000000ULL, 10000000000ULL
+};
+
+/* Upper bounds of the histogram buckets in seconds, as exported */
+static const char *const g_metric_bucket_le[TINYCLI_METRICS_BUCKETS] = {
+    "0.0001", "0.0005", "0.001", "0.005", "0.01", "0.05", "0.1", "0.5", "1", "5", "10"
+};
+
+/* Metric family */
+typedef struct metrics_family {
+    char *name;                     /* Family name */
+    char *help;                     /* Help text, escaped */
+    metric_type_t type;             /* Metric type */
+    tinycli_metric_t *series;       /* First series */
+    tinycli_metric_t **tail;        /* Link of the next series */
+    struct metrics_family *next;    /* Next family, in registration order */
+} metrics_family_t;
+
+/* Series of a family */
+struct tinycli_metric {
+    metrics_family_t *family;       /* Family */
+    char *labels;                   /* Label pairs ("" for none) */
+    uint32_t hash;                  /* Hash of the name and labels */
+    uint32_t slot;                  /* First shard slot (counters and histograms) */
+    int64_t value;                  /* Value (gauges) */
+    tinycli_metric_t *hash_next;    /* Next series in the hash bucket */
+    tinycli_metric_t *next;         /* Next series of the family */
+};
+
+/* Slots of one thread; only the owner writes them */
+typedef struct metrics_shard {
+    uint64_t *chunks[METRICS_CHUNKS]; /* Slot chunks, allocated on first use */
+    struct metrics_shard *prev;     /* Previous shard */
+    struct metrics_shard *next;     /* Next shard */
+} metrics_shard_t;
+
+/* Registry; the lock protects everything but gauge values and shard slots */
+static pthread_mutex_t g_metrics_lock = PTHREAD_MUTEX_INITIALIZER;
+static metrics_family_t *g_metrics_families = NULL;
+static metrics_family_t **g_metrics_families_tail = &g_metrics_families;
+static tinycli_metric_t **g_metrics_hash = NULL;
+static size_t g_metrics_hash_size = 0;
+static size_t g_metrics_count = 0;
+static uint32_t g_metrics_slots = 0;
+static metrics_shard_t *g_metrics_shards = NULL;
+static uint64_t *g_metrics_retired[METRICS_CHUNKS]; /* Slots of exited threads */
+
+/* Shard of the calling thread */
+static pthread_once_t g_metrics_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_metrics_key;
+static __thread metrics_shard_t *t_metrics_shard = NULL;
+
+/* Metrics maintained by the framework */
+static pthread_once_t g_metrics_builtin_once = PTHREAD_ONCE_INIT;
+static tinycli_metrics_builtin_t g_metrics_builtin;
+
+/* Exporter thread and its configuration (protected by the lock; fixed while running) */
+static pthread_mutex_t g_export_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool g_export_running = false;
+static pthread_t g_export_thread;
+static int g_export_wake[2] = { -1, -1 };
+static char *g_export_file = NULL;
+static unsigned int g_export_interval_ms = 0;
+static char *g_export_socket_path = NULL;
+static int g_export_listen_fd = -1;
+
+/* Growable text buffer */
+typedef struct {
+    char *data;                     /* Text */
+    size_t len;                     /* Length of the text */
+    size_t cap;                     /* Capacity of data */
+    bool failed;                    /* An allocation failed */
+} metrics_text_t;
+
+/* Fold the slots of an exiting thread into the totals and free its shard */
+static void shard_detach(void *arg)
+{
+    metrics_shard_t *shard = (metrics_shard_t *)arg;
+    size_t c, i;
+
+    pthread_mutex_lock(&g_metrics_lock);
+    for (c = 0; c < METRICS_CHUNKS; c++) {
+        if (!shard->chunks[c]) {
+            continue;
+        }
+        if (!g_metrics_retired[c]) {
+            g_metrics_retired[c] = (uint64_t *)calloc(METRICS_CHUNK_SLOTS, sizeof(uint64_t));
+        }
+        if (g_metrics_retired[c]) {
+            for (i = 0; i < METRICS_CHUNK_SLOTS; i++) {
+                g_metrics_retired[c][i] += shard->chunks[c][i];
+            }
+        }
+    }
+    if (shard->prev) {
+        shard->prev->next = shard->next;
+    } else {
+        g_metrics_shards = shard->next;
+    }
+    if (shard->next) {
+        shard->next->prev = shard->prev;
+    }
+    pthread_mutex_unlock(&g_metrics_lock);
+
+    for (c = 0; c < METRICS_CHUNKS; c++) {
+        free(shard->chunks[c]);
+    }
+    free(shard);
+    t_metrics_shard = NULL;
+}
+
+/* Create the key whose destructor detaches shards */
+static void shard_key_create(void)
+{
+    pthread_key_create(&g_metrics_key, shard_detach);
+}
+
+/* Give the calling thread a shard */
+static metrics_shard_t *shard_attach(void)
+{
+    metrics_shard_t *shard;
+
+    pthread_once(&g_metrics_key_once, shard_key_create);
+
+    shard = (metrics_shard_t *)calloc(1, sizeof(*shard));
+    if (!shard) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&g_metrics_lock);
+    shard->next = g_metrics_shards;
+    if (g_metrics_shards) {
+        g_metrics_shards->prev = shard;
+    }
+    g_metrics_shards = shard;
+    pthread_mutex_unlock(&g_metrics_lock);
+
+    pthread_setspecific(g_metrics_key, shard);
+    t_metrics_shard = shard;
+
+    return shard;
+}
+
+/* Get the calling thread's copy of a slot (and the ones after it in the chunk) */
+static uint64_t *shard_slots(uint32_t slot)
+{
+    metrics_shard_t *shard = t_metrics_shard;
+    uint64_t *chunk;
+
+    if (!shard && !(shard = shard_attach())) {
+        return NULL;
+    }
+
+    chunk = shard->chunks[slot / METRICS_CHUNK_SLOTS];
+    if (!chunk) {
+        chunk = (uint64_t *)calloc(METRICS_CHUNK_SLOTS, sizeof(uint64_t));
+        if (!chunk) {
+            return NULL;
+        }
+        __atomic_store_n(&shard->chunks[slot / METRICS_CHUNK_SLOTS], chunk, __ATOMIC_RELEASE);
+    }
+
+    return chunk + slot % METRICS_CHUNK_SLOTS;
+}
+
+/* Add to a slot of the calling thread: a plain load and store, no read-modify-write */
+static inline void slot_add(uint64_t *slot, uint64_t value)
+{
+    __atomic_store_n(slot, *slot + value, __ATOMIC_RELAXED);
+}
+
+/* Sum a slot over all threads (lock held) */
+static uint64_t slot_sum(uint32_t slot)
+{
+    size_t c = slot / METRICS_CHUNK_SLOTS, i = slot % METRICS_CHUNK_SLOTS;
+    metrics_shard_t *shard;
+    uint64_t sum = g_metrics_retired[c] ? g_metrics_retired[c][i] : 0, *chunk;
+
+    for (shard = g_metrics_shards; shard != NULL; shard = shard->next) {
+        chunk = __atomic_load_n(&shard->chunks[c], __ATOMIC_ACQUIRE);
+        if (chunk) {
+            sum += __atomic_load_n(&chunk[i], __ATOMIC_RELAXED);
+        }
+    }
+
+    return sum;
+}
+
+/* Check a family name against the text format */
+static bool metric_name_valid(const char *name)
+{
+    const char *p;
+
+    if (!name || !*name || (*name >= '0' && *name <= '9')) {
+        return false;
+    }
+    for (p = name; *p; p++) {
+        if (!((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') ||
+              (*p >= '0' && *p <= '9') || *p == '_' || *p == ':')) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Copy a help text with the escapes of the text format */
+static char *metric_help_escape(const char *help)
+{
+    const char *p;
+    char *copy, *q;
+
+    copy = (char *)malloc(strlen(help) * 2 + 1);
+    if (!copy) {
+        return NULL;
+    }
+    for (p = help, q = copy; *p; p++) {
+        if (*p == '\\' || *p == '\n') {
+            *q++ = '\\';
+            *q++ = *p == '\n' ? 'n' : '\\';
+        } else {
+            *q++ = *p;
+        }
+    }
+    *q = '\0';
+
+    return copy;
+}
+
+/* Double the series hash table (lock held) */
+static int metrics_hash_grow(void)
+{
+    size_t size = g_metrics_hash_size ? g_metrics_hash_size * 2 : METRICS_HASH_INITIAL, i;
+    tinycli_metric_t **hash, *metric, *next;
+
+    hash = (tinycli_metric_t **)calloc(size, sizeof(*hash));
+    if (!hash) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+    for (i = 0; i < g_metrics_hash_size; i++) {
+        for (metric = g_metrics_hash[i]; metric != NULL; metric = next) {
+            next = metric->hash_next;
+            metric->hash_next = hash[metric->hash & (size - 1)];
+            hash[metric->hash & (size - 1)] = metric;
+        }
+    }
+    free(g_metrics_hash);
+    g_metrics_hash = hash;
+    g_metrics_hash_size = size;
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Find a family by name (lock held) */
+static metrics_family_t *metrics_family_find(const char *name)
+{
+    metrics_family_t *family;
+
+    for (family = g_metrics_families; family != NULL; family = family->next) {
+        if (strcmp(family->name, name) == 0) {
+            return family;
+        }
+    }
+
+    return NULL;
+}
+
+/* Add a family (lock held) */
+static metrics_family_t *metrics_family_add(metric_type_t type, const char *name, const char *help)
+{
+    metrics_family_t *family;
+
+    family = (metrics_family_t *)calloc(1, sizeof(*family));
+    if (!family) {
+        return NULL;
+    }
+    family->name = strdup(name);
+    family->help = metric_help_escape(help ? help : "");
+    if (!family->name || !family->help) {
+        free(family->name);
+        free(family->help);
+        free(family);
+        return NULL;
+    }
+    family->type = type;
+    family->tail = &family->series;
+
+    *g_metrics_families_tail = family;
+    g_metrics_families_tail = &family->next;
+
+    return family;
+}
+
+/* Register a series, or find it if it exists */
+static tinycli_metric_t *metric_register(metric_type_t type, const char *name,
+                                         const char *help, const char *labels)
+{
+    metrics_family_t *family;
+    tinycli_metric_t *metric;
+    uint32_t hash, slot, nslots;
+
+    if (!metric_name_valid(name)) {
+        return NULL;
+    }
+    if (!labels) {
+        labels = "";
+    }
+    hash = tinycli_hash(name, strlen(name)) * 16777619u ^ tinycli_hash(labels, strlen(labels));
+    nslots = type == METRIC_COUNTER ? 1 : type == METRIC_HISTOGRAM ? METRICS_HISTOGRAM_SLOTS : 0;
+
+    pthread_mutex_lock(&g_metrics_lock);
+
+    /* Known series */
+    if (g_metrics_hash) {
+        for (metric = g_metrics_hash[hash & (g_metrics_hash_size - 1)]; metric != NULL;
+             metric = metric->hash_next) {
+            if (metric->hash == hash && strcmp(metric->family->name, name) == 0 &&
+                strcmp(metric->labels, labels) == 0) {
+                pthread_mutex_unlock(&g_metrics_lock);
+                return metric->family->type == type ? metric : NULL;
+            }
+        }
+    }
+
+    family = metrics_family_find(name);
+    if (family && family->type != type) {
+        pthread_mutex_unlock(&g_metrics_lock);
+        return NULL;
+    }
+
+    /* The slots of a series share a chunk, so one lookup finds them all */
+    slot = g_metrics_slots;
+    if (nslots && slot % METRICS_CHUNK_SLOTS + nslots > METRICS_CHUNK_SLOTS) {
+        slot += METRICS_CHUNK_SLOTS - slot % METRICS_CHUNK_SLOTS;
+    }
+    if ((size_t)slot + nslots > (size_t)METRICS_CHUNK_SLOTS * METRICS_CHUNKS ||
+        (g_metrics_count >= g_metrics_hash_size && metrics_hash_grow() != TINYCLI_SUCCESS)) {
+        pthread_mutex_unlock(&g_metrics_lock);
+        return NULL;
+    }
+
+    if (!family && !(family = metrics_family_add(type, name, help))) {
+        pthread_mutex_unlock(&g_metrics_lock);
+        return NULL;
+    }
+
+    metric = (tinycli_metric_t *)calloc(1, sizeof(*metric));
+    if (!metric || !(metric->labels = strdup(labels))) {
+        free(metric);
+        pthread_mutex_unlock(&g_metrics_lock);
+        return NULL;
+    }
+    metric->family = family;
+    metric->hash = hash;
+    metric->slot = slot;
+    g_metrics_slots = slot + nslots;
+
+    *family->tail = metric;
+    family->tail = &metric->next;
+    metric->hash_next = g_metrics_hash[hash & (g_metrics_hash_size - 1)];
+    g_metrics_hash[hash & (g_metrics_hash_size - 1)] = metric;
+    g_metrics_count++;
+
+    pthread_mutex_unlock(&g_metrics_lock);
+
+    return metric;
+}
+
+tinycli_metric_t *tinycli_metric_counter(const char *name, const char *help, const char *labels)
+{
+    return metric_register(METRIC_COUNTER, name, help, labels);
+}
+
+tinycli_metric_t *tinycli_metric_gauge(const char *name, const char *help, const char *labels)
+{
+    return metric_register(METRIC_GAUGE, name, help, labels);
+}
+
+tinycli_metric_t *tinycli_metric_histogram(const char *name, const char *help, const char *labels)
+{
+    return metric_register(METRIC_HISTOGRAM, name, help, labels);
+}
+
+void tinycli_metric_inc(tinycli_metric_t *metric, uint64_t value)
+{
+    uint64_t *slot;
+
+    if (!metric) {
+        return;
+    }
+
+    if (metric->family->type == METRIC_GAUGE) {
+        __atomic_add_fetch(&metric->value, (int64_t)value, __ATOMIC_RELAXED);
+    } else if (metric->family->type == METRIC_COUNTER && (slot = shard_slots(metric->slot)) != NULL) {
+        slot_add(slot, value);
+    }
+}
+
+void tinycli_metric_set(tinycli_metric_t *metric, int64_t value)
+{
+    if (metric && metric->family->type == METRIC_GAUGE) {
+        __atomic_store_n(&metric->value, value, __ATOMIC_RELAXED);
+    }
+}
+
+void tinycli_metric_add(tinycli_metric_t *metric, int64_t delta)
+{
+    if (metric && metric->family->type == METRIC_GAUGE) {
+        __atomic_add_fetch(&metric->value, delta, __ATOMIC_RELAXED);
+    }
+}
+
+void tinycli_metric_observe_ns(tinycli_metric_t *metric, uint64_t ns)
+{
+    uint64_t *slots;
+    int b;
+
+    if (!metric || metric->family->type != METRIC_HISTOGRAM ||
+        (slots = shard_slots(metric->slot)) == NULL) {
+        return;
+    }
+
+    for (b = 0; b < TINYCLI_METRICS_BUCKETS && ns > g_metric_bucket_ns[b]; b++) {
+    }
+    slot_add(&slots[b], 1);
+    slot_add(&slots[TINYCLI_METRICS_BUCKETS + 1], ns);
+}
+
+char *tinycli_metric_label(const char *key, const char *value, char *buffer, size_t size)
+{
+    size_t pos;
+    int n;
+
+    if (!key || !value || !buffer) {
+        return NULL;
+    }
+
+    n = snprintf(buffer, size, "%s=\"", key);
+    if (n < 0 || (size_t)n >= size) {
+        return NULL;
+    }
+    pos = (size_t)n;
+
+    for (; *value; value++) {
+        if (pos + 4 > size) {
+            return NULL;
+        }
+        if (*value == '\\' || *value == '"' || *value == '\n') {
+            buffer[pos++] = '\\';
+            buffer[pos++] = *value == '\n' ? 'n' : *value;
+        } else {
+            buffer[pos++] = *value;
+        }
+    }
+    if (pos + 2 > size) {
+        return NULL;
+    }
+    buffer[pos++] = '"';
+    buffer[pos] = '\0';
+
+    return buffer;
+}
+
+/* In a forked child: the locks may have been held by other threads, and the exporter is the parent's */
+static void metrics_atfork_child(void)
+{
+    pthread_mutex_init(&g_metrics_lock, NULL);
+    pthread_mutex_init(&g_export_lock, NULL);
+
+    /* Leave the exporter's pipe, socket and file to the parent */
+    g_export_running = false;
+    if (g_export_wake[0] >= 0) {
+        close(g_export_wake[0]);
+        close(g_export_wake[1]);
+        g_export_wake[0] = g_export_wake[1] = -1;
+    }
+    if (g_export_listen_fd >= 0) {
+        close(g_export_listen_fd);
+        g_export_listen_fd = -1;
+    }
+    g_export_file = NULL;
+    g_export_socket_path = NULL;
+}
+
+/* Register the metrics maintained by the framework */
+static void metrics_builtin_register(void)
+{
+    char label[64];
+    int i;
+
+    /* Every context registers these, so this runs before any fork */
+    pthread_atfork(NULL, NULL, metrics_atfork_child);
+
+    g_metrics_builtin.sessions = tinycli_metric_gauge("tinycli_sessions_active",
+                                                      "Open sessions (contexts)", NULL);
+    g_metrics_builtin.plugins = tinycli_metric_gauge("tinycli_plugins_loaded",
+                                                     "Plugins loaded, summed over sessions", NULL);
+    for (i = 0; i < TINYCLI_MEM_TAG_COUNT; i++) {
+        if (tinycli_metric_label("tag", tinycli_mem_tag_name((tinycli_mem_tag_t)i),
+                                 label, sizeof(label))) {
+            g_metrics_builtin.memory[i] = tinycli_metric_gauge(
+                "tinycli_memory_live_bytes", "Bytes allocated by the framework, by subsystem", label);
+        }
+    }
+}
+
+const tinycli_metrics_builtin_t *tinycli_metrics_builtin(void)
+{
+    pthread_once(&g_metrics_builtin_once, metrics_builtin_register);
+
+    return &g_metrics_builtin;
+}
+
+/* Append formatted text */
+static void __attribute__((format(printf, 2, 3))) text_printf(metrics_text_t *text,
+                                                               const char *fmt, ...)
+{
+    va_list args;
+    size_t cap;
+    char *data;
+    int n;
+
+    while (!text->failed) {
+        va_start(args, fmt);
+        n = vsnprintf(text->data + text->len, text->cap - text->len, fmt, args);
+        va_end(args);
+        if (n < 0) {
+            text->failed = true;
+            return;
+        }
+        if ((size_t)n < text->cap - text->len) {
+            text->len += (size_t)n;
+            return;
+        }
+
+        cap = text->cap * 2;
+        while (cap < text->len + (size_t)n + 1) {
+            cap *= 2;
+        }
+        data = (char *)realloc(text->data, cap);
+        if (!data) {
+            text->failed = true;
+            return;
+        }
+        text->data = data;
+        text->cap = cap;
+    }
+}
+
+/* Render one series (lock held) */
+static void render_series(metrics_text_t *text, const tinycli_metric_t *metric)
+{
+    const char *name = metric->family->name, *labels = metric->labels;
+    bool has_labels = labels[0] != '\0';
+    uint64_t count = 0;
+    int b;
+
+    switch (metric->family->type) {
+    case METRIC_COUNTER:
+        text_printf(text, "%s%s%s%s %llu\n", name, has_labels ? "{" : "", labels,
+                    has_labels ? "}" : "", (unsigned long long)slot_sum(metric->slot));
+        break;
+
+    case METRIC_GAUGE:
+        text_printf(text, "%s%s%s%s %lld\n", name, has_labels ? "{" : "", labels,
+                    has_labels ? "}" : "",
+                    (long long)__atomic_load_n(&metric->value, __ATOMIC_RELAXED));
+        break;
+
+    case METRIC_HISTOGRAM:
+        /* Slots count each bucket on its own; the format wants them cumulative */
+        for (b = 0; b <= TINYCLI_METRICS_BUCKETS; b++) {
+            count += slot_sum(metric->slot + (uint32_t)b);
+            text_printf(text, "%s_bucket{%s%sle=\"%s\"} %llu\n", name, labels,
+                        has_labels ? "," : "",
+                        b < TINYCLI_METRICS_BUCKETS ? g_metric_bucket_le[b] : "+Inf",
+                        (unsigned long long)count);
+        }
+        text_printf(text, "%s_sum%s%s%s %.9f\n", name, has_labels ? "{" : "", labels,
+                    has_labels ? "}" : "",
+                    slot_sum(metric->slot + TINYCLI_METRICS_BUCKETS + 1) / 1e9);
+        text_printf(text, "%s_count%s%s%s %llu\n", name, has_labels ? "{" : "", labels,
+                    has_labels ? "}" : "", (unsigned long long)count);
+        break;
+    }
+}
+
+char *tinycli_metrics_render(size_t *len)
+{
+    const tinycli_metrics_builtin_t *builtin = tinycli_metrics_builtin();
+    metrics_text_t text = { NULL, 0, METRICS_TEXT_INITIAL, false };
+    const metrics_family_t *family;
+    const tinycli_metric_t *metric;
+    tinycli_mem_stats_t stats;
+    int i;
+
+    if (!len) {
+        return NULL;
+    }
+
+    /* Gauges kept by other subsystems are read on export */
+    for (i = 0; i < TINYCLI_MEM_TAG_COUNT; i++) {
+        tinycli_mem_get_stats((tinycli_mem_tag_t)i, &stats);
+        tinycli_metric_set(builtin->memory[i], (int64_t)stats.live_bytes);
+    }
+
+    text.data = (char *)malloc(text.cap);
+    if (!text.data) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&g_metrics_lock);
+    for (family = g_metrics_families; family != NULL; family = family->next) {
+        if (!family->series) {
+            continue;
+        }
+        text_printf(&text, "# HELP %s %s\n", family->name, family->help);
+        text_printf(&text, "# TYPE %s %s\n", family->name, g_metric_type_names[family->type]);
+        for (metric = family->series; metric != NULL; metric = metric->next) {
+            render_series(&text, metric);
+        }
+    }
+    pthread_mutex_unlock(&g_metrics_lock);
+
+    if (text.failed) {
+        free(text.data);
+        return NULL;
+    }
+
+    *len = text.len;
+    return text.data;
+}
+
+int tinycli_metrics_show(tinycli_context_t *ctx)
+{
+    size_t len;
+    char *text;
+    int ret;
+
+    if (!ctx) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    text = tinycli_metrics_render(&len);
+    if (!text) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+    ret = tinycli_output_write(ctx, text, len);
+    free(text);
+
+    return ret;
+}
+
+/* Write all of a buffer to a file descriptor */
+static bool export_write_all(int fd, const char *data, size_t len, bool socket)
+{
+    ssize_t n;
+
+    while (len > 0) {
+        n = socket ? send(fd, data, len, MSG_NOSIGNAL) : write(fd, data, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+
+    return true;
+}
+
+/* Replace the textfile-collector file; the collector never sees a partial file */
+static void export_write_file(const char *path)
+{
+    char tmp[PATH_MAX];
+    size_t len;
+    char *text;
+    bool ok;
+    int fd, n;
+
+    n = snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    if (n < 0 || (size_t)n >= sizeof(tmp)) {
+        return;
+    }
+
+    text = tinycli_metrics_render(&len);
+    if (!text) {
+        return;
+    }
+
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd >= 0) {
+        ok = export_write_all(fd, text, len, false);
+        if (close(fd) != 0 || !ok || rename(tmp, path) != 0) {
+            unlink(tmp);
+        }
+    }
+    free(text);
+}
+
+/* Answer one HTTP request on the socket */
+static void export_serve(int listen_fd)
+{
+    static const char error[] = "HTTP/1.0 500 Internal Server Error\r\nContent-Length: 0\r\n\r\n";
+    char request[1024], header[256];
+    struct pollfd pfd;
+    size_t len = 0, body_len = 0;
+    ssize_t n;
+    char *body;
+    int fd;
+
+    fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+
+    /* Read the request head; its contents don't matter */
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    while (len < sizeof(request) - 1 && poll(&pfd, 1, METRICS_REQUEST_MS) > 0) {
+        n = recv(fd, request + len, sizeof(request) - 1 - len, 0);
+        if (n <= 0) {
+            break;
+        }
+        len += (size_t)n;
+        request[len] = '\0';
+        if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n")) {
+            break;
+        }
+    }
+
+    body = tinycli_metrics_render(&body_len);
+    if (body) {
+        n = snprintf(header, sizeof(header),
+                     "HTTP/1.0 200 OK\r\n"
+                     "Content-Type: text/plain; version=0.0.4\r\n"
+                     "Content-Length: %zu\r\n"
+                     "Connection: close\r\n\r\n", body_len);
+        if (export_write_all(fd, header, (size_t)n, true)) {
+            export_write_all(fd, body, body_len, true);
+        }
+        free(body);
+    } else {
+        export_write_all(fd, error, sizeof(error) - 1, true);
+    }
+
+    close(fd);
+}
+
+/* Exporter thread: rewrite the file when due, answer socket requests in between */
+static void *export_thread(void *arg)
+{
+    struct pollfd fds[2];
+    uint64_t next_ns = 0, now_ns;
+    int timeout, nfds;
+
+    (void)arg;
+
+    fds[0].fd = g_export_wake[0];
+    fds[0].events = POLLIN;
+    fds[1].fd = g_export_listen_fd;
+    fds[1].events = POLLIN;
+    nfds = g_export_listen_fd >= 0 ? 2 : 1;
+
+    for (;;) {
+        timeout = -1;
+        if (g_export_file) {
+            now_ns = tinycli_time_ns();
+            if (now_ns >= next_ns) {
+                export_write_file(g_export_file);
+                next_ns = now_ns + (uint64_t)g_export_interval_ms * 1000000;
+                now_ns = tinycli_time_ns();
+            }
+            timeout = now_ns >= next_ns ? 0 : (int)((next_ns - now_ns + 999999) / 1000000);
+        }
+
+        if (poll(fds, (nfds_t)nfds, timeout) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[0].revents) {
+            break;
+        }
+        if (nfds > 1 && (fds[1].revents & POLLIN)) {
+            export_serve(g_export_listen_fd);
+        }
+    }
+
+    return NULL;
+}
+
+/* Stop the exporter thread (export lock held) */
+static void export_stop_locked(void)
+{
+    char byte = 0;
+    ssize_t n;
+
+    if (g_export_running) {
+        n = write(g_export_wake[1], &byte, 1);
+        (void)n;
+        pthread_join(g_export_thread, NULL);
+        g_export_running = false;
+    }
+    if (g_export_wake[0] >= 0) {
+        close(g_export_wake[0]);
+        close(g_export_wake[1]);
+        g_export_wake[0] = g_export_wake[1] = -1;
+    }
+}
+
+/* Start the exporter thread if there is anything to export (export lock held) */
+static int export_start_locked(void)
+{
+    sigset_t all, old;
+    int ret;
+
+    if (!g_export_file && g_export_listen_fd < 0) {
+        return TINYCLI_SUCCESS;
+    }
+
+    if (pipe2(g_export_wake, O_CLOEXEC) != 0) {
+        g_export_wake[0] = g_export_wake[1] = -1;
+        return TINYCLI_ERROR_GENERAL;
+    }
+
+    /* Signals are for the threads running commands */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    ret = pthread_create(&g_export_thread, NULL, export_thread, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (ret != 0) {
+        export_stop_locked();
+        return TINYCLI_ERROR_GENERAL;
+    }
+    g_export_running = true;
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Close the metrics socket (export lock held) */
+static void export_close_socket_locked(void)
+{
+    if (g_export_listen_fd >= 0) {
+        close(g_export_listen_fd);
+        unlink(g_export_socket_path);
+        g_export_listen_fd = -1;
+    }
+    free(g_export_socket_path);
+    g_export_socket_path = NULL;
+}
+
+int tinycli_metrics_export_file(const char *path, unsigned int interval_ms)
+{
+    char *copy = NULL;
+    int ret;
+
+    if (path && interval_ms == 0) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+    if (path && !(copy = strdup(path))) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    pthread_mutex_lock(&g_export_lock);
+    export_stop_locked();
+    free(g_export_file);
+    g_export_file = copy;
+    g_export_interval_ms = interval_ms;
+    ret = export_start_locked();
+    pthread_mutex_unlock(&g_export_lock);
+
+    return ret;
+}
+
+int tinycli_metrics_export_socket(const char *socket_path)
+{
+    struct sockaddr_un addr;
+    struct stat st;
+    char *copy = NULL;
+    int fd = -1, ret;
+
+    if (socket_path) {
+        if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+            return TINYCLI_ERROR_INVALID_ARGUMENT;
+        }
+        copy = strdup(socket_path);
+        if (!copy) {
+            return TINYCLI_ERROR_MEMORY;
+        }
+
+        /* Replace a stale socket from an earlier run */
+        if (stat(socket_path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+            unlink(socket_path);
+        }
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, socket_path);
+
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+            listen(fd, METRICS_BACKLOG) != 0) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            free(copy);
+            return TINYCLI_ERROR_GENERAL;
+        }
+    }
+
+    pthread_mutex_lock(&g_export_lock);
+    export_stop_locked();
+    export_close_socket_locked();
+    g_export_socket_path = copy;
+    g_export_listen_fd = fd;
+    ret = export_start_locked();
+    pthread_mutex_unlock(&g_export_lock);
+
+    return ret;
+}
+
+void tinycli_metrics_export_stop(void)
+{
+    pthread_mutex_lock(&g_export_lock);
+    export_stop_locked();
+    export_close_socket_locked();
+    free(g_export_file);
+    g_export_file = NULL;
+    pthread_mutex_unlock(&g_export_lock);
+}
@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "output.h"
+#include "context.h"
+#include "alloc.h"
+#include "cancel.h"
+
+/* Initial capture buffer size */
+#define OUTPUT_CAPTURE_INITIAL 1024
+
+void tinycli_output_init(tinycli_output_t *out)
+{
+    if (!out) {
+        return;
+    }
+
+    memset(out, 0, sizeof(*out));
+    out->stream = stdout;
+}
+
+void tinycli_output_destroy(tinycli_output_t *out)
+{
+    if (!out) {
+        return;
+    }
+
+    tinycli_free(out->buf);
+    out->buf = NULL;
+    out->len = 0;
+    out->cap = 0;
+    out->capturing = false;
+}
+
+void tinycli_output_set_stream(tinycli_context_t *ctx, FILE *stream)
+{
+    if (!ctx) {
+        return;
+    }
+
+    tinycli_output_flush(ctx);
+    ctx->output.stream = stream;
+}
+
+/* Make room for len more bytes (plus a terminator) in the capture buffer */
+static int output_reserve(tinycli_output_t *out, size_t len)
+{
+    size_t cap;
+    char *buf;
+
+    if (out->len + len + 1 <= out->cap) {
+        return TINYCLI_SUCCESS;
+    }
+
+    cap = out->cap ? out->cap : OUTPUT_CAPTURE_INITIAL;
+    while (cap < out->len + len + 1) {
+        cap *= 2;
+    }
+
+    buf = (char *)tinycli_realloc(TINYCLI_MEM_OUTPUT, out->buf, cap);
+    if (!buf) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    out->buf = buf;
+    out->cap = cap;
+
+    return TINYCLI_SUCCESS;
+}
+
+int tinycli_output_write(tinycli_context_t *ctx, const void *data, size_t len)
+{
+    tinycli_output_t *out;
+
+    if (!ctx || (!data && len > 0)) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    /* Abandoned commands have lost the terminal */
+    if (tinycli_invocation_abandoned()) {
+        return TINYCLI_ERROR_CANCELLED;
+    }
+
+    out = &ctx->output;
+
+    /* Append to capture buffer */
+    if (out->capturing) {
+        if (output_reserve(out, len) != TINYCLI_SUCCESS) {
+            return TINYCLI_ERROR_MEMORY;
+        }
+        memcpy(out->buf + out->len, data, len);
+        out->len += len;
+        out->buf[out->len] = '\0';
+        return TINYCLI_SUCCESS;
+    }
+
+    /* Discard */
+    if (!out->stream) {
+        return TINYCLI_SUCCESS;
+    }
+
+    out->epoch++;
+    if (fwrite(data, 1, len, out->stream) != len) {
+        return TINYCLI_ERROR_GENERAL;
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+int tinycli_output_vprintf(tinycli_context_t *ctx, const char *fmt, va_list args)
+{
+    tinycli_output_t *out;
+    va_list copy;
+    int n;
+
+    if (!ctx || !fmt) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (tinycli_invocation_abandoned()) {
+        return TINYCLI_ERROR_CANCELLED;
+    }
+
+    out = &ctx->output;
+
+    if (!out->capturing) {
+        out->epoch++;
+        if (out->stream && vfprintf(out->stream, fmt, args) < 0) {
+            return TINYCLI_ERROR_GENERAL;
+        }
+        return TINYCLI_SUCCESS;
+    }
+
+    /* Try to format in place, growing the buffer if it doesn't fit */
+    va_copy(copy, args);
+    n = vsnprintf(out->buf ? out->buf + out->len : NULL,
+                  out->buf ? out->cap - out->len : 0, fmt, copy);
+    va_end(copy);
+    if (n < 0) {
+        return TINYCLI_ERROR_GENERAL;
+    }
+
+    if (out->len + (size_t)n + 1 > out->cap) {
+        if (output_reserve(out, (size_t)n) != TINYCLI_SUCCESS) {
+            return TINYCLI_ERROR_MEMORY;
+        }
+        vsnprintf(out->buf + out->len, out->cap - out->len, fmt, args);
+    }
+    out->len += (size_t)n;
+
+    return TINYCLI_SUCCESS;
+}
+
+void tinycli_output_flush(tinycli_context_t *ctx)
+{
+    if (ctx && !ctx->output.capturing && ctx->output.stream) {
+        fflush(ctx->output.stream);
+    }
+}
+
+int tinycli_output_fd(tinycli_context_t *ctx)
+{
+    if (!ctx || ctx->output.capturing || !ctx->output.stream || tinycli_invocation_abandoned()) {
+        return -1;
+    }
+
+    fflush(ctx->output.stream);
+    return fileno(ctx->output.stream);
+}
+
+int tinycli_output_capture_begin(tinycli_context_t *ctx)
+{
+    if (!ctx) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (ctx->output.capturing) {
+        return TINYCLI_ERROR_GENERAL;
+    }
+
+    if (output_reserve(&ctx->output, 0) != TINYCLI_SUCCESS) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    ctx->output.len = 0;
+    ctx->output.buf[0] = '\0';
+    ctx->output.capturing = true;
+
+    return TINYCLI_SUCCESS;
+}
+
+char *tinycli_output_capture_end(tinycli_context_t *ctx, size_t *len)
+{
+    char *buf;
+
+    if (!ctx || !ctx->output.capturing) {
+        return NULL;
+    }
+
+    /* Hand the buffer over to the caller */
+    buf = ctx->output.buf;
+    if (len) {
+        *len = ctx->output.len;
+    }
+
+    ctx->output.buf = NULL;
+    ctx->output.len = 0;
+    ctx->output.cap = 0;
+    ctx->output.capturing = false;
+
+    return buf;
+}
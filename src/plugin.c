@@ -1,16 +1,24 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <dlfcn.h>
+#include <link.h>
+#include <pthread.h>
 #include <cjson/cJSON.h>
 #include <sys/stat.h>
 #include <libgen.h>
 #include <limits.h>
 #include <unistd.h>
 
+#include "alloc.h"
 #include "plugin.h"
 #include "context.h"
 #include "utils.h"
+#include "runtime.h"
+#include "pluginpath.h"
+#include "metrics.h"
+#include "alias.h"
 
 /* Plugin initialization function name */
 #define PLUGIN_INIT_FUNC "tinycli_plugin_init"
@@ -21,85 +29,470 @@
 /* Max path length for plugin files */
 #define MAX_PATH_LEN 1024
 
-/* Get plugin directory from environment or executable location */
-const char* get_plugin_directory(void)
+/* Shared plugin image: one loaded library used by any number of contexts */
+struct tinycli_plugin_image {
+    char *path;                      /* Resolved path of the library */
+    dev_t dev;                       /* Device of the library file */
+    ino_t ino;                       /* Inode of the library file */
+    void *handle;                    /* Dynamic library handle */
+    tinycli_plugin_init_t init;      /* Plugin initialization function */
+    tinycli_plugin_cleanup_t cleanup; /* Plugin cleanup function */
+    unsigned int bind;               /* Binding flags the library was opened with */
+    uint64_t open_ns;                /* Time dlopen took */
+    uint64_t sym_ns;                 /* Time dlsym took */
+    unsigned int refs;               /* Number of plugins using the image */
+    struct plugin_alias *aliases;    /* Names the image was requested as */
+    struct tinycli_plugin_image *next; /* Next image in the cache */
+};
+
+/* Request key that resolved to an image */
+struct plugin_alias {
+    char *key;                       /* Request key (see plugin_request_key) */
+    struct plugin_alias *next;       /* Next alias */
+};
+
+/* Process-wide image cache */
+static pthread_mutex_t g_image_lock = PTHREAD_MUTEX_INITIALIZER;
+static tinycli_plugin_image_t *g_images = NULL;
+
+/* Plugin compiled into the framework */
+typedef struct {
+    const char *name;                /* Plugin name */
+    const char *description;         /* Plugin description */
+    tinycli_plugin_init_t init;      /* Plugin initialization function */
+    tinycli_plugin_cleanup_t cleanup; /* Plugin cleanup function */
+} plugin_builtin_t;
+
+/* No-op command: measures dispatch overhead without handler cost */
+static int noop_handler(int argc, char **argv, tinycli_context_t *ctx)
 {
-    /* First try environment variable */
-    const char *plugin_dir = getenv("TINYCLI_PLUGIN_DIR");
-    if (plugin_dir && *plugin_dir) {
-        return plugin_dir;
+    (void)argc;
+    (void)argv;
+    (void)ctx;
+    return TINYCLI_SUCCESS;
+}
+
+/* Echo command: adds the cost of the output path */
+static int noop_echo_handler(int argc, char **argv, tinycli_context_t *ctx)
+{
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        tinycli_printf(ctx, i > 1 ? " %s" : "%s", argv[i]);
     }
-    
-    /* Fall back to executable directory */
-    static char path[PATH_MAX];
-    static char dir[PATH_MAX];
-    
-    if (readlink("/proc/self/exe", path, sizeof(path) - 1) > 0) {
-        path[sizeof(path) - 1] = '\0';
-        strcpy(dir, dirname(path));
-        return dir;
+    tinycli_printf(ctx, "\n");
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Initialize the no-op plugin */
+static int noop_plugin_init(tinycli_context_t *ctx)
+{
+    int ret;
+
+    ret = tinycli_register_command(ctx, "noop", "Do nothing (framework overhead baseline)",
+                                   noop_handler, NULL);
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
     }
-    
+
+    return tinycli_register_command(ctx, "noop-echo", "Print the arguments",
+                                    noop_echo_handler, NULL);
+}
+
+/* Built-in plugins, loaded by bare name without a shared library */
+static const plugin_builtin_t g_builtin_plugins[] = {
+    { "noop", "Built-in no-op commands for load testing", noop_plugin_init, NULL },
+};
+
+/* Binding flag names, in the order they are formatted */
+static const struct {
+    const char *name;                /* Name in TINYCLI_PLUGIN_BIND and --bind */
+    unsigned int set;                /* Flags the name sets */
+    unsigned int clear;              /* Flags the name clears */
+} g_bind_names[] = {
+    { "now", 0, TINYCLI_PLUGIN_BIND_LAZY },
+    { "lazy", TINYCLI_PLUGIN_BIND_LAZY, 0 },
+    { "local", 0, TINYCLI_PLUGIN_BIND_GLOBAL },
+    { "global", TINYCLI_PLUGIN_BIND_GLOBAL, 0 },
+    { "deepbind", TINYCLI_PLUGIN_BIND_DEEPBIND, 0 },
+    { "nodelete", TINYCLI_PLUGIN_BIND_NODELETE, 0 },
+};
+
+int tinycli_plugin_bind_parse(const char *text, unsigned int *bind)
+{
+    const char *word, *end;
+    unsigned int flags = 0;
+    size_t len, i;
+
+    if (!text || !bind) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    for (word = text; *word != '\0'; word = *end ? end + 1 : end) {
+        end = strchr(word, ',');
+        if (!end) {
+            end = word + strlen(word);
+        }
+        len = (size_t)(end - word);
+
+        for (i = 0; i < sizeof(g_bind_names) / sizeof(g_bind_names[0]); i++) {
+            if (strlen(g_bind_names[i].name) == len && strncmp(g_bind_names[i].name, word, len) == 0) {
+                flags = (flags & ~g_bind_names[i].clear) | g_bind_names[i].set;
+                break;
+            }
+        }
+        if (i == sizeof(g_bind_names) / sizeof(g_bind_names[0])) {
+            return TINYCLI_ERROR_INVALID_ARGUMENT;
+        }
+    }
+
+    *bind = flags;
+    return TINYCLI_SUCCESS;
+}
+
+char *tinycli_plugin_bind_format(unsigned int bind, char *buffer, size_t size)
+{
+    snprintf(buffer, size, "%s,%s%s%s",
+             (bind & TINYCLI_PLUGIN_BIND_LAZY) ? "lazy" : "now",
+             (bind & TINYCLI_PLUGIN_BIND_GLOBAL) ? "global" : "local",
+             (bind & TINYCLI_PLUGIN_BIND_DEEPBIND) ? ",deepbind" : "",
+             (bind & TINYCLI_PLUGIN_BIND_NODELETE) ? ",nodelete" : "");
+    return buffer;
+}
+
+/* Translate binding flags to dlopen flags */
+static int plugin_dlopen_flags(unsigned int bind)
+{
+    int flags;
+
+    flags = (bind & TINYCLI_PLUGIN_BIND_LAZY) ? RTLD_LAZY : RTLD_NOW;
+    flags |= (bind & TINYCLI_PLUGIN_BIND_GLOBAL) ? RTLD_GLOBAL : RTLD_LOCAL;
+#ifdef RTLD_DEEPBIND
+    if (bind & TINYCLI_PLUGIN_BIND_DEEPBIND) {
+        flags |= RTLD_DEEPBIND;
+    }
+#endif
+#ifdef RTLD_NODELETE
+    if (bind & TINYCLI_PLUGIN_BIND_NODELETE) {
+        flags |= RTLD_NODELETE;
+    }
+#endif
+
+    return flags;
+}
+
+/* Check whether a plugin name is a path rather than a bare name */
+static bool plugin_name_is_path(const char *plugin_name)
+{
+    return plugin_name[0] == '/' ||
+           (plugin_name[0] == '.' && plugin_name[1] == '/') ||
+           (plugin_name[0] == '.' && plugin_name[1] == '.' && plugin_name[2] == '/');
+}
+
+/* Find a built-in plugin by bare name */
+static const plugin_builtin_t *plugin_find_builtin(const char *plugin_name)
+{
+    size_t i;
+
+    for (i = 0; i < sizeof(g_builtin_plugins) / sizeof(g_builtin_plugins[0]); i++) {
+        if (strcmp(g_builtin_plugins[i].name, plugin_name) == 0) {
+            return &g_builtin_plugins[i];
+        }
+    }
+
     return NULL;
 }
 
-/* Try to load plugin from different locations */
-static void *try_load_plugin(const char *plugin_name, char *full_path, size_t path_size)
+/*
+ * Build the cache key for a request. Bare names resolve against the plugin
+ * directory, so the directory is part of the key; absolute paths are their
+ * own key. Relative paths depend on the working directory and get no key.
+ */
+static bool plugin_request_key(const char *plugin_name, const char *plugin_dir,
+                               char *key, size_t size)
 {
-    void *handle = NULL;
-    const char *plugin_dir = tinycli_get_plugin_dir();
+    int n;
+
+    if (plugin_name[0] == '/') {
+        n = snprintf(key, size, "%s", plugin_name);
+    } else if (!plugin_name_is_path(plugin_name)) {
+        n = snprintf(key, size, "%s\n%s", plugin_dir ? plugin_dir : "", plugin_name);
+    } else {
+        return false;
+    }
+
+    return n > 0 && (size_t)n < size;
+}
+
+/* Find an image by request key (lock held) */
+static tinycli_plugin_image_t *image_find_alias(const char *key)
+{
+    tinycli_plugin_image_t *image;
+    struct plugin_alias *alias;
+
+    for (image = g_images; image != NULL; image = image->next) {
+        for (alias = image->aliases; alias != NULL; alias = alias->next) {
+            if (strcmp(alias->key, key) == 0) {
+                return image;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/* Find an image by file identity (lock held) */
+static tinycli_plugin_image_t *image_find_file(dev_t dev, ino_t ino)
+{
+    tinycli_plugin_image_t *image;
+
+    for (image = g_images; image != NULL; image = image->next) {
+        if (image->dev == dev && image->ino == ino) {
+            return image;
+        }
+    }
+
+    return NULL;
+}
+
+/* Remember a request key for an image (lock held); failure only costs a later lookup */
+static void image_add_alias(tinycli_plugin_image_t *image, const char *key)
+{
+    struct plugin_alias *alias;
+
+    alias = (struct plugin_alias *)tinycli_malloc(TINYCLI_MEM_PLUGINS, sizeof(*alias));
+    if (!alias) {
+        return;
+    }
+
+    alias->key = tinycli_mem_strdup(TINYCLI_MEM_PLUGINS, key);
+    if (!alias->key) {
+        tinycli_free(alias);
+        return;
+    }
+
+    alias->next = image->aliases;
+    image->aliases = alias;
+}
+
+/* Free an image record and close its library */
+static void image_destroy(tinycli_plugin_image_t *image)
+{
+    struct plugin_alias *alias, *next;
+
+    for (alias = image->aliases; alias != NULL; alias = next) {
+        next = alias->next;
+        tinycli_free(alias->key);
+        tinycli_free(alias);
+    }
+
+    if (image->handle) {
+        dlclose(image->handle);
+    }
+
+    tinycli_free(image->path);
+    tinycli_free(image);
+}
+
+/* Find the library file for a plugin name: explicit path, then the plugin search path */
+static bool plugin_find_file(const char *plugin_name, const char *plugin_dir,
+                             char *full_path, size_t path_size)
+{
+    char candidate[MAX_PATH_LEN];
     struct stat st;
-    
+
+    (void)path_size;
+
     /* If plugin_name is already a full path, try it directly */
-    if (plugin_name[0] == '/' || 
-        (plugin_name[0] == '.' && plugin_name[1] == '/') ||
-        (plugin_name[0] == '.' && plugin_name[1] == '.' && plugin_name[2] == '/')) {
-        
-        /* Copy the full path */
-        strncpy(full_path, plugin_name, path_size - 1);
-        full_path[path_size - 1] = '\0';
-        
-        /* Try to load it */
-        handle = dlopen(full_path, RTLD_NOW);
-        if (handle) {
-            return handle;
+    if (plugin_name_is_path(plugin_name) && stat(plugin_name, &st) == 0 &&
+        realpath(plugin_name, full_path)) {
+        return true;
+    }
+
+    /* Look the name up in the indexed search path directories */
+    if (plugin_dir && tinycli_plugin_path_find(plugin_dir, plugin_name, candidate, sizeof(candidate)) &&
+        realpath(candidate, full_path)) {
+        return true;
+    }
+
+    return false;
+}
+
+/* Open a plugin library and look up its entry points */
+static tinycli_plugin_image_t *image_open(tinycli_context_t *ctx, const char *plugin_name,
+                                          const char *plugin_dir, unsigned int bind)
+{
+    tinycli_plugin_image_t *image;
+    char full_path[PATH_MAX];
+    struct link_map *map = NULL;
+    struct stat st;
+    const char *error;
+    void *handle;
+    int flags = plugin_dlopen_flags(bind);
+    uint64_t start_ns, open_ns;
+
+    /* Load from a known file, or as a last resort from the standard library paths */
+    if (plugin_find_file(plugin_name, plugin_dir, full_path, sizeof(full_path))) {
+        start_ns = tinycli_time_ns();
+        handle = dlopen(full_path, flags);
+        open_ns = tinycli_time_ns() - start_ns;
+    } else {
+        snprintf(full_path, sizeof(full_path), "lib%s.so", plugin_name);
+        start_ns = tinycli_time_ns();
+        handle = dlopen(full_path, flags);
+        open_ns = tinycli_time_ns() - start_ns;
+        if (handle && dlinfo(handle, RTLD_DI_LINKMAP, &map) == 0 && map && map->l_name) {
+            snprintf(full_path, sizeof(full_path), "%s", map->l_name);
         }
     }
-    
-    /* If we have a plugin directory, try there */
-    if (plugin_dir) {
-        /* Try with .so extension */
-        snprintf(full_path, path_size, "%s/%s.so", plugin_dir, plugin_name);
-        if (stat(full_path, &st) == 0) {
-            handle = dlopen(full_path, RTLD_NOW);
-            if (handle) {
-                return handle;
+
+    if (!handle) {
+        error = dlerror();
+        TINYCLI_LOG(TINYCLI_LOG_WARN, "Failed to load plugin %s: %s", plugin_name, error);
+        tinycli_printf(ctx, "Failed to load plugin: %s\n", error);
+        return NULL;
+    }
+    TINYCLI_LOG(TINYCLI_LOG_DEBUG, "Opened %s in %llu us", full_path,
+                (unsigned long long)(open_ns / 1000));
+
+    image = (tinycli_plugin_image_t *)tinycli_calloc(TINYCLI_MEM_PLUGINS, 1, sizeof(*image));
+    if (!image) {
+        dlclose(handle);
+        return NULL;
+    }
+    image->handle = handle;
+    image->bind = bind;
+    image->open_ns = open_ns;
+    image->refs = 1;
+
+    /* Identify the file so other requests for it share this image */
+    image->path = tinycli_mem_strdup(TINYCLI_MEM_PLUGINS, full_path);
+    if (!image->path) {
+        image_destroy(image);
+        return NULL;
+    }
+    if (stat(full_path, &st) == 0) {
+        image->dev = st.st_dev;
+        image->ino = st.st_ino;
+    }
+
+    /* Get initialization function */
+    start_ns = tinycli_time_ns();
+    dlerror();
+    image->init = (tinycli_plugin_init_t)dlsym(handle, PLUGIN_INIT_FUNC);
+    error = dlerror();
+    if (error) {
+        tinycli_printf(ctx, "Failed to find plugin initialization function: %s\n", error);
+        image_destroy(image);
+        return NULL;
+    }
+
+    /* Get cleanup function */
+    image->cleanup = (tinycli_plugin_cleanup_t)dlsym(handle, PLUGIN_CLEANUP_FUNC);
+    /* Cleanup function is optional, so we don't check for errors */
+    dlerror(); /* Clear any error */
+    image->sym_ns = tinycli_time_ns() - start_ns;
+
+    return image;
+}
+
+/* Get a shared image for a plugin, loading the library on first use */
+static tinycli_plugin_image_t *plugin_image_acquire(tinycli_context_t *ctx, const char *plugin_name,
+                                                    unsigned int bind, bool *shared)
+{
+    tinycli_plugin_image_t *image, *existing;
+    char dir_buf[MAX_PATH_LEN];
+    char key[MAX_PATH_LEN * 2];
+    const char *plugin_dir = tinycli_runtime_get_plugin_dir(ctx->runtime, dir_buf, sizeof(dir_buf));
+    bool has_key = plugin_request_key(plugin_name, plugin_dir, key, sizeof(key));
+
+    /* Fast path: the same request was resolved before */
+    if (has_key) {
+        pthread_mutex_lock(&g_image_lock);
+        image = image_find_alias(key);
+        if (image) {
+            image->refs++;
+        }
+        pthread_mutex_unlock(&g_image_lock);
+
+        if (image) {
+            *shared = true;
+            return image;
+        }
+    }
+
+    /* Slow path: resolve and open the library */
+    image = image_open(ctx, plugin_name, plugin_dir, bind);
+    if (!image) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&g_image_lock);
+
+    /* Share an image already loaded from the same file */
+    existing = (image->ino != 0) ? image_find_file(image->dev, image->ino) : NULL;
+    if (existing) {
+        existing->refs++;
+    } else {
+        image->next = g_images;
+        g_images = image;
+    }
+
+    if (has_key) {
+        image_add_alias(existing ? existing : image, key);
+    }
+
+    pthread_mutex_unlock(&g_image_lock);
+
+    *shared = existing != NULL;
+    if (existing) {
+        image_destroy(image);
+        return existing;
+    }
+
+    return image;
+}
+
+/* Release a shared image, closing the library when its last user is gone */
+static void plugin_image_release(tinycli_plugin_image_t *image)
+{
+    tinycli_plugin_image_t **pp;
+    bool last;
+
+    pthread_mutex_lock(&g_image_lock);
+    last = --image->refs == 0;
+    if (last) {
+        for (pp = &g_images; *pp != NULL; pp = &(*pp)->next) {
+            if (*pp == image) {
+                *pp = image->next;
+                break;
             }
         }
     }
-    
-    /* As a last resort, try in standard library paths */
-    snprintf(full_path, path_size, "lib%s.so", plugin_name);
-    handle = dlopen(full_path, RTLD_NOW);
-    
-    return handle;
+    pthread_mutex_unlock(&g_image_lock);
+
+    if (last) {
+        image_destroy(image);
+    }
 }
 
-/* Extract plugin name from path */
-static char *extract_plugin_name(const char *plugin_path)
+/* Extract plugin name from path into buffer */
+static char *extract_plugin_name(const char *plugin_path, char *buffer, size_t size)
 {
-    char *plugin_name = (char *)tinycli_basename(plugin_path);
-    if (!plugin_name) {
+    const char *base = tinycli_basename(plugin_path);
+    if (!base || strlen(base) >= size) {
         return NULL;
     }
+    strcpy(buffer, base);
 
     /* Remove extension from plugin name */
-    char *dot = strrchr(plugin_name, '.');
+    char *dot = strrchr(buffer, '.');
     if (dot) {
         *dot = '\0';
     }
     
-    return plugin_name;
+    return buffer;
 }
 
 tinycli_plugin_t *tinycli_plugin_create(const char *name, const char *description,
@@ -112,7 +505,7 @@ tinycli_plugin_t *tinycli_plugin_create(const char *name, const char *descriptio
     }
 
     /* Allocate plugin */
-    plugin = (tinycli_plugin_t *)malloc(sizeof(tinycli_plugin_t));
+    plugin = (tinycli_plugin_t *)tinycli_malloc(TINYCLI_MEM_PLUGINS, sizeof(tinycli_plugin_t));
     if (!plugin) {
         return NULL;
     }
@@ -121,33 +514,35 @@ tinycli_plugin_t *tinycli_plugin_create(const char *name, const char *descriptio
     memset(plugin, 0, sizeof(tinycli_plugin_t));
 
     /* Set name */
-    plugin->name = tinycli_strdup(name);
+    plugin->name = tinycli_mem_strdup(TINYCLI_MEM_PLUGINS, name);
     if (!plugin->name) {
-        free(plugin);
+        tinycli_free(plugin);
         return NULL;
     }
 
     /* Set description (if provided) */
     if (description) {
-        plugin->description = tinycli_strdup(description);
+        plugin->description = tinycli_mem_strdup(TINYCLI_MEM_PLUGINS, description);
         if (!plugin->description) {
-            free(plugin->name);
-            free(plugin);
+            tinycli_free(plugin->name);
+            tinycli_free(plugin);
             return NULL;
         }
     }
 
     /* Set version (if provided) */
     if (version) {
-        plugin->version = tinycli_strdup(version);
+        plugin->version = tinycli_mem_strdup(TINYCLI_MEM_PLUGINS, version);
         if (!plugin->version) {
-            free(plugin->description);
-            free(plugin->name);
-            free(plugin);
+            tinycli_free(plugin->description);
+            tinycli_free(plugin->name);
+            tinycli_free(plugin);
             return NULL;
         }
     }
 
+    tinycli_metric_add(tinycli_metrics_builtin()->plugins, 1);
+
     return plugin;
 }
 
@@ -157,23 +552,19 @@ void tinycli_plugin_free(tinycli_plugin_t *plugin)
         return;
     }
 
-    /* Call cleanup function if available */
-    if (plugin->cleanup && plugin->handle) {
-        plugin->cleanup(NULL);
-    }
-
-    /* Close dynamic library */
-    if (plugin->handle) {
-        dlclose(plugin->handle);
+    /* Release the shared library image */
+    if (plugin->image) {
+        plugin_image_release(plugin->image);
     }
 
     /* Free strings */
-    free(plugin->name);
-    free(plugin->description);
-    free(plugin->version);
+    tinycli_free(plugin->name);
+    tinycli_free(plugin->description);
+    tinycli_free(plugin->version);
 
     /* Free plugin */
-    free(plugin);
+    tinycli_free(plugin);
+    tinycli_metric_add(tinycli_metrics_builtin()->plugins, -1);
 }
 
 tinycli_plugin_t *tinycli_plugin_find(tinycli_context_t *ctx, const char *name)
@@ -196,59 +587,73 @@ tinycli_plugin_t *tinycli_plugin_find(tinycli_context_t *ctx, const char *name)
 
 int tinycli_plugin_load(tinycli_context_t *ctx, const char *plugin_path)
 {
+    if (!ctx || !plugin_path) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    return tinycli_plugin_load_bind(ctx, plugin_path, tinycli_runtime_get_plugin_bind(ctx->runtime));
+}
+
+int tinycli_plugin_load_bind(tinycli_context_t *ctx, const char *plugin_path, unsigned int bind)
+{
+    const plugin_builtin_t *builtin;
     tinycli_plugin_t *plugin;
-    void *handle;
-    tinycli_plugin_init_t init_func;
-    tinycli_plugin_cleanup_t cleanup_func;
-    const char *error;
+    tinycli_plugin_image_t *image;
     char *plugin_name;
+    bool shared = false;
+    uint64_t start_ns;
     int ret;
-    char full_path[MAX_PATH_LEN];
+    char name_buf[MAX_PATH_LEN];
 
     if (!ctx || !plugin_path) {
         return TINYCLI_ERROR_INVALID_ARGUMENT;
     }
 
-    /* Try to load the plugin from different locations */
-    handle = try_load_plugin(plugin_path, full_path, sizeof(full_path));
-    if (!handle) {
-        tinycli_printf(ctx, "Failed to load plugin: %s\n", dlerror());
+    /* Get plugin name from path */
+    plugin_name = extract_plugin_name(plugin_path, name_buf, sizeof(name_buf));
+    if (!plugin_name) {
         return TINYCLI_ERROR_PLUGIN;
     }
 
-    /* Get initialization function */
-    init_func = (tinycli_plugin_init_t)dlsym(handle, PLUGIN_INIT_FUNC);
-    error = dlerror();
-    if (error) {
-        tinycli_printf(ctx, "Failed to find plugin initialization function: %s\n", error);
-        dlclose(handle);
-        return TINYCLI_ERROR_PLUGIN;
+    /* Don't touch the library if the plugin is already loaded here */
+    if (tinycli_plugin_find(ctx, plugin_name)) {
+        return TINYCLI_ERROR_PLUGIN_EXISTS;
     }
 
-    /* Get cleanup function */
-    cleanup_func = (tinycli_plugin_cleanup_t)dlsym(handle, PLUGIN_CLEANUP_FUNC);
-    /* Cleanup function is optional, so we don't check for errors */
-    dlerror(); /* Clear any error */
+    /* Built-in plugins don't need a library */
+    builtin = plugin_name_is_path(plugin_path) ? NULL : plugin_find_builtin(plugin_path);
+    if (builtin) {
+        plugin = tinycli_plugin_create(builtin->name, builtin->description, "built-in");
+        if (!plugin) {
+            return TINYCLI_ERROR_MEMORY;
+        }
+        plugin->init = builtin->init;
+        plugin->cleanup = builtin->cleanup;
+    } else {
+        /* Get the shared library image (loaded once per process) */
+        image = plugin_image_acquire(ctx, plugin_path, bind, &shared);
+        if (!image) {
+            return TINYCLI_ERROR_PLUGIN;
+        }
 
-    /* Get plugin name from path */
-    plugin_name = extract_plugin_name(plugin_path);
-    if (!plugin_name) {
-        dlclose(handle);
-        return TINYCLI_ERROR_PLUGIN;
-    }
+        /* Create plugin */
+        plugin = tinycli_plugin_create(plugin_name, "Dynamically loaded plugin", NULL);
+        if (!plugin) {
+            plugin_image_release(image);
+            return TINYCLI_ERROR_MEMORY;
+        }
 
-    /* Create plugin */
-    plugin = tinycli_plugin_create(plugin_name, "Dynamically loaded plugin", NULL);
-    if (!plugin) {
-        dlclose(handle);
-        return TINYCLI_ERROR_MEMORY;
+        /* Set plugin image, handle and functions */
+        plugin->image = image;
+        plugin->handle = image->handle;
+        plugin->init = image->init;
+        plugin->cleanup = image->cleanup;
+        plugin->bind = image->bind;
+        plugin->shared = shared;
+        plugin->open_ns = image->open_ns;
+        plugin->sym_ns = image->sym_ns;
     }
 
-    /* Set plugin handle and functions */
-    plugin->handle = handle;
-    plugin->init = init_func;
-    plugin->cleanup = cleanup_func;
-
     /* Add plugin to context */
     ret = tinycli_context_add_plugin(ctx, plugin);
     if (ret != TINYCLI_SUCCESS) {
@@ -257,9 +662,18 @@ int tinycli_plugin_load(tinycli_context_t *ctx, const char *plugin_path)
     }
 
     /* Initialize plugin */
+    ctx->current_plugin = plugin;
+    start_ns = tinycli_time_ns();
     ret = plugin->init(ctx);
+    plugin->init_ns = tinycli_time_ns() - start_ns;
+    ctx->current_plugin = NULL;
     if (ret != TINYCLI_SUCCESS) {
         tinycli_printf(ctx, "Failed to initialize plugin: %s\n", plugin_name);
+        /* Remove the commands it registered: they point into the plugin and its image */
+        if (tinycli_command_table_remove_plugin(&ctx->commands, plugin) > 0) {
+            tinycli_alias_unresolve(ctx);
+            ctx->generation++;
+        }
         /* Remove plugin from context */
         ctx->plugins = plugin->next;
         tinycli_plugin_free(plugin);
@@ -379,7 +793,7 @@ int tinycli_plugin_load_json(tinycli_context_t *ctx, const char *json_path)
     fseek(file, 0, SEEK_SET);
 
     /* Allocate buffer for file data */
-    json_data = (char *)malloc(file_size + 1);
+    json_data = (char *)tinycli_malloc(TINYCLI_MEM_PLUGINS, file_size + 1);
     if (!json_data) {
         fclose(file);
         return TINYCLI_ERROR_MEMORY;
@@ -388,7 +802,7 @@ int tinycli_plugin_load_json(tinycli_context_t *ctx, const char *json_path)
     /* Read file data */
     if (fread(json_data, 1, file_size, file) != (size_t)file_size) {
         tinycli_printf(ctx, "Failed to read JSON file: %s\n", json_path);
-        free(json_data);
+        tinycli_free(json_data);
         fclose(file);
         return TINYCLI_ERROR_PLUGIN;
     }
@@ -399,7 +813,7 @@ int tinycli_plugin_load_json(tinycli_context_t *ctx, const char *json_path)
     root = cJSON_Parse(json_data);
     if (!root) {
         tinycli_printf(ctx, "Failed to parse JSON: %s\n", cJSON_GetErrorPtr());
-        free(json_data);
+        tinycli_free(json_data);
         return TINYCLI_ERROR_PLUGIN;
     }
 
@@ -429,69 +843,118 @@ int tinycli_plugin_load_json(tinycli_context_t *ctx, const char *json_path)
 cleanup:
     /* Clean up */
     cJSON_Delete(root);
-    free(json_data);
+    tinycli_free(json_data);
 
     return ret;
 }
 
-void tinycli_plugin_list(tinycli_context_t *ctx)
+int tinycli_plugin_list(tinycli_context_t *ctx)
 {
     tinycli_plugin_t *plugin;
     int count = 0;
-    int max_name_len = 0;
-    int max_version_len = 0;
+    char dir_buf[MAX_PATH_LEN];
+    const char *plugin_dir;
+    bool text;
+    int ret;
 
     if (!ctx) {
-        return;
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
     }
 
-    /* Find maximum lengths for formatting */
     for (plugin = ctx->plugins; plugin != NULL; plugin = plugin->next) {
-        int name_len = strlen(plugin->name);
-        int version_len = plugin->version ? strlen(plugin->version) : 0;
-        
-        if (name_len > max_name_len) {
-            max_name_len = name_len;
-        }
-        
-        if (version_len > max_version_len) {
-            max_version_len = version_len;
-        }
-        
         count++;
     }
 
     /* Print plugin list header */
-    tinycli_printf(ctx, "Loaded plugins (%d):\n", count);
-    
-    if (count == 0) {
-        tinycli_printf(ctx, "  No plugins loaded\n");
-        tinycli_printf(ctx, "\nUse 'load plugin <n>' to load a plugin\n");
-        return;
+    text = tinycli_get_output_format(ctx) == TINYCLI_FORMAT_TEXT;
+    if (text) {
+        tinycli_printf(ctx, "Loaded plugins (%d):\n", count);
+        if (count == 0) {
+            tinycli_printf(ctx, "  No plugins loaded\n");
+            tinycli_printf(ctx, "\nUse 'load plugin <n>' to load a plugin\n");
+            return TINYCLI_SUCCESS;
+        }
     }
 
-    /* Print header */
-    tinycli_printf(ctx, "  %-*s  %-*s  %s\n", 
-                  max_name_len, "NAME",
-                  max_version_len, "VERSION",
-                  "DESCRIPTION");
-    
-    tinycli_printf(ctx, "  ");
-    for (int i = 0; i < max_name_len; i++) tinycli_printf(ctx, "-");
-    tinycli_printf(ctx, "  ");
-    for (int i = 0; i < max_version_len; i++) tinycli_printf(ctx, "-");
-    tinycli_printf(ctx, "  ");
-    tinycli_printf(ctx, "---------------\n");
-
-    /* Print plugins */
-    for (plugin = ctx->plugins; plugin != NULL; plugin = plugin->next) {
-        tinycli_printf(ctx, "  %-*s  %-*s  %s\n", 
-                      max_name_len, plugin->name,
-                      max_version_len, plugin->version ? plugin->version : "N/A",
-                      plugin->description ? plugin->description : "");
+    /* Emit plugins; text columns are fitted at the end */
+    ret = tinycli_table_begin(ctx, "plugins");
+    for (plugin = ctx->plugins; plugin != NULL && ret == TINYCLI_SUCCESS; plugin = plugin->next) {
+        ret = tinycli_record_begin(ctx);
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_string(ctx, "name", plugin->name);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_string(ctx, "version", plugin->version ? plugin->version : "N/A");
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_string(ctx, "description", plugin->description);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_record_end(ctx);
+        } else {
+            tinycli_record_end(ctx);
+        }
     }
-    
+    if (ret != TINYCLI_SUCCESS) {
+        tinycli_table_end(ctx);
+        return ret;
+    }
+    ret = tinycli_table_end(ctx);
+
     /* Print help message */
-    tinycli_printf(ctx, "\nPlugin directory: %s\n", tinycli_get_plugin_dir() ? tinycli_get_plugin_dir() : "Not set");
-    tinycli_printf(ctx, "Use 'load plugin <n>' to load additional plugins\n");
+    if (text) {
+        plugin_dir = tinycli_runtime_get_plugin_dir(ctx->runtime, dir_buf, sizeof(dir_buf));
+        tinycli_printf(ctx, "\nPlugin path: %s\n", plugin_dir ? plugin_dir : "Not set");
+        tinycli_printf(ctx, "Use 'load plugin <n>' to load additional plugins\n");
+    }
+
+    return ret;
+}
+
+int tinycli_plugin_list_timing(tinycli_context_t *ctx)
+{
+    tinycli_plugin_t *plugin;
+    char bind_buf[64];
+    int ret;
+
+    if (!ctx) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    /* Libraries opened by an earlier request show the time that request took */
+    ret = tinycli_table_begin(ctx, "plugin_timing");
+    for (plugin = ctx->plugins; plugin != NULL && ret == TINYCLI_SUCCESS; plugin = plugin->next) {
+        ret = tinycli_record_begin(ctx);
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_string(ctx, "name", plugin->name);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_string(ctx, "bind", plugin->image ?
+                                      tinycli_plugin_bind_format(plugin->bind, bind_buf, sizeof(bind_buf)) :
+                                      "-");
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_bool(ctx, "shared", plugin->shared);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_int(ctx, "dlopen_us", (long long)(plugin->open_ns / 1000));
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_int(ctx, "dlsym_us", (long long)(plugin->sym_ns / 1000));
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_int(ctx, "init_us", (long long)(plugin->init_ns / 1000));
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_record_end(ctx);
+        } else {
+            tinycli_record_end(ctx);
+        }
+    }
+    if (ret != TINYCLI_SUCCESS) {
+        tinycli_table_end(ctx);
+        return ret;
+    }
+
+    return tinycli_table_end(ctx);
 }
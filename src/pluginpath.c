@@ -0,0 +1,363 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "pluginpath.h"
+#include "alloc.h"
+#include "utils.h"
+
+/* Size of the buffer directory entries are read into */
+#define PLUGINPATH_DENTS_SIZE (32 * 1024)
+
+/* Directories modified this recently may change again within the same timestamp */
+#define PLUGINPATH_RACY_SEC 2
+
+/* Plugin library in a directory */
+typedef struct {
+    uint32_t hash;                  /* Hash of the name */
+    int next;                       /* Next entry in the bucket (-1 for none) */
+    char *name;                     /* Plugin name (file name without ".so") */
+} pluginpath_entry_t;
+
+/* Index of one directory */
+typedef struct pluginpath_dir {
+    char *path;                     /* Directory as given in the search path */
+    bool scanned;                   /* The index reflects the directory at some point */
+    bool racy;                      /* Scanned too close to its last change: check again */
+    dev_t dev;                      /* Device of the directory when scanned */
+    ino_t ino;                      /* Inode of the directory when scanned */
+    struct timespec mtime;          /* Modification time when scanned */
+    pluginpath_entry_t *entries;    /* Plugin libraries */
+    size_t count;                   /* Number of entries */
+    size_t cap;                     /* Capacity of entries */
+    int *buckets;                   /* First entry of each bucket (-1 for none) */
+    size_t nbuckets;                /* Number of buckets (power of two) */
+    struct pluginpath_dir *next;    /* Next indexed directory */
+} pluginpath_dir_t;
+
+/* Process-wide directory index */
+static pthread_mutex_t g_pluginpath_lock = PTHREAD_MUTEX_INITIALIZER;
+static pluginpath_dir_t *g_pluginpath_dirs = NULL;
+
+/* Drop the entries of a directory */
+static void dir_clear(pluginpath_dir_t *dir)
+{
+    size_t i;
+
+    for (i = 0; i < dir->count; i++) {
+        tinycli_free(dir->entries[i].name);
+    }
+    dir->count = 0;
+    tinycli_free(dir->buckets);
+    dir->buckets = NULL;
+    dir->nbuckets = 0;
+}
+
+/* Add a file name to a directory index if it names a plugin library */
+static int dir_add(pluginpath_dir_t *dir, const char *file)
+{
+    size_t len = strlen(file);
+    pluginpath_entry_t *entry;
+
+    if (len <= 3 || strcmp(file + len - 3, ".so") != 0) {
+        return TINYCLI_SUCCESS;
+    }
+
+    if (dir->count == dir->cap) {
+        size_t cap = dir->cap ? dir->cap * 2 : 16;
+        pluginpath_entry_t *entries = (pluginpath_entry_t *)tinycli_realloc(
+            TINYCLI_MEM_PLUGINS, dir->entries, cap * sizeof(*entries));
+        if (!entries) {
+            return TINYCLI_ERROR_MEMORY;
+        }
+        dir->entries = entries;
+        dir->cap = cap;
+    }
+
+    entry = &dir->entries[dir->count];
+    entry->name = (char *)tinycli_malloc(TINYCLI_MEM_PLUGINS, len - 2);
+    if (!entry->name) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+    memcpy(entry->name, file, len - 3);
+    entry->name[len - 3] = '\0';
+    entry->hash = tinycli_hash(entry->name, len - 3);
+    dir->count++;
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Read the file names of a directory into its index */
+static int dir_read(pluginpath_dir_t *dir, int fd)
+{
+#ifdef __linux__
+    char *buf;
+    long n = 0, pos;
+    int ret = TINYCLI_SUCCESS;
+
+    buf = (char *)tinycli_malloc(TINYCLI_MEM_PLUGINS, PLUGINPATH_DENTS_SIZE);
+    if (!buf) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    /* Raw entries, many per system call, without a DIR stream */
+    while (ret == TINYCLI_SUCCESS &&
+           (n = syscall(SYS_getdents64, fd, buf, PLUGINPATH_DENTS_SIZE)) > 0) {
+        for (pos = 0; pos < n && ret == TINYCLI_SUCCESS;) {
+            struct dirent64 *dent = (struct dirent64 *)(buf + pos);
+            if (dent->d_type != DT_DIR) {
+                ret = dir_add(dir, dent->d_name);
+            }
+            pos += dent->d_reclen;
+        }
+    }
+    if (n < 0 && ret == TINYCLI_SUCCESS) {
+        ret = TINYCLI_ERROR_GENERAL;
+    }
+
+    tinycli_free(buf);
+    return ret;
+#else
+    struct dirent *dent;
+    DIR *d;
+    int ret = TINYCLI_SUCCESS;
+
+    d = fdopendir(dup(fd));
+    if (!d) {
+        return TINYCLI_ERROR_GENERAL;
+    }
+    while (ret == TINYCLI_SUCCESS && (dent = readdir(d)) != NULL) {
+        ret = dir_add(dir, dent->d_name);
+    }
+    closedir(d);
+    return ret;
+#endif
+}
+
+/* Hash the entries of a directory into buckets */
+static int dir_hash(pluginpath_dir_t *dir)
+{
+    size_t nbuckets = 16, i, b;
+
+    while (nbuckets < dir->count * 2) {
+        nbuckets *= 2;
+    }
+    dir->buckets = (int *)tinycli_malloc(TINYCLI_MEM_PLUGINS, nbuckets * sizeof(int));
+    if (!dir->buckets) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+    dir->nbuckets = nbuckets;
+    memset(dir->buckets, 0xff, nbuckets * sizeof(int));
+
+    for (i = 0; i < dir->count; i++) {
+        b = dir->entries[i].hash & (nbuckets - 1);
+        dir->entries[i].next = dir->buckets[b];
+        dir->buckets[b] = (int)i;
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Bring the index of a directory up to date (lock held) */
+static void dir_refresh(pluginpath_dir_t *dir)
+{
+    struct stat st;
+    int fd;
+
+    /* The directory changes whenever a file is added, removed or renamed */
+    if (stat(dir->path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        dir_clear(dir);
+        dir->scanned = false;
+        return;
+    }
+    if (dir->scanned && !dir->racy && st.st_dev == dir->dev && st.st_ino == dir->ino &&
+        st.st_mtim.tv_sec == dir->mtime.tv_sec && st.st_mtim.tv_nsec == dir->mtime.tv_nsec) {
+        return;
+    }
+
+    dir_clear(dir);
+    dir->scanned = false;
+    fd = open(dir->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    if (dir_read(dir, fd) != TINYCLI_SUCCESS || dir_hash(dir) != TINYCLI_SUCCESS) {
+        close(fd);
+        dir_clear(dir);
+        return;
+    }
+    close(fd);
+
+    dir->scanned = true;
+    dir->dev = st.st_dev;
+    dir->ino = st.st_ino;
+    dir->mtime = st.st_mtim;
+
+    /* A change in the same timestamp tick as the scan wouldn't show in the mtime */
+    dir->racy = time(NULL) - st.st_mtim.tv_sec < PLUGINPATH_RACY_SEC;
+}
+
+/* Find the index of a directory as it is (lock held) */
+static pluginpath_dir_t *dir_find(const char *path, size_t len)
+{
+    pluginpath_dir_t *dir;
+
+    for (dir = g_pluginpath_dirs; dir != NULL; dir = dir->next) {
+        if (strncmp(dir->path, path, len) == 0 && dir->path[len] == '\0') {
+            return dir;
+        }
+    }
+
+    return NULL;
+}
+
+/* Get the up-to-date index of a directory (lock held) */
+static pluginpath_dir_t *dir_get(const char *path, size_t len)
+{
+    pluginpath_dir_t *dir = dir_find(path, len);
+
+    if (!dir) {
+        dir = (pluginpath_dir_t *)tinycli_calloc(TINYCLI_MEM_PLUGINS, 1, sizeof(*dir));
+        if (!dir) {
+            return NULL;
+        }
+        dir->path = (char *)tinycli_malloc(TINYCLI_MEM_PLUGINS, len + 1);
+        if (!dir->path) {
+            tinycli_free(dir);
+            return NULL;
+        }
+        memcpy(dir->path, path, len);
+        dir->path[len] = '\0';
+        dir->next = g_pluginpath_dirs;
+        g_pluginpath_dirs = dir;
+    }
+
+    dir_refresh(dir);
+
+    return dir;
+}
+
+/* Look a plugin name up in a directory index */
+static bool dir_contains(const pluginpath_dir_t *dir, const char *name, uint32_t hash)
+{
+    int i;
+
+    if (!dir->scanned) {
+        return false;
+    }
+
+    for (i = dir->buckets[hash & (dir->nbuckets - 1)]; i >= 0; i = dir->entries[i].next) {
+        if (dir->entries[i].hash == hash && strcmp(dir->entries[i].name, name) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Find the next directory of a search path: sets *len and returns its start, NULL at the end */
+static const char *path_next(const char **cursor, size_t *len)
+{
+    const char *start = *cursor, *end;
+
+    while (*start == ':') {
+        start++;
+    }
+    if (*start == '\0') {
+        return NULL;
+    }
+
+    end = strchr(start, ':');
+    if (!end) {
+        end = start + strlen(start);
+    }
+    *len = (size_t)(end - start);
+    *cursor = end;
+
+    return start;
+}
+
+bool tinycli_plugin_path_find(const char *search_path, const char *name, char *path, size_t size)
+{
+    const char *cursor = search_path, *start;
+    pluginpath_dir_t *dir;
+    uint32_t hash;
+    size_t len;
+    int n;
+
+    if (!search_path || !name || !path || size == 0 || strchr(name, '/')) {
+        return false;
+    }
+
+    hash = tinycli_hash(name, strlen(name));
+
+    pthread_mutex_lock(&g_pluginpath_lock);
+    while ((start = path_next(&cursor, &len)) != NULL) {
+        dir = dir_get(start, len);
+        if (dir && dir_contains(dir, name, hash)) {
+            n = snprintf(path, size, "%s/%s.so", dir->path, name);
+            pthread_mutex_unlock(&g_pluginpath_lock);
+            return n > 0 && (size_t)n < size;
+        }
+    }
+    pthread_mutex_unlock(&g_pluginpath_lock);
+
+    return false;
+}
+
+int tinycli_plugin_path_complete(const char *search_path, const char *prefix,
+                                 tinycli_completion_emitter_t *emitter)
+{
+    const char *cursor = search_path, *start, *earlier_cursor, *earlier;
+    pluginpath_dir_t *dir, *other;
+    pluginpath_entry_t *entry;
+    size_t len, other_len, prefix_len, i;
+    bool shadowed;
+    int ret = TINYCLI_SUCCESS;
+
+    if (!search_path || !prefix || !emitter) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+    prefix_len = strlen(prefix);
+
+    pthread_mutex_lock(&g_pluginpath_lock);
+    while (ret == TINYCLI_SUCCESS && (start = path_next(&cursor, &len)) != NULL) {
+        dir = dir_get(start, len);
+        if (!dir || !dir->scanned) {
+            continue;
+        }
+
+        for (i = 0; i < dir->count && ret == TINYCLI_SUCCESS; i++) {
+            entry = &dir->entries[i];
+            if (strncmp(entry->name, prefix, prefix_len) != 0) {
+                continue;
+            }
+
+            /* Names in an earlier directory (refreshed already) hide this one */
+            shadowed = false;
+            earlier_cursor = search_path;
+            while (!shadowed && (earlier = path_next(&earlier_cursor, &other_len)) != start) {
+                other = dir_find(earlier, other_len);
+                shadowed = other && other != dir && dir_contains(other, entry->name, entry->hash);
+            }
+            if (!shadowed) {
+                ret = tinycli_completion_emit(emitter, entry->name);
+            }
+        }
+    }
+    pthread_mutex_unlock(&g_pluginpath_lock);
+
+    return ret;
+}
@@ -0,0 +1,768 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <semaphore.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#include "pool.h"
+#include "context.h"
+#include "command.h"
+#include "cancel.h"
+#include "output.h"
+#include "emit.h"
+#include "alloc.h"
+
+/* Time between liveness checks while waiting for a worker */
+#define POOL_WAIT_MS 50
+
+/* Size of a response frame header: type and length */
+#define POOL_FRAME_HEADER 5
+
+/* Single-producer, single-consumer byte ring in shared memory */
+typedef struct {
+    uint32_t head;                  /* Bytes written so far (wraps around) */
+    uint32_t tail;                  /* Bytes read so far (wraps around) */
+    uint32_t size;                  /* Capacity (power of two) */
+    uint32_t offset;                /* Offset of the data in the region */
+    sem_t data;                     /* Posted after every write */
+    sem_t space;                    /* Posted after every read */
+} pool_ring_t;
+
+/* Shared memory region of a worker */
+typedef struct {
+    pool_ring_t request;            /* Shell to worker */
+    pool_ring_t response;           /* Worker to shell */
+} pool_shm_t;
+
+/* Offset of the ring data, after the header */
+#define POOL_SHM_HEADER ((sizeof(pool_shm_t) + 63) & ~(size_t)63)
+
+/* Size of the shared memory region of a worker */
+#define POOL_SHM_SIZE (POOL_SHM_HEADER + TINYCLI_POOL_REQUEST_RING + TINYCLI_POOL_RESPONSE_RING)
+
+/* Worker slot */
+typedef struct {
+    pid_t pid;                      /* Worker process (0 when not running) */
+    uint64_t generation;            /* Registry generation it was forked with */
+    pool_shm_t *shm;                /* Shared rings */
+    bool sems;                      /* Semaphores are initialized */
+    bool busy;                      /* Taken by a caller */
+    bool respawn;                   /* A caller on another thread waits for a fresh worker */
+    bool spawning;                  /* Being forked by the owner thread */
+    uint64_t runs;                  /* Commands run in this slot */
+    uint64_t restarts;              /* Times the slot's worker was replaced */
+} pool_worker_t;
+
+/* Pool of worker processes */
+struct tinycli_pool {
+    pthread_mutex_t lock;           /* Protects the busy and spawn flags */
+    pthread_cond_t idle;            /* Signalled when a worker becomes idle */
+    pthread_cond_t spawned;         /* Signalled when the owner has forked requested workers */
+    pthread_t owner;                /* Thread that forks workers (the one that set up the pool) */
+    unsigned int count;             /* Number of workers */
+    pool_worker_t workers[TINYCLI_POOL_MAX_WORKERS]; /* Worker slots */
+};
+
+/* Command in flight, seen from the shell */
+typedef struct {
+    tinycli_context_t *ctx;         /* Context of the caller */
+    pool_worker_t *worker;          /* Worker running the command */
+    int status;                     /* Wait status once the worker died */
+} pool_call_t;
+
+/* Wait on a ring semaphore; in the shell, stop if the worker died or the command was cancelled */
+static int pool_wait(sem_t *sem, pool_call_t *call)
+{
+    struct timespec ts;
+
+    if (!call) {
+        while (sem_wait(sem) != 0) {
+            if (errno != EINTR) {
+                return TINYCLI_ERROR_GENERAL;
+            }
+        }
+        return TINYCLI_SUCCESS;
+    }
+
+    for (;;) {
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += POOL_WAIT_MS * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        if (sem_timedwait(sem, &ts) == 0) {
+            break;
+        }
+        if (errno != ETIMEDOUT && errno != EINTR) {
+            return TINYCLI_ERROR_GENERAL;
+        }
+
+        if (waitpid(call->worker->pid, &call->status, WNOHANG) == call->worker->pid) {
+            call->worker->pid = 0;
+            return TINYCLI_ERROR_PLUGIN;
+        }
+        if (tinycli_cancelled(call->ctx)) {
+            return TINYCLI_ERROR_CANCELLED;
+        }
+    }
+
+    /* Posts for data seen since are stale; the caller looks at the ring again */
+    while (sem_trywait(sem) == 0) {
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Copy bytes into a ring, waiting for space */
+static int ring_write(pool_shm_t *shm, pool_ring_t *ring, const void *data, size_t len,
+                      pool_call_t *call)
+{
+    char *base = (char *)shm + ring->offset;
+    const char *p = (const char *)data;
+    uint32_t head, room, pos, n, first;
+    int ret;
+
+    while (len > 0) {
+        head = ring->head;
+        room = ring->size - (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE));
+        if (room == 0) {
+            ret = pool_wait(&ring->space, call);
+            if (ret != TINYCLI_SUCCESS) {
+                return ret;
+            }
+            continue;
+        }
+
+        n = len < room ? (uint32_t)len : room;
+        pos = head & (ring->size - 1);
+        first = n < ring->size - pos ? n : ring->size - pos;
+        memcpy(base + pos, p, first);
+        memcpy(base, p + first, n - first);
+        __atomic_store_n(&ring->head, head + n, __ATOMIC_RELEASE);
+        sem_post(&ring->data);
+
+        p += n;
+        len -= n;
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Copy bytes out of a ring, waiting for data */
+static int ring_read(pool_shm_t *shm, pool_ring_t *ring, void *data, size_t len, pool_call_t *call)
+{
+    char *base = (char *)shm + ring->offset;
+    char *p = (char *)data;
+    uint32_t tail, avail, pos, n, first;
+    int ret;
+
+    while (len > 0) {
+        tail = ring->tail;
+        avail = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - tail;
+        if (avail == 0) {
+            ret = pool_wait(&ring->data, call);
+            if (ret != TINYCLI_SUCCESS) {
+                return ret;
+            }
+            continue;
+        }
+
+        n = len < avail ? (uint32_t)len : avail;
+        pos = tail & (ring->size - 1);
+        first = n < ring->size - pos ? n : ring->size - pos;
+        memcpy(p, base + pos, first);
+        memcpy(p + first, base, n - first);
+        __atomic_store_n(&ring->tail, tail + n, __ATOMIC_RELEASE);
+        sem_post(&ring->space);
+
+        p += n;
+        len -= n;
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Send a response frame (worker side) */
+static int pool_send_frame(pool_shm_t *shm, char type, const void *data, uint32_t len)
+{
+    char header[POOL_FRAME_HEADER];
+    int ret;
+
+    header[0] = type;
+    memcpy(header + 1, &len, sizeof(len));
+    ret = ring_write(shm, &shm->response, header, sizeof(header), NULL);
+    if (ret == TINYCLI_SUCCESS) {
+        ret = ring_write(shm, &shm->response, data, len, NULL);
+    }
+
+    return ret;
+}
+
+/* Output stream of a worker: everything written becomes an output frame */
+static ssize_t pool_stream_write(void *cookie, const char *buf, size_t size)
+{
+    if (size > UINT32_MAX || pool_send_frame((pool_shm_t *)cookie, 'O', buf, (uint32_t)size) != TINYCLI_SUCCESS) {
+        return -1;
+    }
+
+    return (ssize_t)size;
+}
+
+/* Main loop of a worker process */
+static void pool_child_main(tinycli_context_t *ctx, pool_shm_t *shm)
+{
+    cookie_io_functions_t io = { NULL, pool_stream_write, NULL, NULL };
+    tinycli_command_t *cmd;
+    sigset_t none;
+    FILE *stream;
+    char *buf = NULL, *p, **argv = NULL;
+    size_t cap = 0;
+    uint32_t len, format, argc, i;
+    int status;
+
+    /* Ctrl-C is for the shell, which kills the worker if it has to */
+    signal(SIGINT, SIG_IGN);
+    signal(SIGTERM, SIG_DFL);
+    sigemptyset(&none);
+    sigprocmask(SIG_SETMASK, &none, NULL);
+#ifdef __linux__
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+
+    /* Only this thread exists here: forget the shell's threads and commands */
+    tinycli_cancel_after_fork(ctx);
+    ctx->pool = NULL;
+    tinycli_emit_init(&ctx->emit);
+
+    /* Both stdout and the context's output go back to the shell */
+    stream = fopencookie(shm, "w", io);
+    if (!stream) {
+        _exit(1);
+    }
+    setvbuf(stream, NULL, _IOFBF, 4096);
+    stdout = stream;
+    tinycli_output_init(&ctx->output);
+
+    for (;;) {
+        /* Read a request */
+        if (ring_read(shm, &shm->request, &len, sizeof(len), NULL) != TINYCLI_SUCCESS || len < 8) {
+            break;
+        }
+        if (len + 1 > cap) {
+            char *grown = (char *)tinycli_realloc(TINYCLI_MEM_CORE, buf, len + 1);
+            if (!grown) {
+                break;
+            }
+            buf = grown;
+            cap = len + 1;
+        }
+        if (ring_read(shm, &shm->request, buf, len, NULL) != TINYCLI_SUCCESS) {
+            break;
+        }
+        buf[len] = '\0';
+
+        /* Split it into the command name and arguments */
+        memcpy(&format, buf, sizeof(format));
+        memcpy(&argc, buf + 4, sizeof(argc));
+        p = buf + 8;
+        cmd = tinycli_command_find(ctx, p);
+        p += strlen(p) + 1;
+
+        tinycli_free(argv);
+        argv = (char **)tinycli_malloc(TINYCLI_MEM_CORE, (argc + 1) * sizeof(char *));
+        if (!argv) {
+            break;
+        }
+        for (i = 0; i < argc && p < buf + len; i++) {
+            argv[i] = p;
+            p += strlen(p) + 1;
+        }
+        argv[i] = NULL;
+
+        /* Run it */
+        if (!cmd || i != argc) {
+            status = TINYCLI_ERROR_NOT_FOUND;
+        } else {
+            tinycli_set_output_format(ctx, (tinycli_output_format_t)format);
+            status = cmd->handler((int)argc, argv, ctx);
+        }
+        tinycli_output_flush(ctx);
+        fflush(stream);
+
+        if (pool_send_frame(shm, 'R', &status, sizeof(status)) != TINYCLI_SUCCESS) {
+            break;
+        }
+    }
+
+    _exit(0);
+}
+
+/* Set up the rings of a worker slot */
+static void pool_shm_init(pool_worker_t *worker)
+{
+    pool_shm_t *shm = worker->shm;
+
+    if (worker->sems) {
+        sem_destroy(&shm->request.data);
+        sem_destroy(&shm->request.space);
+        sem_destroy(&shm->response.data);
+        sem_destroy(&shm->response.space);
+    }
+
+    memset(shm, 0, sizeof(*shm));
+    shm->request.size = TINYCLI_POOL_REQUEST_RING;
+    shm->request.offset = (uint32_t)POOL_SHM_HEADER;
+    shm->response.size = TINYCLI_POOL_RESPONSE_RING;
+    shm->response.offset = (uint32_t)(POOL_SHM_HEADER + TINYCLI_POOL_REQUEST_RING);
+    sem_init(&shm->request.data, 1, 0);
+    sem_init(&shm->request.space, 1, 0);
+    sem_init(&shm->response.data, 1, 0);
+    sem_init(&shm->response.space, 1, 0);
+    worker->sems = true;
+}
+
+/* Kill the process of a worker slot */
+static void pool_kill(pool_worker_t *worker)
+{
+    int status;
+
+    if (worker->pid > 0) {
+        kill(worker->pid, SIGKILL);
+        while (waitpid(worker->pid, &status, 0) < 0 && errno == EINTR) {
+        }
+        worker->pid = 0;
+    }
+}
+
+/* Fork a worker for a slot from the current state of the context */
+static int pool_spawn(tinycli_context_t *ctx, pool_worker_t *worker)
+{
+    pid_t pid;
+
+    if (worker->pid > 0) {
+        pool_kill(worker);
+        worker->restarts++;
+    }
+    pool_shm_init(worker);
+
+    /* Don't let the child inherit buffered output */
+    tinycli_output_flush(ctx);
+    fflush(stdout);
+    fflush(stderr);
+
+    pid = fork();
+    if (pid < 0) {
+        return TINYCLI_ERROR_GENERAL;
+    }
+    if (pid == 0) {
+        pool_child_main(ctx, worker->shm);
+    }
+
+    worker->pid = pid;
+    worker->generation = ctx->generation;
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Get a fresh worker into a slot taken by the caller */
+static int pool_refresh(tinycli_context_t *ctx, tinycli_pool_t *pool, pool_worker_t *worker)
+{
+    struct timespec ts;
+    int ret = TINYCLI_SUCCESS;
+
+    /* The owner forks right here */
+    if (pthread_equal(pthread_self(), pool->owner)) {
+        return pool_spawn(ctx, worker);
+    }
+
+    /*
+     * Anywhere else (the command worker thread, usually) fork() would copy
+     * a process whose helper threads may hold locks: ask the owner, which
+     * waits on the cancellation pipe while a command runs, to do it.
+     */
+    pthread_mutex_lock(&pool->lock);
+    worker->respawn = true;
+    pthread_mutex_unlock(&pool->lock);
+    if (ctx->cancel_pipe[1] >= 0) {
+        ssize_t n = write(ctx->cancel_pipe[1], "p", 1);
+        (void)n;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    while (worker->respawn || worker->spawning) {
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += POOL_WAIT_MS * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&pool->spawned, &pool->lock, &ts);
+        if (worker->respawn && tinycli_cancelled(ctx)) {
+            worker->respawn = false;
+            ret = TINYCLI_ERROR_CANCELLED;
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (ret == TINYCLI_SUCCESS && (worker->pid == 0 || worker->generation != ctx->generation)) {
+        ret = TINYCLI_ERROR_GENERAL;
+    }
+
+    return ret;
+}
+
+void tinycli_pool_service(tinycli_context_t *ctx)
+{
+    tinycli_pool_t *pool;
+    bool mine[TINYCLI_POOL_MAX_WORKERS], todo[TINYCLI_POOL_MAX_WORKERS];
+    pool_worker_t *worker;
+    unsigned int i;
+    bool any = false;
+
+    if (!ctx || !ctx->pool || !pthread_equal(pthread_self(), ctx->pool->owner)) {
+        return;
+    }
+    pool = ctx->pool;
+
+    /* Requested slots, and idle ones that died or predate the registry */
+    pthread_mutex_lock(&pool->lock);
+    for (i = 0; i < pool->count; i++) {
+        worker = &pool->workers[i];
+        mine[i] = false;
+        todo[i] = worker->respawn;
+        if (!worker->busy && (worker->pid == 0 || worker->generation != ctx->generation)) {
+            worker->busy = true;
+            mine[i] = todo[i] = true;
+        }
+        if (todo[i]) {
+            worker->respawn = false;
+            worker->spawning = true;
+            any = true;
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    if (!any) {
+        return;
+    }
+
+    for (i = 0; i < pool->count; i++) {
+        if (todo[i]) {
+            pool_spawn(ctx, &pool->workers[i]);
+        }
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    for (i = 0; i < pool->count; i++) {
+        if (todo[i]) {
+            pool->workers[i].spawning = false;
+        }
+        if (mine[i]) {
+            pool->workers[i].busy = false;
+        }
+    }
+    pthread_cond_broadcast(&pool->spawned);
+    pthread_cond_broadcast(&pool->idle);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* Take an idle worker, waiting for one if all are busy */
+static pool_worker_t *pool_acquire(tinycli_pool_t *pool)
+{
+    pool_worker_t *worker = NULL;
+    unsigned int i;
+
+    pthread_mutex_lock(&pool->lock);
+    while (!worker) {
+        for (i = 0; i < pool->count; i++) {
+            if (!pool->workers[i].busy) {
+                worker = &pool->workers[i];
+                worker->busy = true;
+                break;
+            }
+        }
+        if (!worker) {
+            pthread_cond_wait(&pool->idle, &pool->lock);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return worker;
+}
+
+/* Give a worker back */
+static void pool_release(tinycli_pool_t *pool, pool_worker_t *worker)
+{
+    pthread_mutex_lock(&pool->lock);
+    worker->busy = false;
+    pthread_cond_signal(&pool->idle);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* Send a request for a command */
+static int pool_send_request(pool_call_t *call, tinycli_command_t *cmd, int argc, char **argv)
+{
+    pool_shm_t *shm = call->worker->shm;
+    uint32_t len, format, count = (uint32_t)argc;
+    size_t total = 8 + cmd->name_len + 1;
+    int i, ret;
+
+    for (i = 0; i < argc; i++) {
+        total += strlen(argv[i]) + 1;
+    }
+    if (total > UINT32_MAX) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+    len = (uint32_t)total;
+    format = (uint32_t)tinycli_get_output_format(call->ctx);
+
+    /* The ring streams: requests larger than it are fine */
+    ret = ring_write(shm, &shm->request, &len, sizeof(len), call);
+    if (ret == TINYCLI_SUCCESS) {
+        ret = ring_write(shm, &shm->request, &format, sizeof(format), call);
+    }
+    if (ret == TINYCLI_SUCCESS) {
+        ret = ring_write(shm, &shm->request, &count, sizeof(count), call);
+    }
+    if (ret == TINYCLI_SUCCESS) {
+        ret = ring_write(shm, &shm->request, cmd->name, cmd->name_len + 1, call);
+    }
+    for (i = 0; i < argc && ret == TINYCLI_SUCCESS; i++) {
+        ret = ring_write(shm, &shm->request, argv[i], strlen(argv[i]) + 1, call);
+    }
+
+    return ret;
+}
+
+/* Copy output frames to the context until the result frame */
+static int pool_receive(pool_call_t *call, int *status)
+{
+    pool_shm_t *shm = call->worker->shm;
+    char header[POOL_FRAME_HEADER], buf[4096];
+    uint32_t len, n;
+    int ret;
+
+    for (;;) {
+        ret = ring_read(shm, &shm->response, header, sizeof(header), call);
+        if (ret != TINYCLI_SUCCESS) {
+            return ret;
+        }
+        memcpy(&len, header + 1, sizeof(len));
+
+        if (header[0] == 'R') {
+            if (len != sizeof(*status)) {
+                return TINYCLI_ERROR_GENERAL;
+            }
+            return ring_read(shm, &shm->response, status, sizeof(*status), call);
+        }
+
+        /* Output: pass it on as it arrives */
+        while (len > 0) {
+            n = len < sizeof(buf) ? len : (uint32_t)sizeof(buf);
+            ret = ring_read(shm, &shm->response, buf, n, call);
+            if (ret != TINYCLI_SUCCESS) {
+                return ret;
+            }
+            tinycli_output_write(call->ctx, buf, n);
+            len -= n;
+        }
+    }
+}
+
+int tinycli_pool_execute(tinycli_context_t *ctx, tinycli_command_t *cmd, int argc, char **argv)
+{
+    tinycli_pool_t *pool;
+    pool_call_t call;
+    int ret, status = TINYCLI_ERROR_GENERAL;
+
+    if (!ctx || !ctx->pool || !cmd) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+    pool = ctx->pool;
+
+    memset(&call, 0, sizeof(call));
+    call.ctx = ctx;
+    call.worker = pool_acquire(pool);
+
+    /* Normally replaced ahead of time; a plugin loaded by this command's caller isn't */
+    if (call.worker->pid == 0 || call.worker->generation != ctx->generation) {
+        ret = pool_refresh(ctx, pool, call.worker);
+        if (ret != TINYCLI_SUCCESS) {
+            pool_release(pool, call.worker);
+            return ret;
+        }
+    }
+    call.worker->runs++;
+
+    ret = pool_send_request(&call, cmd, argc, argv);
+    if (ret == TINYCLI_SUCCESS) {
+        ret = pool_receive(&call, &status);
+    }
+
+    if (ret == TINYCLI_ERROR_PLUGIN) {
+        if (WIFSIGNALED(call.status)) {
+            TINYCLI_LOG(TINYCLI_LOG_WARN, "Worker died running %s: %s", cmd->name,
+                        strsignal(WTERMSIG(call.status)));
+            tinycli_printf(ctx, "Worker for %s died: %s\n", cmd->name, strsignal(WTERMSIG(call.status)));
+        } else {
+            TINYCLI_LOG(TINYCLI_LOG_WARN, "Worker exited running %s with status %d", cmd->name,
+                        WIFEXITED(call.status) ? WEXITSTATUS(call.status) : -1);
+            tinycli_printf(ctx, "Worker for %s exited with status %d\n", cmd->name,
+                           WIFEXITED(call.status) ? WEXITSTATUS(call.status) : -1);
+        }
+    }
+
+    /* A worker that died or was left mid-command goes; the owner forks its replacement */
+    if (ret != TINYCLI_SUCCESS) {
+        pool_kill(call.worker);
+        call.worker->restarts++;
+        if (pthread_equal(pthread_self(), pool->owner)) {
+            pool_spawn(ctx, call.worker);
+        }
+        status = ret;
+    }
+
+    pool_release(pool, call.worker);
+
+    return status;
+}
+
+int tinycli_pool_list(tinycli_context_t *ctx)
+{
+    tinycli_pool_t *pool;
+    pool_worker_t *worker;
+    unsigned int i;
+    int ret;
+
+    if (!ctx) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    pool = ctx->pool;
+    if (!pool) {
+        if (tinycli_get_output_format(ctx) == TINYCLI_FORMAT_TEXT) {
+            tinycli_printf(ctx, "Isolation is off\n");
+        }
+        return TINYCLI_SUCCESS;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    ret = tinycli_table_begin(ctx, "workers");
+    for (i = 0; i < pool->count && ret == TINYCLI_SUCCESS; i++) {
+        worker = &pool->workers[i];
+        ret = tinycli_record_begin(ctx);
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_int(ctx, "slot", i);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_int(ctx, "pid", worker->pid);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_string(ctx, "state", worker->pid == 0 ? "down" :
+                                      worker->busy ? "busy" :
+                                      worker->generation != ctx->generation ? "stale" : "idle");
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_int(ctx, "runs", (long long)worker->runs);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_int(ctx, "restarts", (long long)worker->restarts);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_record_end(ctx);
+        } else {
+            tinycli_record_end(ctx);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    if (ret != TINYCLI_SUCCESS) {
+        tinycli_table_end(ctx);
+        return ret;
+    }
+
+    return tinycli_table_end(ctx);
+}
+
+void tinycli_pool_destroy(tinycli_pool_t *pool)
+{
+    unsigned int i;
+
+    if (!pool) {
+        return;
+    }
+
+    for (i = 0; i < pool->count; i++) {
+        pool_worker_t *worker = &pool->workers[i];
+
+        pool_kill(worker);
+        if (worker->sems) {
+            sem_destroy(&worker->shm->request.data);
+            sem_destroy(&worker->shm->request.space);
+            sem_destroy(&worker->shm->response.data);
+            sem_destroy(&worker->shm->response.space);
+        }
+        munmap(worker->shm, POOL_SHM_SIZE);
+    }
+
+    pthread_cond_destroy(&pool->spawned);
+    pthread_cond_destroy(&pool->idle);
+    pthread_mutex_destroy(&pool->lock);
+    tinycli_free(pool);
+}
+
+int tinycli_set_isolation(tinycli_context_t *ctx, unsigned int workers)
+{
+    tinycli_pool_t *pool;
+    unsigned int i;
+    void *shm;
+
+    if (!ctx || workers > TINYCLI_POOL_MAX_WORKERS) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    tinycli_pool_destroy(ctx->pool);
+    ctx->pool = NULL;
+    if (workers == 0) {
+        return TINYCLI_SUCCESS;
+    }
+
+    pool = (tinycli_pool_t *)tinycli_calloc(TINYCLI_MEM_CORE, 1, sizeof(*pool));
+    if (!pool) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+    pthread_cond_init(&pool->spawned, NULL);
+    pool->owner = pthread_self();
+
+    /* Map the rings of every slot and fork its worker */
+    for (i = 0; i < workers; i++) {
+        shm = mmap(NULL, POOL_SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (shm == MAP_FAILED) {
+            break;
+        }
+        pool->workers[i].shm = (pool_shm_t *)shm;
+        pool->count++;
+        if (pool_spawn(ctx, &pool->workers[i]) != TINYCLI_SUCCESS) {
+            break;
+        }
+    }
+    if (i < workers) {
+        tinycli_pool_destroy(pool);
+        return TINYCLI_ERROR_GENERAL;
+    }
+
+    ctx->pool = pool;
+
+    return TINYCLI_SUCCESS;
+}
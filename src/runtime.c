@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <libgen.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "runtime.h"
+#include "context.h"
+#include "plugin.h"
+#include "alloc.h"
+#include "utils.h"
+
+/* Process-wide default runtime */
+static tinycli_runtime_t g_default_runtime;
+static pthread_once_t g_default_once = PTHREAD_ONCE_INIT;
+
+/* Find the plugin search path from the environment or executable location */
+static char *runtime_find_plugin_dir(char *buffer, size_t size)
+{
+    char path[PATH_MAX];
+    ssize_t len;
+
+    /* First try the search path, then the single directory */
+    const char *plugin_dir = getenv("TINYCLI_PLUGIN_PATH");
+    if (!plugin_dir || !*plugin_dir) {
+        plugin_dir = getenv("TINYCLI_PLUGIN_DIR");
+    }
+    if (plugin_dir && *plugin_dir) {
+        snprintf(buffer, size, "%s", plugin_dir);
+        return buffer;
+    }
+
+    /* Fall back to executable directory */
+    len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (len > 0) {
+        path[len] = '\0';
+        snprintf(buffer, size, "%s", dirname(path));
+        return buffer;
+    }
+
+    return NULL;
+}
+
+/* Initialize runtime fields */
+static int runtime_init(tinycli_runtime_t *runtime)
+{
+    char dir[PATH_MAX];
+    const char *bind;
+
+    memset(runtime, 0, sizeof(*runtime));
+    if (pthread_mutex_init(&runtime->lock, NULL) != 0) {
+        return TINYCLI_ERROR_GENERAL;
+    }
+    runtime->refs = 1;
+
+    /* Resolve the plugin search path once for all contexts */
+    if (runtime_find_plugin_dir(dir, sizeof(dir))) {
+        runtime->plugin_dir = tinycli_mem_strdup(TINYCLI_MEM_PLUGINS, dir);
+    }
+
+    /* Bind plugin libraries eagerly and locally unless told otherwise */
+    bind = getenv("TINYCLI_PLUGIN_BIND");
+    if (bind && *bind && tinycli_plugin_bind_parse(bind, &runtime->plugin_bind) != TINYCLI_SUCCESS) {
+        runtime->plugin_bind = TINYCLI_PLUGIN_BIND_NOW;
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+static void runtime_default_init(void)
+{
+    runtime_init(&g_default_runtime);
+    g_default_runtime.is_default = true;
+}
+
+tinycli_runtime_t *tinycli_runtime_default(void)
+{
+    pthread_once(&g_default_once, runtime_default_init);
+    return &g_default_runtime;
+}
+
+tinycli_runtime_t *tinycli_runtime_create(void)
+{
+    tinycli_runtime_t *runtime;
+
+    runtime = (tinycli_runtime_t *)tinycli_malloc(TINYCLI_MEM_CORE, sizeof(tinycli_runtime_t));
+    if (!runtime) {
+        return NULL;
+    }
+
+    if (runtime_init(runtime) != TINYCLI_SUCCESS) {
+        tinycli_free(runtime);
+        return NULL;
+    }
+
+    return runtime;
+}
+
+tinycli_runtime_t *tinycli_runtime_retain(tinycli_runtime_t *runtime)
+{
+    if (runtime) {
+        __atomic_add_fetch(&runtime->refs, 1, __ATOMIC_RELAXED);
+    }
+
+    return runtime;
+}
+
+void tinycli_runtime_release(tinycli_runtime_t *runtime)
+{
+    if (!runtime || runtime->is_default) {
+        return;
+    }
+
+    if (__atomic_sub_fetch(&runtime->refs, 1, __ATOMIC_ACQ_REL) != 0) {
+        return;
+    }
+
+    /* Last reference: free the runtime */
+    tinycli_watchdog_destroy(runtime->watchdog);
+    tinycli_free(runtime->plugin_dir);
+    pthread_mutex_destroy(&runtime->lock);
+    tinycli_free(runtime);
+}
+
+tinycli_runtime_t *tinycli_get_runtime(tinycli_context_t *ctx)
+{
+    return ctx ? ctx->runtime : NULL;
+}
+
+void tinycli_runtime_set_plugin_dir(tinycli_runtime_t *runtime, const char *dir)
+{
+    char *copy = NULL;
+    char *old;
+
+    if (!runtime) {
+        runtime = tinycli_runtime_default();
+    }
+
+    if (dir) {
+        copy = tinycli_mem_strdup(TINYCLI_MEM_PLUGINS, dir);
+        if (!copy) {
+            return;
+        }
+    }
+
+    pthread_mutex_lock(&runtime->lock);
+    old = runtime->plugin_dir;
+    runtime->plugin_dir = copy;
+    pthread_mutex_unlock(&runtime->lock);
+
+    tinycli_free(old);
+}
+
+char *tinycli_runtime_get_plugin_dir(tinycli_runtime_t *runtime, char *buffer, size_t size)
+{
+    char *ret = NULL;
+
+    if (!buffer || size == 0) {
+        return NULL;
+    }
+
+    if (!runtime) {
+        runtime = tinycli_runtime_default();
+    }
+
+    pthread_mutex_lock(&runtime->lock);
+    if (runtime->plugin_dir && strlen(runtime->plugin_dir) < size) {
+        strcpy(buffer, runtime->plugin_dir);
+        ret = buffer;
+    }
+    pthread_mutex_unlock(&runtime->lock);
+
+    return ret;
+}
+
+void tinycli_runtime_set_plugin_bind(tinycli_runtime_t *runtime, unsigned int bind)
+{
+    if (!runtime) {
+        runtime = tinycli_runtime_default();
+    }
+
+    pthread_mutex_lock(&runtime->lock);
+    runtime->plugin_bind = bind;
+    pthread_mutex_unlock(&runtime->lock);
+}
+
+unsigned int tinycli_runtime_get_plugin_bind(tinycli_runtime_t *runtime)
+{
+    unsigned int bind;
+
+    if (!runtime) {
+        runtime = tinycli_runtime_default();
+    }
+
+    pthread_mutex_lock(&runtime->lock);
+    bind = runtime->plugin_bind;
+    pthread_mutex_unlock(&runtime->lock);
+
+    return bind;
+}
+
+const char *tinycli_get_plugin_dir(void)
+{
+    return tinycli_runtime_default()->plugin_dir;
+}
+
+void tinycli_set_plugin_dir(const char *dir)
+{
+    tinycli_runtime_set_plugin_dir(NULL, dir);
+}
@@ -0,0 +1,1627 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "script.h"
+#include "context.h"
+#include "command.h"
+#include "alloc.h"
+#include "utils.h"
+
+/* Version of the cache file layout */
+#define SCRIPT_CACHE_VERSION 1
+
+/* No jump target or patch chain end */
+#define SCRIPT_NONE UINT32_MAX
+
+/* Maximum number of variable slots */
+#define SCRIPT_MAX_SLOTS 65535
+
+/* Maximum number of words on a line */
+#define SCRIPT_MAX_WORDS 256
+
+/* Instructions */
+enum {
+    OP_EXEC,                        /* Run command: a = first arg, b = argc, c = name */
+    OP_SET,                         /* slot = arg a */
+    OP_ARITH,                       /* slot = arg a <cmp> arg b */
+    OP_JUMP,                        /* Jump to a */
+    OP_JUMPF,                       /* Jump to c unless arg a <cmp> arg b */
+    OP_RESET,                       /* Reset the loop counter of slot */
+    OP_FOR                          /* slot = arg (a + counter of d) while counter < b, else jump to c */
+};
+
+/* Comparisons */
+enum {
+    CMP_TRUE,                       /* Value is not empty or "0" */
+    CMP_EQ,
+    CMP_NE,
+    CMP_LT,
+    CMP_LE,
+    CMP_GT,
+    CMP_GE
+};
+
+/* Argument parts */
+enum {
+    PART_LITERAL,                   /* value = string offset */
+    PART_VAR                        /* value = slot */
+};
+
+/* Instruction */
+typedef struct {
+    uint8_t op;                     /* Operation */
+    uint8_t cmp;                    /* Comparison or arithmetic operator */
+    uint16_t slot;                  /* Variable slot */
+    uint32_t a, b, c, d;            /* Operands */
+} script_instr_t;
+
+/* Argument: concatenation of parts */
+typedef struct {
+    uint32_t first;                 /* First part */
+    uint32_t count;                 /* Number of parts */
+} script_arg_t;
+
+/* Argument part */
+typedef struct {
+    uint32_t kind;                  /* PART_LITERAL or PART_VAR */
+    uint32_t value;                 /* String offset or slot */
+} script_part_t;
+
+/* Compiled script */
+struct tinycli_script {
+    script_instr_t *code;           /* Instructions */
+    uint32_t *lines;                /* Source line of each instruction */
+    uint32_t code_count, code_cap;
+    script_arg_t *args;             /* Arguments */
+    uint32_t arg_count, arg_cap;
+    script_part_t *parts;           /* Argument parts */
+    uint32_t part_count, part_cap;
+    char *strings;                  /* Literal strings */
+    uint32_t strings_len, strings_cap;
+    uint32_t *slot_names;           /* String offset of each slot's name */
+    uint32_t slot_count, slot_cap;
+    uint32_t max_argc;              /* Largest command argument count */
+    char ***argv;                   /* Prebuilt argument vector of each instruction (or NULL) */
+    char **argv_storage;            /* Storage for the prebuilt vectors */
+};
+
+/* Cache file header */
+typedef struct {
+    char magic[8];                  /* TINYCLI_SCRIPT_MAGIC */
+    uint32_t version;               /* SCRIPT_CACHE_VERSION */
+    uint32_t header_size;           /* Size of this header */
+    uint64_t source_size;           /* Size of the script */
+    int64_t source_mtime_sec;       /* Modification time of the script */
+    int64_t source_mtime_nsec;
+    uint32_t code_count;            /* Array sizes */
+    uint32_t arg_count;
+    uint32_t part_count;
+    uint32_t strings_len;
+    uint32_t slot_count;
+    uint32_t max_argc;
+} script_cache_header_t;
+
+/* Open block while compiling */
+typedef struct {
+    int type;                       /* Block type */
+    uint32_t start;                 /* Loop start (condition or FOR instruction) */
+    uint32_t branch;                /* Pending conditional jump (or FOR instruction) */
+    uint32_t jump;                  /* Pending jump over the else branch */
+    uint32_t breaks;                /* Chain of break jumps */
+    uint32_t continues;             /* Chain of continue jumps */
+    uint16_t var;                   /* Loop variable */
+} script_block_t;
+
+/* Block types */
+enum {
+    BLOCK_IF,
+    BLOCK_ELSE,
+    BLOCK_WHILE,
+    BLOCK_RANGE,
+    BLOCK_LIST
+};
+
+/* Compiler state */
+typedef struct {
+    tinycli_script_t *script;       /* Script being built */
+    uint32_t line;                  /* Current source line */
+    script_block_t blocks[TINYCLI_SCRIPT_MAX_DEPTH];
+    int depth;                      /* Number of open blocks */
+    char *error;                    /* Error buffer */
+    size_t error_size;              /* Size of the error buffer */
+} script_compiler_t;
+
+/* Variable value at run time */
+typedef struct {
+    char *str;                      /* Value */
+    size_t len;                     /* Length of the value */
+    size_t cap;                     /* Capacity of the value buffer */
+    uint32_t counter;               /* Loop counter */
+} script_var_t;
+
+/* Interpreter state */
+typedef struct {
+    tinycli_context_t *ctx;         /* Context running the script */
+    const tinycli_script_t *script; /* Script */
+    script_var_t *vars;             /* Variables */
+    tinycli_command_t **commands;   /* Commands resolved in this run, per instruction */
+    char **argv;                    /* Argument vector being built */
+    size_t *offsets;                /* Scratch offsets of the arguments being built */
+    char *scratch;                  /* Expanded arguments */
+    size_t scratch_len, scratch_cap;
+} script_vm_t;
+
+/* Grow an array to hold at least need elements */
+static int script_grow(void **buf, uint32_t *cap, uint32_t need, size_t elem)
+{
+    uint32_t new_cap;
+    void *new_buf;
+
+    if (need <= *cap) {
+        return TINYCLI_SUCCESS;
+    }
+
+    new_cap = *cap ? *cap : 16;
+    while (new_cap < need) {
+        new_cap *= 2;
+    }
+
+    new_buf = tinycli_realloc(TINYCLI_MEM_SCRIPT, *buf, (size_t)new_cap * elem);
+    if (!new_buf) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+    *buf = new_buf;
+    *cap = new_cap;
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Report a compile error */
+static int compile_error(script_compiler_t *c, const char *fmt, ...)
+{
+    va_list args;
+    int n;
+
+    if (c->error && c->error_size > 0) {
+        n = snprintf(c->error, c->error_size, "line %u: ", c->line);
+        if (n >= 0 && (size_t)n < c->error_size) {
+            va_start(args, fmt);
+            vsnprintf(c->error + n, c->error_size - (size_t)n, fmt, args);
+            va_end(args);
+        }
+    }
+
+    return TINYCLI_ERROR_INVALID_ARGUMENT;
+}
+
+/* Append a string to the literal pool */
+static int script_add_string(tinycli_script_t *s, const char *str, size_t len, uint32_t *offset)
+{
+    if (len >= UINT32_MAX - s->strings_len - 1 ||
+        script_grow((void **)&s->strings, &s->strings_cap, s->strings_len + (uint32_t)len + 1,
+                    sizeof(char)) != TINYCLI_SUCCESS) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    *offset = s->strings_len;
+    memcpy(s->strings + s->strings_len, str, len);
+    s->strings[s->strings_len + len] = '\0';
+    s->strings_len += (uint32_t)len + 1;
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Find or create the slot of a variable */
+static int script_slot(script_compiler_t *c, const char *name, size_t len, uint16_t *slot)
+{
+    tinycli_script_t *s = c->script;
+    uint32_t i, offset;
+
+    for (i = 0; i < s->slot_count; i++) {
+        const char *slot_name = s->strings + s->slot_names[i];
+        if (strlen(slot_name) == len && memcmp(slot_name, name, len) == 0) {
+            *slot = (uint16_t)i;
+            return TINYCLI_SUCCESS;
+        }
+    }
+
+    if (s->slot_count == SCRIPT_MAX_SLOTS) {
+        return compile_error(c, "too many variables");
+    }
+    if (script_add_string(s, name, len, &offset) != TINYCLI_SUCCESS ||
+        script_grow((void **)&s->slot_names, &s->slot_cap, s->slot_count + 1,
+                    sizeof(uint32_t)) != TINYCLI_SUCCESS) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    s->slot_names[s->slot_count] = offset;
+    *slot = (uint16_t)s->slot_count++;
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Append a part to an argument being compiled */
+static int script_add_part(tinycli_script_t *s, uint32_t kind, uint32_t value)
+{
+    if (script_grow((void **)&s->parts, &s->part_cap, s->part_count + 1,
+                    sizeof(script_part_t)) != TINYCLI_SUCCESS) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    s->parts[s->part_count].kind = kind;
+    s->parts[s->part_count].value = value;
+    s->part_count++;
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Compile a word into an argument, splitting out variable references */
+static int compile_arg(script_compiler_t *c, const char *word, uint32_t *index)
+{
+    tinycli_script_t *s = c->script;
+    const char *p = word;
+    char *literal;
+    size_t lit_len = 0;
+    uint32_t first = s->part_count, offset;
+    uint16_t slot;
+    int ret = TINYCLI_SUCCESS;
+
+    literal = (char *)tinycli_malloc(TINYCLI_MEM_SCRIPT, strlen(word) + 1);
+    if (!literal) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    while (*p && ret == TINYCLI_SUCCESS) {
+        const char *name;
+        size_t name_len;
+
+        if (p[0] != '$' || p[1] == '\0') {
+            literal[lit_len++] = *p++;
+            continue;
+        }
+        if (p[1] == '$') {
+            literal[lit_len++] = '$';
+            p += 2;
+            continue;
+        }
+
+        /* Variable reference */
+        if (p[1] == '{') {
+            name = p + 2;
+            name_len = strcspn(name, "}");
+            if (name[name_len] != '}' || name_len == 0) {
+                ret = compile_error(c, "bad variable reference in '%s'", word);
+                break;
+            }
+            p = name + name_len + 1;
+        } else if (p[1] == '?' || p[1] == '#') {
+            name = p + 1;
+            name_len = 1;
+            p += 2;
+        } else {
+            name = p + 1;
+            for (name_len = 0; isalnum((unsigned char)name[name_len]) || name[name_len] == '_';
+                 name_len++) {
+            }
+            if (name_len == 0) {
+                literal[lit_len++] = *p++;
+                continue;
+            }
+            p = name + name_len;
+        }
+
+        /* Flush the pending literal */
+        if (lit_len > 0) {
+            ret = script_add_string(s, literal, lit_len, &offset);
+            if (ret == TINYCLI_SUCCESS) {
+                ret = script_add_part(s, PART_LITERAL, offset);
+            }
+            lit_len = 0;
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = script_slot(c, name, name_len, &slot);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = script_add_part(s, PART_VAR, slot);
+        }
+    }
+
+    /* Trailing literal (or the whole word, possibly empty) */
+    if (ret == TINYCLI_SUCCESS && (lit_len > 0 || s->part_count == first)) {
+        ret = script_add_string(s, literal, lit_len, &offset);
+        if (ret == TINYCLI_SUCCESS) {
+            ret = script_add_part(s, PART_LITERAL, offset);
+        }
+    }
+    tinycli_free(literal);
+
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
+    }
+
+    if (script_grow((void **)&s->args, &s->arg_cap, s->arg_count + 1,
+                    sizeof(script_arg_t)) != TINYCLI_SUCCESS) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+    s->args[s->arg_count].first = first;
+    s->args[s->arg_count].count = s->part_count - first;
+    *index = s->arg_count++;
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Append an instruction */
+static int compile_emit(script_compiler_t *c, uint8_t op, uint8_t cmp, uint16_t slot,
+                        uint32_t a, uint32_t b, uint32_t cc, uint32_t d, uint32_t *pc)
+{
+    tinycli_script_t *s = c->script;
+    script_instr_t *in;
+    uint32_t cap = s->code_cap;
+
+    if (script_grow((void **)&s->code, &s->code_cap, s->code_count + 1,
+                    sizeof(script_instr_t)) != TINYCLI_SUCCESS ||
+        script_grow((void **)&s->lines, &cap, s->code_count + 1,
+                    sizeof(uint32_t)) != TINYCLI_SUCCESS) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    in = &s->code[s->code_count];
+    in->op = op;
+    in->cmp = cmp;
+    in->slot = slot;
+    in->a = a;
+    in->b = b;
+    in->c = cc;
+    in->d = d;
+    s->lines[s->code_count] = c->line;
+    if (pc) {
+        *pc = s->code_count;
+    }
+    s->code_count++;
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Point a chain of jumps (linked through their target field) at a target */
+static void compile_patch_chain(tinycli_script_t *s, uint32_t chain, uint32_t target)
+{
+    while (chain != SCRIPT_NONE) {
+        uint32_t next = s->code[chain].a;
+        s->code[chain].a = target;
+        chain = next;
+    }
+}
+
+/* Map a comparison operator */
+static int compile_cmp(const char *op)
+{
+    static const char *const ops[] = { "==", "!=", "<", "<=", ">", ">=" };
+    size_t i;
+
+    for (i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+        if (strcmp(op, ops[i]) == 0) {
+            return CMP_EQ + (int)i;
+        }
+    }
+
+    return -1;
+}
+
+/* Compile a condition into a conditional jump with an unset target */
+static int compile_condition(script_compiler_t *c, char **words, int count, uint32_t *pc)
+{
+    uint32_t lhs, rhs = 0;
+    int cmp = CMP_TRUE, ret;
+
+    if (count == 3) {
+        cmp = compile_cmp(words[1]);
+        if (cmp < 0) {
+            return compile_error(c, "unknown comparison '%s'", words[1]);
+        }
+    } else if (count != 1) {
+        return compile_error(c, "expected <value> [<op> <value>]");
+    }
+
+    ret = compile_arg(c, words[0], &lhs);
+    if (ret == TINYCLI_SUCCESS && count == 3) {
+        ret = compile_arg(c, words[2], &rhs);
+    }
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
+    }
+
+    return compile_emit(c, OP_JUMPF, (uint8_t)cmp, 0, lhs, rhs, SCRIPT_NONE, 0, pc);
+}
+
+/* Open a block */
+static script_block_t *compile_push(script_compiler_t *c, int type)
+{
+    script_block_t *block;
+
+    if (c->depth == TINYCLI_SCRIPT_MAX_DEPTH) {
+        compile_error(c, "blocks nested too deeply");
+        return NULL;
+    }
+
+    block = &c->blocks[c->depth++];
+    memset(block, 0, sizeof(*block));
+    block->type = type;
+    block->start = c->script->code_count;
+    block->branch = SCRIPT_NONE;
+    block->jump = SCRIPT_NONE;
+    block->breaks = SCRIPT_NONE;
+    block->continues = SCRIPT_NONE;
+
+    return block;
+}
+
+/* Find the innermost loop */
+static script_block_t *compile_loop(script_compiler_t *c)
+{
+    int i;
+
+    for (i = c->depth - 1; i >= 0; i--) {
+        if (c->blocks[i].type >= BLOCK_WHILE) {
+            return &c->blocks[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Close the innermost block */
+static int compile_end(script_compiler_t *c)
+{
+    tinycli_script_t *s = c->script;
+    script_block_t *block;
+    uint32_t one, pc;
+    int ret;
+
+    if (c->depth == 0) {
+        return compile_error(c, "'end' without a block");
+    }
+    block = &c->blocks[--c->depth];
+
+    switch (block->type) {
+    case BLOCK_IF:
+        s->code[block->branch].c = s->code_count;
+        break;
+
+    case BLOCK_ELSE:
+        s->code[block->jump].a = s->code_count;
+        break;
+
+    case BLOCK_WHILE:
+    case BLOCK_LIST:
+        ret = compile_emit(c, OP_JUMP, 0, 0, block->start, 0, 0, 0, NULL);
+        if (ret != TINYCLI_SUCCESS) {
+            return ret;
+        }
+        compile_patch_chain(s, block->continues, block->start);
+        s->code[block->branch].c = s->code_count;
+        break;
+
+    case BLOCK_RANGE:
+        /* continue jumps to the increment */
+        compile_patch_chain(s, block->continues, s->code_count);
+        ret = compile_arg(c, "1", &one);
+        if (ret == TINYCLI_SUCCESS) {
+            ret = compile_arg(c, "", &pc);
+        }
+        if (ret != TINYCLI_SUCCESS) {
+            return ret;
+        }
+        /* var = $var + 1: the first part of the empty arg is replaced by the variable */
+        s->parts[s->args[pc].first].kind = PART_VAR;
+        s->parts[s->args[pc].first].value = block->var;
+        ret = compile_emit(c, OP_ARITH, '+', block->var, pc, one, 0, 0, NULL);
+        if (ret == TINYCLI_SUCCESS) {
+            ret = compile_emit(c, OP_JUMP, 0, 0, block->start, 0, 0, 0, NULL);
+        }
+        if (ret != TINYCLI_SUCCESS) {
+            return ret;
+        }
+        s->code[block->branch].c = s->code_count;
+        break;
+    }
+
+    compile_patch_chain(s, block->breaks, s->code_count);
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Compile a 'for' statement */
+static int compile_for(script_compiler_t *c, char **words, int count)
+{
+    tinycli_script_t *s = c->script;
+    script_block_t *block;
+    const char *dots;
+    uint32_t from, to, first = 0, arg, var_arg;
+    uint16_t var, counter;
+    char hidden[32];
+    int i, ret;
+
+    if (count < 4 || strcmp(words[2], "in") != 0) {
+        return compile_error(c, "expected 'for <var> in <from>..<to>' or 'for <var> in <word>...'");
+    }
+    ret = script_slot(c, words[1], strlen(words[1]), &var);
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
+    }
+
+    dots = strstr(words[3], "..");
+    if (count == 4 && dots && dots != words[3] && dots[2] != '\0') {
+        /* Range: var = from; while var <= to ... var = var + 1 */
+        words[3][dots - words[3]] = '\0';
+        ret = compile_arg(c, words[3], &from);
+        if (ret == TINYCLI_SUCCESS) {
+            ret = compile_arg(c, dots + 2, &to);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = compile_emit(c, OP_SET, 0, var, from, 0, 0, 0, NULL);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = compile_arg(c, "", &var_arg);
+        }
+        if (ret != TINYCLI_SUCCESS) {
+            return ret;
+        }
+        s->parts[s->args[var_arg].first].kind = PART_VAR;
+        s->parts[s->args[var_arg].first].value = var;
+
+        block = compile_push(c, BLOCK_RANGE);
+        if (!block) {
+            return TINYCLI_ERROR_INVALID_ARGUMENT;
+        }
+        block->var = var;
+        return compile_emit(c, OP_JUMPF, CMP_LE, 0, var_arg, to, SCRIPT_NONE, 0, &block->branch);
+    }
+
+    /* List: a hidden slot holds the position */
+    snprintf(hidden, sizeof(hidden), " for%d", c->depth);
+    ret = script_slot(c, hidden, strlen(hidden), &counter);
+    for (i = 3; ret == TINYCLI_SUCCESS && i < count; i++) {
+        ret = compile_arg(c, words[i], &arg);
+        if (i == 3) {
+            first = arg;
+        }
+    }
+    if (ret == TINYCLI_SUCCESS) {
+        ret = compile_emit(c, OP_RESET, 0, counter, 0, 0, 0, 0, NULL);
+    }
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
+    }
+
+    block = compile_push(c, BLOCK_LIST);
+    if (!block) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+    block->var = var;
+    return compile_emit(c, OP_FOR, 0, var, first, (uint32_t)(count - 3), SCRIPT_NONE, counter,
+                        &block->branch);
+}
+
+/* Compile one line split into words */
+static int compile_statement(script_compiler_t *c, char **words, int count)
+{
+    tinycli_script_t *s = c->script;
+    script_block_t *block;
+    uint32_t first = 0, arg, lhs, rhs, name, pc;
+    uint16_t slot;
+    int i, ret;
+
+    if (strcmp(words[0], "set") == 0) {
+        if ((count != 4 && count != 6) || strcmp(words[2], "=") != 0) {
+            return compile_error(c, "expected 'set <var> = <value> [<op> <value>]'");
+        }
+        ret = script_slot(c, words[1], strlen(words[1]), &slot);
+        if (ret == TINYCLI_SUCCESS) {
+            ret = compile_arg(c, words[3], &lhs);
+        }
+        if (ret != TINYCLI_SUCCESS) {
+            return ret;
+        }
+        if (count == 4) {
+            return compile_emit(c, OP_SET, 0, slot, lhs, 0, 0, 0, NULL);
+        }
+        if (strlen(words[4]) != 1 || !strchr("+-*/%", words[4][0])) {
+            return compile_error(c, "unknown operator '%s'", words[4]);
+        }
+        ret = compile_arg(c, words[5], &rhs);
+        if (ret != TINYCLI_SUCCESS) {
+            return ret;
+        }
+        return compile_emit(c, OP_ARITH, (uint8_t)words[4][0], slot, lhs, rhs, 0, 0, NULL);
+    }
+
+    if (strcmp(words[0], "if") == 0 || strcmp(words[0], "while") == 0) {
+        bool loop = words[0][0] == 'w';
+
+        block = compile_push(c, loop ? BLOCK_WHILE : BLOCK_IF);
+        if (!block) {
+            return TINYCLI_ERROR_INVALID_ARGUMENT;
+        }
+        return compile_condition(c, words + 1, count - 1, &block->branch);
+    }
+
+    if (strcmp(words[0], "else") == 0) {
+        if (count != 1 || c->depth == 0 || c->blocks[c->depth - 1].type != BLOCK_IF) {
+            return compile_error(c, "'else' without 'if'");
+        }
+        block = &c->blocks[c->depth - 1];
+        ret = compile_emit(c, OP_JUMP, 0, 0, SCRIPT_NONE, 0, 0, 0, &block->jump);
+        if (ret != TINYCLI_SUCCESS) {
+            return ret;
+        }
+        s->code[block->branch].c = s->code_count;
+        block->type = BLOCK_ELSE;
+        return TINYCLI_SUCCESS;
+    }
+
+    if (strcmp(words[0], "end") == 0) {
+        if (count != 1) {
+            return compile_error(c, "unexpected words after 'end'");
+        }
+        return compile_end(c);
+    }
+
+    if (strcmp(words[0], "for") == 0) {
+        return compile_for(c, words, count);
+    }
+
+    if (strcmp(words[0], "break") == 0 || strcmp(words[0], "continue") == 0) {
+        bool is_break = words[0][0] == 'b';
+
+        block = compile_loop(c);
+        if (!block || count != 1) {
+            return compile_error(c, "'%s' outside a loop", words[0]);
+        }
+        ret = compile_emit(c, OP_JUMP, 0, 0, is_break ? block->breaks : block->continues,
+                           0, 0, 0, &pc);
+        if (ret != TINYCLI_SUCCESS) {
+            return ret;
+        }
+        if (is_break) {
+            block->breaks = pc;
+        } else {
+            block->continues = pc;
+        }
+        return TINYCLI_SUCCESS;
+    }
+
+    /* Command: the name is resolved when the script runs */
+    if (strchr(words[0], '$')) {
+        return compile_error(c, "command name must not contain variables");
+    }
+    for (i = 0; i < count; i++) {
+        ret = compile_arg(c, words[i], &arg);
+        if (ret != TINYCLI_SUCCESS) {
+            return ret;
+        }
+        if (i == 0) {
+            first = arg;
+        }
+    }
+    name = s->parts[s->args[first].first].value;
+    if ((uint32_t)count > s->max_argc) {
+        s->max_argc = (uint32_t)count;
+    }
+
+    return compile_emit(c, OP_EXEC, 0, 0, first, (uint32_t)count, name, 0, NULL);
+}
+
+/* Split a line into words like tinycli_parse_line (in place) */
+static int script_split(char *line, char **words, int max_words)
+{
+    char *p = line, *out = line;
+    bool in_quotes = false;
+    int count = 0;
+
+    while (*p) {
+        if (!in_quotes && isspace((unsigned char)*p)) {
+            p++;
+            continue;
+        }
+        if (count == max_words) {
+            return -1;
+        }
+
+        words[count++] = out;
+        while (*p) {
+            if (*p == '"') {
+                in_quotes = !in_quotes;
+                p++;
+            } else if (!in_quotes && isspace((unsigned char)*p)) {
+                p++;
+                break;
+            } else {
+                *out++ = *p++;
+            }
+        }
+        *out++ = '\0';
+    }
+
+    return count;
+}
+
+/* Verify that all indexes of a script are in range */
+static bool script_verify(const tinycli_script_t *s)
+{
+    uint32_t i;
+
+    if (s->strings_len == 0 || s->strings[s->strings_len - 1] != '\0' ||
+        s->slot_count == 0 || s->slot_count > SCRIPT_MAX_SLOTS) {
+        return false;
+    }
+    for (i = 0; i < s->slot_count; i++) {
+        if (s->slot_names[i] >= s->strings_len) {
+            return false;
+        }
+    }
+    for (i = 0; i < s->part_count; i++) {
+        if (s->parts[i].kind == PART_LITERAL ? s->parts[i].value >= s->strings_len :
+            s->parts[i].kind != PART_VAR || s->parts[i].value >= s->slot_count) {
+            return false;
+        }
+    }
+    for (i = 0; i < s->arg_count; i++) {
+        if (s->args[i].count == 0 || s->args[i].first >= s->part_count ||
+            s->args[i].count > s->part_count - s->args[i].first) {
+            return false;
+        }
+    }
+    for (i = 0; i < s->code_count; i++) {
+        const script_instr_t *in = &s->code[i];
+
+        if (in->slot >= s->slot_count && in->op != OP_EXEC && in->op != OP_JUMP &&
+            in->op != OP_JUMPF) {
+            return false;
+        }
+        switch (in->op) {
+        case OP_EXEC:
+            if (in->b == 0 || in->b > s->max_argc || in->a >= s->arg_count ||
+                in->b > s->arg_count - in->a || in->c >= s->strings_len) {
+                return false;
+            }
+            break;
+        case OP_SET:
+            if (in->a >= s->arg_count) {
+                return false;
+            }
+            break;
+        case OP_ARITH:
+        case OP_JUMPF:
+            if (in->a >= s->arg_count || in->b >= s->arg_count ||
+                (in->op == OP_JUMPF && (in->c > s->code_count || in->cmp > CMP_GE))) {
+                return false;
+            }
+            break;
+        case OP_JUMP:
+            if (in->a > s->code_count) {
+                return false;
+            }
+            break;
+        case OP_RESET:
+            break;
+        case OP_FOR:
+            if (in->b == 0 || in->a >= s->arg_count || in->b > s->arg_count - in->a ||
+                in->c > s->code_count || in->d >= s->slot_count) {
+                return false;
+            }
+            break;
+        default:
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Build the argument vectors that contain no variables */
+static int script_link(tinycli_script_t *s)
+{
+    uint32_t i, j, total = 0;
+    char **storage;
+
+    s->argv = (char ***)tinycli_calloc(TINYCLI_MEM_SCRIPT, s->code_count ? s->code_count : 1,
+                                       sizeof(char **));
+    if (!s->argv) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    /* Count the storage needed */
+    for (i = 0; i < s->code_count; i++) {
+        if (s->code[i].op == OP_EXEC) {
+            total += s->code[i].b + 1;
+        }
+    }
+    storage = (char **)tinycli_malloc(TINYCLI_MEM_SCRIPT, (total ? total : 1) * sizeof(char *));
+    if (!storage) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+    s->argv_storage = storage;
+
+    for (i = 0; i < s->code_count; i++) {
+        const script_instr_t *in = &s->code[i];
+        bool literal = true;
+
+        if (in->op != OP_EXEC) {
+            continue;
+        }
+        for (j = 0; j < in->b && literal; j++) {
+            const script_arg_t *arg = &s->args[in->a + j];
+            literal = arg->count == 1 && s->parts[arg->first].kind == PART_LITERAL;
+        }
+        if (!literal) {
+            continue;
+        }
+
+        for (j = 0; j < in->b; j++) {
+            storage[j] = s->strings + s->parts[s->args[in->a + j].first].value;
+        }
+        storage[in->b] = NULL;
+        s->argv[i] = storage;
+        storage += in->b + 1;
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Allocate an empty script with the reserved $? slot */
+static tinycli_script_t *script_create(void)
+{
+    tinycli_script_t *s;
+    uint32_t offset;
+
+    s = (tinycli_script_t *)tinycli_calloc(TINYCLI_MEM_SCRIPT, 1, sizeof(*s));
+    if (!s) {
+        return NULL;
+    }
+
+    if (script_add_string(s, "?", 1, &offset) != TINYCLI_SUCCESS ||
+        script_grow((void **)&s->slot_names, &s->slot_cap, 1, sizeof(uint32_t)) != TINYCLI_SUCCESS) {
+        tinycli_script_free(s);
+        return NULL;
+    }
+    s->slot_names[0] = offset;
+    s->slot_count = 1;
+
+    return s;
+}
+
+tinycli_script_t *tinycli_script_compile(const char *source, size_t len,
+                                         char *error, size_t error_size)
+{
+    script_compiler_t c;
+    char *words[SCRIPT_MAX_WORDS];
+    char *line = NULL;
+    size_t pos = 0, line_cap = 0;
+    int count, ret = TINYCLI_SUCCESS;
+
+    if (error && error_size > 0) {
+        error[0] = '\0';
+    }
+    if (!source) {
+        return NULL;
+    }
+
+    memset(&c, 0, sizeof(c));
+    c.error = error;
+    c.error_size = error_size;
+    c.script = script_create();
+    if (!c.script) {
+        return NULL;
+    }
+
+    while (pos < len && ret == TINYCLI_SUCCESS) {
+        const char *start = source + pos, *nl;
+        size_t line_len;
+        char *p;
+
+        nl = memchr(start, '\n', len - pos);
+        line_len = nl ? (size_t)(nl - start) : len - pos;
+        pos += line_len + 1;
+        c.line++;
+
+        /* Copy the line so it can be split in place */
+        if (line_len + 1 > line_cap) {
+            char *new_line = (char *)tinycli_realloc(TINYCLI_MEM_SCRIPT, line, line_len + 1);
+            if (!new_line) {
+                ret = TINYCLI_ERROR_MEMORY;
+                break;
+            }
+            line = new_line;
+            line_cap = line_len + 1;
+        }
+        memcpy(line, start, line_len);
+        line[line_len] = '\0';
+
+        /* Skip blank lines and comments */
+        for (p = line; isspace((unsigned char)*p); p++) {
+        }
+        if (*p == '\0' || *p == '#') {
+            continue;
+        }
+
+        count = script_split(p, words, SCRIPT_MAX_WORDS);
+        if (count < 0) {
+            ret = compile_error(&c, "too many words");
+        } else if (count > 0) {
+            ret = compile_statement(&c, words, count);
+        }
+    }
+    tinycli_free(line);
+
+    if (ret == TINYCLI_SUCCESS && c.depth > 0) {
+        ret = compile_error(&c, "missing 'end'");
+    }
+    if (ret == TINYCLI_SUCCESS) {
+        ret = script_link(c.script);
+    }
+    if (ret != TINYCLI_SUCCESS) {
+        if (ret == TINYCLI_ERROR_MEMORY && error && error_size > 0) {
+            snprintf(error, error_size, "out of memory");
+        }
+        tinycli_script_free(c.script);
+        return NULL;
+    }
+
+    return c.script;
+}
+
+void tinycli_script_free(tinycli_script_t *script)
+{
+    if (!script) {
+        return;
+    }
+
+    tinycli_free(script->code);
+    tinycli_free(script->lines);
+    tinycli_free(script->args);
+    tinycli_free(script->parts);
+    tinycli_free(script->strings);
+    tinycli_free(script->slot_names);
+    tinycli_free(script->argv);
+    tinycli_free(script->argv_storage);
+    tinycli_free(script);
+}
+
+/* Whether the disk cache is enabled */
+static bool script_cache_enabled(void)
+{
+    const char *env = getenv("TINYCLI_SCRIPT_CACHE");
+
+    return !env || strcmp(env, "0") != 0;
+}
+
+/* Read a whole file */
+static char *script_read_file(const char *path, size_t *len)
+{
+    struct stat st;
+    char *data;
+    FILE *file;
+
+    file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+    if (fstat(fileno(file), &st) != 0 || !S_ISREG(st.st_mode)) {
+        fclose(file);
+        return NULL;
+    }
+
+    data = (char *)tinycli_malloc(TINYCLI_MEM_SCRIPT, (size_t)st.st_size + 1);
+    if (!data) {
+        fclose(file);
+        return NULL;
+    }
+    *len = fread(data, 1, (size_t)st.st_size, file);
+    data[*len] = '\0';
+    fclose(file);
+
+    return data;
+}
+
+/* Copy an array out of a cache file */
+static bool script_cache_take(const char **p, const char *end, void **dst, size_t size)
+{
+    if ((size_t)(end - *p) < size) {
+        return false;
+    }
+
+    *dst = tinycli_malloc(TINYCLI_MEM_SCRIPT, size ? size : 1);
+    if (!*dst) {
+        return false;
+    }
+    memcpy(*dst, *p, size);
+    *p += size;
+
+    return true;
+}
+
+/* Load a compiled script from its cache file if it matches the source */
+static tinycli_script_t *script_cache_read(const char *cache_path, const struct stat *source)
+{
+    script_cache_header_t header;
+    tinycli_script_t *s;
+    const char *p, *end;
+    char *data;
+    size_t len;
+    bool ok;
+
+    data = script_read_file(cache_path, &len);
+    if (!data) {
+        return NULL;
+    }
+    if (len < sizeof(header)) {
+        tinycli_free(data);
+        return NULL;
+    }
+    memcpy(&header, data, sizeof(header));
+
+    if (memcmp(header.magic, TINYCLI_SCRIPT_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != SCRIPT_CACHE_VERSION || header.header_size != sizeof(header) ||
+        header.source_size != (uint64_t)source->st_size ||
+        header.source_mtime_sec != (int64_t)source->st_mtim.tv_sec ||
+        header.source_mtime_nsec != (int64_t)source->st_mtim.tv_nsec) {
+        tinycli_free(data);
+        return NULL;
+    }
+
+    s = (tinycli_script_t *)tinycli_calloc(TINYCLI_MEM_SCRIPT, 1, sizeof(*s));
+    if (!s) {
+        tinycli_free(data);
+        return NULL;
+    }
+
+    p = data + sizeof(header);
+    end = data + len;
+    ok = script_cache_take(&p, end, (void **)&s->code, (size_t)header.code_count * sizeof(script_instr_t)) &&
+         script_cache_take(&p, end, (void **)&s->lines, (size_t)header.code_count * sizeof(uint32_t)) &&
+         script_cache_take(&p, end, (void **)&s->args, (size_t)header.arg_count * sizeof(script_arg_t)) &&
+         script_cache_take(&p, end, (void **)&s->parts, (size_t)header.part_count * sizeof(script_part_t)) &&
+         script_cache_take(&p, end, (void **)&s->strings, header.strings_len) &&
+         script_cache_take(&p, end, (void **)&s->slot_names, (size_t)header.slot_count * sizeof(uint32_t)) &&
+         p == end;
+    tinycli_free(data);
+
+    s->code_count = s->code_cap = header.code_count;
+    s->arg_count = s->arg_cap = header.arg_count;
+    s->part_count = s->part_cap = header.part_count;
+    s->strings_len = s->strings_cap = header.strings_len;
+    s->slot_count = s->slot_cap = header.slot_count;
+    s->max_argc = header.max_argc;
+
+    if (!ok || !script_verify(s) || script_link(s) != TINYCLI_SUCCESS) {
+        tinycli_script_free(s);
+        return NULL;
+    }
+
+    return s;
+}
+
+/* Write a compiled script to its cache file */
+static void script_cache_write(const tinycli_script_t *s, const char *cache_path,
+                               const struct stat *source)
+{
+    script_cache_header_t header;
+    char tmp_path[4096];
+    FILE *file;
+    bool ok;
+
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.%ld", cache_path, (long)getpid()) >=
+        (int)sizeof(tmp_path)) {
+        return;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TINYCLI_SCRIPT_MAGIC, sizeof(header.magic));
+    header.version = SCRIPT_CACHE_VERSION;
+    header.header_size = sizeof(header);
+    header.source_size = (uint64_t)source->st_size;
+    header.source_mtime_sec = (int64_t)source->st_mtim.tv_sec;
+    header.source_mtime_nsec = (int64_t)source->st_mtim.tv_nsec;
+    header.code_count = s->code_count;
+    header.arg_count = s->arg_count;
+    header.part_count = s->part_count;
+    header.strings_len = s->strings_len;
+    header.slot_count = s->slot_count;
+    header.max_argc = s->max_argc;
+
+    file = fopen(tmp_path, "wb");
+    if (!file) {
+        return;
+    }
+    ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+         fwrite(s->code, sizeof(script_instr_t), s->code_count, file) == s->code_count &&
+         fwrite(s->lines, sizeof(uint32_t), s->code_count, file) == s->code_count &&
+         fwrite(s->args, sizeof(script_arg_t), s->arg_count, file) == s->arg_count &&
+         fwrite(s->parts, sizeof(script_part_t), s->part_count, file) == s->part_count &&
+         fwrite(s->strings, 1, s->strings_len, file) == s->strings_len &&
+         fwrite(s->slot_names, sizeof(uint32_t), s->slot_count, file) == s->slot_count;
+    ok = fclose(file) == 0 && ok;
+
+    /* Replace the old cache atomically */
+    if (!ok || rename(tmp_path, cache_path) != 0) {
+        unlink(tmp_path);
+    }
+}
+
+int tinycli_script_load(const char *path, tinycli_script_t **script,
+                        char *error, size_t error_size)
+{
+    char cache_path[4096];
+    struct stat st;
+    char *source;
+    size_t len;
+    bool cache;
+
+    if (!path || !script) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+    *script = NULL;
+
+    if (stat(path, &st) != 0) {
+        if (error && error_size > 0) {
+            snprintf(error, error_size, "%s", strerror(errno));
+        }
+        return TINYCLI_ERROR_NOT_FOUND;
+    }
+
+    /* Use the compiled form if the script is unchanged */
+    cache = script_cache_enabled() &&
+            snprintf(cache_path, sizeof(cache_path), "%s%s", path,
+                     TINYCLI_SCRIPT_CACHE_SUFFIX) < (int)sizeof(cache_path);
+    if (cache) {
+        *script = script_cache_read(cache_path, &st);
+        if (*script) {
+            return TINYCLI_SUCCESS;
+        }
+    }
+
+    /* Compile the source */
+    source = script_read_file(path, &len);
+    if (!source) {
+        if (error && error_size > 0) {
+            snprintf(error, error_size, "%s", strerror(errno));
+        }
+        return TINYCLI_ERROR_NOT_FOUND;
+    }
+    *script = tinycli_script_compile(source, len, error, error_size);
+    tinycli_free(source);
+    if (!*script) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (cache) {
+        script_cache_write(*script, cache_path, &st);
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Set a variable */
+static int vm_set(script_vm_t *vm, uint16_t slot, const char *value, size_t len)
+{
+    script_var_t *var = &vm->vars[slot];
+
+    if (value == var->str) {
+        return TINYCLI_SUCCESS;
+    }
+    if (len + 1 > var->cap) {
+        char *buf = (char *)tinycli_realloc(TINYCLI_MEM_SCRIPT, var->str, len + 1);
+        if (!buf) {
+            return TINYCLI_ERROR_MEMORY;
+        }
+        var->str = buf;
+        var->cap = len + 1;
+    }
+    memcpy(var->str, value, len);
+    var->str[len] = '\0';
+    var->len = len;
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Set a variable to a number */
+static int vm_set_number(script_vm_t *vm, uint16_t slot, long long value)
+{
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "%lld", value);
+
+    return vm_set(vm, slot, buf, (size_t)len);
+}
+
+/* Append an expanded argument to the scratch buffer */
+static int vm_expand(script_vm_t *vm, uint32_t index, size_t *offset)
+{
+    const tinycli_script_t *s = vm->script;
+    const script_arg_t *arg = &s->args[index];
+    uint32_t i;
+
+    *offset = vm->scratch_len;
+    for (i = 0; i < arg->count; i++) {
+        const script_part_t *part = &s->parts[arg->first + i];
+        const char *str;
+        size_t len;
+
+        if (part->kind == PART_LITERAL) {
+            str = s->strings + part->value;
+            len = strlen(str);
+        } else {
+            str = vm->vars[part->value].str;
+            len = vm->vars[part->value].len;
+        }
+
+        if (vm->scratch_len + len + 1 > vm->scratch_cap) {
+            size_t cap = vm->scratch_cap ? vm->scratch_cap : 256;
+            char *buf;
+
+            while (cap < vm->scratch_len + len + 1) {
+                cap *= 2;
+            }
+            buf = (char *)tinycli_realloc(TINYCLI_MEM_SCRIPT, vm->scratch, cap);
+            if (!buf) {
+                return TINYCLI_ERROR_MEMORY;
+            }
+            vm->scratch = buf;
+            vm->scratch_cap = cap;
+        }
+        if (len > 0) {
+            memcpy(vm->scratch + vm->scratch_len, str, len);
+            vm->scratch_len += len;
+        }
+    }
+    vm->scratch[vm->scratch_len++] = '\0';
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Evaluate arguments without copying literals and lone variables */
+static int vm_eval(script_vm_t *vm, uint32_t first, uint32_t count, char **out)
+{
+    const tinycli_script_t *s = vm->script;
+    uint32_t i;
+    int ret;
+
+    vm->scratch_len = 0;
+    for (i = 0; i < count; i++) {
+        const script_arg_t *arg = &s->args[first + i];
+        const script_part_t *part = &s->parts[arg->first];
+
+        vm->offsets[i] = SIZE_MAX;
+        if (arg->count == 1 && part->kind == PART_LITERAL) {
+            out[i] = (char *)s->strings + part->value;
+        } else if (arg->count == 1 && vm->vars[part->value].str) {
+            out[i] = vm->vars[part->value].str;
+        } else {
+            ret = vm_expand(vm, first + i, &vm->offsets[i]);
+            if (ret != TINYCLI_SUCCESS) {
+                return ret;
+            }
+        }
+    }
+
+    /* The scratch buffer no longer moves */
+    for (i = 0; i < count; i++) {
+        if (vm->offsets[i] != SIZE_MAX) {
+            out[i] = vm->scratch + vm->offsets[i];
+        }
+    }
+    out[count] = NULL;
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Parse a whole string as an integer */
+static bool vm_number(const char *str, long long *value)
+{
+    char *end;
+
+    if (*str == '\0') {
+        return false;
+    }
+    errno = 0;
+    *value = strtoll(str, &end, 10);
+    return *end == '\0' && errno == 0;
+}
+
+/* Evaluate a comparison */
+static bool vm_compare(int cmp, const char *lhs, const char *rhs)
+{
+    long long a, b;
+    int order;
+
+    if (cmp == CMP_TRUE) {
+        return lhs[0] != '\0' && strcmp(lhs, "0") != 0;
+    }
+
+    if (vm_number(lhs, &a) && vm_number(rhs, &b)) {
+        order = a < b ? -1 : a > b;
+    } else {
+        order = strcmp(lhs, rhs);
+    }
+
+    switch (cmp) {
+    case CMP_EQ: return order == 0;
+    case CMP_NE: return order != 0;
+    case CMP_LT: return order < 0;
+    case CMP_LE: return order <= 0;
+    case CMP_GT: return order > 0;
+    default:     return order >= 0;
+    }
+}
+
+/* Report a run-time error */
+static int vm_error(script_vm_t *vm, uint32_t pc, const char *msg)
+{
+    tinycli_printf(vm->ctx, "Script error at line %u: %s\n", vm->script->lines[pc], msg);
+    return TINYCLI_ERROR_GENERAL;
+}
+
+/* Set the script arguments */
+static int vm_set_args(script_vm_t *vm, int argc, char **argv)
+{
+    const tinycli_script_t *s = vm->script;
+    uint32_t i;
+    int ret = TINYCLI_SUCCESS;
+
+    for (i = 1; i < s->slot_count && ret == TINYCLI_SUCCESS; i++) {
+        const char *name = s->strings + s->slot_names[i];
+        char *end;
+        long n;
+
+        if (strcmp(name, "#") == 0) {
+            ret = vm_set_number(vm, (uint16_t)i, argc > 0 ? argc - 1 : 0);
+        } else if (isdigit((unsigned char)name[0])) {
+            n = strtol(name, &end, 10);
+            if (*end == '\0' && n < argc) {
+                ret = vm_set(vm, (uint16_t)i, argv[n], strlen(argv[n]));
+            }
+        }
+    }
+
+    return ret;
+}
+
+/* Execute the bytecode */
+static int vm_run(script_vm_t *vm)
+{
+    const tinycli_script_t *s = vm->script;
+    uint32_t pc = 0;
+    int status = TINYCLI_SUCCESS, ret;
+
+    while (pc < s->code_count) {
+        const script_instr_t *in = &s->code[pc];
+        char *vals[3];
+        long long a, b, r;
+        bool overflow;
+
+        switch (in->op) {
+        case OP_EXEC: {
+            tinycli_command_t *cmd = vm->commands[pc];
+            char **argv = s->argv[pc];
+
+            /* Look the command up once per run */
+            if (!cmd) {
+                const char *name = s->strings + in->c;
+                cmd = tinycli_command_find(vm->ctx, name);
+                if (!cmd) {
+                    tinycli_printf(vm->ctx, "Unknown command: %s\n", name);
+                    status = TINYCLI_ERROR_NOT_FOUND;
+                    ret = vm_set_number(vm, 0, status);
+                    if (ret != TINYCLI_SUCCESS) {
+                        return ret;
+                    }
+                    pc++;
+                    break;
+                }
+                vm->commands[pc] = cmd;
+            }
+
+            if (!argv) {
+                ret = vm_eval(vm, in->a, in->b, vm->argv);
+                if (ret != TINYCLI_SUCCESS) {
+                    return ret;
+                }
+                argv = vm->argv;
+            }
+
+            /* Stop a cancelled (or timed out and abandoned) script between commands */
+            if (tinycli_cancelled(vm->ctx)) {
+                return TINYCLI_ERROR_CANCELLED;
+            }
+
+            status = tinycli_command_execute(vm->ctx, cmd, (int)in->b, argv);
+            if (status != TINYCLI_SUCCESS) {
+                tinycli_printf(vm->ctx, "Command failed with error code %d\n", status);
+            }
+            ret = vm_set_number(vm, 0, status);
+            if (ret != TINYCLI_SUCCESS) {
+                return ret;
+            }
+            pc++;
+            break;
+        }
+
+        case OP_SET:
+            ret = vm_eval(vm, in->a, 1, vals);
+            if (ret == TINYCLI_SUCCESS) {
+                ret = vm_set(vm, in->slot, vals[0], strlen(vals[0]));
+            }
+            if (ret != TINYCLI_SUCCESS) {
+                return ret;
+            }
+            pc++;
+            break;
+
+        case OP_ARITH:
+            ret = vm_eval(vm, in->a, 1, vals);
+            if (ret != TINYCLI_SUCCESS) {
+                return ret;
+            }
+            if (!vm_number(vals[0], &a)) {
+                return vm_error(vm, pc, "not a number");
+            }
+            ret = vm_eval(vm, in->b, 1, vals);
+            if (ret != TINYCLI_SUCCESS) {
+                return ret;
+            }
+            if (!vm_number(vals[0], &b)) {
+                return vm_error(vm, pc, "not a number");
+            }
+            if ((in->cmp == '/' || in->cmp == '%') && b == 0) {
+                return vm_error(vm, pc, "division by zero");
+            }
+            switch (in->cmp) {
+            case '+': overflow = __builtin_add_overflow(a, b, &r); break;
+            case '-': overflow = __builtin_sub_overflow(a, b, &r); break;
+            case '*': overflow = __builtin_mul_overflow(a, b, &r); break;
+            default:
+                /* LLONG_MIN / -1 traps */
+                overflow = a == LLONG_MIN && b == -1;
+                if (!overflow) {
+                    r = in->cmp == '/' ? a / b : a % b;
+                }
+                break;
+            }
+            if (overflow) {
+                return vm_error(vm, pc, "integer overflow");
+            }
+            ret = vm_set_number(vm, in->slot, r);
+            if (ret != TINYCLI_SUCCESS) {
+                return ret;
+            }
+            pc++;
+            break;
+
+        case OP_JUMP:
+            /* Loops go through a backward jump: a script without commands can spin too */
+            if (in->a <= pc && tinycli_cancelled(vm->ctx)) {
+                return TINYCLI_ERROR_CANCELLED;
+            }
+            pc = in->a;
+            break;
+
+        case OP_JUMPF:
+            if (in->cmp == CMP_TRUE) {
+                ret = vm_eval(vm, in->a, 1, vals);
+                vals[1] = vals[0];
+            } else {
+                /* Expand both sides into the scratch buffer */
+                uint32_t idx[2];
+                size_t off[2];
+                int i;
+
+                idx[0] = in->a;
+                idx[1] = in->b;
+                vm->scratch_len = 0;
+                for (i = 0, ret = TINYCLI_SUCCESS; i < 2 && ret == TINYCLI_SUCCESS; i++) {
+                    ret = vm_expand(vm, idx[i], &off[i]);
+                }
+                if (ret == TINYCLI_SUCCESS) {
+                    vals[0] = vm->scratch + off[0];
+                    vals[1] = vm->scratch + off[1];
+                }
+            }
+            if (ret != TINYCLI_SUCCESS) {
+                return ret;
+            }
+            pc = vm_compare(in->cmp, vals[0], vals[1]) ? pc + 1 : in->c;
+            break;
+
+        case OP_RESET:
+            vm->vars[in->slot].counter = 0;
+            pc++;
+            break;
+
+        case OP_FOR: {
+            script_var_t *counter = &vm->vars[in->d];
+
+            if (counter->counter >= in->b) {
+                pc = in->c;
+                break;
+            }
+            ret = vm_eval(vm, in->a + counter->counter, 1, vals);
+            if (ret == TINYCLI_SUCCESS) {
+                ret = vm_set(vm, in->slot, vals[0], strlen(vals[0]));
+            }
+            if (ret != TINYCLI_SUCCESS) {
+                return ret;
+            }
+            counter->counter++;
+            pc++;
+            break;
+        }
+
+        default:
+            return vm_error(vm, pc, "bad instruction");
+        }
+    }
+
+    return status;
+}
+
+int tinycli_script_run(tinycli_context_t *ctx, const tinycli_script_t *script,
+                       int argc, char **argv)
+{
+    script_vm_t vm;
+    uint32_t i;
+    int ret;
+
+    if (!ctx || !script) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    memset(&vm, 0, sizeof(vm));
+    vm.ctx = ctx;
+    vm.script = script;
+    vm.vars = (script_var_t *)tinycli_calloc(TINYCLI_MEM_SCRIPT, script->slot_count,
+                                            sizeof(script_var_t));
+    vm.commands = (tinycli_command_t **)tinycli_calloc(TINYCLI_MEM_SCRIPT,
+                                                      script->code_count ? script->code_count : 1,
+                                                      sizeof(tinycli_command_t *));
+    vm.argv = (char **)tinycli_malloc(TINYCLI_MEM_SCRIPT, (script->max_argc + 3) * sizeof(char *));
+    vm.offsets = (size_t *)tinycli_malloc(TINYCLI_MEM_SCRIPT, (script->max_argc + 3) * sizeof(size_t));
+
+    if (!vm.vars || !vm.commands || !vm.argv || !vm.offsets) {
+        ret = TINYCLI_ERROR_MEMORY;
+    } else {
+        /* Variables start out empty */
+        ret = TINYCLI_SUCCESS;
+        for (i = 0; i < script->slot_count && ret == TINYCLI_SUCCESS; i++) {
+            ret = vm_set(&vm, (uint16_t)i, "", 0);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = vm_set_number(&vm, 0, 0);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = vm_set_args(&vm, argc, argv);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = vm_run(&vm);
+        }
+    }
+
+    if (vm.vars) {
+        for (i = 0; i < script->slot_count; i++) {
+            tinycli_free(vm.vars[i].str);
+        }
+    }
+    tinycli_free(vm.vars);
+    tinycli_free(vm.commands);
+    tinycli_free(vm.argv);
+    tinycli_free(vm.offsets);
+    tinycli_free(vm.scratch);
+
+    return ret;
+}
@@ -0,0 +1,362 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+#include "server.h"
+#include "context.h"
+#include "alloc.h"
+#include "runtime.h"
+
+/* Initial size of a connection's receive buffer */
+#define SERVER_RECV_INITIAL 4096
+
+/* Pending connections queued by the kernel */
+#define SERVER_BACKLOG 128
+
+/* Client connection */
+struct server_conn {
+    tinycli_server_t *server;       /* Owning server */
+    int fd;                         /* Connection socket */
+    struct server_conn *prev;       /* Previous connection */
+    struct server_conn *next;       /* Next connection */
+};
+
+/* Unix socket server */
+struct tinycli_server {
+    tinycli_runtime_t *runtime;     /* Runtime for client contexts */
+    char *path;                     /* Socket path */
+    int listen_fd;                  /* Listening socket */
+    int wake[2];                    /* Self-pipe used to stop the accept loop */
+    pthread_mutex_t lock;           /* Protects the connection list */
+    pthread_cond_t idle;            /* Signalled when a connection closes */
+    struct server_conn *conns;      /* Open connections */
+};
+
+tinycli_server_t *tinycli_server_create(tinycli_runtime_t *runtime, const char *socket_path)
+{
+    tinycli_server_t *server;
+    struct sockaddr_un addr;
+    struct stat st;
+    int fd;
+
+    if (!socket_path || strlen(socket_path) >= sizeof(addr.sun_path)) {
+        return NULL;
+    }
+
+    server = (tinycli_server_t *)tinycli_calloc(TINYCLI_MEM_CORE, 1, sizeof(*server));
+    if (!server) {
+        return NULL;
+    }
+    server->listen_fd = -1;
+    server->wake[0] = server->wake[1] = -1;
+    pthread_mutex_init(&server->lock, NULL);
+    pthread_cond_init(&server->idle, NULL);
+
+    server->path = tinycli_mem_strdup(TINYCLI_MEM_CORE, socket_path);
+    if (!server->path || pipe(server->wake) != 0) {
+        tinycli_server_destroy(server);
+        return NULL;
+    }
+    fcntl(server->wake[0], F_SETFD, FD_CLOEXEC);
+    fcntl(server->wake[1], F_SETFD, FD_CLOEXEC);
+    fcntl(server->wake[1], F_SETFL, O_NONBLOCK);
+
+    /* Replace a stale socket from an earlier run */
+    if (stat(socket_path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(socket_path);
+    }
+
+    /* Create listening socket */
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        tinycli_server_destroy(server);
+        return NULL;
+    }
+    server->listen_fd = fd;
+    if (listen(fd, SERVER_BACKLOG) != 0) {
+        tinycli_server_destroy(server);
+        return NULL;
+    }
+
+    server->runtime = tinycli_runtime_retain(runtime ? runtime : tinycli_runtime_default());
+
+    return server;
+}
+
+/* Send a reply, retrying on partial writes */
+static int server_send(int fd, struct iovec *iov, int iovcnt)
+{
+    struct msghdr msg;
+    ssize_t n;
+
+    while (iovcnt > 0) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+
+        n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return TINYCLI_ERROR_GENERAL;
+        }
+
+        /* Skip what was written */
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Execute one request line and send the framed reply */
+static int server_handle_line(tinycli_context_t *ctx, int fd, const char *line)
+{
+    struct iovec iov[2];
+    char header[32];
+    size_t len = 0;
+    char *out;
+    int ret;
+
+    if (tinycli_output_capture_begin(ctx) != TINYCLI_SUCCESS) {
+        return TINYCLI_ERROR_GENERAL;
+    }
+    ret = tinycli_execute_line(ctx, line);
+    out = tinycli_output_capture_end(ctx, &len);
+
+    iov[0].iov_base = header;
+    iov[0].iov_len = (size_t)snprintf(header, sizeof(header), "%d %zu\n", ret, out ? len : 0);
+    iov[1].iov_base = out;
+    iov[1].iov_len = out ? len : 0;
+    ret = server_send(fd, iov, 2);
+
+    tinycli_free(out);
+    return ret;
+}
+
+/* Serve one client connection */
+static void *server_conn_thread(void *arg)
+{
+    struct server_conn *conn = (struct server_conn *)arg;
+    tinycli_server_t *server = conn->server;
+    tinycli_context_t *ctx;
+    size_t cap = SERVER_RECV_INITIAL, len = 0;
+    char *buf;
+
+    ctx = tinycli_init_with_runtime(server->runtime, "");
+    buf = (char *)tinycli_malloc(TINYCLI_MEM_CORE, cap);
+
+    while (ctx && buf && ctx->running) {
+        char *line, *nl;
+        ssize_t n;
+
+        /* Grow the buffer for long lines */
+        if (len == cap) {
+            char *new_buf;
+
+            if (cap > TINYCLI_SERVER_MAX_LINE) {
+                break;
+            }
+            new_buf = (char *)tinycli_realloc(TINYCLI_MEM_CORE, buf, cap * 2);
+            if (!new_buf) {
+                break;
+            }
+            buf = new_buf;
+            cap *= 2;
+        }
+
+        n = recv(conn->fd, buf + len, cap - len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        len += (size_t)n;
+
+        /* Execute complete lines */
+        line = buf;
+        while (ctx->running && (nl = memchr(line, '\n', len - (size_t)(line - buf))) != NULL) {
+            *nl = '\0';
+            if (nl > line && nl[-1] == '\r') {
+                nl[-1] = '\0';
+            }
+            if (server_handle_line(ctx, conn->fd, line) != TINYCLI_SUCCESS) {
+                ctx->running = false;
+            }
+            line = nl + 1;
+        }
+
+        /* Keep the partial line */
+        len -= (size_t)(line - buf);
+        memmove(buf, line, len);
+    }
+
+    tinycli_free(buf);
+    tinycli_cleanup(ctx);
+
+    /* Remove the connection (before closing, so stop never sees a reused fd) */
+    pthread_mutex_lock(&server->lock);
+    if (conn->prev) {
+        conn->prev->next = conn->next;
+    } else {
+        server->conns = conn->next;
+    }
+    if (conn->next) {
+        conn->next->prev = conn->prev;
+    }
+    pthread_cond_broadcast(&server->idle);
+    pthread_mutex_unlock(&server->lock);
+
+    close(conn->fd);
+    tinycli_free(conn);
+    return NULL;
+}
+
+/* Accept a client and start its thread */
+static void server_accept(tinycli_server_t *server)
+{
+    struct server_conn *conn;
+    pthread_attr_t attr;
+    pthread_t thread;
+    int fd;
+
+    fd = accept4(server->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+
+    conn = (struct server_conn *)tinycli_calloc(TINYCLI_MEM_CORE, 1, sizeof(*conn));
+    if (!conn) {
+        close(fd);
+        return;
+    }
+    conn->server = server;
+    conn->fd = fd;
+
+    pthread_mutex_lock(&server->lock);
+    conn->next = server->conns;
+    if (server->conns) {
+        server->conns->prev = conn;
+    }
+    server->conns = conn;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &attr, server_conn_thread, conn) != 0) {
+        server->conns = conn->next;
+        if (conn->next) {
+            conn->next->prev = NULL;
+        }
+        close(fd);
+        tinycli_free(conn);
+    }
+    pthread_attr_destroy(&attr);
+    pthread_mutex_unlock(&server->lock);
+}
+
+int tinycli_server_run(tinycli_server_t *server)
+{
+    struct pollfd fds[2];
+    struct server_conn *conn;
+    char byte;
+
+    if (!server) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    fds[0].fd = server->listen_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = server->wake[0];
+    fds[1].events = POLLIN;
+
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[1].revents) {
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            server_accept(server);
+        }
+    }
+
+    /* Drain the stop request */
+    while (read(server->wake[0], &byte, 1) < 0 && errno == EINTR) {
+    }
+
+    /* Shut down open connections and wait for their threads */
+    pthread_mutex_lock(&server->lock);
+    for (conn = server->conns; conn != NULL; conn = conn->next) {
+        shutdown(conn->fd, SHUT_RDWR);
+    }
+    while (server->conns) {
+        pthread_cond_wait(&server->idle, &server->lock);
+    }
+    pthread_mutex_unlock(&server->lock);
+
+    return TINYCLI_SUCCESS;
+}
+
+void tinycli_server_stop(tinycli_server_t *server)
+{
+    char byte = 0;
+    ssize_t n;
+
+    if (server) {
+        n = write(server->wake[1], &byte, 1);
+        (void)n;
+    }
+}
+
+void tinycli_server_destroy(tinycli_server_t *server)
+{
+    if (!server) {
+        return;
+    }
+
+    if (server->listen_fd >= 0) {
+        close(server->listen_fd);
+        unlink(server->path);
+    }
+    if (server->wake[0] >= 0) {
+        close(server->wake[0]);
+        close(server->wake[1]);
+    }
+    if (server->runtime) {
+        tinycli_runtime_release(server->runtime);
+    }
+    pthread_mutex_destroy(&server->lock);
+    pthread_cond_destroy(&server->idle);
+    tinycli_free(server->path);
+    tinycli_free(server);
+}
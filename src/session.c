@@ -0,0 +1,417 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "session.h"
+#include "context.h"
+#include "alloc.h"
+#include "utils.h"
+
+/* Output buffer size for session logs */
+#define SESSION_WRITE_BUFFER 65536
+
+/* Session recorder */
+struct tinycli_session_recorder {
+    FILE *file;                     /* Session log */
+    uint64_t last_ns;               /* Start time of the previous record */
+};
+
+/* Recorded line loaded for replay */
+typedef struct {
+    uint64_t offset_ns;             /* Start time relative to the session start */
+    int result;                     /* Recorded result code */
+    const char *line;               /* Command line */
+} replay_record_t;
+
+/* Session log loaded for replay */
+typedef struct {
+    replay_record_t *records;       /* Records in execution order */
+    size_t count;                   /* Number of records */
+    char *lines;                    /* Storage for the command lines */
+} replay_log_t;
+
+/* Replay worker state */
+typedef struct {
+    const replay_log_t *log;        /* Log to replay */
+    const tinycli_replay_options_t *options; /* Replay options */
+    uint64_t start_ns;              /* Common start time of all workers */
+    uint64_t *latencies;            /* Latency of each executed record */
+    uint64_t errors;                /* Commands that returned an error */
+    uint64_t mismatches;            /* Results that differ from the recording */
+    int ret;                        /* Worker result */
+} replay_worker_t;
+
+/* Write an unsigned LEB128 varint */
+static void session_put_varint(FILE *file, uint64_t value)
+{
+    while (value >= 0x80) {
+        putc((int)(value & 0x7f) | 0x80, file);
+        value >>= 7;
+    }
+    putc((int)value, file);
+}
+
+/* Read an unsigned LEB128 varint; returns false at the end of the buffer */
+static bool session_get_varint(const unsigned char **p, const unsigned char *end,
+                               uint64_t *value)
+{
+    uint64_t v = 0;
+    int shift = 0;
+
+    while (*p < end && shift < 64) {
+        unsigned char byte = *(*p)++;
+        v |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = v;
+            return true;
+        }
+        shift += 7;
+    }
+
+    return false;
+}
+
+int tinycli_session_record_start(tinycli_context_t *ctx, const char *path)
+{
+    tinycli_session_recorder_t *rec;
+    struct timespec now;
+    uint64_t wall_ns;
+    int i;
+
+    if (!ctx || !path) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (ctx->recorder) {
+        return TINYCLI_ERROR_GENERAL;
+    }
+
+    rec = (tinycli_session_recorder_t *)tinycli_calloc(TINYCLI_MEM_CORE, 1, sizeof(*rec));
+    if (!rec) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    rec->file = fopen(path, "wb");
+    if (!rec->file) {
+        tinycli_free(rec);
+        return TINYCLI_ERROR_GENERAL;
+    }
+    setvbuf(rec->file, NULL, _IOFBF, SESSION_WRITE_BUFFER);
+
+    /* Write header */
+    clock_gettime(CLOCK_REALTIME, &now);
+    wall_ns = (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+    fwrite(TINYCLI_SESSION_MAGIC, 1, strlen(TINYCLI_SESSION_MAGIC), rec->file);
+    for (i = 0; i < 8; i++) {
+        putc((int)((wall_ns >> (8 * i)) & 0xff), rec->file);
+    }
+
+    rec->last_ns = tinycli_time_ns();
+    ctx->recorder = rec;
+
+    return TINYCLI_SUCCESS;
+}
+
+void tinycli_session_record_stop(tinycli_context_t *ctx)
+{
+    if (!ctx || !ctx->recorder) {
+        return;
+    }
+
+    fclose(ctx->recorder->file);
+    tinycli_free(ctx->recorder);
+    ctx->recorder = NULL;
+}
+
+void tinycli_session_record_line(tinycli_context_t *ctx, const char *line,
+                                 uint64_t start_ns, uint64_t duration_ns, int result)
+{
+    tinycli_session_recorder_t *rec;
+    size_t len;
+
+    if (!ctx || !ctx->recorder || !line) {
+        return;
+    }
+
+    rec = ctx->recorder;
+    len = strlen(line);
+
+    session_put_varint(rec->file, start_ns > rec->last_ns ? start_ns - rec->last_ns : 0);
+    session_put_varint(rec->file, duration_ns);
+    session_put_varint(rec->file, ((uint64_t)(int64_t)result << 1) ^ (uint64_t)((int64_t)result >> 63));
+    session_put_varint(rec->file, len);
+    fwrite(line, 1, len, rec->file);
+
+    rec->last_ns = start_ns;
+}
+
+/* Free a loaded session log */
+static void replay_log_free(replay_log_t *log)
+{
+    tinycli_free(log->records);
+    tinycli_free(log->lines);
+    memset(log, 0, sizeof(*log));
+}
+
+/* Load a session log into memory */
+static int replay_log_load(const char *path, replay_log_t *log)
+{
+    const size_t magic_len = strlen(TINYCLI_SESSION_MAGIC);
+    const unsigned char *p, *end;
+    unsigned char *data;
+    size_t capacity = 0, used = 0;
+    uint64_t offset = 0;
+    long size;
+    FILE *file;
+
+    memset(log, 0, sizeof(*log));
+
+    /* Read the whole file */
+    file = fopen(path, "rb");
+    if (!file) {
+        return TINYCLI_ERROR_NOT_FOUND;
+    }
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size < (long)magic_len + 8) {
+        fclose(file);
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    data = (unsigned char *)tinycli_malloc(TINYCLI_MEM_CORE, (size_t)size);
+    if (!data) {
+        fclose(file);
+        return TINYCLI_ERROR_MEMORY;
+    }
+    if (fread(data, 1, (size_t)size, file) != (size_t)size ||
+        memcmp(data, TINYCLI_SESSION_MAGIC, magic_len) != 0) {
+        fclose(file);
+        tinycli_free(data);
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+    fclose(file);
+
+    /* Lines are stored NUL-terminated, which never needs more than the file size */
+    log->lines = (char *)tinycli_malloc(TINYCLI_MEM_CORE, (size_t)size);
+    if (!log->lines) {
+        tinycli_free(data);
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    /* Parse records */
+    p = data + magic_len + 8;
+    end = data + size;
+    while (p < end) {
+        uint64_t delta, duration, result, len;
+
+        if (!session_get_varint(&p, end, &delta) ||
+            !session_get_varint(&p, end, &duration) ||
+            !session_get_varint(&p, end, &result) ||
+            !session_get_varint(&p, end, &len) ||
+            len > (uint64_t)(end - p)) {
+            break;  /* Truncated record, e.g. from a crashed session */
+        }
+
+        if (log->count == capacity) {
+            size_t new_capacity = capacity ? capacity * 2 : 256;
+            replay_record_t *records = (replay_record_t *)tinycli_realloc(TINYCLI_MEM_CORE, log->records,
+                                                                         new_capacity * sizeof(*records));
+            if (!records) {
+                tinycli_free(data);
+                replay_log_free(log);
+                return TINYCLI_ERROR_MEMORY;
+            }
+            log->records = records;
+            capacity = new_capacity;
+        }
+
+        offset += delta;
+        memcpy(log->lines + used, p, (size_t)len);
+        log->lines[used + len] = '\0';
+
+        log->records[log->count].offset_ns = offset;
+        log->records[log->count].result = (int)(int64_t)((result >> 1) ^ (~(result & 1) + 1));
+        log->records[log->count].line = log->lines + used;
+        log->count++;
+
+        used += (size_t)len + 1;
+        p += len;
+    }
+
+    tinycli_free(data);
+    return TINYCLI_SUCCESS;
+}
+
+/* Sleep until a monotonic time */
+static void replay_sleep_until(uint64_t target_ns)
+{
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)(target_ns / 1000000000ull);
+    ts.tv_nsec = (long)(target_ns % 1000000000ull);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+/* Replay the log against a private context */
+static void *replay_worker(void *arg)
+{
+    replay_worker_t *worker = (replay_worker_t *)arg;
+    const tinycli_replay_options_t *options = worker->options;
+    tinycli_context_t *ctx;
+    size_t i;
+
+    ctx = tinycli_init_with_runtime(options->runtime, "");
+    if (!ctx) {
+        worker->ret = TINYCLI_ERROR_MEMORY;
+        return NULL;
+    }
+    tinycli_output_set_stream(ctx, NULL);
+
+    for (i = 0; i < worker->log->count; i++) {
+        const replay_record_t *rec = &worker->log->records[i];
+        uint64_t t0;
+        int ret;
+
+        /* Keep the recorded pacing, scaled by the speed */
+        if (options->speed > 0) {
+            replay_sleep_until(worker->start_ns + (uint64_t)((double)rec->offset_ns / options->speed));
+        }
+
+        t0 = tinycli_time_ns();
+        ret = tinycli_execute_line(ctx, rec->line);
+        worker->latencies[i] = tinycli_time_ns() - t0;
+
+        if (ret != TINYCLI_SUCCESS) {
+            worker->errors++;
+        }
+        if (ret != rec->result) {
+            worker->mismatches++;
+        }
+    }
+
+    tinycli_cleanup(ctx);
+    worker->ret = TINYCLI_SUCCESS;
+    return NULL;
+}
+
+/* Order latencies */
+static int replay_compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* Get a percentile from sorted samples */
+static uint64_t replay_percentile(const uint64_t *sorted, size_t count, double q)
+{
+    size_t i = (size_t)((double)count * q);
+
+    return sorted[i < count ? i : count - 1];
+}
+
+int tinycli_session_replay(const char *path, const tinycli_replay_options_t *options,
+                           tinycli_replay_report_t *report)
+{
+    tinycli_replay_options_t defaults;
+    replay_worker_t *workers = NULL;
+    pthread_t *threads = NULL;
+    uint64_t *latencies = NULL;
+    replay_log_t log;
+    unsigned int i, started = 0;
+    uint64_t start_ns;
+    size_t total;
+    int ret;
+
+    if (!path || !report) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (!options) {
+        memset(&defaults, 0, sizeof(defaults));
+        options = &defaults;
+    }
+    if (options->concurrency == 0 || options->speed < 0) {
+        if (options == &defaults) {
+            defaults.concurrency = 1;
+        } else {
+            return TINYCLI_ERROR_INVALID_ARGUMENT;
+        }
+    }
+
+    memset(report, 0, sizeof(*report));
+
+    ret = replay_log_load(path, &log);
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
+    }
+    if (log.count == 0) {
+        replay_log_free(&log);
+        return TINYCLI_SUCCESS;
+    }
+
+    /* One latency slot per record and worker */
+    total = log.count * options->concurrency;
+    latencies = (uint64_t *)tinycli_malloc(TINYCLI_MEM_CORE, total * sizeof(uint64_t));
+    workers = (replay_worker_t *)tinycli_calloc(TINYCLI_MEM_CORE, options->concurrency,
+                                               sizeof(replay_worker_t));
+    threads = (pthread_t *)tinycli_malloc(TINYCLI_MEM_CORE, options->concurrency * sizeof(pthread_t));
+    if (!latencies || !workers || !threads) {
+        ret = TINYCLI_ERROR_MEMORY;
+        goto cleanup;
+    }
+
+    /* Start workers */
+    start_ns = tinycli_time_ns();
+    for (i = 0; i < options->concurrency; i++) {
+        workers[i].log = &log;
+        workers[i].options = options;
+        workers[i].start_ns = start_ns;
+        workers[i].latencies = latencies + (size_t)i * log.count;
+        workers[i].ret = TINYCLI_ERROR_GENERAL;
+        if (pthread_create(&threads[i], NULL, replay_worker, &workers[i]) != 0) {
+            ret = TINYCLI_ERROR_GENERAL;
+            break;
+        }
+        started++;
+    }
+
+    /* Wait for workers and collect their counters */
+    for (i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+        if (workers[i].ret != TINYCLI_SUCCESS) {
+            ret = workers[i].ret;
+        }
+        report->errors += workers[i].errors;
+        report->mismatches += workers[i].mismatches;
+    }
+    report->elapsed = (double)(tinycli_time_ns() - start_ns) / 1e9;
+
+    if (ret != TINYCLI_SUCCESS) {
+        goto cleanup;
+    }
+
+    /* Compute throughput and latency percentiles */
+    qsort(latencies, total, sizeof(uint64_t), replay_compare_u64);
+    report->commands = total;
+    report->throughput = report->elapsed > 0 ? (double)total / report->elapsed : 0;
+    report->p50_ns = replay_percentile(latencies, total, 0.50);
+    report->p90_ns = replay_percentile(latencies, total, 0.90);
+    report->p99_ns = replay_percentile(latencies, total, 0.99);
+    report->p999_ns = replay_percentile(latencies, total, 0.999);
+    report->max_ns = latencies[total - 1];
+
+cleanup:
+    tinycli_free(threads);
+    tinycli_free(workers);
+    tinycli_free(latencies);
+    replay_log_free(&log);
+
+    return ret;
+}
@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "strpool.h"
+
+/* Arena block payload sizes; blocks double in size up to the maximum */
+#define STRPOOL_BLOCK_MIN 256
+#define STRPOOL_BLOCK_MAX 65536
+
+/* Initial hash set capacity */
+#define STRPOOL_INITIAL_CAPACITY 16
+
+/* Arena block; string data follows the header */
+struct tinycli_strpool_block {
+    struct tinycli_strpool_block *next; /* Next (older) block */
+    size_t size;                        /* Payload size */
+    size_t used;                        /* Payload bytes in use */
+};
+
+void tinycli_strpool_init(tinycli_strpool_t *pool, tinycli_mem_tag_t tag)
+{
+    if (!pool) {
+        return;
+    }
+
+    memset(pool, 0, sizeof(*pool));
+    pool->tag = tag;
+}
+
+void tinycli_strpool_destroy(tinycli_strpool_t *pool)
+{
+    struct tinycli_strpool_block *block, *next;
+
+    if (!pool) {
+        return;
+    }
+
+    /* Free arena blocks */
+    for (block = pool->blocks; block != NULL; block = next) {
+        next = block->next;
+        tinycli_free(block);
+    }
+
+    /* Free hash set */
+    tinycli_free(pool->entries);
+
+    memset(pool, 0, sizeof(*pool));
+}
+
+/* Grow the hash set to new_capacity entries */
+static int strpool_rehash(tinycli_strpool_t *pool, size_t new_capacity)
+{
+    tinycli_strpool_entry_t *entries;
+    size_t i, j, mask = new_capacity - 1;
+
+    entries = (tinycli_strpool_entry_t *)tinycli_calloc(pool->tag, new_capacity,
+                                                        sizeof(tinycli_strpool_entry_t));
+    if (!entries) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    /* Reinsert existing entries */
+    for (i = 0; i < pool->capacity; i++) {
+        if (!pool->entries[i].str) {
+            continue;
+        }
+        for (j = pool->entries[i].hash & mask; entries[j].str; j = (j + 1) & mask) {
+        }
+        entries[j] = pool->entries[i];
+    }
+
+    tinycli_free(pool->entries);
+    pool->entries = entries;
+    pool->capacity = new_capacity;
+
+    return TINYCLI_SUCCESS;
+}
+
+/* Copy a string into the arena */
+static char *strpool_store(tinycli_strpool_t *pool, const char *str, size_t len)
+{
+    struct tinycli_strpool_block *block = pool->blocks;
+    char *dst;
+
+    /* Start a new block if the current one is full */
+    if (!block || block->size - block->used < len + 1) {
+        size_t size = block ? block->size * 2 : STRPOOL_BLOCK_MIN;
+
+        if (size > STRPOOL_BLOCK_MAX) {
+            size = STRPOOL_BLOCK_MAX;
+        }
+        if (size < len + 1) {
+            size = len + 1;
+        }
+
+        block = (struct tinycli_strpool_block *)tinycli_malloc(pool->tag,
+                                                               sizeof(*block) + size);
+        if (!block) {
+            return NULL;
+        }
+        block->size = size;
+        block->used = 0;
+
+        /* Keep a partly used block in front if it has more room left */
+        if (pool->blocks && size == len + 1 &&
+            pool->blocks->size - pool->blocks->used > 0) {
+            block->next = pool->blocks->next;
+            pool->blocks->next = block;
+        } else {
+            block->next = pool->blocks;
+            pool->blocks = block;
+        }
+    }
+
+    dst = (char *)(block + 1) + block->used;
+    memcpy(dst, str, len);
+    dst[len] = '\0';
+    block->used += len + 1;
+
+    return dst;
+}
+
+const char *tinycli_strpool_intern(tinycli_strpool_t *pool, const char *str,
+                                   size_t len, uint32_t hash)
+{
+    size_t i, mask;
+    char *dst;
+
+    if (!pool || !str || len > UINT32_MAX) {
+        return NULL;
+    }
+
+    /* Keep the load factor at or below one half */
+    if ((pool->count + 1) * 2 > pool->capacity) {
+        size_t new_capacity = pool->capacity ? pool->capacity * 2 : STRPOOL_INITIAL_CAPACITY;
+        if (strpool_rehash(pool, new_capacity) != TINYCLI_SUCCESS) {
+            return NULL;
+        }
+    }
+
+    /* Look for an existing copy */
+    mask = pool->capacity - 1;
+    for (i = hash & mask; pool->entries[i].str; i = (i + 1) & mask) {
+        tinycli_strpool_entry_t *e = &pool->entries[i];
+        if (e->hash == hash && e->len == len && memcmp(e->str, str, len) == 0) {
+            return e->str;
+        }
+    }
+
+    /* Store a new copy */
+    dst = strpool_store(pool, str, len);
+    if (!dst) {
+        return NULL;
+    }
+
+    pool->entries[i].hash = hash;
+    pool->entries[i].len = (uint32_t)len;
+    pool->entries[i].str = dst;
+    pool->count++;
+    pool->bytes += len + 1;
+
+    return dst;
+}
@@ -0,0 +1,590 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <readline/readline.h>
+
+#include "timer.h"
+#include "context.h"
+#include "output.h"
+#include "alloc.h"
+#include "utils.h"
+
+/* Slot index mask */
+#define TIMER_MASK (TINYCLI_TIMER_SLOTS - 1)
+
+/* Nanoseconds per tick */
+#define TIMER_TICK_NS ((uint64_t)TINYCLI_TIMER_TICK_MS * 1000000ull)
+
+/* Ticks covered by the whole wheel */
+#define TIMER_RANGE (1ull << (TINYCLI_TIMER_SLOT_BITS * TINYCLI_TIMER_LEVELS))
+
+/* Get the timers of a context, creating them on first use */
+static tinycli_timers_t *timers_get(tinycli_context_t *ctx)
+{
+    if (!ctx->timers) {
+        ctx->timers = (tinycli_timers_t *)tinycli_calloc(TINYCLI_MEM_TIMER, 1,
+                                                         sizeof(tinycli_timers_t));
+        if (ctx->timers) {
+            ctx->timers->start_ns = tinycli_time_ns();
+            ctx->timers->next_id = 1;
+        }
+    }
+
+    return ctx->timers;
+}
+
+/* Put a timer into the slot matching its distance from now */
+static void wheel_insert(tinycli_timers_t *timers, tinycli_timer_t *timer)
+{
+    uint64_t expires = timer->expires;
+    uint64_t delta;
+    tinycli_timer_t **slot;
+    int level;
+
+    /* Overdue timers go into the current slot; far ones into the last level */
+    if (expires < timers->now) {
+        expires = timers->now;
+    }
+    delta = expires - timers->now;
+    if (delta >= TIMER_RANGE) {
+        expires = timers->now + TIMER_RANGE - 1;
+        delta = TIMER_RANGE - 1;
+    }
+
+    for (level = 0; level < TINYCLI_TIMER_LEVELS - 1; level++) {
+        if (delta < (1ull << (TINYCLI_TIMER_SLOT_BITS * (level + 1)))) {
+            break;
+        }
+    }
+
+    slot = &timers->slots[level][(expires >> (TINYCLI_TIMER_SLOT_BITS * level)) & TIMER_MASK];
+    timer->prev = NULL;
+    timer->next = *slot;
+    if (*slot) {
+        (*slot)->prev = timer;
+    }
+    *slot = timer;
+}
+
+/* Take a timer out of its slot */
+static void wheel_remove(tinycli_timers_t *timers, tinycli_timer_t *timer)
+{
+    int level;
+
+    if (timer->prev) {
+        timer->prev->next = timer->next;
+    } else if (timers->due == timer) {
+        /* Head of the timers of the tick being run */
+        timers->due = timer->next;
+    } else {
+        /* Head of its slot: find which one */
+        for (level = 0; level < TINYCLI_TIMER_LEVELS; level++) {
+            tinycli_timer_t **slot = &timers->slots[level][
+                (timer->expires >> (TINYCLI_TIMER_SLOT_BITS * level)) & TIMER_MASK];
+            if (*slot == timer) {
+                *slot = timer->next;
+                break;
+            }
+        }
+        if (level == TINYCLI_TIMER_LEVELS) {
+            /* Clamped or overdue timers sit in a slot of another tick */
+            int i;
+            for (level = 0; level < TINYCLI_TIMER_LEVELS; level++) {
+                for (i = 0; i < TINYCLI_TIMER_SLOTS; i++) {
+                    if (timers->slots[level][i] == timer) {
+                        timers->slots[level][i] = timer->next;
+                    }
+                }
+            }
+        }
+    }
+    if (timer->next) {
+        timer->next->prev = timer->prev;
+    }
+    timer->prev = NULL;
+    timer->next = NULL;
+}
+
+/* Free a timer */
+static void timer_free(tinycli_timer_t *timer)
+{
+    tinycli_free(timer->line);
+    tinycli_free(timer->last);
+    tinycli_free(timer);
+}
+
+/* Check whether output goes to a terminal */
+static bool timer_output_is_tty(tinycli_context_t *ctx)
+{
+    return !ctx->output.capturing && ctx->output.stream && isatty(fileno(ctx->output.stream));
+}
+
+/* Make room for asynchronous output below the prompt */
+static void timer_output_begin(tinycli_context_t *ctx, bool tty)
+{
+    if (!ctx->event_handler) {
+        return;
+    }
+
+    /* Clear the prompt line, or end it when it can't be cleared */
+    tinycli_output_write(ctx, tty ? "\r\033[K" : "\n", tty ? 4 : 1);
+}
+
+/* Show the prompt and pending input again */
+static void timer_output_end(tinycli_context_t *ctx)
+{
+    tinycli_output_flush(ctx);
+    if (ctx->event_handler) {
+        rl_on_new_line();
+        rl_redisplay();
+    }
+}
+
+/* Count the lines of some output */
+static unsigned int timer_count_lines(const char *text, size_t len)
+{
+    unsigned int lines = 0;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        if (text[i] == '\n') {
+            lines++;
+        }
+    }
+
+    return len > 0 && text[len - 1] != '\n' ? lines + 1 : lines;
+}
+
+/* Get the next line of some output; returns false at the end */
+static bool timer_next_line(const char **p, const char *end, const char **line, size_t *len)
+{
+    const char *nl;
+
+    if (*p >= end) {
+        return false;
+    }
+
+    nl = memchr(*p, '\n', (size_t)(end - *p));
+    *line = *p;
+    *len = nl ? (size_t)(nl - *p) : (size_t)(end - *p);
+    *p = nl ? nl + 1 : end;
+
+    return true;
+}
+
+/* Redraw a watch in place, rewriting only the lines that changed */
+static void timer_watch_redraw(tinycli_context_t *ctx, tinycli_timer_t *timer,
+                               const char *out, size_t len, unsigned int lines)
+{
+    const char *old = timer->last, *old_end = timer->last + timer->last_len;
+    const char *cur = out, *cur_end = out + len;
+    unsigned int i, total = lines > timer->last_lines ? lines : timer->last_lines;
+
+    /* The header line never changes: start on the first output line */
+    tinycli_printf(ctx, "\033[%uA", timer->last_lines - 1);
+
+    for (i = 1; i < total; i++) {
+        const char *old_line = NULL, *cur_line = NULL;
+        size_t old_len = 0, cur_len = 0;
+        bool has_old = timer_next_line(&old, old_end, &old_line, &old_len);
+        bool has_cur = timer_next_line(&cur, cur_end, &cur_line, &cur_len);
+
+        if (has_cur && has_old && old_len == cur_len && memcmp(old_line, cur_line, cur_len) == 0) {
+            /* Unchanged: step over it */
+            tinycli_output_write(ctx, "\033[1B", 4);
+        } else if (has_cur) {
+            tinycli_output_write(ctx, "\r\033[K", 4);
+            tinycli_output_write(ctx, cur_line, cur_len);
+            tinycli_output_write(ctx, "\n", 1);
+        } else {
+            /* The output got shorter */
+            tinycli_output_write(ctx, "\r\033[K\n", 5);
+        }
+    }
+
+    /* Put the prompt right below the new output */
+    if (timer->last_lines > lines) {
+        tinycli_printf(ctx, "\033[%uA", timer->last_lines - lines);
+    }
+}
+
+/* Run a watch and show what changed */
+static void timer_run_watch(tinycli_context_t *ctx, tinycli_timer_t *timer)
+{
+    bool tty = timer_output_is_tty(ctx), in_place;
+    unsigned int lines;
+    char *out;
+    size_t len;
+
+    /* Collect the output */
+    if (tinycli_output_capture_begin(ctx) != TINYCLI_SUCCESS) {
+        return;
+    }
+    tinycli_execute_line(ctx, timer->line);
+    out = tinycli_output_capture_end(ctx, &len);
+    if (!out) {
+        return;
+    }
+
+    /* Nothing to do if nothing changed */
+    if (timer->last && timer->last_len == len && memcmp(timer->last, out, len) == 0) {
+        tinycli_free(out);
+        return;
+    }
+
+    /* The header counts as the first line */
+    lines = timer_count_lines(out, len) + 1;
+
+    /* Still the last thing on screen if nothing was written since */
+    in_place = tty && timer->last && timer->last_epoch == ctx->output.epoch;
+
+    timer_output_begin(ctx, tty);
+    if (in_place) {
+        timer_watch_redraw(ctx, timer, out, len, lines);
+    } else {
+        tinycli_printf(ctx, "Every %.2fs: %s\n",
+                       (double)(timer->interval * TINYCLI_TIMER_TICK_MS) / 1000.0, timer->line);
+        tinycli_output_write(ctx, out, len);
+        if (len > 0 && out[len - 1] != '\n') {
+            tinycli_output_write(ctx, "\n", 1);
+        }
+    }
+    timer_output_end(ctx);
+
+    tinycli_free(timer->last);
+    timer->last = out;
+    timer->last_len = len;
+    timer->last_lines = lines;
+    timer->last_epoch = ctx->output.epoch;
+}
+
+/* Run a timer that is due */
+static void timer_run(tinycli_context_t *ctx, tinycli_timer_t *timer)
+{
+    tinycli_timers_t *timers = ctx->timers;
+
+    timers->running = timer;
+    if (timer->kind == TINYCLI_TIMER_WATCH) {
+        timer_run_watch(ctx, timer);
+    } else {
+        timer_output_begin(ctx, timer_output_is_tty(ctx));
+        tinycli_execute_line(ctx, timer->line);
+        timer_output_end(ctx);
+    }
+    timers->running = NULL;
+    timer->runs++;
+
+    /* The command may have cancelled its own timer */
+    if (timer->cancelled) {
+        timer_free(timer);
+        return;
+    }
+
+    /* Keep to the original schedule unless we fell a whole period behind */
+    timer->expires += timer->interval;
+    if (timer->expires <= timers->now) {
+        timer->expires = timers->now + timer->interval;
+    }
+    wheel_insert(timers, timer);
+}
+
+/* Move the timers of a slot on an upper level down */
+static void wheel_cascade(tinycli_timers_t *timers, int level)
+{
+    tinycli_timer_t **slot, *timer, *next;
+
+    slot = &timers->slots[level][(timers->now >> (TINYCLI_TIMER_SLOT_BITS * level)) & TIMER_MASK];
+    timer = *slot;
+    *slot = NULL;
+
+    for (; timer != NULL; timer = next) {
+        next = timer->next;
+        wheel_insert(timers, timer);
+    }
+}
+
+/* Advance the wheel to a tick, running the timers that expire */
+static void wheel_advance(tinycli_context_t *ctx, uint64_t target)
+{
+    tinycli_timers_t *timers = ctx->timers;
+    tinycli_timer_t **slot, *timer;
+    int level;
+
+    while (timers->now < target) {
+        /* Nothing can expire without timers */
+        if (timers->count == 0) {
+            timers->now = target;
+            break;
+        }
+
+        timers->now++;
+
+        /* Cascade the upper levels whose lower level wrapped around */
+        for (level = 1; level < TINYCLI_TIMER_LEVELS; level++) {
+            if (timers->now & ((1ull << (TINYCLI_TIMER_SLOT_BITS * level)) - 1)) {
+                break;
+            }
+            wheel_cascade(timers, level);
+        }
+
+        /* Run the timers of this tick */
+        /* The list stays reachable while it runs: a command can cancel timers in it */
+        slot = &timers->slots[0][timers->now & TIMER_MASK];
+        timers->due = *slot;
+        *slot = NULL;
+        while ((timer = timers->due) != NULL) {
+            timers->due = timer->next;
+            if (timers->due) {
+                timers->due->prev = NULL;
+            }
+            timer->prev = NULL;
+            timer->next = NULL;
+            if (timer->expires > timers->now) {
+                /* Clamped timer that isn't due yet */
+                wheel_insert(timers, timer);
+                continue;
+            }
+            timer_run(ctx, timer);
+        }
+    }
+}
+
+int tinycli_timers_run(tinycli_context_t *ctx)
+{
+    tinycli_timers_t *timers;
+
+    if (!ctx) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    timers = ctx->timers;
+    if (!timers || timers->count == 0 || timers->running) {
+        return TINYCLI_SUCCESS;
+    }
+
+    wheel_advance(ctx, (tinycli_time_ns() - timers->start_ns) / TIMER_TICK_NS);
+
+    return TINYCLI_SUCCESS;
+}
+
+int tinycli_timers_next_ms(tinycli_context_t *ctx)
+{
+    tinycli_timers_t *timers;
+    uint64_t ticks, due_ns, now_ns;
+
+    if (!ctx || !ctx->timers || ctx->timers->count == 0) {
+        return -1;
+    }
+    timers = ctx->timers;
+
+    /* The nearest busy slot of the first level, or the next cascade */
+    for (ticks = 1; ticks < TINYCLI_TIMER_SLOTS; ticks++) {
+        if (timers->slots[0][(timers->now + ticks) & TIMER_MASK]) {
+            break;
+        }
+        if (((timers->now + ticks) & TIMER_MASK) == 0) {
+            break;
+        }
+    }
+
+    due_ns = timers->start_ns + (timers->now + ticks) * TIMER_TICK_NS;
+    now_ns = tinycli_time_ns();
+    if (due_ns <= now_ns) {
+        return 0;
+    }
+
+    return (int)((due_ns - now_ns + 999999) / 1000000);
+}
+
+int tinycli_timer_add(tinycli_context_t *ctx, tinycli_timer_kind_t kind,
+                      unsigned long interval_ms, const char *line, unsigned int *id)
+{
+    tinycli_timers_t *timers;
+    tinycli_timer_t *timer, **tail;
+
+    if (!ctx || !line || interval_ms < TINYCLI_TIMER_TICK_MS) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    timers = timers_get(ctx);
+    if (!timers) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    timer = (tinycli_timer_t *)tinycli_calloc(TINYCLI_MEM_TIMER, 1, sizeof(*timer));
+    if (!timer) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+    timer->line = tinycli_mem_strdup(TINYCLI_MEM_TIMER, line);
+    if (!timer->line) {
+        tinycli_free(timer);
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    /* Catch the wheel up before scheduling relative to it */
+    if (!timers->running) {
+        wheel_advance(ctx, (tinycli_time_ns() - timers->start_ns) / TIMER_TICK_NS);
+    }
+
+    timer->kind = kind;
+    timer->id = timers->next_id++;
+    timer->interval = (interval_ms + TINYCLI_TIMER_TICK_MS - 1) / TINYCLI_TIMER_TICK_MS;
+    timer->expires = timers->now + timer->interval;
+    wheel_insert(timers, timer);
+    timers->count++;
+
+    /* Keep the list in id order */
+    for (tail = &timers->all; *tail; tail = &(*tail)->all_next) {
+    }
+    *tail = timer;
+
+    if (id) {
+        *id = timer->id;
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+int tinycli_timer_cancel(tinycli_context_t *ctx, unsigned int id)
+{
+    tinycli_timers_t *timers;
+    tinycli_timer_t **link, *timer;
+    bool found = false;
+
+    if (!ctx) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    timers = ctx->timers;
+    if (!timers) {
+        return TINYCLI_ERROR_NOT_FOUND;
+    }
+
+    for (link = &timers->all; (timer = *link) != NULL;) {
+        if (id != 0 && timer->id != id) {
+            link = &timer->all_next;
+            continue;
+        }
+
+        *link = timer->all_next;
+        timers->count--;
+        found = true;
+
+        /* A running timer is out of the wheel and freed when it returns */
+        if (timer == timers->running) {
+            timer->cancelled = true;
+        } else {
+            wheel_remove(timers, timer);
+            timer_free(timer);
+        }
+    }
+
+    return found ? TINYCLI_SUCCESS : TINYCLI_ERROR_NOT_FOUND;
+}
+
+int tinycli_timer_list(tinycli_context_t *ctx)
+{
+    tinycli_timer_t *timer;
+    uint64_t now;
+    int ret;
+
+    if (!ctx) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (!ctx->timers || !ctx->timers->all) {
+        if (tinycli_get_output_format(ctx) == TINYCLI_FORMAT_TEXT) {
+            tinycli_printf(ctx, "No timers\n");
+        }
+        return TINYCLI_SUCCESS;
+    }
+    now = ctx->timers->now;
+
+    ret = tinycli_table_begin(ctx, "timers");
+    for (timer = ctx->timers->all; timer != NULL && ret == TINYCLI_SUCCESS; timer = timer->all_next) {
+        ret = tinycli_record_begin(ctx);
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_int(ctx, "id", timer->id);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_string(ctx, "kind",
+                                      timer->kind == TINYCLI_TIMER_WATCH ? "watch" : "every");
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_int(ctx, "interval_ms",
+                                   (long long)(timer->interval * TINYCLI_TIMER_TICK_MS));
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_int(ctx, "next_ms", timer->expires > now ?
+                                   (long long)((timer->expires - now) * TINYCLI_TIMER_TICK_MS) : 0);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_int(ctx, "runs", (long long)timer->runs);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_emit_string(ctx, "command", timer->line);
+        }
+        if (ret == TINYCLI_SUCCESS) {
+            ret = tinycli_record_end(ctx);
+        } else {
+            tinycli_record_end(ctx);
+        }
+    }
+    if (ret != TINYCLI_SUCCESS) {
+        tinycli_table_end(ctx);
+        return ret;
+    }
+
+    return tinycli_table_end(ctx);
+}
+
+int tinycli_timer_parse_interval(const char *text, unsigned long *interval_ms)
+{
+    char *end;
+    double value, scale;
+
+    if (!text || !interval_ms) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    value = strtod(text, &end);
+    if (end == text || value <= 0) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (*end == '\0' || strcmp(end, "s") == 0) {
+        scale = 1000.0;
+    } else if (strcmp(end, "ms") == 0) {
+        scale = 1.0;
+    } else if (strcmp(end, "m") == 0) {
+        scale = 60000.0;
+    } else if (strcmp(end, "h") == 0) {
+        scale = 3600000.0;
+    } else {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    value *= scale;
+    if (value < TINYCLI_TIMER_TICK_MS || value > 1e12) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+    *interval_ms = (unsigned long)value;
+
+    return TINYCLI_SUCCESS;
+}
+
+void tinycli_timers_free(tinycli_timers_t *timers)
+{
+    tinycli_timer_t *timer, *next;
+
+    if (!timers) {
+        return;
+    }
+
+    for (timer = timers->all; timer != NULL; timer = next) {
+        next = timer->all_next;
+        timer_free(timer);
+    }
+    tinycli_free(timers);
+}
@@ -2,154 +2,341 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 #include <readline/readline.h>
 #include <readline/history.h>
 
 #include "tinycli.h"
+#include "alloc.h"
 #include "context.h"
 #include "command.h"
 #include "plugin.h"
 #include "utils.h"
+#include "runtime.h"
+#include "session.h"
+#include "alias.h"
+#include "cancel.h"
 
-/* Global plugin directory path */
-static char *g_plugin_dir = NULL;
-
-/* Global context for readline */
-static tinycli_context_t *g_readline_ctx = NULL;
-
-/* Our own implementation of rl_get_closure and rl_set_closure */
-static void *tinycli_rl_get_closure(void)
-{
-    return g_readline_ctx;
-}
-
-static void tinycli_rl_set_closure(void *ctx)
-{
-    g_readline_ctx = (tinycli_context_t *)ctx;
-}
+/* Context that currently owns the terminal (readline state is process-wide) */
+static tinycli_context_t *g_terminal_ctx = NULL;
 
 /* Readline completion function */
 static char **tinycli_completion(const char *text, int start, int end);
 
-/* Readline initialization */
-static void tinycli_readline_init(tinycli_context_t *ctx);
+/* Attach readline to a context */
+static int tinycli_readline_attach(tinycli_context_t *ctx);
+
+/* Detach readline from a context */
+static void tinycli_readline_detach(tinycli_context_t *ctx);
 
-/* Readline cleanup */
-static void tinycli_readline_cleanup(void);
+/* Readline callback for completed lines in event-loop mode */
+static void tinycli_line_handler(char *line);
 
-/* Initialize plugin directory */
-static void init_plugin_directory(void)
+tinycli_context_t *tinycli_init(const char *prompt)
 {
-    /* Get plugin directory from environment or executable location */
-    extern const char* get_plugin_directory(void);
-    const char *dir = get_plugin_directory();
-    if (dir) {
-        tinycli_set_plugin_dir(dir);
-    }
+    return tinycli_init_with_runtime(NULL, prompt);
 }
 
-tinycli_context_t *tinycli_init(const char *prompt)
+tinycli_context_t *tinycli_init_with_runtime(tinycli_runtime_t *runtime, const char *prompt)
 {
-    tinycli_context_t *ctx = tinycli_context_create();
+    tinycli_context_t *ctx = tinycli_context_create(runtime ? runtime : tinycli_runtime_default());
     if (!ctx) {
         return NULL;
     }
     
     /* Set prompt */
-    ctx->prompt = tinycli_strdup(prompt ? prompt : "tinycli> ");
+    ctx->prompt = tinycli_mem_strdup(TINYCLI_MEM_CORE, prompt ? prompt : "tinycli> ");
     if (!ctx->prompt) {
         tinycli_context_free(ctx);
         return NULL;
     }
 
-    /* Initialize plugin directory */
-    init_plugin_directory();
-
     /* Register built-in commands */
     if (tinycli_register_builtins(ctx) != TINYCLI_SUCCESS) {
         tinycli_context_free(ctx);
         return NULL;
     }
 
-    /* Initialize readline */
-    tinycli_readline_init(ctx);
-
     return ctx;
 }
 
 void tinycli_cleanup(tinycli_context_t *ctx)
 {
     if (ctx) {
-        /* Cleanup readline */
-        tinycli_readline_cleanup();
+        /* Free saved history */
+        if (ctx->history) {
+            HISTORY_STATE empty;
+
+            history_set_history_state(ctx->history);
+            clear_history();
+            free(history_list());
+            memset(&empty, 0, sizeof(empty));
+            history_set_history_state(&empty);
+            free(ctx->history);
+            ctx->history = NULL;
+        }
 
         /* Free context */
         tinycli_context_free(ctx);
     }
-
-    /* Free plugin directory path */
-    if (g_plugin_dir) {
-        free(g_plugin_dir);
-        g_plugin_dir = NULL;
-    }
 }
 
 int tinycli_run(tinycli_context_t *ctx)
 {
-    char *line;
-    int argc;
-    char **argv;
-    int ret = TINYCLI_SUCCESS;
+    int ret;
 
     if (!ctx) {
         return TINYCLI_ERROR_INVALID_ARGUMENT;
     }
 
-    ctx->running = true;
+    /* The blocking loop is the event loop with nothing else on it */
+    ret = tinycli_event_begin(ctx);
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
+    }
+
     while (ctx->running) {
-        /* Read a line */
-        line = readline(ctx->prompt);
-        if (!line) {
-            /* EOF (Ctrl+D) */
-            printf("\n");
+        ret = tinycli_poll_once(ctx, -1);
+        if (ret < 0) {
             break;
         }
+    }
 
-        /* Skip empty lines */
-        if (line[0] == '\0') {
-            free(line);
-            continue;
-        }
+    tinycli_event_end(ctx);
 
-        /* Add to history */
+    return ret < 0 ? ret : ctx->event_result;
+}
+
+int tinycli_event_begin(tinycli_context_t *ctx)
+{
+    if (!ctx) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    /* Take over the terminal */
+    if (tinycli_readline_attach(ctx) != TINYCLI_SUCCESS) {
+        return TINYCLI_ERROR_GENERAL;
+    }
+
+    ctx->running = true;
+    ctx->event_mode = true;
+    ctx->event_result = TINYCLI_SUCCESS;
+
+    /* Show the prompt; input arrives through tinycli_event_process() */
+    rl_callback_handler_install(ctx->prompt, tinycli_line_handler);
+    ctx->event_handler = true;
+
+    return TINYCLI_SUCCESS;
+}
+
+int tinycli_event_fd(tinycli_context_t *ctx)
+{
+    if (!ctx || !ctx->event_mode) {
+        return -1;
+    }
+
+    return fileno(rl_instream ? rl_instream : stdin);
+}
+
+int tinycli_event_process(tinycli_context_t *ctx)
+{
+    if (!ctx || !ctx->event_mode) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (ctx->event_handler) {
+        rl_callback_read_char();
+    }
+
+    return TINYCLI_SUCCESS;
+}
+
+int tinycli_poll_once(tinycli_context_t *ctx, int timeout_ms)
+{
+    struct pollfd pfd;
+    int n, ret, next_ms;
+
+    if (!ctx || !ctx->event_mode) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+    if (!ctx->running) {
+        return 0;
+    }
+
+    pfd.fd = tinycli_event_fd(ctx);
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    /* Wake up for the next periodic command */
+    next_ms = tinycli_timers_next_ms(ctx);
+    if (next_ms >= 0 && (timeout_ms < 0 || next_ms < timeout_ms)) {
+        timeout_ms = next_ms;
+    }
+
+    n = poll(&pfd, 1, timeout_ms);
+    if (n < 0) {
+        return errno == EINTR ? 0 : TINYCLI_ERROR_GENERAL;
+    }
+
+    tinycli_timers_run(ctx);
+    if (n == 0 || !ctx->running) {
+        return 0;
+    }
+
+    /* A hangup without data still has to reach readline as end of input */
+    ret = tinycli_event_process(ctx);
+    return ret == TINYCLI_SUCCESS ? 1 : ret;
+}
+
+int tinycli_event_epoll_add(tinycli_context_t *ctx, int epfd)
+{
+#ifdef __linux__
+    struct epoll_event event;
+
+    if (!ctx || !ctx->event_mode || epfd < 0 || ctx->epoll_fd >= 0) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.ptr = ctx;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, tinycli_event_fd(ctx), &event) != 0) {
+        return TINYCLI_ERROR_GENERAL;
+    }
+    ctx->epoll_fd = epfd;
+
+    return TINYCLI_SUCCESS;
+#else
+    (void)ctx;
+    (void)epfd;
+    return TINYCLI_ERROR_GENERAL;
+#endif
+}
+
+bool tinycli_is_running(tinycli_context_t *ctx)
+{
+    return ctx && ctx->running;
+}
+
+void tinycli_event_end(tinycli_context_t *ctx)
+{
+    if (!ctx || !ctx->event_mode) {
+        return;
+    }
+
+#ifdef __linux__
+    if (ctx->epoll_fd >= 0) {
+        epoll_ctl(ctx->epoll_fd, EPOLL_CTL_DEL, tinycli_event_fd(ctx), NULL);
+        ctx->epoll_fd = -1;
+    }
+#endif
+
+    if (ctx->event_handler) {
+        rl_callback_handler_remove();
+        ctx->event_handler = false;
+    }
+    ctx->event_mode = false;
+
+    /* Release the terminal */
+    tinycli_readline_detach(ctx);
+}
+
+/* Run a line completed by readline in event-loop mode */
+static void tinycli_line_handler(char *line)
+{
+    tinycli_context_t *ctx = g_terminal_ctx;
+
+    /* The echoed input moved the screen on */
+    ctx->output.epoch++;
+
+    if (!line) {
+        /* EOF (Ctrl+D) */
+        printf("\n");
+        ctx->running = false;
+    } else if (line[0] != '\0') {
+        /* Add to history and execute */
         add_history(line);
+        ctx->event_result = tinycli_execute_line(ctx, line);
+        tinycli_output_flush(ctx);
+    }
+    free(line);
 
-        /* Parse line */
-        if (tinycli_parse_line(line, &argc, &argv) != TINYCLI_SUCCESS) {
-            free(line);
-            continue;
-        }
+    /* Don't show another prompt once the loop is done */
+    if (!ctx->running) {
+        rl_callback_handler_remove();
+        ctx->event_handler = false;
+    }
+}
 
-        /* Handle special case: ? (help) */
-        if (strcmp(argv[0], "?") == 0) {
-            tinycli_command_list(ctx);
-        } else {
-            /* Find command */
-            tinycli_command_t *cmd = tinycli_command_find(ctx, argv[0]);
-            if (cmd) {
-                /* Execute command */
-                ret = tinycli_command_execute(ctx, cmd, argc, argv);
-                if (ret != TINYCLI_SUCCESS) {
-                    tinycli_printf(ctx, "Command failed with error code %d\n", ret);
-                }
-            } else {
-                tinycli_printf(ctx, "Unknown command: %s\n", argv[0]);
-            }
+/* Run an alias for tinycli_invoke() */
+static int invoke_alias(tinycli_context_t *ctx, void *target, int argc, char **argv)
+{
+    return tinycli_alias_execute(ctx, (tinycli_alias_t *)target, argc, argv);
+}
+
+int tinycli_execute_line(tinycli_context_t *ctx, const char *line)
+{
+    tinycli_command_t *cmd;
+    tinycli_alias_t *alias;
+    int argc;
+    char **argv;
+    uint64_t start_ns = 0;
+    int ret;
+
+    if (!ctx || !line) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    /* A command that was given up on can't look up or run anything */
+    if (tinycli_invocation_abandoned()) {
+        return TINYCLI_ERROR_CANCELLED;
+    }
+
+    /* Only read the clock when recording */
+    if (ctx->recorder) {
+        start_ns = tinycli_time_ns();
+    }
+
+    /* Parse line */
+    ret = tinycli_parse_line(line, &argc, &argv);
+    if (ret != TINYCLI_SUCCESS || argc == 0) {
+        return ret;
+    }
+
+    /* Aliases take precedence over commands */
+    alias = ctx->aliases ? tinycli_alias_find(ctx, argv[0]) : NULL;
+    cmd = alias ? NULL : tinycli_command_find(ctx, argv[0]);
+
+    /* Execute alias or command with a cancellation token */
+    if (alias) {
+        ret = tinycli_invoke(ctx, 0, invoke_alias, alias, argc, argv);
+    } else if (cmd) {
+        ret = tinycli_command_execute(ctx, cmd, argc, argv);
+        if (ret != TINYCLI_SUCCESS && ret != TINYCLI_ERROR_CANCELLED && ret != TINYCLI_ERROR_TIMEOUT) {
+            tinycli_printf(ctx, "Command failed with error code %d\n", ret);
         }
+    } else {
+        tinycli_printf(ctx, "Unknown command: %s\n", argv[0]);
+        ret = TINYCLI_ERROR_NOT_FOUND;
+    }
 
-        /* Free arguments */
-        tinycli_free_args(argc, argv);
-        free(line);
+    if (ret == TINYCLI_ERROR_CANCELLED) {
+        tinycli_printf(ctx, "Command cancelled\n");
+    } else if (ret == TINYCLI_ERROR_TIMEOUT) {
+        tinycli_printf(ctx, "Command timed out\n");
+    }
+
+    /* Free arguments */
+    tinycli_free_args(argc, argv);
+
+    /* Append to the session log */
+    if (ctx->recorder) {
+        tinycli_session_record_line(ctx, line, start_ns, tinycli_time_ns() - start_ns, ret);
     }
 
     return ret;
@@ -158,21 +345,94 @@ int tinycli_run(tinycli_context_t *ctx)
 int tinycli_register_command(tinycli_context_t *ctx, const char *name, 
                             const char *help, tinycli_cmd_handler_t handler,
                             tinycli_completion_func_t completion)
+{
+    if (!ctx || !name || !handler) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    /* Add command to context */
+    return tinycli_context_add_command(ctx, name, help, handler, completion);
+}
+
+int tinycli_register_command_timeout(tinycli_context_t *ctx, const char *name,
+                                     const char *help, tinycli_cmd_handler_t handler,
+                                     tinycli_completion_func_t completion,
+                                     unsigned int timeout_ms)
+{
+    int ret;
+
+    ret = tinycli_register_command(ctx, name, help, handler, completion);
+    if (ret != TINYCLI_SUCCESS) {
+        return ret;
+    }
+
+    return tinycli_set_command_timeout(ctx, name, timeout_ms);
+}
+
+int tinycli_set_command_timeout(tinycli_context_t *ctx, const char *name, unsigned int timeout_ms)
 {
     tinycli_command_t *cmd;
 
-    if (!ctx || !name || !handler) {
+    if (!ctx || !name) {
         return TINYCLI_ERROR_INVALID_ARGUMENT;
     }
 
-    /* Create command */
-    cmd = tinycli_command_create(name, help, handler, completion);
+    cmd = tinycli_command_find(ctx, name);
     if (!cmd) {
-        return TINYCLI_ERROR_MEMORY;
+        return TINYCLI_ERROR_NOT_FOUND;
     }
 
-    /* Add command to context */
-    return tinycli_context_add_command(ctx, cmd);
+    cmd->info->timeout_ms = timeout_ms;
+
+    return TINYCLI_SUCCESS;
+}
+
+int tinycli_register_completion(tinycli_context_t *ctx, const char *name,
+                                tinycli_completion_v2_func_t completion, void *user_data)
+{
+    tinycli_command_t *cmd;
+
+    if (!ctx || !name || !completion) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    cmd = tinycli_command_find(ctx, name);
+    if (!cmd) {
+        return TINYCLI_ERROR_NOT_FOUND;
+    }
+
+    cmd->info->completion_v2 = completion;
+    cmd->info->completion_data = user_data;
+
+    /* Invalidate cached completions */
+    ctx->generation++;
+
+    return TINYCLI_SUCCESS;
+}
+
+int tinycli_register_async_completion(tinycli_context_t *ctx, const char *name,
+                                      tinycli_async_completion_func_t provider,
+                                      void *user_data, unsigned int deadline_ms)
+{
+    tinycli_command_t *cmd;
+    int ret;
+
+    if (!ctx || !name || !provider) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    cmd = tinycli_command_find(ctx, name);
+    if (!cmd) {
+        return TINYCLI_ERROR_NOT_FOUND;
+    }
+
+    ret = tinycli_completion_async_register(ctx, cmd, provider, user_data, deadline_ms);
+    if (ret == TINYCLI_SUCCESS) {
+        /* Invalidate cached completions */
+        ctx->generation++;
+    }
+
+    return ret;
 }
 
 int tinycli_load_plugin(tinycli_context_t *ctx, const char *plugin_path)
@@ -184,6 +444,15 @@ int tinycli_load_plugin(tinycli_context_t *ctx, const char *plugin_path)
     return tinycli_plugin_load(ctx, plugin_path);
 }
 
+int tinycli_load_plugin_bind(tinycli_context_t *ctx, const char *plugin_path, unsigned int bind)
+{
+    if (!ctx || !plugin_path) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    return tinycli_plugin_load_bind(ctx, plugin_path, bind);
+}
+
 int tinycli_load_plugin_json(tinycli_context_t *ctx, const char *json_path)
 {
     if (!ctx || !json_path) {
@@ -193,52 +462,70 @@ int tinycli_load_plugin_json(tinycli_context_t *ctx, const char *json_path)
     return tinycli_plugin_load_json(ctx, json_path);
 }
 
+int tinycli_load_aliases(tinycli_context_t *ctx, const char *path)
+{
+    if (!ctx || !path) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    return tinycli_alias_load_file(ctx, path);
+}
+
 void tinycli_printf(tinycli_context_t *ctx, const char *fmt, ...)
 {
     va_list args;
     va_start(args, fmt);
-    vprintf(fmt, args);
+    if (ctx) {
+        tinycli_output_vprintf(ctx, fmt, args);
+    } else {
+        vprintf(fmt, args);
+    }
     va_end(args);
 }
 
-const char *tinycli_get_plugin_dir(void)
+static char **tinycli_completion(const char *text, int start, int end)
 {
-    return g_plugin_dir;
+    return tinycli_command_complete(g_terminal_ctx, text, start, end);
 }
 
-void tinycli_set_plugin_dir(const char *dir)
+static int tinycli_readline_attach(tinycli_context_t *ctx)
 {
-    if (g_plugin_dir) {
-        free(g_plugin_dir);
-        g_plugin_dir = NULL;
-    }
+    tinycli_context_t *expected = NULL;
 
-    if (dir) {
-        g_plugin_dir = tinycli_strdup(dir);
+    /* Only one context can own the terminal */
+    if (!__atomic_compare_exchange_n(&g_terminal_ctx, &expected, ctx, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        return TINYCLI_ERROR_GENERAL;
     }
-}
-
-static char **tinycli_completion(const char *text, int start, int end)
-{
-    tinycli_context_t *ctx = (tinycli_context_t *)tinycli_rl_get_closure();
-    return tinycli_command_complete(ctx, text, start, end);
-}
 
-static void tinycli_readline_init(tinycli_context_t *ctx)
-{
     /* Set up readline */
     rl_attempted_completion_function = tinycli_completion;
-    tinycli_rl_set_closure(ctx);
     
     /* Allow conditional parsing of ~/.inputrc */
     rl_readline_name = "tinycli";
 
     /* Don't use completion query */
     rl_completion_query_items = 0;
+
+    /* Restore this context's history */
+    if (ctx->history) {
+        history_set_history_state(ctx->history);
+        free(ctx->history);
+        ctx->history = NULL;
+    }
+
+    return TINYCLI_SUCCESS;
 }
 
-static void tinycli_readline_cleanup(void)
+static void tinycli_readline_detach(tinycli_context_t *ctx)
 {
-    /* Clear history */
-    clear_history();
+    HISTORY_STATE empty;
+
+    /* Keep history with the context and leave readline with an empty one */
+    ctx->history = history_get_history_state();
+    memset(&empty, 0, sizeof(empty));
+    history_set_history_state(&empty);
+
+    rl_attempted_completion_function = NULL;
+    __atomic_store_n(&g_terminal_ctx, NULL, __ATOMIC_RELEASE);
 }
@@ -2,10 +2,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <libgen.h>
 
+#include "alloc.h"
 #include "utils.h"
 
 int tinycli_parse_line(const char *line, int *argc, char ***argv)
@@ -36,15 +38,15 @@ int tinycli_parse_line(const char *line, int *argc, char ***argv)
     }
 
     /* Allocate initial argument array */
-    args = (char **)malloc(capacity * sizeof(char *));
+    args = (char **)tinycli_malloc(TINYCLI_MEM_PARSER, capacity * sizeof(char *));
     if (!args) {
         return TINYCLI_ERROR_MEMORY;
     }
 
     /* Allocate buffer for arguments (same size as input line) */
-    buf = (char *)malloc(strlen(line) + 1);
+    buf = (char *)tinycli_malloc(TINYCLI_MEM_PARSER, strlen(line) + 1);
     if (!buf) {
-        free(args);
+        tinycli_free(args);
         return TINYCLI_ERROR_MEMORY;
     }
 
@@ -85,10 +87,11 @@ int tinycli_parse_line(const char *line, int *argc, char ***argv)
         /* Resize argument array if needed */
         if (count >= capacity) {
             capacity *= 2;
-            char **new_args = (char **)realloc(args, capacity * sizeof(char *));
+            char **new_args = (char **)tinycli_realloc(TINYCLI_MEM_PARSER, args,
+                                                      capacity * sizeof(char *));
             if (!new_args) {
-                free(buf);
-                free(args);
+                tinycli_free(buf);
+                tinycli_free(args);
                 return TINYCLI_ERROR_MEMORY;
             }
             args = new_args;
@@ -107,11 +110,11 @@ void tinycli_free_args(int argc, char **argv)
     if (argv) {
         /* Free argument buffer (first argument) */
         if (argc > 0 && argv[0]) {
-            free(argv[0]);
+            tinycli_free(argv[0]);
         }
 
         /* Free argument array */
-        free(argv);
+        tinycli_free(argv);
     }
 }
 
@@ -124,6 +127,7 @@ char *tinycli_strdup(const char *str)
         return NULL;
     }
 
+    /* Plugins release the copy with free(): keep it on the C library heap */
     len = strlen(str) + 1;
     dup = (char *)malloc(len);
     if (dup) {
@@ -133,6 +137,27 @@ char *tinycli_strdup(const char *str)
     return dup;
 }
 
+uint32_t tinycli_hash(const char *str, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+uint64_t tinycli_time_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
 bool tinycli_starts_with(const char *str, const char *prefix)
 {
     if (!str || !prefix) {
@@ -178,7 +203,7 @@ char *tinycli_dirname(const char *path, char *buffer, size_t size)
     }
 
     /* Copy path to temporary buffer */
-    temp = tinycli_strdup(path);
+    temp = tinycli_mem_strdup(TINYCLI_MEM_CORE, path);
     if (!temp) {
         return NULL;
     }
@@ -186,7 +211,7 @@ char *tinycli_dirname(const char *path, char *buffer, size_t size)
     /* Get directory name */
     dir = dirname(temp);
     if (!dir) {
-        free(temp);
+        tinycli_free(temp);
         return NULL;
     }
 
@@ -195,7 +220,7 @@ char *tinycli_dirname(const char *path, char *buffer, size_t size)
     buffer[size - 1] = '\0';
 
     /* Free temporary buffer */
-    free(temp);
+    tinycli_free(temp);
 
     return buffer;
 }
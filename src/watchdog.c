@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+
+#include "watchdog.h"
+#include "runtime.h"
+#include "alloc.h"
+#include "utils.h"
+
+/* Initial heap capacity */
+#define WATCHDOG_INITIAL_CAPACITY 16
+
+/* Watchdog thread and its deadline heap */
+struct tinycli_watchdog {
+    pthread_mutex_t lock;           /* Protects the heap and stop */
+    pthread_cond_t cond;            /* Signalled when the earliest deadline changes */
+    pthread_t thread;               /* Watchdog thread */
+    bool stop;                      /* Thread should exit */
+    tinycli_deadline_t **heap;      /* Armed deadlines, earliest first */
+    size_t count;                   /* Number of armed deadlines */
+    size_t cap;                     /* Heap capacity */
+};
+
+/* Put a deadline at a heap position */
+static void heap_set(tinycli_watchdog_t *watchdog, size_t i, tinycli_deadline_t *deadline)
+{
+    watchdog->heap[i] = deadline;
+    deadline->pos = i + 1;
+}
+
+/* Move a deadline towards the root while it is earlier than its parent */
+static void heap_up(tinycli_watchdog_t *watchdog, size_t i)
+{
+    tinycli_deadline_t *deadline = watchdog->heap[i];
+
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (watchdog->heap[parent]->due_ns <= deadline->due_ns) {
+            break;
+        }
+        heap_set(watchdog, i, watchdog->heap[parent]);
+        i = parent;
+    }
+    heap_set(watchdog, i, deadline);
+}
+
+/* Move a deadline towards the leaves while it is later than a child */
+static void heap_down(tinycli_watchdog_t *watchdog, size_t i)
+{
+    tinycli_deadline_t *deadline = watchdog->heap[i];
+
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= watchdog->count) {
+            break;
+        }
+        if (child + 1 < watchdog->count &&
+            watchdog->heap[child + 1]->due_ns < watchdog->heap[child]->due_ns) {
+            child++;
+        }
+        if (deadline->due_ns <= watchdog->heap[child]->due_ns) {
+            break;
+        }
+        heap_set(watchdog, i, watchdog->heap[child]);
+        i = child;
+    }
+    heap_set(watchdog, i, deadline);
+}
+
+/* Take a deadline out of the heap */
+static void heap_remove(tinycli_watchdog_t *watchdog, tinycli_deadline_t *deadline)
+{
+    size_t i = deadline->pos - 1;
+    tinycli_deadline_t *last;
+
+    deadline->pos = 0;
+    last = watchdog->heap[--watchdog->count];
+    if (last == deadline) {
+        return;
+    }
+
+    /* Fill the hole with the last deadline and restore the order */
+    heap_set(watchdog, i, last);
+    heap_up(watchdog, i);
+    heap_down(watchdog, last->pos - 1);
+}
+
+/* Convert a monotonic time in nanoseconds to a timespec */
+static void watchdog_timespec(struct timespec *ts, uint64_t ns)
+{
+    ts->tv_sec = (time_t)(ns / 1000000000ull);
+    ts->tv_nsec = (long)(ns % 1000000000ull);
+}
+
+/* Expire deadlines as they pass */
+static void *watchdog_thread(void *arg)
+{
+    tinycli_watchdog_t *watchdog = (tinycli_watchdog_t *)arg;
+    tinycli_deadline_t *deadline;
+    struct timespec ts;
+    uint64_t now;
+
+    pthread_mutex_lock(&watchdog->lock);
+    while (!watchdog->stop) {
+        if (watchdog->count == 0) {
+            pthread_cond_wait(&watchdog->cond, &watchdog->lock);
+            continue;
+        }
+
+        now = tinycli_time_ns();
+        deadline = watchdog->heap[0];
+        if (deadline->due_ns > now) {
+            watchdog_timespec(&ts, deadline->due_ns);
+            pthread_cond_timedwait(&watchdog->cond, &watchdog->lock, &ts);
+            continue;
+        }
+
+        heap_remove(watchdog, deadline);
+        deadline->expire(deadline);
+    }
+    pthread_mutex_unlock(&watchdog->lock);
+
+    return NULL;
+}
+
+/* Get the watchdog of a runtime, starting it on first use */
+static tinycli_watchdog_t *watchdog_get(tinycli_runtime_t *runtime)
+{
+    tinycli_watchdog_t *watchdog;
+    pthread_condattr_t attr;
+    sigset_t all, saved;
+    int ret;
+
+    pthread_mutex_lock(&runtime->lock);
+    watchdog = runtime->watchdog;
+    if (watchdog) {
+        pthread_mutex_unlock(&runtime->lock);
+        return watchdog;
+    }
+
+    watchdog = (tinycli_watchdog_t *)tinycli_calloc(TINYCLI_MEM_CORE, 1, sizeof(*watchdog));
+    if (!watchdog) {
+        pthread_mutex_unlock(&runtime->lock);
+        return NULL;
+    }
+    pthread_mutex_init(&watchdog->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&watchdog->cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    /* Keep signals for the threads that run commands */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &saved);
+    ret = pthread_create(&watchdog->thread, NULL, watchdog_thread, watchdog);
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+    if (ret != 0) {
+        pthread_cond_destroy(&watchdog->cond);
+        pthread_mutex_destroy(&watchdog->lock);
+        tinycli_free(watchdog);
+        pthread_mutex_unlock(&runtime->lock);
+        return NULL;
+    }
+
+    runtime->watchdog = watchdog;
+    pthread_mutex_unlock(&runtime->lock);
+
+    return watchdog;
+}
+
+int tinycli_watchdog_arm(tinycli_runtime_t *runtime, tinycli_deadline_t *deadline, uint64_t due_ns)
+{
+    tinycli_watchdog_t *watchdog;
+    tinycli_deadline_t *first;
+
+    if (!runtime || !deadline || !deadline->expire) {
+        return TINYCLI_ERROR_INVALID_ARGUMENT;
+    }
+
+    watchdog = watchdog_get(runtime);
+    if (!watchdog) {
+        return TINYCLI_ERROR_MEMORY;
+    }
+
+    pthread_mutex_lock(&watchdog->lock);
+    first = watchdog->count ? watchdog->heap[0] : NULL;
+
+    if (deadline->pos) {
+        /* Move */
+        deadline->due_ns = due_ns;
+        heap_up(watchdog, deadline->pos - 1);
+        heap_down(watchdog, deadline->pos - 1);
+    } else {
+        /* Insert */
+        if (watchdog->count == watchdog->cap) {
+            size_t cap = watchdog->cap ? watchdog->cap * 2 : WATCHDOG_INITIAL_CAPACITY;
+            tinycli_deadline_t **heap = (tinycli_deadline_t **)tinycli_realloc(
+                TINYCLI_MEM_CORE, watchdog->heap, cap * sizeof(*heap));
+            if (!heap) {
+                pthread_mutex_unlock(&watchdog->lock);
+                return TINYCLI_ERROR_MEMORY;
+            }
+            watchdog->heap = heap;
+            watchdog->cap = cap;
+        }
+        deadline->due_ns = due_ns;
+        heap_set(watchdog, watchdog->count++, deadline);
+        heap_up(watchdog, watchdog->count - 1);
+    }
+
+    /* Only the earliest deadline decides when the thread wakes up */
+    if (watchdog->heap[0] != first || first == deadline) {
+        pthread_cond_signal(&watchdog->cond);
+    }
+    pthread_mutex_unlock(&watchdog->lock);
+
+    return TINYCLI_SUCCESS;
+}
+
+void tinycli_watchdog_disarm(tinycli_runtime_t *runtime, tinycli_deadline_t *deadline)
+{
+    tinycli_watchdog_t *watchdog;
+
+    if (!runtime || !deadline) {
+        return;
+    }
+
+    pthread_mutex_lock(&runtime->lock);
+    watchdog = runtime->watchdog;
+    pthread_mutex_unlock(&runtime->lock);
+    if (!watchdog) {
+        return;
+    }
+
+    /* An earlier deadline going away doesn't need a wake-up: the thread
+       rechecks the heap when it does wake */
+    pthread_mutex_lock(&watchdog->lock);
+    if (deadline->pos) {
+        heap_remove(watchdog, deadline);
+    }
+    pthread_mutex_unlock(&watchdog->lock);
+}
+
+void tinycli_watchdog_after_fork(tinycli_runtime_t *runtime)
+{
+    if (!runtime) {
+        return;
+    }
+
+    /* The parent's watchdog and the deadlines in its heap are left behind */
+    pthread_mutex_init(&runtime->lock, NULL);
+    runtime->watchdog = NULL;
+}
+
+void tinycli_watchdog_destroy(tinycli_watchdog_t *watchdog)
+{
+    if (!watchdog) {
+        return;
+    }
+
+    pthread_mutex_lock(&watchdog->lock);
+    watchdog->stop = true;
+    pthread_cond_signal(&watchdog->cond);
+    pthread_mutex_unlock(&watchdog->lock);
+    pthread_join(watchdog->thread, NULL);
+
+    pthread_cond_destroy(&watchdog->cond);
+    pthread_mutex_destroy(&watchdog->lock);
+    tinycli_free(watchdog->heap);
+    tinycli_free(watchdog);
+}